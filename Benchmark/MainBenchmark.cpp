@@ -0,0 +1,381 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Camera.h"
+#include "Image.h"
+#include "MaterialSet.h"
+#include "Sampling.h"
+#include "SphereAccel.h"
+#include "Timer.h"
+#include "Math\Random.h"
+
+using namespace std;
+using namespace Math;
+
+
+// Benchmark parameters.  Every benchmark runs WARMUP_REPETITIONS untimed passes over its precomputed inputs,
+// then NUM_REPETITIONS timed passes, and reports the median and 95th percentile time per item.
+constexpr int WARMUP_REPETITIONS = 3;
+constexpr int NUM_REPETITIONS = 25;
+constexpr size_t NUM_RAYS = 1 << 14;
+constexpr size_t NUM_SAMPLES = 1 << 18;
+constexpr size_t SPHERE_COUNTS[] = { 8, 32, 128, 512, 2048 };
+constexpr uint32_t DATA_SEED = 1524374227u;
+
+constexpr const char* DEFAULT_OUTPUT_FILENAME = "benchmark.json";
+
+// Results are folded into this, so the compiler cannot drop the work being timed
+volatile uint32_t g_sink = 0;
+
+
+struct BenchmarkResult
+{
+	string	name;
+	size_t	itemsPerRepetition{ 0 };
+	double	medianNs{ 0.0 };
+	double	p95Ns{ 0.0 };
+	double	minNs{ 0.0 };
+};
+
+
+template <typename Func>
+BenchmarkResult RunBenchmark(const string& name, size_t itemsPerRepetition, Func&& func)
+{
+	for (int i = 0; i < WARMUP_REPETITIONS; ++i)
+	{
+		func();
+	}
+
+	vector<double> nsPerItem(NUM_REPETITIONS);
+	for (int i = 0; i < NUM_REPETITIONS; ++i)
+	{
+		Timer timer;
+		timer.Start();
+		func();
+		timer.Stop();
+
+		nsPerItem[i] = 1000.0 * timer.GetElapsedMicroseconds() / static_cast<double>(itemsPerRepetition);
+	}
+
+	sort(nsPerItem.begin(), nsPerItem.end());
+
+	// Nearest rank percentiles
+	auto percentile = [&](double p)
+	{
+		size_t rank = static_cast<size_t>(ceil(p * static_cast<double>(nsPerItem.size())));
+		return nsPerItem[min(max(rank, size_t(1)), nsPerItem.size()) - 1];
+	};
+
+	BenchmarkResult result;
+	result.name = name;
+	result.itemsPerRepetition = itemsPerRepetition;
+	result.medianNs = percentile(0.5);
+	result.p95Ns = percentile(0.95);
+	result.minNs = nsPerItem.front();
+
+	stringstream sstr;
+	sstr.precision(4);
+	sstr << fixed << name << ": median " << result.medianNs << " ns, p95 " << result.p95Ns << " ns, min " << result.minNs << " ns" << endl;
+	cout << sstr.str();
+	OutputDebugStringA(sstr.str().c_str());
+
+	return result;
+}
+
+
+// Camera rays through random points of a 90 degree view down -Z, with a small aperture
+vector<Ray> GenerateRays(RandomNumberGenerator& rng)
+{
+	Camera camera;
+	camera.LookAt(Vector3(kZero), Vector3(0.0f, 0.0f, -1.0f), Vector3(kYUnitVector), 90.0f, 1.0f, 0.05f, 20.0f);
+
+	uint32_t state = DATA_SEED | 1;
+
+	vector<Ray> rays(NUM_RAYS);
+	for (auto& ray : rays)
+	{
+		ray = camera.GetRay(rng.NextFloat(), rng.NextFloat(), state);
+	}
+	return rays;
+}
+
+
+// Flat, unsorted sphere data in front of the camera, padded to the widest SIMD size like a single BVH leaf
+struct SphereData
+{
+	vector<float, aligned_allocator<float, 64>>			centerX;
+	vector<float, aligned_allocator<float, 64>>			centerY;
+	vector<float, aligned_allocator<float, 64>>			centerZ;
+	vector<float, aligned_allocator<float, 64>>			radiusSq;
+	vector<float, aligned_allocator<float, 64>>			invRadius;
+	vector<uint32_t, aligned_allocator<uint32_t, 64>>	id;
+
+	SphereList GetList() const
+	{
+		SphereList list;
+		list.centerX = centerX.data();
+		list.centerY = centerY.data();
+		list.centerZ = centerZ.data();
+		list.radiusSq = radiusSq.data();
+		list.invRadius = invRadius.data();
+		list.id = id.data();
+		list.numSlots = id.size();
+		return list;
+	}
+};
+
+
+SphereData GenerateSpheres(RandomNumberGenerator& rng, size_t numSpheres)
+{
+	const size_t numSlots = AlignUp(numSpheres, 8);
+	const float nan = numeric_limits<float>::quiet_NaN();
+
+	SphereData data;
+	data.centerX.assign(numSlots, 0.0f);
+	data.centerY.assign(numSlots, 0.0f);
+	data.centerZ.assign(numSlots, 0.0f);
+	data.radiusSq.assign(numSlots, nan);
+	data.invRadius.assign(numSlots, nan);
+	data.id.assign(numSlots, INVALID_PRIMITIVE);
+
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const float radius = rng.NextFloat(0.2f, 1.0f);
+		data.centerX[i] = rng.NextFloat(-10.0f, 10.0f);
+		data.centerY[i] = rng.NextFloat(-10.0f, 10.0f);
+		data.centerZ[i] = rng.NextFloat(-30.0f, -10.0f);
+		data.radiusSq[i] = radius * radius;
+		data.invRadius[i] = 1.0f / radius;
+		data.id[i] = static_cast<uint32_t>(i);
+	}
+
+	return data;
+}
+
+
+template <int N>
+void BenchmarkIntersectSpheres(const vector<Ray>& rays, const SphereData& spheres, vector<BenchmarkResult>& results)
+{
+	const SphereList list = spheres.GetList();
+
+	stringstream name;
+	name << "IntersectSpheres<" << N << ">/" << count_if(spheres.id.begin(), spheres.id.end(), [](uint32_t id) { return id != INVALID_PRIMITIVE; });
+
+	results.push_back(RunBenchmark(name.str(), rays.size(), [&]()
+	{
+		uint32_t sink = 0;
+		for (const auto& sourceRay : rays)
+		{
+			Ray ray = sourceRay;
+			uint32_t hitSlot = INVALID_PRIMITIVE;
+			IntersectSpheres<N>(list, 0, list.numSlots, ray, hitSlot);
+			sink += hitSlot;
+		}
+		g_sink += sink;
+	}));
+}
+
+
+// Ray/hit pairs for shading: each ray ends on a surface with a random normal facing back towards it
+struct ShadingInput
+{
+	Ray		ray;
+	Hit		hit;
+};
+
+
+vector<ShadingInput> GenerateShadingInputs(RandomNumberGenerator& rng, const vector<Ray>& rays, uint32_t materialId)
+{
+	vector<ShadingInput> inputs(rays.size());
+	for (size_t i = 0; i < rays.size(); ++i)
+	{
+		ShadingInput& input = inputs[i];
+		input.ray = rays[i];
+		input.ray.tmax = rng.NextFloat(1.0f, 20.0f);
+
+		Vector3 dir(input.ray.dirX, input.ray.dirY, input.ray.dirZ);
+		Vector3 normal = Normalize(Vector3(rng.NextFloat(-1.0f, 1.0f), rng.NextFloat(-1.0f, 1.0f), rng.NextFloat(-1.0f, 1.0f)));
+		if (Dot(normal, dir) > 0.0f)
+		{
+			normal = -normal;
+		}
+
+		input.hit.normalX = normal.GetX();
+		input.hit.normalY = normal.GetY();
+		input.hit.normalZ = normal.GetZ();
+		input.hit.geomId = materialId;
+	}
+	return inputs;
+}
+
+
+void BenchmarkScatter(RandomNumberGenerator& rng, const vector<Ray>& rays, vector<BenchmarkResult>& results)
+{
+	MaterialSet materialSet;
+	const uint32_t lambertian = static_cast<uint32_t>(materialSet.AddLambertian(Vector3(0.5f, 0.5f, 0.5f)));
+	const uint32_t metallic = static_cast<uint32_t>(materialSet.AddMetallic(Vector3(0.7f, 0.6f, 0.5f), 0.25f));
+	const uint32_t dielectric = static_cast<uint32_t>(materialSet.AddDielectric(1.5f));
+
+	const pair<const char*, uint32_t> materials[] =
+	{
+		{ "Scatter/Lambertian", lambertian },
+		{ "Scatter/Metallic", metallic },
+		{ "Scatter/Dielectric", dielectric }
+	};
+
+	for (const auto& material : materials)
+	{
+		const auto inputs = GenerateShadingInputs(rng, rays, material.second);
+
+		results.push_back(RunBenchmark(material.first, inputs.size(), [&]()
+		{
+			uint32_t state = DATA_SEED | 1;
+			uint32_t sink = 0;
+			for (const auto& input : inputs)
+			{
+				Vector3 attenuation;
+				Ray scattered;
+				sink += materialSet.Scatter(input.ray, input.hit, attenuation, scattered, state) ? 1 : 0;
+			}
+			g_sink += sink;
+		}));
+	}
+}
+
+
+void BenchmarkCamera(RandomNumberGenerator& rng, vector<BenchmarkResult>& results)
+{
+	Camera camera;
+	camera.LookAt(Vector3(13.0f, 2.0f, 3.0f), Vector3(kZero), Vector3(kYUnitVector), 20.0f, 16.0f / 9.0f, 0.1f, 10.0f);
+
+	vector<float> uv(2 * NUM_SAMPLES);
+	for (auto& value : uv)
+	{
+		value = rng.NextFloat();
+	}
+
+	results.push_back(RunBenchmark("Camera::GetRay", NUM_SAMPLES, [&]()
+	{
+		uint32_t state = DATA_SEED | 1;
+		float sink = 0.0f;
+		for (size_t i = 0; i < NUM_SAMPLES; ++i)
+		{
+			Ray ray = camera.GetRay(uv[2 * i], uv[2 * i + 1], state);
+			sink += ray.dirX;
+		}
+		g_sink += static_cast<uint32_t>(sink);
+	}));
+}
+
+
+void BenchmarkSampling(vector<BenchmarkResult>& results)
+{
+	results.push_back(RunBenchmark("UniformUnitSphere3d", NUM_SAMPLES, [&]()
+	{
+		uint32_t state = DATA_SEED | 1;
+		Vector3 sum(kZero);
+		for (size_t i = 0; i < NUM_SAMPLES; ++i)
+		{
+			sum += UniformUnitSphere3d(state);
+		}
+		g_sink += static_cast<uint32_t>(static_cast<float>(sum.GetX()));
+	}));
+}
+
+
+void BenchmarkLinearToSRGB(RandomNumberGenerator& rng, vector<BenchmarkResult>& results)
+{
+	// Slightly past 1.0, so the clamp is exercised too
+	vector<Vector3> colors(NUM_SAMPLES);
+	for (auto& color : colors)
+	{
+		color = Vector3(rng.NextFloat(0.0f, 1.2f), rng.NextFloat(0.0f, 1.2f), rng.NextFloat(0.0f, 1.2f));
+	}
+
+	results.push_back(RunBenchmark("LinearToSRGB", NUM_SAMPLES, [&]()
+	{
+		Vector3 sum(kZero);
+		for (const auto& color : colors)
+		{
+			sum += LinearToSRGB(color);
+		}
+		g_sink += static_cast<uint32_t>(static_cast<float>(sum.GetX()));
+	}));
+}
+
+
+bool WriteJson(const char* filename, const vector<BenchmarkResult>& results)
+{
+	ofstream outfile;
+	outfile.open(filename, ios::out | ios::trunc);
+	if (!outfile.is_open())
+	{
+		return false;
+	}
+
+	outfile.precision(6);
+	outfile << fixed;
+	outfile << "{" << endl;
+	outfile << "  \"warmupRepetitions\": " << WARMUP_REPETITIONS << "," << endl;
+	outfile << "  \"repetitions\": " << NUM_REPETITIONS << "," << endl;
+	outfile << "  \"unit\": \"ns/item\"," << endl;
+	outfile << "  \"results\": [" << endl;
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& result = results[i];
+		outfile << "    { \"name\": \"" << result.name << "\", \"items\": " << result.itemsPerRepetition;
+		outfile << ", \"median\": " << result.medianNs << ", \"p95\": " << result.p95Ns << ", \"min\": " << result.minNs << " }";
+		outfile << (i + 1 < results.size() ? "," : "") << endl;
+	}
+
+	outfile << "  ]" << endl;
+	outfile << "}" << endl;
+
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+// Usage: Benchmark [output.json]
+int main(int argc, char** argv)
+{
+	const char* outputFilename = (argc > 1) ? argv[1] : DEFAULT_OUTPUT_FILENAME;
+
+	// All inputs come from a fixed seed, so every run measures the same work
+	RandomNumberGenerator rng;
+	rng.SetSeed(DATA_SEED);
+
+	const vector<Ray> rays = GenerateRays(rng);
+
+	vector<BenchmarkResult> results;
+
+	for (size_t numSpheres : SPHERE_COUNTS)
+	{
+		const SphereData spheres = GenerateSpheres(rng, numSpheres);
+
+		BenchmarkIntersectSpheres<1>(rays, spheres, results);
+		BenchmarkIntersectSpheres<4>(rays, spheres, results);
+		BenchmarkIntersectSpheres<8>(rays, spheres, results);
+	}
+
+	BenchmarkScatter(rng, rays, results);
+	BenchmarkCamera(rng, results);
+	BenchmarkSampling(results);
+	BenchmarkLinearToSRGB(rng, results);
+
+	if (!WriteJson(outputFilename, results))
+	{
+		cerr << "Failed to write " << outputFilename << endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
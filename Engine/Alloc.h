@@ -134,4 +134,12 @@ public:
 	// Allocators are not required to be assignable, so
 	// all allocators should have a deleted assignment operator. 
 	aligned_allocator& operator=(const aligned_allocator&) = delete;
-};
\ No newline at end of file
+};
+
+
+// Releases the storage of a vector, which clear() keeps
+template <typename T, typename Allocator>
+void FreeVector(std::vector<T, Allocator>& v)
+{
+	std::vector<T, Allocator>().swap(v);
+}
\ No newline at end of file
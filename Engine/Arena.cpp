@@ -0,0 +1,260 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Arena.h"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+#if defined(_WIN32)
+
+// Large pages need SeLockMemoryPrivilege, which is granted by policy but disabled in the process token by default
+bool EnableLockMemoryPrivilege()
+{
+	HANDLE token = nullptr;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+	{
+		return false;
+	}
+
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED when the account doesn't hold the privilege
+	bool enabled = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+		AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+
+	CloseHandle(token);
+	return enabled;
+}
+
+
+uint8_t* MapLargePages(size_t size, void*& base, bool& largePages)
+{
+	static const bool s_canLockMemory = EnableLockMemoryPrivilege();
+
+	const size_t minimum = GetLargePageMinimum();
+	if (s_canLockMemory && minimum != 0 && size % minimum == 0)
+	{
+		base = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (base)
+		{
+			largePages = true;
+			return static_cast<uint8_t*>(base);
+		}
+	}
+
+	// Regular pages.  VirtualAlloc only aligns to 64 KB, so reserve an extra large page and commit the aligned part.
+	base = VirtualAlloc(nullptr, size + LARGE_PAGE_SIZE, MEM_RESERVE, PAGE_NOACCESS);
+	if (!base)
+	{
+		return nullptr;
+	}
+
+	uint8_t* data = AlignUp(static_cast<uint8_t*>(base), LARGE_PAGE_SIZE);
+	if (!VirtualAlloc(data, size, MEM_COMMIT, PAGE_READWRITE))
+	{
+		VirtualFree(base, 0, MEM_RELEASE);
+		base = nullptr;
+		return nullptr;
+	}
+	return data;
+}
+
+
+void UnmapLargePages(void* base, uint8_t* data, size_t size)
+{
+	VirtualFree(base, 0, MEM_RELEASE);
+}
+
+#else
+
+uint8_t* MapLargePages(size_t size, void*& base, bool& largePages)
+{
+	// Explicit huge pages only exist when the administrator reserved some (vm.nr_hugepages)
+	base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (base != MAP_FAILED)
+	{
+		largePages = true;
+		return static_cast<uint8_t*>(base);
+	}
+
+	// Otherwise ask for transparent huge pages, which the kernel only uses for 2 MB aligned ranges.  Map an extra
+	// large page and trim the unaligned ends.
+	const size_t mappedSize = size + LARGE_PAGE_SIZE;
+	base = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+	{
+		base = nullptr;
+		return nullptr;
+	}
+
+	uint8_t* start = static_cast<uint8_t*>(base);
+	uint8_t* data = AlignUp(start, LARGE_PAGE_SIZE);
+	if (data > start)
+	{
+		munmap(start, data - start);
+	}
+	if (start + mappedSize > data + size)
+	{
+		munmap(data + size, start + mappedSize - (data + size));
+	}
+
+	madvise(data, size, MADV_HUGEPAGE);
+
+	base = data;
+	return data;
+}
+
+
+void UnmapLargePages(void* base, uint8_t* data, size_t size)
+{
+	munmap(data, size);
+}
+
+#endif
+
+} // anonymous namespace
+
+
+MemoryArena::MemoryArena(size_t capacity, ArenaPages pages, size_t alignment)
+	: m_pages(pages)
+{
+	assert(IsAligned(alignment, alignment) && alignment >= CACHE_LINE_SIZE);
+
+	if (pages == ArenaPages::Large)
+	{
+		assert(alignment <= LARGE_PAGE_SIZE);
+		m_alignment = LARGE_PAGE_SIZE;
+		m_capacity = AlignUp(max(capacity, size_t(1)), LARGE_PAGE_SIZE);
+		m_data = MapLargePages(m_capacity, m_base, m_largePages);
+	}
+	else
+	{
+		m_alignment = alignment;
+		m_capacity = AlignUp(max(capacity, size_t(1)), CACHE_LINE_SIZE);
+		m_base = _mm_malloc(m_capacity, alignment);
+		m_data = static_cast<uint8_t*>(m_base);
+	}
+
+	if (!m_data)
+	{
+		throw std::bad_alloc();
+	}
+}
+
+
+MemoryArena::~MemoryArena()
+{
+	if (m_pages == ArenaPages::Large)
+	{
+		UnmapLargePages(m_base, m_data, m_capacity);
+	}
+	else
+	{
+		_mm_free(m_base);
+	}
+}
+
+
+void* MemoryArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment <= m_alignment);
+
+	const size_t offset = AlignUp(m_used, alignment);
+	if (offset > m_capacity || size > m_capacity - offset)
+	{
+		throw std::bad_alloc();
+	}
+
+	m_used = offset + size;
+	return m_data + offset;
+}
+
+
+ScratchArena::ScratchArena(size_t capacity)
+{
+	m_blocks.push_back(make_unique<MemoryArena>(capacity, ArenaPages::Small));
+}
+
+
+void* ScratchArena::Allocate(size_t size, size_t alignment)
+{
+	MemoryArena* block = m_blocks.back().get();
+
+	const size_t offset = AlignUp(block->GetUsed(), alignment);
+	if (offset > block->GetCapacity() || size > block->GetCapacity() - offset)
+	{
+		// Chain a block at least as large as everything so far, so a growing tile needs few of them
+		m_blocks.push_back(make_unique<MemoryArena>(max(size + alignment, GetCapacity()), ArenaPages::Small));
+		block = m_blocks.back().get();
+	}
+
+	const size_t usedBefore = block->GetUsed();
+	void* data = block->Allocate(size, alignment);
+	m_used += block->GetUsed() - usedBefore;
+	return data;
+}
+
+
+void ScratchArena::Reset()
+{
+	m_highWaterMark = max(m_highWaterMark, m_used);
+	m_used = 0;
+
+	if (m_blocks.size() > 1)
+	{
+		// Padding at the ends of the chained blocks isn't counted in m_used, so leave some headroom
+		const size_t capacity = AlignUp(m_highWaterMark + m_highWaterMark / 8, CACHE_LINE_SIZE);
+		m_blocks.clear();
+		m_blocks.push_back(make_unique<MemoryArena>(capacity, ArenaPages::Small));
+	}
+	else
+	{
+		m_blocks.back()->Reset();
+	}
+}
+
+
+void ScratchArena::Reserve(size_t capacity)
+{
+	if (m_used == 0 && m_blocks.size() == 1 && m_blocks.back()->GetCapacity() < capacity)
+	{
+		m_blocks.back() = make_unique<MemoryArena>(capacity, ArenaPages::Small);
+	}
+}
+
+
+size_t ScratchArena::GetCapacity() const
+{
+	size_t capacity = 0;
+	for (const auto& block : m_blocks)
+	{
+		capacity += block->GetCapacity();
+	}
+	return capacity;
+}
+
+
+ScratchArena& GetThreadScratchArena()
+{
+	thread_local ScratchArena arena;
+	return arena;
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t LARGE_PAGE_SIZE = 2 * 1024 * 1024;
+constexpr size_t SCRATCH_ARENA_SIZE = 256 * 1024;
+
+
+enum class ArenaPages
+{
+	Small,	// Regular pages, aligned to the arena's alignment
+	Large	// 2 MB pages, so a whole arena takes a handful of TLB entries
+};
+
+
+/**
+*  One contiguous, fixed size region of memory that is handed out with a bump pointer and freed in one shot.
+*  Large page arenas are 2 MB aligned and backed by large pages where the OS grants them: MEM_LARGE_PAGES on
+*  Windows (requires the "Lock pages in memory" privilege), MAP_HUGETLB or else transparent huge pages on Linux.
+*  Without them the arena still works, on regular pages.
+*/
+class MemoryArena
+{
+public:
+	// alignment is that of the start of the arena, a power of two from a cache line up to a large page.  Large
+	// page arenas always start on a large page.
+	MemoryArena(size_t capacity, ArenaPages pages, size_t alignment = CACHE_LINE_SIZE);
+	~MemoryArena();
+
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+	// Throws std::bad_alloc when the arena is full.  alignment may not exceed the arena's.
+	void* Allocate(size_t size, size_t alignment = CACHE_LINE_SIZE);
+
+	template <typename T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(count * sizeof(T), std::max(alignof(T), CACHE_LINE_SIZE)));
+	}
+
+	// Makes the whole arena available again.  Everything allocated from it is invalidated.
+	void Reset() { m_used = 0; }
+
+	uint8_t* GetData() const { return m_data; }
+	size_t GetCapacity() const { return m_capacity; }
+	size_t GetUsed() const { return m_used; }
+	size_t GetAlignment() const { return m_alignment; }
+
+	// Whether the OS actually backed the arena with large pages (transparent huge pages are not reported)
+	bool HasLargePages() const { return m_largePages; }
+
+private:
+	void*		m_base{ nullptr };		// Start of the OS allocation, which m_data may be aligned up from
+	uint8_t*	m_data{ nullptr };
+	size_t		m_capacity{ 0 };
+	size_t		m_used{ 0 };
+	size_t		m_alignment{ CACHE_LINE_SIZE };
+	ArenaPages	m_pages;
+	bool		m_largePages{ false };
+};
+
+
+/**
+*  Per-thread scratch memory for transient data, such as per-tile sample accumulators and ray or hit batches.
+*  Allocation is a pointer bump in the current block, and Reset() releases everything at once, so per-tile data
+*  never goes through the global heap.  An allocation that doesn't fit chains another block; the next Reset()
+*  then replaces the chain with a single block of the high water mark, so a thread stops growing after its
+*  largest tile.  Reserve() pre-sizes the arena from a high water mark measured earlier.
+*/
+class ScratchArena
+{
+public:
+	explicit ScratchArena(size_t capacity = SCRATCH_ARENA_SIZE);
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment = CACHE_LINE_SIZE);
+
+	// Uninitialized storage for count objects, cache line aligned
+	template <typename T>
+	T* Allocate(size_t count)
+	{
+		return static_cast<T*>(Allocate(count * sizeof(T), std::max(alignof(T), CACHE_LINE_SIZE)));
+	}
+
+	// Arrays for Float<N>::Load and Store: cache line aligned, and padded to whole cache lines, so a SIMD load
+	// of the last elements stays inside the allocation
+	template <typename T>
+	T* AllocateSimdArray(size_t count)
+	{
+		return static_cast<T*>(Allocate(Math::AlignUp(count * sizeof(T), CACHE_LINE_SIZE), CACHE_LINE_SIZE));
+	}
+
+	// Invalidates everything allocated since the last Reset()
+	void Reset();
+
+	// Grows the arena to at least capacity bytes, e.g. to a high water mark from an earlier run.  Only has an
+	// effect while nothing is allocated.
+	void Reserve(size_t capacity);
+
+	// Bytes allocated since the last Reset(), alignment padding included
+	size_t GetUsed() const { return m_used; }
+
+	// Most bytes in use at once since the arena was created
+	size_t GetHighWaterMark() const { return std::max(m_highWaterMark, m_used); }
+
+	size_t GetCapacity() const;
+
+private:
+	std::vector<std::unique_ptr<MemoryArena>>	m_blocks;	// The last block is the current one
+	size_t										m_used{ 0 };
+	size_t										m_highWaterMark{ 0 };
+};
+
+
+// Scratch arena of the calling thread, created on first use and kept until the thread exits
+ScratchArena& GetThreadScratchArena();
\ No newline at end of file
@@ -0,0 +1,416 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "BakedFile.h"
+
+#include <cstring>
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+using namespace Math;
+using namespace std;
+
+
+bool GetBakedSourceInfo(const char* filename, BakedSourceInfo& info)
+{
+#if defined(_WIN32)
+	struct _stat64 status;
+	if (_stat64(filename, &status) != 0)
+	{
+		return false;
+	}
+#else
+	struct stat status;
+	if (stat(filename, &status) != 0)
+	{
+		return false;
+	}
+#endif
+
+	info.size = static_cast<uint64_t>(status.st_size);
+	info.modifiedTime = static_cast<int64_t>(status.st_mtime);
+	return true;
+}
+
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const char* filename)
+{
+	Close();
+
+	m_file = open(filename, O_RDONLY);
+	if (m_file < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_SHARED, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = reinterpret_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(fileStat.st_size);
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_data)
+	{
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+		m_data = nullptr;
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+	m_size = 0;
+}
+
+#endif
+
+
+BakedFileWriter::BakedFileWriter(uint32_t simdSize, uint64_t contentHash)
+	: m_simdSize(simdSize)
+	, m_contentHash(contentHash)
+{}
+
+
+void BakedFileWriter::AddSection(uint32_t tag, const void* data, size_t size, size_t alignment)
+{
+	assert(IsAligned(alignment, alignment));
+	m_sections.push_back({ tag, data, size, max(alignment, BAKED_FILE_ALIGNMENT) });
+}
+
+
+bool BakedFileWriter::SetSource(const char* filename)
+{
+	BakedSourceInfo info;
+	if (!GetBakedSourceInfo(filename, info))
+	{
+		return false;
+	}
+
+	const size_t pathLength = strlen(filename);
+	m_source.resize(sizeof(info) + pathLength);
+	memcpy(m_source.data(), &info, sizeof(info));
+	memcpy(m_source.data() + sizeof(info), filename, pathLength);
+
+	AddSection(TAG_BAKED_SOURCE, m_source);
+	return true;
+}
+
+
+void BakedFileWriter::Layout(BakedFileHeader& header, vector<BakedSection>& sectionTable) const
+{
+	sectionTable.resize(m_sections.size());
+
+	uint64_t offset = AlignUp(sizeof(BakedFileHeader) + sectionTable.size() * sizeof(BakedSection), BAKED_FILE_ALIGNMENT);
+	for (size_t i = 0; i < m_sections.size(); ++i)
+	{
+		BakedSection& section = sectionTable[i];
+		memset(&section, 0, sizeof(section));
+		offset = AlignUp(offset, m_sections[i].alignment);
+
+		section.tag = m_sections[i].tag;
+		section.alignment = static_cast<uint32_t>(m_sections[i].alignment);
+		section.offset = offset;
+		section.size = m_sections[i].size;
+
+		offset = AlignUp(offset + section.size, BAKED_FILE_ALIGNMENT);
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = BAKED_FILE_MAGIC;
+	header.version = BAKED_FILE_VERSION;
+	header.numSections = static_cast<uint32_t>(m_sections.size());
+	header.simdSize = m_simdSize;
+	header.fileSize = offset;
+	header.contentHash = m_contentHash;
+}
+
+
+bool BakedFileWriter::Write(const char* filename) const
+{
+	BakedFileHeader header;
+	vector<BakedSection> sectionTable;
+	Layout(header, sectionTable);
+
+	ofstream outfile;
+	outfile.open(filename, ios::out | ios::trunc | ios::binary);
+	if (!outfile.is_open())
+	{
+		return false;
+	}
+
+	const char padding[BAKED_FILE_ALIGNMENT] = {};
+	auto padTo = [&](uint64_t offset)
+	{
+		uint64_t pos = static_cast<uint64_t>(outfile.tellp());
+		while (pos < offset)
+		{
+			const size_t count = static_cast<size_t>(min<uint64_t>(offset - pos, BAKED_FILE_ALIGNMENT));
+			outfile.write(padding, count);
+			pos += count;
+		}
+	};
+
+	outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	outfile.write(reinterpret_cast<const char*>(sectionTable.data()), sectionTable.size() * sizeof(BakedSection));
+
+	for (size_t i = 0; i < m_sections.size(); ++i)
+	{
+		padTo(sectionTable[i].offset);
+		outfile.write(reinterpret_cast<const char*>(m_sections[i].data), m_sections[i].size);
+	}
+	padTo(header.fileSize);
+
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+size_t BakedFileWriter::GetSize() const
+{
+	BakedFileHeader header;
+	vector<BakedSection> sectionTable;
+	Layout(header, sectionTable);
+
+	return static_cast<size_t>(header.fileSize);
+}
+
+
+void BakedFileWriter::WriteTo(uint8_t* dest) const
+{
+	BakedFileHeader header;
+	vector<BakedSection> sectionTable;
+	Layout(header, sectionTable);
+
+	// Zero everything first, which takes care of the padding between sections
+	memset(dest, 0, static_cast<size_t>(header.fileSize));
+	memcpy(dest, &header, sizeof(header));
+	memcpy(dest + sizeof(header), sectionTable.data(), sectionTable.size() * sizeof(BakedSection));
+
+	for (size_t i = 0; i < m_sections.size(); ++i)
+	{
+		memcpy(dest + sectionTable[i].offset, m_sections[i].data, m_sections[i].size);
+	}
+}
+
+
+size_t BakedFileWriter::GetAlignment() const
+{
+	size_t alignment = BAKED_FILE_ALIGNMENT;
+	for (const auto& section : m_sections)
+	{
+		alignment = max(alignment, section.alignment);
+	}
+	return alignment;
+}
+
+
+bool BakedFileReader::Open(const char* filename)
+{
+	Close();
+
+	if (!m_file.Open(filename))
+	{
+		return false;
+	}
+
+	if (!Validate(m_file.GetData(), m_file.GetSize()))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+
+bool BakedFileReader::Open(const uint8_t* data, size_t size)
+{
+	Close();
+
+	return Validate(data, size);
+}
+
+
+bool BakedFileReader::Validate(const uint8_t* data, size_t size)
+{
+	if (size < sizeof(BakedFileHeader))
+	{
+		return false;
+	}
+
+	const BakedFileHeader* header = reinterpret_cast<const BakedFileHeader*>(data);
+	if (header->magic != BAKED_FILE_MAGIC || header->version != BAKED_FILE_VERSION || header->fileSize != size)
+	{
+		return false;
+	}
+
+	if (sizeof(BakedFileHeader) + header->numSections * sizeof(BakedSection) > size)
+	{
+		return false;
+	}
+
+	// Make sure every section lies inside the file and is aligned in memory, so the data can be used as-is
+	const BakedSection* sections = reinterpret_cast<const BakedSection*>(data + sizeof(BakedFileHeader));
+	for (uint32_t i = 0; i < header->numSections; ++i)
+	{
+		const BakedSection& section = sections[i];
+		const size_t alignment = max(static_cast<size_t>(section.alignment), BAKED_FILE_ALIGNMENT);
+		if (!IsAligned(section.alignment, section.alignment) || section.offset > size || section.size > size - section.offset ||
+			!IsAligned(data + section.offset, alignment))
+		{
+			return false;
+		}
+	}
+
+	m_data = data;
+	m_header = header;
+	m_sections = sections;
+	return true;
+}
+
+
+void BakedFileReader::Close()
+{
+	m_data = nullptr;
+	m_header = nullptr;
+	m_sections = nullptr;
+	m_file.Close();
+}
+
+
+bool BakedFileReader::MatchesSource(const char* filename) const
+{
+	size_t size = 0;
+	const uint8_t* source = reinterpret_cast<const uint8_t*>(FindSection(TAG_BAKED_SOURCE, size));
+	if (!source || size < sizeof(BakedSourceInfo))
+	{
+		return false;
+	}
+
+	BakedSourceInfo recorded;
+	memcpy(&recorded, source, sizeof(recorded));
+
+	const size_t pathLength = strlen(filename);
+	if (size - sizeof(recorded) != pathLength || memcmp(source + sizeof(recorded), filename, pathLength) != 0)
+	{
+		return false;
+	}
+
+	BakedSourceInfo current;
+	return GetBakedSourceInfo(filename, current) && current.size == recorded.size && current.modifiedTime == recorded.modifiedTime;
+}
+
+
+const void* BakedFileReader::FindSection(uint32_t tag, size_t& size) const
+{
+	size = 0;
+	if (!m_header)
+	{
+		return nullptr;
+	}
+
+	for (uint32_t i = 0; i < m_header->numSections; ++i)
+	{
+		if (m_sections[i].tag == tag)
+		{
+			size = static_cast<size_t>(m_sections[i].size);
+			return m_data + m_sections[i].offset;
+		}
+	}
+
+	return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+
+constexpr uint32_t BAKED_FILE_MAGIC = 0x4B425452; // 'RTBK'
+constexpr uint32_t BAKED_FILE_VERSION = 2;
+constexpr size_t BAKED_FILE_ALIGNMENT = 64;
+
+
+constexpr uint32_t MakeBakedTag(char a, char b, char c, char d)
+{
+	return uint32_t(a) | (uint32_t(b) << 8) | (uint32_t(c) << 16) | (uint32_t(d) << 24);
+}
+
+
+// The file is a 64 byte header, followed by the section table, followed by the section data.  Every section
+// starts on a 64 byte boundary, or on the larger alignment it was added with, and is referenced by its offset
+// from the start of the file, so the whole file can be mapped at any suitably aligned address and the sections
+// used in place.
+struct BakedFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	numSections;
+	uint32_t	simdSize;		// SIMD width that primitive padding was done for
+	uint64_t	fileSize;
+	uint64_t	contentHash;
+	uint8_t		reserved[32];
+};
+static_assert(sizeof(BakedFileHeader) == 64, "BakedFileHeader must be 64 bytes");
+
+
+struct BakedSection
+{
+	uint32_t	tag;
+	uint32_t	alignment;		// Of offset, at least BAKED_FILE_ALIGNMENT
+	uint64_t	offset;
+	uint64_t	size;
+	uint64_t	reserved2;
+};
+static_assert(sizeof(BakedSection) == 32, "BakedSection must be 32 bytes");
+
+
+// Identifies the file the data in a baked file was built from.  The section holds this, followed by the path.
+constexpr uint32_t TAG_BAKED_SOURCE = MakeBakedTag('S', 'R', 'C', 'F');
+
+struct BakedSourceInfo
+{
+	uint64_t	size;
+	int64_t		modifiedTime;	// Seconds since the epoch
+};
+
+// Returns false if the file doesn't exist
+bool GetBakedSourceInfo(const char* filename, BakedSourceInfo& info);
+
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* filename);
+	void Close();
+
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	const uint8_t*	m_data{ nullptr };
+	size_t			m_size{ 0 };
+
+#if defined(_WIN32)
+	HANDLE			m_file{ INVALID_HANDLE_VALUE };
+	HANDLE			m_mapping{ nullptr };
+#else
+	int				m_file{ -1 };
+#endif
+};
+
+
+class BakedFileWriter
+{
+public:
+	BakedFileWriter(uint32_t simdSize, uint64_t contentHash = 0);
+
+	// The data is not copied, and must stay valid until Write() is called.  alignment is a power of two, and
+	// values below BAKED_FILE_ALIGNMENT are raised to it.
+	void AddSection(uint32_t tag, const void* data, size_t size, size_t alignment = BAKED_FILE_ALIGNMENT);
+
+	template <typename T, typename Alloc>
+	void AddSection(uint32_t tag, const std::vector<T, Alloc>& data, size_t alignment = BAKED_FILE_ALIGNMENT)
+	{
+		AddSection(tag, data.data(), data.size() * sizeof(T), alignment);
+	}
+
+	// Records the size, modification time and path of the file the data was built from, so readers can tell
+	// when it has changed.  Returns false if the file doesn't exist.
+	bool SetSource(const char* filename);
+
+	bool Write(const char* filename) const;
+
+	// In-memory image of the file, for readers that open memory instead of a file.  dest must hold GetSize()
+	// bytes and be GetAlignment() aligned.
+	size_t GetSize() const;
+	void WriteTo(uint8_t* dest) const;
+
+	// Largest alignment of any section
+	size_t GetAlignment() const;
+
+private:
+	void Layout(BakedFileHeader& header, std::vector<BakedSection>& sectionTable) const;
+
+private:
+	struct PendingSection
+	{
+		uint32_t	tag;
+		const void*	data;
+		size_t		size;
+		size_t		alignment;
+	};
+
+	uint32_t					m_simdSize;
+	uint64_t					m_contentHash;
+	std::vector<PendingSection>	m_sections;
+	std::vector<uint8_t>		m_source;
+};
+
+
+class BakedFileReader
+{
+public:
+	// Maps the file and validates the header and section table
+	bool Open(const char* filename);
+
+	// Same, over a file image already in memory, which must stay valid until Close()
+	bool Open(const uint8_t* data, size_t size);
+
+	void Close();
+
+	bool IsOpen() const { return m_header != nullptr; }
+
+	uint32_t GetSimdSize() const { return m_header->simdSize; }
+	uint64_t GetContentHash() const { return m_header->contentHash; }
+
+	// True if the file was written with SetSource() for the same path, and that file has not changed since
+	bool MatchesSource(const char* filename) const;
+
+	// Returns nullptr if the section doesn't exist
+	const void* FindSection(uint32_t tag, size_t& size) const;
+
+	template <typename T>
+	const T* FindSection(uint32_t tag, size_t& count) const
+	{
+		size_t size = 0;
+		const void* data = FindSection(tag, size);
+		count = size / sizeof(T);
+		return reinterpret_cast<const T*>(data);
+	}
+
+private:
+	bool Validate(const uint8_t* data, size_t size);
+
+private:
+	MappedFile				m_file;
+	const uint8_t*			m_data{ nullptr };
+	const BakedFileHeader*	m_header{ nullptr };
+	const BakedSection*		m_sections{ nullptr };
+};
\ No newline at end of file
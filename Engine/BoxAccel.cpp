@@ -0,0 +1,290 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "BoxAccel.h"
+
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+// Slab test over a range of leaf slots.  Rays starting inside a box hit its far side.  Shrinks ray.tmax and
+// records the slot on a closer hit.
+template<int N>
+void IntersectBoxes(const BoxList& boxList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
+	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
+	Float<N> rayOrigZ = Float<N>::Broadcast(ray.posZ);
+	Float<N> invDirX = Float<N>::Broadcast(1.0f / ray.dirX);
+	Float<N> invDirY = Float<N>::Broadcast(1.0f / ray.dirY);
+	Float<N> invDirZ = Float<N>::Broadcast(1.0f / ray.dirZ);
+
+	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
+	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
+	UInt<N> slot(0xffffffff);
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
+	{
+		Float<N> t0X = (Float<N>::Load(boxList.minX + i) - rayOrigX) * invDirX;
+		Float<N> t0Y = (Float<N>::Load(boxList.minY + i) - rayOrigY) * invDirY;
+		Float<N> t0Z = (Float<N>::Load(boxList.minZ + i) - rayOrigZ) * invDirZ;
+		Float<N> t1X = (Float<N>::Load(boxList.maxX + i) - rayOrigX) * invDirX;
+		Float<N> t1Y = (Float<N>::Load(boxList.maxY + i) - rayOrigY) * invDirY;
+		Float<N> t1Z = (Float<N>::Load(boxList.maxZ + i) - rayOrigZ) * invDirZ;
+
+		Float<N> tNear = Max(Max(Min(t0X, t1X), Min(t0Y, t1Y)), Min(t0Z, t1Z));
+		Float<N> tFar = Min(Min(Max(t0X, t1X), Max(t0Y, t1Y)), Max(t0Z, t1Z));
+
+		// Padding slots have every bound at +inf, which puts t at +/-inf
+		Float<N> t = Select(tNear > tmin, tNear, tFar);
+		Bool<N> mask = (tNear <= tFar) & (t > tmin) & (t < hitT);
+
+		if (Any(mask))
+		{
+			hitT = Select(mask, t, hitT);
+			slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
+		}
+	}
+
+	float minT = ReduceMin(hitT);
+	if (minT < ray.tmax)
+	{
+		uint32_t minMask = Mask(hitT == Float<N>(minT));
+		uint32_t slots[N];
+		UInt<N>::StoreU(slots, slot);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
+			{
+				hitSlot = slots[lane] + lane;
+				ray.tmax = minT;
+				break;
+			}
+		}
+	}
+}
+
+
+template<>
+void IntersectBoxes<1>(const BoxList& boxList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const float invDirX = 1.0f / ray.dirX;
+	const float invDirY = 1.0f / ray.dirY;
+	const float invDirZ = 1.0f / ray.dirZ;
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
+	{
+		float t0X = (boxList.minX[i] - ray.posX) * invDirX;
+		float t0Y = (boxList.minY[i] - ray.posY) * invDirY;
+		float t0Z = (boxList.minZ[i] - ray.posZ) * invDirZ;
+		float t1X = (boxList.maxX[i] - ray.posX) * invDirX;
+		float t1Y = (boxList.maxY[i] - ray.posY) * invDirY;
+		float t1Z = (boxList.maxZ[i] - ray.posZ) * invDirZ;
+
+		float tNear = max(max(min(t0X, t1X), min(t0Y, t1Y)), min(t0Z, t1Z));
+		float tFar = min(min(max(t0X, t1X), max(t0Y, t1Y)), max(t0Z, t1Z));
+
+		float t = (tNear > ray.tmin) ? tNear : tFar;
+		if (tNear <= tFar && t > ray.tmin && t < ray.tmax)
+		{
+			ray.tmax = t;
+			hitSlot = static_cast<uint32_t>(i);
+		}
+	}
+}
+
+
+BoxAccelerator::BoxAccelerator(Scene* scene)
+	: m_scene(scene)
+	, m_streams('B')
+{}
+
+
+void BoxAccelerator::AddBox(const Vector3& minCorner, const Vector3& maxCorner, uint32_t id)
+{
+	if (m_streams.IsLoaded())
+	{
+		UnloadAccel();
+	}
+
+	const float values[6] =
+	{
+		minCorner.GetX(), minCorner.GetY(), minCorner.GetZ(),
+		maxCorner.GetX(), maxCorner.GetY(), maxCorner.GetZ()
+	};
+
+	BvhBounds bounds;
+	bounds.Grow(values[0], values[1], values[2]);
+	bounds.Grow(values[3], values[4], values[5]);
+
+	m_streams.Add(values, id, bounds);
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void BoxAccelerator::IntersectBvh(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	m_streams.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectBoxes<N>(m_boxList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		// The normal is that of the box face nearest the hit point.  Distances to the face planes stay finite for
+		// flat boxes, where both faces on the flat axis coincide and the one facing the ray is used.
+		const float hitPos[3] = { ray.posX + ray.tmax * ray.dirX, ray.posY + ray.tmax * ray.dirY, ray.posZ + ray.tmax * ray.dirZ };
+		const float boxMin[3] = { m_boxList.minX[hitSlot], m_boxList.minY[hitSlot], m_boxList.minZ[hitSlot] };
+		const float boxMax[3] = { m_boxList.maxX[hitSlot], m_boxList.maxY[hitSlot], m_boxList.maxZ[hitSlot] };
+		const float rayDir[3] = { ray.dirX, ray.dirY, ray.dirZ };
+
+		int faceAxis = 0;
+		float faceSign = 0.0f;
+		float faceDistance = FLT_MAX;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float distanceMin = fabsf(hitPos[axis] - boxMin[axis]);
+			const float distanceMax = fabsf(hitPos[axis] - boxMax[axis]);
+			const float distance = min(distanceMin, distanceMax);
+			if (distance < faceDistance)
+			{
+				faceAxis = axis;
+				faceDistance = distance;
+				if (distanceMin != distanceMax)
+				{
+					faceSign = (distanceMin < distanceMax) ? -1.0f : 1.0f;
+				}
+				else
+				{
+					faceSign = (rayDir[axis] > 0.0f) ? -1.0f : 1.0f;
+				}
+			}
+		}
+
+		hit.normalX = (faceAxis == 0) ? faceSign : 0.0f;
+		hit.normalY = (faceAxis == 1) ? faceSign : 0.0f;
+		hit.normalZ = (faceAxis == 2) ? faceSign : 0.0f;
+		hit.geomId = m_boxList.id[hitSlot];
+	}
+}
+
+
+void BoxAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectBvh<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectBvh<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectBvh<8>(ray, hit);
+	}
+}
+
+
+void BoxAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const float inf = std::numeric_limits<float>::infinity();
+	const float padValues[6] = { inf, inf, inf, inf, inf, inf };
+
+	m_streams.Build(m_scene->GetSimdSize(), true, padValues);
+	UpdateList();
+
+	m_dirty = false;
+}
+
+
+BvhBounds BoxAccelerator::GetBounds() const
+{
+	return m_streams.GetBounds();
+}
+
+
+size_t BoxAccelerator::GetMemoryUsage() const
+{
+	return m_streams.GetMemoryUsage();
+}
+
+
+uint64_t BoxAccelerator::GetContentHash() const
+{
+	return m_streams.GetContentHash();
+}
+
+
+void BoxAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	m_streams.Save(writer);
+}
+
+
+bool BoxAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	if (!m_streams.Load(reader, m_scene->GetSimdSize()))
+	{
+		return false;
+	}
+
+	UpdateList();
+
+	m_dirty = false;
+	return true;
+}
+
+
+void BoxAccelerator::UnloadAccel()
+{
+	if (!m_streams.IsLoaded())
+	{
+		return;
+	}
+
+	m_streams.Unload();
+	UpdateList();
+
+	m_dirty = true;
+}
+
+
+void BoxAccelerator::UpdateList()
+{
+	m_boxList.minX = m_streams.GetStream(0);
+	m_boxList.minY = m_streams.GetStream(1);
+	m_boxList.minZ = m_streams.GetStream(2);
+	m_boxList.maxX = m_streams.GetStream(3);
+	m_boxList.maxY = m_streams.GetStream(4);
+	m_boxList.maxZ = m_streams.GetStream(5);
+	m_boxList.id = m_streams.GetIds();
+	m_boxList.numSlots = m_streams.GetNumSlots();
+}
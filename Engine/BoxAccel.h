@@ -0,0 +1,72 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "IAccelerator.h"
+#include "PrimitiveStreams.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// View over axis-aligned box data in BVH leaf order, padded per leaf to a multiple of the SIMD width
+struct BoxList
+{
+	const float*	minX{ nullptr };
+	const float*	minY{ nullptr };
+	const float*	minZ{ nullptr };
+	const float*	maxX{ nullptr };
+	const float*	maxY{ nullptr };
+	const float*	maxZ{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
+};
+
+
+class BoxAccelerator : public IAccelerator
+{
+public:
+	BoxAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Box;
+	}
+
+	void AddBox(const Math::Vector3& minCorner, const Math::Vector3& maxCorner, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectBvh(Ray& ray, Hit& hit) const;
+
+	void UpdateList();
+
+private:
+	Scene*				m_scene;
+
+	PrimitiveStreams<6>	m_streams;
+	BoxList				m_boxList;
+
+	bool				m_dirty{ false };
+};
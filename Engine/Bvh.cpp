@@ -0,0 +1,336 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Bvh.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr int NUM_BINS = 16;
+constexpr int MAX_DEPTH = 48;
+
+
+struct SahBin
+{
+	BvhBounds bounds;
+	size_t count{ 0 };
+};
+
+
+__forceinline float Centroid(const BvhBounds& bounds, int axis)
+{
+	switch (axis)
+	{
+	case 0: return 0.5f * (bounds.minX + bounds.maxX);
+	case 1: return 0.5f * (bounds.minY + bounds.maxY);
+	default: return 0.5f * (bounds.minZ + bounds.maxZ);
+	}
+}
+
+} // anonymous namespace
+
+
+void BvhBounds::Grow(float x, float y, float z)
+{
+	minX = std::min(minX, x);
+	minY = std::min(minY, y);
+	minZ = std::min(minZ, z);
+	maxX = std::max(maxX, x);
+	maxY = std::max(maxY, y);
+	maxZ = std::max(maxZ, z);
+}
+
+
+void BvhBounds::Grow(const BvhBounds& other)
+{
+	minX = std::min(minX, other.minX);
+	minY = std::min(minY, other.minY);
+	minZ = std::min(minZ, other.minZ);
+	maxX = std::max(maxX, other.maxX);
+	maxY = std::max(maxY, other.maxY);
+	maxZ = std::max(maxZ, other.maxZ);
+}
+
+
+float BvhBounds::SurfaceArea() const
+{
+	if (IsEmpty())
+	{
+		return 0.0f;
+	}
+
+	float dx = maxX - minX;
+	float dy = maxY - minY;
+	float dz = maxZ - minZ;
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+
+void Bvh::Build(const vector<BvhBounds>& primBounds, size_t simdSize, size_t maxLeafSize)
+{
+	Clear();
+
+	m_simdSize = simdSize;
+	m_maxLeafSize = std::max(maxLeafSize, simdSize);
+
+	if (primBounds.empty())
+	{
+		return;
+	}
+
+	vector<uint32_t> indices(primBounds.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		indices[i] = static_cast<uint32_t>(i);
+	}
+
+	m_nodeStorage.reserve(2 * DivideByMultiple(primBounds.size(), simdSize));
+	m_primSlots.reserve(AlignUp(primBounds.size(), simdSize) * 2);
+
+	BuildRecursive(primBounds, indices.data(), 0, indices.size(), 0);
+
+	m_nodes = m_nodeStorage.data();
+	m_numNodes = m_nodeStorage.size();
+}
+
+
+void Bvh::Attach(const BvhNode* nodes, size_t numNodes)
+{
+	Clear();
+
+	m_nodes = nodes;
+	m_numNodes = numNodes;
+}
+
+
+bool Bvh::IsValid(const BvhNode* nodes, size_t numNodes, size_t numSlots, size_t simdSize)
+{
+	// Children always come after their parent, so one pass in index order sees every parent before its children
+	vector<uint8_t> depths(numNodes, 0);
+	for (size_t i = 0; i < numNodes; ++i)
+	{
+		const BvhNode& node = nodes[i];
+		if (node.IsLeaf())
+		{
+			if (node.offset % simdSize != 0 || node.count % simdSize != 0 || uint64_t(node.offset) + node.count > numSlots)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const size_t depth = depths[i] + 1;
+		if (node.offset <= i + 1 || node.offset >= numNodes || depth >= BVH_STACK_SIZE)
+		{
+			return false;
+		}
+
+		depths[i + 1] = max(depths[i + 1], static_cast<uint8_t>(depth));
+		depths[node.offset] = max(depths[node.offset], static_cast<uint8_t>(depth));
+	}
+
+	return true;
+}
+
+
+void Bvh::Clear()
+{
+	FreeVector(m_nodeStorage);
+	FreeVector(m_primSlots);
+	m_nodes = nullptr;
+	m_numNodes = 0;
+}
+
+
+size_t GetIdCount(const uint32_t* ids, size_t numIds)
+{
+	size_t idCount = 0;
+	for (size_t i = 0; i < numIds; ++i)
+	{
+		if (ids[i] != INVALID_PRIMITIVE)
+		{
+			idCount = max(idCount, size_t(ids[i]) + 1);
+		}
+	}
+	return idCount;
+}
+
+
+bool AreSlotIdsValid(const uint32_t* slotIds, size_t numSlots, size_t idCount)
+{
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		if (slotIds[i] != INVALID_PRIMITIVE && slotIds[i] >= idCount)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+BvhBounds Bvh::GetBounds() const
+{
+	BvhBounds bounds;
+	if (m_numNodes > 0)
+	{
+		bounds.Grow(m_nodes[0].minX, m_nodes[0].minY, m_nodes[0].minZ);
+		bounds.Grow(m_nodes[0].maxX, m_nodes[0].maxY, m_nodes[0].maxZ);
+	}
+	return bounds;
+}
+
+
+uint32_t Bvh::BuildRecursive(const vector<BvhBounds>& primBounds, uint32_t* indices, size_t begin, size_t end, int depth)
+{
+	const uint32_t nodeIndex = static_cast<uint32_t>(m_nodeStorage.size());
+	m_nodeStorage.emplace_back();
+
+	BvhBounds bounds;
+	BvhBounds centroidBounds;
+	for (size_t i = begin; i < end; ++i)
+	{
+		const BvhBounds& b = primBounds[indices[i]];
+		bounds.Grow(b);
+		centroidBounds.Grow(Centroid(b, 0), Centroid(b, 1), Centroid(b, 2));
+	}
+
+	const size_t count = end - begin;
+
+	// Costs are measured in SIMD batches, since a leaf of 1 primitive costs the same as a leaf of simdSize primitives
+	const float leafCost = static_cast<float>(DivideByMultiple(count, m_simdSize));
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	const float extent[3] =
+	{
+		centroidBounds.maxX - centroidBounds.minX,
+		centroidBounds.maxY - centroidBounds.minY,
+		centroidBounds.maxZ - centroidBounds.minZ
+	};
+	const float centroidMin[3] = { centroidBounds.minX, centroidBounds.minY, centroidBounds.minZ };
+
+	if (count > m_simdSize)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (extent[axis] <= 0.0f)
+			{
+				continue;
+			}
+
+			SahBin bins[NUM_BINS];
+			const float binScale = NUM_BINS * 0.9999f / extent[axis];
+			for (size_t i = begin; i < end; ++i)
+			{
+				const BvhBounds& b = primBounds[indices[i]];
+				int bin = static_cast<int>((Centroid(b, axis) - centroidMin[axis]) * binScale);
+				bins[bin].bounds.Grow(b);
+				++bins[bin].count;
+			}
+
+			// Sweep from the right to accumulate the right-hand costs, then from the left
+			float rightArea[NUM_BINS - 1];
+			size_t rightCount[NUM_BINS - 1];
+			BvhBounds accum;
+			size_t accumCount = 0;
+			for (int i = NUM_BINS - 1; i > 0; --i)
+			{
+				accum.Grow(bins[i].bounds);
+				accumCount += bins[i].count;
+				rightArea[i - 1] = accum.SurfaceArea();
+				rightCount[i - 1] = accumCount;
+			}
+
+			accum = BvhBounds();
+			accumCount = 0;
+			for (int i = 0; i < NUM_BINS - 1; ++i)
+			{
+				accum.Grow(bins[i].bounds);
+				accumCount += bins[i].count;
+
+				if (accumCount == 0 || rightCount[i] == 0)
+				{
+					continue;
+				}
+
+				float cost = accum.SurfaceArea() * DivideByMultiple(accumCount, m_simdSize) +
+					rightArea[i] * DivideByMultiple(rightCount[i], m_simdSize);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i;
+				}
+			}
+		}
+	}
+
+	const float parentArea = bounds.SurfaceArea();
+	const float splitCost = (parentArea > 0.0f) ? (0.5f + bestCost / parentArea) : FLT_MAX;
+
+	size_t mid = begin;
+	if (bestAxis >= 0 && (splitCost < leafCost || count > m_maxLeafSize) && depth < MAX_DEPTH)
+	{
+		const float binScale = NUM_BINS * 0.9999f / extent[bestAxis];
+		uint32_t* midPtr = std::partition(indices + begin, indices + end, [&](uint32_t index)
+		{
+			int bin = static_cast<int>((Centroid(primBounds[index], bestAxis) - centroidMin[bestAxis]) * binScale);
+			return bin <= bestSplit;
+		});
+		mid = midPtr - indices;
+	}
+	else if (count > m_maxLeafSize)
+	{
+		// No useful SAH split (coincident centroids or too deep), so fall back to an object median split
+		int axis = (extent[0] >= extent[1] && extent[0] >= extent[2]) ? 0 : (extent[1] >= extent[2] ? 1 : 2);
+		mid = begin + count / 2;
+		std::nth_element(indices + begin, indices + mid, indices + end, [&](uint32_t a, uint32_t b)
+		{
+			return Centroid(primBounds[a], axis) < Centroid(primBounds[b], axis);
+		});
+	}
+
+	BvhNode& node = m_nodeStorage[nodeIndex];
+	node.minX = bounds.minX;
+	node.minY = bounds.minY;
+	node.minZ = bounds.minZ;
+	node.maxX = bounds.maxX;
+	node.maxY = bounds.maxY;
+	node.maxZ = bounds.maxZ;
+
+	if (mid == begin || mid == end)
+	{
+		// Leaf, padded out to a multiple of the SIMD width
+		node.offset = static_cast<uint32_t>(m_primSlots.size());
+		node.count = static_cast<uint32_t>(AlignUp(count, m_simdSize));
+
+		m_primSlots.insert(m_primSlots.end(), indices + begin, indices + end);
+		m_primSlots.resize(node.offset + node.count, INVALID_PRIMITIVE);
+	}
+	else
+	{
+		BuildRecursive(primBounds, indices, begin, mid, depth + 1);
+		uint32_t rightIndex = BuildRecursive(primBounds, indices, mid, end, depth + 1);
+
+		// Note: don't hold on to the node reference across the recursive calls, since the storage may grow
+		m_nodeStorage[nodeIndex].offset = rightIndex;
+		m_nodeStorage[nodeIndex].count = 0;
+	}
+
+	return nodeIndex;
+}
\ No newline at end of file
@@ -0,0 +1,278 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "PerfCounters.h"
+
+
+constexpr uint32_t INVALID_PRIMITIVE = 0xFFFFFFFF;
+
+// Entries in the traversal stacks, which bounds the depth of a hierarchy
+constexpr size_t BVH_STACK_SIZE = 64;
+
+
+// One more than the largest id that is not INVALID_PRIMITIVE, or 0 if there is none
+size_t GetIdCount(const uint32_t* ids, size_t numIds);
+
+// Whether every slot id read from a file is padding or below idCount, so that it can index the scene's
+// per-primitive tables
+bool AreSlotIdsValid(const uint32_t* slotIds, size_t numSlots, size_t idCount);
+
+
+struct BvhBounds
+{
+	float minX{ FLT_MAX };
+	float minY{ FLT_MAX };
+	float minZ{ FLT_MAX };
+	float maxX{ -FLT_MAX };
+	float maxY{ -FLT_MAX };
+	float maxZ{ -FLT_MAX };
+
+	void Grow(float x, float y, float z);
+	void Grow(const BvhBounds& other);
+
+	float SurfaceArea() const;
+	bool IsEmpty() const { return minX > maxX; }
+};
+
+
+// 32 bytes, two nodes per cache line.  Interior nodes store their left child immediately after themselves
+// (depth-first order), and the index of the right child in offset.  Leaf nodes store the first primitive slot
+// in offset and the number of primitives in count.
+struct BvhNode
+{
+	float		minX;
+	float		minY;
+	float		minZ;
+	uint32_t	offset;
+	float		maxX;
+	float		maxY;
+	float		maxZ;
+	uint32_t	count;
+
+	__forceinline bool IsLeaf() const { return count != 0; }
+	__forceinline BvhBounds GetBounds() const { return BvhBounds{ minX, minY, minZ, maxX, maxY, maxZ }; }
+};
+
+
+class Bvh
+{
+public:
+	// Builds a binned SAH hierarchy over the primitive bounds.  Leaves are padded out to a multiple of simdSize
+	// primitive slots so that accelerators can run their Float<N> kernels directly over a leaf.
+	void Build(const std::vector<BvhBounds>& primBounds, size_t simdSize, size_t maxLeafSize);
+
+	// Attach externally owned (e.g. memory-mapped) nodes instead of building.  Check them with IsValid first when
+	// they come from a file.
+	void Attach(const BvhNode* nodes, size_t numNodes);
+
+	// Whether nodes read from a file are safe to traverse: every child comes after its parent and within numNodes,
+	// no path is deeper than the traversal stacks, and every leaf covers whole groups of simdSize slots within
+	// numSlots
+	static bool IsValid(const BvhNode* nodes, size_t numNodes, size_t numSlots, size_t simdSize);
+	void Clear();
+
+	// Maps each padded primitive slot to the original primitive index, or INVALID_PRIMITIVE for padding
+	const std::vector<uint32_t>& GetPrimitiveSlots() const { return m_primSlots; }
+
+	const BvhNode* GetNodes() const { return m_nodes; }
+	size_t GetNumNodes() const { return m_numNodes; }
+	BvhBounds GetBounds() const;
+	size_t GetMemoryUsage() const { return m_numNodes * sizeof(BvhNode); }
+
+	// Front-to-back traversal.  leafFunc(firstSlot, numSlots) is expected to shrink ray.tmax on a hit.
+	// CountNodeFetches counts the node reads with CountNodeFetch.
+	template <bool CountNodeFetches = false, typename LeafFunc>
+	void Intersect(Ray& ray, LeafFunc&& leafFunc) const;
+
+	// Calls leafFunc(firstSlot, numSlots) for every leaf whose node, and every ancestor, passes nodeFunc(node),
+	// e.g. to gather the leaves inside a volume
+	template <typename NodeFunc, typename LeafFunc>
+	void Visit(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const;
+
+private:
+	uint32_t BuildRecursive(const std::vector<BvhBounds>& primBounds, uint32_t* indices, size_t begin, size_t end, int depth);
+
+private:
+	std::vector<BvhNode, aligned_allocator<BvhNode, 64>>	m_nodeStorage;
+	std::vector<uint32_t>									m_primSlots;
+
+	const BvhNode*	m_nodes{ nullptr };
+	size_t			m_numNodes{ 0 };
+
+	size_t			m_simdSize{ 1 };
+	size_t			m_maxLeafSize{ 8 };
+};
+
+
+__forceinline bool IntersectBvhNode(const BvhNode& node, float posX, float posY, float posZ, float invDirX, float invDirY, float invDirZ, float tmin, float tmax, float& tEntry)
+{
+	float tx0 = (node.minX - posX) * invDirX;
+	float tx1 = (node.maxX - posX) * invDirX;
+	float ty0 = (node.minY - posY) * invDirY;
+	float ty1 = (node.maxY - posY) * invDirY;
+	float tz0 = (node.minZ - posZ) * invDirZ;
+	float tz1 = (node.maxZ - posZ) * invDirZ;
+
+	float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), tmin));
+	float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), tmax));
+
+	tEntry = tNear;
+	return tNear <= tFar;
+}
+
+
+template <bool CountNodeFetches, typename LeafFunc>
+void Bvh::Intersect(Ray& ray, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0)
+	{
+		return;
+	}
+
+	const float invDirX = 1.0f / ray.dirX;
+	const float invDirY = 1.0f / ray.dirY;
+	const float invDirZ = 1.0f / ray.dirZ;
+
+	if (CountNodeFetches)
+	{
+		CountNodeFetch(&m_nodes[0]);
+	}
+
+	float tEntry = 0.0f;
+	if (!IntersectBvhNode(m_nodes[0], ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tEntry))
+	{
+		return;
+	}
+
+	uint32_t stack[64];
+	float stackT[64];
+	int stackSize = 0;
+
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const BvhNode& node = m_nodes[nodeIndex];
+
+		if (node.IsLeaf())
+		{
+			leafFunc(node.offset, node.count);
+		}
+		else
+		{
+			const uint32_t leftIndex = nodeIndex + 1;
+			const uint32_t rightIndex = node.offset;
+
+			if (CountNodeFetches)
+			{
+				CountNodeFetch(&m_nodes[leftIndex]);
+				CountNodeFetch(&m_nodes[rightIndex]);
+			}
+
+			float tLeft = 0.0f;
+			float tRight = 0.0f;
+			bool hitLeft = IntersectBvhNode(m_nodes[leftIndex], ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tLeft);
+			bool hitRight = IntersectBvhNode(m_nodes[rightIndex], ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tRight);
+
+			if (hitLeft && hitRight)
+			{
+				// Visit the nearer child first, defer the other one
+				if (tRight < tLeft)
+				{
+					stack[stackSize] = leftIndex;
+					stackT[stackSize++] = tLeft;
+					nodeIndex = rightIndex;
+				}
+				else
+				{
+					stack[stackSize] = rightIndex;
+					stackT[stackSize++] = tRight;
+					nodeIndex = leftIndex;
+				}
+				continue;
+			}
+			else if (hitLeft)
+			{
+				nodeIndex = leftIndex;
+				continue;
+			}
+			else if (hitRight)
+			{
+				nodeIndex = rightIndex;
+				continue;
+			}
+		}
+
+		// Pop the next node, skipping any that are now further away than the closest hit
+		do
+		{
+			if (stackSize == 0)
+			{
+				return;
+			}
+			--stackSize;
+		} while (stackT[stackSize] > ray.tmax);
+
+		nodeIndex = stack[stackSize];
+	}
+}
+
+
+template <typename NodeFunc, typename LeafFunc>
+void Bvh::Visit(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0 || !nodeFunc(m_nodes[0]))
+	{
+		return;
+	}
+
+	uint32_t stack[64];
+	int stackSize = 0;
+
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const BvhNode& node = m_nodes[nodeIndex];
+
+		if (node.IsLeaf())
+		{
+			leafFunc(node.offset, node.count);
+		}
+		else
+		{
+			const uint32_t leftIndex = nodeIndex + 1;
+			const uint32_t rightIndex = node.offset;
+			const bool visitLeft = nodeFunc(m_nodes[leftIndex]);
+			const bool visitRight = nodeFunc(m_nodes[rightIndex]);
+
+			if (visitLeft && visitRight)
+			{
+				stack[stackSize++] = rightIndex;
+				nodeIndex = leftIndex;
+				continue;
+			}
+			else if (visitLeft)
+			{
+				nodeIndex = leftIndex;
+				continue;
+			}
+			else if (visitRight)
+			{
+				nodeIndex = rightIndex;
+				continue;
+			}
+		}
+
+		if (stackSize == 0)
+		{
+			return;
+		}
+		nodeIndex = stack[--stackSize];
+	}
+}
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "Camera.h"
 
 #include "Sampling.h"
+#include "TileFrustum.h"
 #include "Math\Random.h"
 
 
@@ -49,4 +50,34 @@ Ray Camera::GetRay(float u, float v, uint32_t& state) const
 	ray.tmax = FLT_MAX;
 
 	return ray;
+}
+
+
+TileFrustum Camera::GetTileFrustum(float u0, float v0, float u1, float v1) const
+{
+	const Vector3 tileCenter = m_lowerLeft + (0.5f * (u0 + u1)) * m_horizontal + (0.5f * (v0 + v1)) * m_vertical;
+
+	// Each side plane contains the direction of its tile edge.  Rays from the lens edge on the plane's side cross
+	// the edge at the focus plane from the inside; rays from the opposite lens edge cross it from the outside.
+	// The plane through the near lens edge, parallel to the ray from the far lens edge through the tile edge,
+	// bounds both before and beyond the focus plane.
+	auto sidePlane = [&](const Vector3& edgePoint, const Vector3& edgeDir, const Vector3& outward)
+	{
+		const Vector3 nearLens = m_origin + m_lensRadius * outward;
+		const Vector3 farLens = m_origin - m_lensRadius * outward;
+
+		Vector3 normal = Cross(edgeDir, edgePoint - farLens);
+		if (Dot(normal, tileCenter - nearLens) < 0.0f)
+		{
+			normal = -normal;
+		}
+		return BoundingPlane(nearLens, normal);
+	};
+
+	TileFrustum frustum;
+	frustum.planes[0] = sidePlane(m_lowerLeft + u0 * m_horizontal, m_v, -m_u);
+	frustum.planes[1] = sidePlane(m_lowerLeft + u1 * m_horizontal, m_v, m_u);
+	frustum.planes[2] = sidePlane(m_lowerLeft + v0 * m_vertical, m_u, -m_v);
+	frustum.planes[3] = sidePlane(m_lowerLeft + v1 * m_vertical, m_u, m_v);
+	return frustum;
 }
\ No newline at end of file
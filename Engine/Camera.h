@@ -9,6 +9,10 @@
 #pragma once
 
 
+// Forward declarations
+struct TileFrustum;
+
+
 class Camera
 {
 public:
@@ -18,6 +22,9 @@ public:
 
 	Ray GetRay(float u, float v, uint32_t& rng) const;
 
+	// Bounds every ray GetRay can return for u in [u0, u1] and v in [v0, v1], whatever the lens sample
+	TileFrustum GetTileFrustum(float u0, float v0, float u1, float v1) const;
+
 private:
 	Math::Vector3 m_origin;
 	Math::Vector3 m_lowerLeft;
@@ -17,59 +17,254 @@ using namespace Math;
 using namespace std;
 
 
+// The side is x^2 + z^2 = k^2 * h^2 relative to the cone axis, where k = radius / height and h is the distance
+// below the apex.  Side hits are kept for 0 <= h <= height, and the base cap is the disk at the bottom.
+// Shrinks ray.tmax and records the slot, and whether the cap or the side was hit, on a closer hit.
 template<int N>
-void IntersectCones(const ConeList& coneList, Ray& ray, Hit& hit)
+void IntersectCones(const ConeList& coneList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot, bool& hitCap)
 {
-}
+	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
+	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
+	Float<N> rayOrigZ = Float<N>::Broadcast(ray.posZ);
+	Float<N> rayDirX = Float<N>::Broadcast(ray.dirX);
+	Float<N> rayDirY = Float<N>::Broadcast(ray.dirY);
+	Float<N> rayDirZ = Float<N>::Broadcast(ray.dirZ);
+	Float<N> rayInvDirY = Float<N>::Broadcast(1.0f / ray.dirY);
 
+	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
+	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
 
-void IntersectCone1(const ConeList& coneList, size_t index, Ray& ray, Hit& hit)
-{
+	const Float<N> zero(0.0f);
+
+	const Float<N> dirXZSq = (rayDirX * rayDirX) + (rayDirZ * rayDirZ);
+	const Float<N> dirYSq = rayDirY * rayDirY;
+
+	UInt<N> slot(0xffffffff);
+	UInt<N> cap(0);
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
+	{
+		// Load data for N cones
+		Float<N> centerX = Float<N>::Load(coneList.centerX + i);
+		Float<N> centerY = Float<N>::Load(coneList.centerY + i);
+		Float<N> centerZ = Float<N>::Load(coneList.centerZ + i);
+		Float<N> radius = Float<N>::Load(coneList.radius + i);
+		Float<N> height = Float<N>::Load(coneList.height + i);
+
+		Float<N> k = radius / height;
+		Float<N> kSq = k * k;
+
+		// Origin relative to the apex, with y measured downwards
+		Float<N> ocX = rayOrigX - centerX;
+		Float<N> ocY = (centerY + height) - rayOrigY;
+		Float<N> ocZ = rayOrigZ - centerZ;
+
+		Float<N> a = dirXZSq - kSq * dirYSq;
+		Float<N> b = (ocX * rayDirX) + (ocZ * rayDirZ) + kSq * (ocY * rayDirY);
+		Float<N> c = (ocX * ocX) + (ocZ * ocZ) - kSq * (ocY * ocY);
+
+		Float<N> discriminant = (b * b) - (a * c);
+		Bool<N> discrPos = discriminant >= zero;
+
+		Float<N> t = hitT;
+
+		if (Any(discrPos))
+		{
+			Float<N> discrSqrt = Sqrt(Max(discriminant, zero));
+			Float<N> invA = Float<N>(1.0f) / a;
+
+			// Either root may be the nearer one depending on the sign of a, and either may lie on the mirrored
+			// cone above the apex, so both are tested
+			Float<N> t0 = (-b - discrSqrt) * invA;
+			Float<N> t1 = (-b + discrSqrt) * invA;
+			Float<N> h0 = ocY - t0 * rayDirY;
+			Float<N> h1 = ocY - t1 * rayDirY;
+
+			Bool<N> valid0 = discrPos & (t0 > tmin) & (t0 < t) & (h0 >= zero) & (h0 <= height);
+			t = Select(valid0, t0, t);
+			Bool<N> valid1 = discrPos & (t1 > tmin) & (t1 < t) & (h1 >= zero) & (h1 <= height);
+			t = Select(valid1, t1, t);
+		}
+
+		// Base cap
+		Float<N> tCap = (centerY - rayOrigY) * rayInvDirY;
+		Float<N> capX = ocX + tCap * rayDirX;
+		Float<N> capZ = ocZ + tCap * rayDirZ;
+		Bool<N> validCap = (tCap > tmin) & (tCap < t) & (((capX * capX) + (capZ * capZ)) <= (radius * radius));
+		t = Select(validCap, tCap, t);
+
+		Bool<N> mask = t < hitT;
+
+		slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
+		cap = Select(mask, Select(validCap, UInt<N>(1), UInt<N>(0)), cap);
+		hitT = Select(mask, t, hitT);
+	}
+
+	float minT = ReduceMin(hitT);
+	if (minT < ray.tmax)
+	{
+		uint32_t minMask = Mask(hitT == Float<N>(minT));
+		uint32_t slots[N];
+		uint32_t caps[N];
+		UInt<N>::StoreU(slots, slot);
+		UInt<N>::StoreU(caps, cap);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
+			{
+				hitSlot = slots[lane] + lane;
+				hitCap = (caps[lane] != 0);
+				ray.tmax = minT;
+				break;
+			}
+		}
+	}
 }
 
-template <>
-void IntersectCones<1>(const ConeList& coneList, Ray& ray, Hit& hit)
+
+void IntersectCone1(const ConeList& coneList, size_t index, Ray& ray, uint32_t& hitSlot, bool& hitCap)
 {
-	Hit tempHit;
-	float closestHit = ray.tmax;
+	const float radius = coneList.radius[index];
+	const float height = coneList.height[index];
+	const float kSq = (radius * radius) / (height * height);
 
-	for (size_t i = 0; i < coneList.GetNumCones(); ++i)
+	// Origin relative to the apex, with y measured downwards
+	const float ocX = ray.posX - coneList.centerX[index];
+	const float ocY = (coneList.centerY[index] + height) - ray.posY;
+	const float ocZ = ray.posZ - coneList.centerZ[index];
+
+	float a = ray.dirX * ray.dirX + ray.dirZ * ray.dirZ - kSq * ray.dirY * ray.dirY;
+	float b = ocX * ray.dirX + ocZ * ray.dirZ + kSq * ocY * ray.dirY;
+	float c = ocX * ocX + ocZ * ocZ - kSq * ocY * ocY;
+	float discriminant = b * b - a * c;
+
+	if (discriminant >= 0.0f && a != 0.0f)
 	{
-		IntersectCone1(coneList, i, ray, hit);
-		if(tempHit.geomId != 0xFFFFFFFF)
+		float discrSqrt = sqrtf(discriminant);
+		float roots[2] = { (-b - discrSqrt) / a, (-b + discrSqrt) / a };
+		if (roots[1] < roots[0])
 		{
-			closestHit = ray.tmax;
-			hit = tempHit;
+			swap(roots[0], roots[1]);
+		}
+
+		for (float t : roots)
+		{
+			float h = ocY - t * ray.dirY;
+			if (t > ray.tmin && t < ray.tmax && h >= 0.0f && h <= height)
+			{
+				ray.tmax = t;
+				hitSlot = static_cast<uint32_t>(index);
+				hitCap = false;
+				break;
+			}
 		}
 	}
 
-	if (tempHit.geomId != 0xFFFFFFFF)
+	// Base cap
+	if (ray.dirY != 0.0f)
+	{
+		float t = (coneList.centerY[index] - ray.posY) / ray.dirY;
+		if (t > ray.tmin && t < ray.tmax)
+		{
+			float capX = ocX + t * ray.dirX;
+			float capZ = ocZ + t * ray.dirZ;
+			if (capX * capX + capZ * capZ <= radius * radius)
+			{
+				ray.tmax = t;
+				hitSlot = static_cast<uint32_t>(index);
+				hitCap = true;
+			}
+		}
+	}
+}
+
+
+template<>
+void IntersectCones<1>(const ConeList& coneList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot, bool& hitCap)
+{
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
 	{
-		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - coneList.centerX[hit.geomId];
-		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - coneList.centerY[hit.geomId];
-		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - coneList.centerZ[hit.geomId];
+		IntersectCone1(coneList, i, ray, hitSlot, hitCap);
 	}
 }
 
 
 ConeAccelerator::ConeAccelerator(Scene* scene)
 	: m_scene(scene)
+	, m_streams('C')
 {}
 
 
 void ConeAccelerator::AddCone(const Vector3& center, float radius, float height, uint32_t id)
 {
-	m_coneList.centerX.push_back(center.GetX());
-	m_coneList.centerY.push_back(center.GetY());
-	m_coneList.centerZ.push_back(center.GetZ());
-	m_coneList.radius.push_back(radius);
-	m_coneList.height.push_back(height);
-	m_coneList.id.push_back(id);
+	if (m_streams.IsLoaded())
+	{
+		UnloadAccel();
+	}
+
+	const float values[5] = { center.GetX(), center.GetY(), center.GetZ(), radius, height };
+
+	BvhBounds bounds;
+	bounds.Grow(values[0] - radius, values[1], values[2] - radius);
+	bounds.Grow(values[0] + radius, values[1] + height, values[2] + radius);
+
+	m_streams.Add(values, id, bounds);
 
 	m_dirty = true;
 }
 
 
+template <int N>
+void ConeAccelerator::IntersectBvh(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+	bool hitCap = false;
+
+	m_streams.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectCones<N>(m_coneList, first, count, ray, hitSlot, hitCap);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float radius = m_coneList.radius[hitSlot];
+		const float height = m_coneList.height[hitSlot];
+
+		const float localX = (ray.posX + ray.tmax * ray.dirX) - m_coneList.centerX[hitSlot];
+		const float localZ = (ray.posZ + ray.tmax * ray.dirZ) - m_coneList.centerZ[hitSlot];
+
+		const float radialDist = sqrtf(localX * localX + localZ * localZ);
+
+		if (hitCap)
+		{
+			// Base cap
+			hit.normalX = 0.0f;
+			hit.normalY = -1.0f;
+			hit.normalZ = 0.0f;
+		}
+		else if (radialDist > 0.0f)
+		{
+			// Side, the gradient of x^2 + z^2 - k^2 * h^2 is proportional to (x, k * r, z)
+			const float slope = radius / height;
+			const float normalY = slope * radialDist;
+			const float invLength = 1.0f / sqrtf(radialDist * radialDist + normalY * normalY);
+			hit.normalX = localX * invLength;
+			hit.normalY = normalY * invLength;
+			hit.normalZ = localZ * invLength;
+		}
+		else
+		{
+			// Apex
+			hit.normalX = 0.0f;
+			hit.normalY = 1.0f;
+			hit.normalZ = 0.0f;
+		}
+		hit.geomId = m_coneList.id[hitSlot];
+	}
+}
+
 void ConeAccelerator::Intersect1(Ray& ray, Hit& hit) const
 {
 	assert(!m_dirty);
@@ -78,36 +273,98 @@ void ConeAccelerator::Intersect1(Ray& ray, Hit& hit) const
 
 	if (simdSize == 1)
 	{
-		IntersectCones<1>(m_coneList, ray, hit);
+		IntersectBvh<1>(ray, hit);
 	}
 	else if (simdSize == 4)
 	{
-		IntersectCones<1>(m_coneList, ray, hit);
+		IntersectBvh<4>(ray, hit);
 	}
 	else if (simdSize == 8)
 	{
-		IntersectCones<1>(m_coneList, ray, hit);
+		IntersectBvh<8>(ray, hit);
 	}
 }
 
 
 void ConeAccelerator::Commit()
 {
-	const auto simdSize = m_scene->GetSimdSize();
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	// Padding slots get a NaN radius and height, which fail every comparison
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	const float padValues[5] = { 0.0f, 0.0f, 0.0f, nan, nan };
+
+	m_streams.Build(m_scene->GetSimdSize(), true, padValues);
+	UpdateList();
+
+	m_dirty = false;
+}
+
+
+BvhBounds ConeAccelerator::GetBounds() const
+{
+	return m_streams.GetBounds();
+}
+
+
+size_t ConeAccelerator::GetMemoryUsage() const
+{
+	return m_streams.GetMemoryUsage();
+}
 
-	size_t curSize = m_coneList.centerX.size();
-	size_t targetSize = AlignUp(curSize, simdSize);
 
-	// Pad out the sphere arrays with dummy data until we're a multiple of m_simdSize
-	for (size_t i = curSize; i < targetSize; ++i)
+uint64_t ConeAccelerator::GetContentHash() const
+{
+	return m_streams.GetContentHash();
+}
+
+
+void ConeAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	m_streams.Save(writer);
+}
+
+
+bool ConeAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	if (!m_streams.Load(reader, m_scene->GetSimdSize()))
 	{
-		m_coneList.centerX.push_back(0.0f);
-		m_coneList.centerY.push_back(0.0f);
-		m_coneList.centerZ.push_back(0.0f);
-		m_coneList.radius.push_back(0.0f);
-		m_coneList.height.push_back(0.0f);
-		m_coneList.id.push_back(0xFFFFFFFF); // TODO: Make this a constant somewhere
+		return false;
 	}
 
+	UpdateList();
+
 	m_dirty = false;
+	return true;
+}
+
+
+void ConeAccelerator::UnloadAccel()
+{
+	if (!m_streams.IsLoaded())
+	{
+		return;
+	}
+
+	m_streams.Unload();
+	UpdateList();
+
+	m_dirty = true;
+}
+
+
+void ConeAccelerator::UpdateList()
+{
+	m_coneList.centerX = m_streams.GetStream(0);
+	m_coneList.centerY = m_streams.GetStream(1);
+	m_coneList.centerZ = m_streams.GetStream(2);
+	m_coneList.radius = m_streams.GetStream(3);
+	m_coneList.height = m_streams.GetStream(4);
+	m_coneList.id = m_streams.GetIds();
+	m_coneList.numSlots = m_streams.GetNumSlots();
 }
\ No newline at end of file
@@ -9,24 +9,29 @@
 #pragma once
 
 #include "IAccelerator.h"
+#include "PrimitiveStreams.h"
 
 
 // Forward declarations
 class Scene;
 
 
+// View over capped cone data in BVH leaf order, padded per leaf to a multiple of the SIMD width.  Each cone has
+// its base disk on center and its apex at center + (0, height, 0).
 struct ConeList
 {
-	std::vector<float, aligned_allocator<float, 16>>		centerX;
-	std::vector<float, aligned_allocator<float, 16>>		centerY;
-	std::vector<float, aligned_allocator<float, 16>>		centerZ;
-	std::vector<float, aligned_allocator<float, 16>>		radius;
-	std::vector<float, aligned_allocator<float, 16>>		height;
-	std::vector<uint32_t, aligned_allocator<uint32_t, 16>>	id;
+	const float*	centerX{ nullptr };
+	const float*	centerY{ nullptr };
+	const float*	centerZ{ nullptr };
+	const float*	radius{ nullptr };
+	const float*	height{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
 
 	__forceinline size_t GetNumCones() const
 	{
-		return centerX.size();
+		return numSlots;
 	}
 
 	__forceinline Math::Vector3 Center(size_t index) const
@@ -52,10 +57,26 @@ public:
 	void Intersect1(Ray& ray, Hit& hit) const final;
 
 	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectBvh(Ray& ray, Hit& hit) const;
+
+	void UpdateList();
 
 private:
-	Scene * m_scene;
-	ConeList		m_coneList;
+	Scene*				m_scene;
+
+	PrimitiveStreams<5>	m_streams;
+	ConeList			m_coneList;
 
-	bool			m_dirty{ false };
+	bool				m_dirty{ false };
 };
\ No newline at end of file
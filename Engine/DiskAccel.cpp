@@ -0,0 +1,275 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "DiskAccel.h"
+
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+// Shrinks ray.tmax and records the slot on a closer hit
+template<int N>
+void IntersectDisks(const DiskList& diskList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
+	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
+	Float<N> rayOrigZ = Float<N>::Broadcast(ray.posZ);
+	Float<N> rayDirX = Float<N>::Broadcast(ray.dirX);
+	Float<N> rayDirY = Float<N>::Broadcast(ray.dirY);
+	Float<N> rayDirZ = Float<N>::Broadcast(ray.dirZ);
+
+	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
+	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
+	UInt<N> slot(0xffffffff);
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
+	{
+		Float<N> normalX = Float<N>::Load(diskList.normalX + i);
+		Float<N> normalY = Float<N>::Load(diskList.normalY + i);
+		Float<N> normalZ = Float<N>::Load(diskList.normalZ + i);
+
+		Float<N> coX = Float<N>::Load(diskList.centerX + i) - rayOrigX;
+		Float<N> coY = Float<N>::Load(diskList.centerY + i) - rayOrigY;
+		Float<N> coZ = Float<N>::Load(diskList.centerZ + i) - rayOrigZ;
+
+		Float<N> denom = normalX * rayDirX + normalY * rayDirY + normalZ * rayDirZ;
+		Float<N> t = (normalX * coX + normalY * coY + normalZ * coZ) / denom;
+
+		// Offset of the hit point from the center
+		Float<N> pX = t * rayDirX - coX;
+		Float<N> pY = t * rayDirY - coY;
+		Float<N> pZ = t * rayDirZ - coZ;
+		Float<N> distSq = pX * pX + pY * pY + pZ * pZ;
+
+		// Padding slots have a zero normal, so t is NaN
+		Bool<N> mask = (distSq < Float<N>::Load(diskList.radiusSq + i)) & (t > tmin) & (t < hitT);
+
+		if (Any(mask))
+		{
+			hitT = Select(mask, t, hitT);
+			slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
+		}
+	}
+
+	float minT = ReduceMin(hitT);
+	if (minT < ray.tmax)
+	{
+		uint32_t minMask = Mask(hitT == Float<N>(minT));
+		uint32_t slots[N];
+		UInt<N>::StoreU(slots, slot);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
+			{
+				hitSlot = slots[lane] + lane;
+				ray.tmax = minT;
+				break;
+			}
+		}
+	}
+}
+
+
+template<>
+void IntersectDisks<1>(const DiskList& diskList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
+	{
+		const float normalX = diskList.normalX[i];
+		const float normalY = diskList.normalY[i];
+		const float normalZ = diskList.normalZ[i];
+
+		const float coX = diskList.centerX[i] - ray.posX;
+		const float coY = diskList.centerY[i] - ray.posY;
+		const float coZ = diskList.centerZ[i] - ray.posZ;
+
+		float denom = normalX * ray.dirX + normalY * ray.dirY + normalZ * ray.dirZ;
+		float t = (normalX * coX + normalY * coY + normalZ * coZ) / denom;
+
+		if (t > ray.tmin && t < ray.tmax)
+		{
+			float pX = t * ray.dirX - coX;
+			float pY = t * ray.dirY - coY;
+			float pZ = t * ray.dirZ - coZ;
+
+			if (pX * pX + pY * pY + pZ * pZ < diskList.radiusSq[i])
+			{
+				ray.tmax = t;
+				hitSlot = static_cast<uint32_t>(i);
+			}
+		}
+	}
+}
+
+
+DiskAccelerator::DiskAccelerator(Scene* scene)
+	: m_scene(scene)
+	, m_streams('D')
+{}
+
+
+void DiskAccelerator::AddDisk(const Vector3& center, const Vector3& normal, float radius, uint32_t id)
+{
+	if (m_streams.IsLoaded())
+	{
+		UnloadAccel();
+	}
+
+	Vector3 n = Normalize(normal);
+	const float values[7] =
+	{
+		center.GetX(), center.GetY(), center.GetZ(),
+		n.GetX(), n.GetY(), n.GetZ(),
+		radius * radius
+	};
+
+	// The extent along each axis is radius * sin of the angle between the axis and the normal
+	const float extentX = radius * sqrtf(max(0.0f, 1.0f - values[3] * values[3]));
+	const float extentY = radius * sqrtf(max(0.0f, 1.0f - values[4] * values[4]));
+	const float extentZ = radius * sqrtf(max(0.0f, 1.0f - values[5] * values[5]));
+
+	BvhBounds bounds;
+	bounds.Grow(values[0] - extentX, values[1] - extentY, values[2] - extentZ);
+	bounds.Grow(values[0] + extentX, values[1] + extentY, values[2] + extentZ);
+
+	m_streams.Add(values, id, bounds);
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void DiskAccelerator::IntersectBvh(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	m_streams.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectDisks<N>(m_diskList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		hit.normalX = m_diskList.normalX[hitSlot];
+		hit.normalY = m_diskList.normalY[hitSlot];
+		hit.normalZ = m_diskList.normalZ[hitSlot];
+		hit.geomId = m_diskList.id[hitSlot];
+	}
+}
+
+
+void DiskAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectBvh<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectBvh<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectBvh<8>(ray, hit);
+	}
+}
+
+
+void DiskAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const float padValues[7] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f };
+
+	m_streams.Build(m_scene->GetSimdSize(), true, padValues);
+	UpdateList();
+
+	m_dirty = false;
+}
+
+
+BvhBounds DiskAccelerator::GetBounds() const
+{
+	return m_streams.GetBounds();
+}
+
+
+size_t DiskAccelerator::GetMemoryUsage() const
+{
+	return m_streams.GetMemoryUsage();
+}
+
+
+uint64_t DiskAccelerator::GetContentHash() const
+{
+	return m_streams.GetContentHash();
+}
+
+
+void DiskAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	m_streams.Save(writer);
+}
+
+
+bool DiskAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	if (!m_streams.Load(reader, m_scene->GetSimdSize()))
+	{
+		return false;
+	}
+
+	UpdateList();
+
+	m_dirty = false;
+	return true;
+}
+
+
+void DiskAccelerator::UnloadAccel()
+{
+	if (!m_streams.IsLoaded())
+	{
+		return;
+	}
+
+	m_streams.Unload();
+	UpdateList();
+
+	m_dirty = true;
+}
+
+
+void DiskAccelerator::UpdateList()
+{
+	m_diskList.centerX = m_streams.GetStream(0);
+	m_diskList.centerY = m_streams.GetStream(1);
+	m_diskList.centerZ = m_streams.GetStream(2);
+	m_diskList.normalX = m_streams.GetStream(3);
+	m_diskList.normalY = m_streams.GetStream(4);
+	m_diskList.normalZ = m_streams.GetStream(5);
+	m_diskList.radiusSq = m_streams.GetStream(6);
+	m_diskList.id = m_streams.GetIds();
+	m_diskList.numSlots = m_streams.GetNumSlots();
+}
@@ -0,0 +1,73 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "IAccelerator.h"
+#include "PrimitiveStreams.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// View over disk data in BVH leaf order, padded per leaf to a multiple of the SIMD width
+struct DiskList
+{
+	const float*	centerX{ nullptr };
+	const float*	centerY{ nullptr };
+	const float*	centerZ{ nullptr };
+	const float*	normalX{ nullptr };
+	const float*	normalY{ nullptr };
+	const float*	normalZ{ nullptr };
+	const float*	radiusSq{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
+};
+
+
+class DiskAccelerator : public IAccelerator
+{
+public:
+	DiskAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Disk;
+	}
+
+	void AddDisk(const Math::Vector3& center, const Math::Vector3& normal, float radius, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectBvh(Ray& ray, Hit& hit) const;
+
+	void UpdateList();
+
+private:
+	Scene*				m_scene;
+
+	PrimitiveStreams<7>	m_streams;
+	DiskList			m_diskList;
+
+	bool				m_dirty{ false };
+};
@@ -0,0 +1,336 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#if USE_EMBREE
+
+#include "EmbreeAccel.h"
+
+#include "Hash.h"
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr int PACKET_SIZE = 8;
+
+
+void SphereBoundsFunc(const RTCBoundsFunctionArguments* args)
+{
+	const auto& spheres = *(const EmbreeAccelerator::SphereArrays*)args->geometryUserPtr;
+	const unsigned int primID = args->primID;
+	const float radius = spheres.radius[primID];
+
+	RTCBounds* bounds = args->bounds_o;
+	bounds->lower_x = spheres.centerX[primID] - radius;
+	bounds->lower_y = spheres.centerY[primID] - radius;
+	bounds->lower_z = spheres.centerZ[primID] - radius;
+	bounds->upper_x = spheres.centerX[primID] + radius;
+	bounds->upper_y = spheres.centerY[primID] + radius;
+	bounds->upper_z = spheres.centerZ[primID] + radius;
+}
+
+
+// Handles single rays and packets alike, one valid lane at a time
+void SphereIntersectFuncN(const RTCIntersectFunctionNArguments* args)
+{
+	const int* valid = args->valid;
+	const unsigned int N = args->N;
+	RTCRayN* rays = RTCRayHitN_RayN(args->rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(args->rayhit, N);
+
+	const auto& spheres = *(const EmbreeAccelerator::SphereArrays*)args->geometryUserPtr;
+	const unsigned int primID = args->primID;
+	const Vector3 center(spheres.centerX[primID], spheres.centerY[primID], spheres.centerZ[primID]);
+	const float radius = spheres.radius[primID];
+
+	for (unsigned int lane = 0; lane < N; ++lane)
+	{
+		if (valid[lane] != -1) continue;
+
+		const Vector3 org(RTCRayN_org_x(rays, N, lane), RTCRayN_org_y(rays, N, lane), RTCRayN_org_z(rays, N, lane));
+		const Vector3 dir(RTCRayN_dir_x(rays, N, lane), RTCRayN_dir_y(rays, N, lane), RTCRayN_dir_z(rays, N, lane));
+		const float tnear = RTCRayN_tnear(rays, N, lane);
+		float& tfar = RTCRayN_tfar(rays, N, lane);
+
+		// Same math as IntersectSphere1, which expects normalized directions
+		const Vector3 oc = org - center;
+		const float b = Dot(oc, dir);
+		const float c = Dot(oc, oc) - radius * radius;
+		const float discriminant = b * b - c;
+		if (discriminant <= 0.0f) continue;
+
+		const float discrSqrt = sqrtf(discriminant);
+		float t = -b - discrSqrt;
+		if (!(t < tfar && t > tnear))
+		{
+			t = -b + discrSqrt;
+			if (!(t < tfar && t > tnear)) continue;
+		}
+
+		const Vector3 Ng = (org + t * dir) - center;
+
+		RTCHit hit;
+		hit.Ng_x = Ng.GetX();
+		hit.Ng_y = Ng.GetY();
+		hit.Ng_z = Ng.GetZ();
+		hit.u = 0.0f;
+		hit.v = 0.0f;
+		hit.instID[0] = args->context->instID[0];
+		hit.geomID = 0;
+		hit.primID = primID;
+
+		tfar = t;
+		rtcCopyHitToHitN(hits, &hit, N, lane);
+	}
+}
+
+
+void InitRayHit(const Ray& ray, RTCRayHit& rayHit)
+{
+	rayHit.ray.org_x = ray.posX;
+	rayHit.ray.org_y = ray.posY;
+	rayHit.ray.org_z = ray.posZ;
+	rayHit.ray.tnear = ray.tmin;
+	rayHit.ray.dir_x = ray.dirX;
+	rayHit.ray.dir_y = ray.dirY;
+	rayHit.ray.dir_z = ray.dirZ;
+	rayHit.ray.time = 0.0f;
+	rayHit.ray.tfar = ray.tmax;
+	rayHit.ray.mask = 0xFFFFFFFF;
+	rayHit.ray.id = 0;
+	rayHit.ray.flags = 0;
+	rayHit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+	rayHit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+	rayHit.hit.primID = RTC_INVALID_GEOMETRY_ID;
+}
+
+} // anonymous namespace
+
+
+EmbreeAccelerator::EmbreeAccelerator(Scene* scene)
+	: m_scene(scene)
+{
+	m_device = rtcNewDevice(nullptr);
+	rtcSetDeviceMemoryMonitorFunction(m_device, MemoryMonitor, this);
+}
+
+
+EmbreeAccelerator::~EmbreeAccelerator()
+{
+	if (m_rtcScene)
+	{
+		rtcReleaseScene(m_rtcScene);
+	}
+	rtcReleaseDevice(m_device);
+}
+
+
+void EmbreeAccelerator::AddSphere(const Vector3& center, float radius, uint32_t id)
+{
+	m_spheres.centerX.push_back(center.GetX());
+	m_spheres.centerY.push_back(center.GetY());
+	m_spheres.centerZ.push_back(center.GetZ());
+	m_spheres.radius.push_back(radius);
+	m_spheres.id.push_back(id);
+
+	m_bounds.Grow(center.GetX() - radius, center.GetY() - radius, center.GetZ() - radius);
+	m_bounds.Grow(center.GetX() + radius, center.GetY() + radius, center.GetZ() + radius);
+
+	m_dirty = true;
+}
+
+
+void EmbreeAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+
+	RTCRayHit rayHit;
+	InitRayHit(ray, rayHit);
+
+	rtcIntersect1(m_rtcScene, &context, &rayHit);
+
+	ResolveHit(rayHit.hit.Ng_x, rayHit.hit.Ng_y, rayHit.hit.Ng_z, rayHit.hit.geomID, rayHit.hit.primID, rayHit.ray.tfar, ray, hit);
+}
+
+
+void EmbreeAccelerator::IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const
+{
+	assert(!m_dirty);
+
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+
+	if (!coherent)
+	{
+		// Kept per thread, so streams stop allocating once the thread has seen its largest batch
+		thread_local vector<RTCRayHit> rayHits;
+		rayHits.resize(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			InitRayHit(rays[i], rayHits[i]);
+			rayHits[i].ray.id = static_cast<unsigned int>(i);
+		}
+
+		context.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+		rtcIntersect1M(m_rtcScene, &context, rayHits.data(), static_cast<unsigned int>(count), sizeof(RTCRayHit));
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const RTCRayHit& rayHit = rayHits[i];
+			ResolveHit(rayHit.hit.Ng_x, rayHit.hit.Ng_y, rayHit.hit.Ng_z, rayHit.hit.geomID, rayHit.hit.primID, rayHit.ray.tfar, rays[i], hits[i]);
+		}
+		return;
+	}
+
+	context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+	for (size_t first = 0; first < count; first += PACKET_SIZE)
+	{
+		const int numLanes = static_cast<int>(min<size_t>(PACKET_SIZE, count - first));
+
+		// Inactive lanes of the last packet repeat its last ray, and are masked off
+		alignas(32) int valid[PACKET_SIZE];
+		RTCRayHit8 rayHit;
+		for (int lane = 0; lane < PACKET_SIZE; ++lane)
+		{
+			const Ray& ray = rays[first + min(lane, numLanes - 1)];
+
+			valid[lane] = (lane < numLanes) ? -1 : 0;
+			rayHit.ray.org_x[lane] = ray.posX;
+			rayHit.ray.org_y[lane] = ray.posY;
+			rayHit.ray.org_z[lane] = ray.posZ;
+			rayHit.ray.tnear[lane] = ray.tmin;
+			rayHit.ray.dir_x[lane] = ray.dirX;
+			rayHit.ray.dir_y[lane] = ray.dirY;
+			rayHit.ray.dir_z[lane] = ray.dirZ;
+			rayHit.ray.time[lane] = 0.0f;
+			rayHit.ray.tfar[lane] = ray.tmax;
+			rayHit.ray.mask[lane] = 0xFFFFFFFF;
+			rayHit.ray.id[lane] = lane;
+			rayHit.ray.flags[lane] = 0;
+			rayHit.hit.instID[0][lane] = RTC_INVALID_GEOMETRY_ID;
+			rayHit.hit.geomID[lane] = RTC_INVALID_GEOMETRY_ID;
+			rayHit.hit.primID[lane] = RTC_INVALID_GEOMETRY_ID;
+		}
+
+		rtcIntersect8(valid, m_rtcScene, &context, &rayHit);
+
+		for (int lane = 0; lane < numLanes; ++lane)
+		{
+			ResolveHit(rayHit.hit.Ng_x[lane], rayHit.hit.Ng_y[lane], rayHit.hit.Ng_z[lane], rayHit.hit.geomID[lane], rayHit.hit.primID[lane], rayHit.ray.tfar[lane], rays[first + lane], hits[first + lane]);
+		}
+	}
+}
+
+
+void EmbreeAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	if (m_rtcScene)
+	{
+		rtcReleaseScene(m_rtcScene);
+	}
+	m_rtcScene = rtcNewScene(m_device);
+
+	RTCGeometry geom = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_USER);
+	rtcAttachGeometryByID(m_rtcScene, geom, 0);
+
+	rtcSetGeometryUserPrimitiveCount(geom, static_cast<unsigned int>(m_spheres.id.size()));
+	rtcSetGeometryUserData(geom, &m_spheres);
+	rtcSetGeometryBoundsFunction(geom, SphereBoundsFunc, nullptr);
+	rtcSetGeometryIntersectFunction(geom, SphereIntersectFuncN);
+
+	rtcCommitGeometry(geom);
+	rtcReleaseGeometry(geom);
+
+	rtcCommitScene(m_rtcScene);
+
+	m_dirty = false;
+}
+
+
+BvhBounds EmbreeAccelerator::GetBounds() const
+{
+	return m_bounds;
+}
+
+
+size_t EmbreeAccelerator::GetMemoryUsage() const
+{
+	const size_t sphereBytes = m_spheres.id.size() * (4 * sizeof(float) + sizeof(uint32_t));
+	return static_cast<size_t>(max<int64_t>(m_memoryUsage, 0)) + sphereBytes;
+}
+
+
+uint64_t EmbreeAccelerator::GetContentHash() const
+{
+	uint64_t hash = HashVector(m_spheres.centerX);
+	hash = HashVector(m_spheres.centerY, hash);
+	hash = HashVector(m_spheres.centerZ, hash);
+	hash = HashVector(m_spheres.radius, hash);
+	return HashVector(m_spheres.id, hash);
+}
+
+
+void EmbreeAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	// Nothing to save, Embree's BVH stays in Embree's memory
+}
+
+
+bool EmbreeAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	// The content hash already matched, and nothing points into the file, so the Embree scene only needs to exist
+	Commit();
+	return true;
+}
+
+
+void EmbreeAccelerator::UnloadAccel()
+{
+}
+
+
+bool EmbreeAccelerator::MemoryMonitor(void* userPtr, ssize_t bytes, bool post)
+{
+	// Frees are reported with negative sizes
+	EmbreeAccelerator* accel = (EmbreeAccelerator*)userPtr;
+	accel->m_memoryUsage += bytes;
+	return true;
+}
+
+
+void EmbreeAccelerator::ResolveHit(float NgX, float NgY, float NgZ, uint32_t geomID, uint32_t primID, float tfar, Ray& ray, Hit& hit) const
+{
+	if (geomID != RTC_INVALID_GEOMETRY_ID)
+	{
+		Vector3 normal = Normalize(Vector3(NgX, NgY, NgZ));
+		hit.normalX = normal.GetX();
+		hit.normalY = normal.GetY();
+		hit.normalZ = normal.GetZ();
+		hit.geomId = m_spheres.id[primID];
+
+		ray.tmax = tfar;
+	}
+}
+
+#endif // USE_EMBREE
\ No newline at end of file
@@ -0,0 +1,89 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#if USE_EMBREE
+
+#include "Bvh.h"
+#include "IAccelerator.h"
+
+#include "embree3/rtcore.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// Spheres traced by Embree instead of the engine's own BVH, for scenes with SceneBackend::Embree.  Commit()
+// mirrors the added spheres into one Embree user geometry over SoA arrays, with a primitive per sphere.  Embree
+// builds its BVH in its own memory and can't save it, so the accelerator cache and scene arenas hold nothing
+// for it, and LoadAccel only makes sure the Embree scene is built.
+class EmbreeAccelerator : public IAccelerator
+{
+public:
+	EmbreeAccelerator(Scene* scene);
+	~EmbreeAccelerator();
+
+	EmbreeAccelerator(const EmbreeAccelerator&) = delete;
+	EmbreeAccelerator& operator=(const EmbreeAccelerator&) = delete;
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Embree;
+	}
+
+	void AddSphere(const Math::Vector3& center, float radius, uint32_t id);
+
+	// Intersection methods.  Coherent batches are traced as rtcIntersect8 packets, the others as rtcIntersect1M
+	// streams.
+	void Intersect1(Ray& ray, Hit& hit) const final;
+	void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+
+	// Everything allocated through the Embree device, plus the sphere arrays the callbacks read
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+	// Sphere data, indexed by Embree primitive id
+	struct SphereArrays
+	{
+		std::vector<float>		centerX;
+		std::vector<float>		centerY;
+		std::vector<float>		centerZ;
+		std::vector<float>		radius;
+		std::vector<uint32_t>	id;
+	};
+
+private:
+	static bool MemoryMonitor(void* userPtr, ssize_t bytes, bool post);
+
+	void ResolveHit(float NgX, float NgY, float NgZ, uint32_t geomID, uint32_t primID, float tfar, Ray& ray, Hit& hit) const;
+
+private:
+	Scene*					m_scene;
+
+	RTCDevice				m_device{ nullptr };
+	RTCScene				m_rtcScene{ nullptr };
+
+	SphereArrays			m_spheres;
+	BvhBounds				m_bounds;
+
+	std::atomic<int64_t>	m_memoryUsage{ 0 };
+
+	bool					m_dirty{ false };
+};
+
+#endif // USE_EMBREE
\ No newline at end of file
@@ -12,5 +12,33 @@ enum class PrimitiveType
 {
 	Sphere,
 	Cone,
+	Triangle,
+	Plane,
+	Box,
+	Disk,
+	Quad,
+	Instance,
+	SphereGrid,
+	SphereKdTree,
+	SphereSorted,
+	SphereLinear,
+	Embree,
 	Unknown
+};
+
+
+// How SphereAccelerator stores its built spheres
+enum class SphereLayout
+{
+	SoA,	// One array per field
+	AoSoA	// SphereBlocks of 8 spheres, all fields of a leaf in one contiguous read
+};
+
+
+// How SphereAccelerator stores its BVH nodes
+enum class BvhNodeFormat
+{
+	Full,		// BvhNodes with float bounds, one per node
+	Quantized,	// QuantizedBvhNodes with both children's bounds in 8 bits per plane, one per interior node
+	Treelet		// BvhNodes as sibling pairs on one cache line, grouped into page-sized treelets (TreeletBvh)
 };
\ No newline at end of file
@@ -0,0 +1,609 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "GridAccel.h"
+
+#include "BakedFile.h"
+#include "Hash.h"
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Spheres with a radius beyond this many times the median are tested against every ray instead of gridded
+constexpr float GRID_LARGE_SPHERE_FACTOR = 16.0f;
+
+// Upper limit per axis, so a few far outliers can't blow up the cell count
+constexpr uint32_t GRID_MAX_RESOLUTION = 1024;
+
+// Direct mapped, keyed by input sphere index.  Only the scalar path uses it: with SIMD a cell is one or two
+// Float<N> tests either way, so skipping single spheres saves nothing.  Skipping whole Float<N> groups whose
+// lanes are all mailboxed measured 25-33% slower with 8 lanes: every group pays a scalar lookup per lane, and
+// only groups with no new sphere at all are saved.
+constexpr uint32_t GRID_MAILBOX_SIZE = 16;
+
+constexpr uint32_t TAG_GRID_INFO = MakeBakedTag('G', 'I', 'N', 'F');
+constexpr uint32_t TAG_GRID_CELLS = MakeBakedTag('G', 'C', 'E', 'L');
+constexpr uint32_t TAG_GRID_IDS = MakeBakedTag('G', 'I', 'D', 'S');
+constexpr uint32_t TAG_GRID_INDICES = MakeBakedTag('G', 'I', 'D', 'X');
+constexpr uint32_t TAG_GRID_DATA[5] =
+{
+	MakeBakedTag('G', 'C', 'X', ' '),
+	MakeBakedTag('G', 'C', 'Y', ' '),
+	MakeBakedTag('G', 'C', 'Z', ' '),
+	MakeBakedTag('G', 'R', 'S', 'Q'),
+	MakeBakedTag('G', 'I', 'R', 'D')
+};
+
+
+// Cell resolution for about targetCells cells over the extents.  Axes thinner than a cell, like the height of
+// a layer of spheres on the ground, get a single cell, and the others share the cells out between them.
+void ChooseResolution(const float(&extents)[3], size_t targetCells, uint32_t(&res)[3])
+{
+	bool active[3] = { extents[0] > 0.0f, extents[1] > 0.0f, extents[2] > 0.0f };
+
+	float cellSize = 0.0f;
+	for (;;)
+	{
+		int numActive = 0;
+		double volume = 1.0;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (active[axis])
+			{
+				volume *= extents[axis];
+				++numActive;
+			}
+		}
+
+		if (numActive == 0)
+		{
+			break;
+		}
+
+		cellSize = static_cast<float>(pow(volume / static_cast<double>(targetCells), 1.0 / numActive));
+
+		bool changed = false;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (active[axis] && extents[axis] < cellSize)
+			{
+				active[axis] = false;
+				changed = true;
+			}
+		}
+
+		if (!changed)
+		{
+			break;
+		}
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		res[axis] = 1;
+		if (active[axis])
+		{
+			const float cells = ceilf(extents[axis] / cellSize);
+			res[axis] = static_cast<uint32_t>(min(max(cells, 1.0f), static_cast<float>(GRID_MAX_RESOLUTION)));
+		}
+	}
+}
+
+
+__forceinline uint32_t CellCoord(float pos, float minPos, float cellSize, uint32_t res)
+{
+	const int coord = static_cast<int>((pos - minPos) / cellSize);
+	return static_cast<uint32_t>(min(max(coord, 0), static_cast<int>(res) - 1));
+}
+
+} // anonymous namespace
+
+
+GridAccelerator::GridAccelerator(Scene* scene)
+	: m_scene(scene)
+{}
+
+
+void GridAccelerator::AddSphere(const Vector3& center, float radius, uint32_t id)
+{
+	if (m_loaded)
+	{
+		UnloadAccel();
+	}
+
+	m_inputCenterX.push_back(center.GetX());
+	m_inputCenterY.push_back(center.GetY());
+	m_inputCenterZ.push_back(center.GetZ());
+	m_inputRadius.push_back(radius);
+	m_inputId.push_back(id);
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void GridAccelerator::IntersectCell(uint32_t cell, Ray& ray, uint32_t& hitSlot, uint32_t* mailbox) const
+{
+	const uint32_t first = m_cellStart[cell];
+	const uint32_t last = m_cellStart[cell + 1];
+
+	if (N > 1)
+	{
+		if (first != last)
+		{
+			IntersectSpheres<N>(m_sphereList, first, last - first, ray, hitSlot);
+		}
+		return;
+	}
+
+	for (uint32_t slot = first; slot < last; ++slot)
+	{
+		// Spheres overlapping several cells are only tested in the first one the ray visits
+		const uint32_t index = m_sphereIndex[slot];
+		uint32_t& entry = mailbox[index & (GRID_MAILBOX_SIZE - 1)];
+		if (entry == index)
+		{
+			continue;
+		}
+		entry = index;
+
+		IntersectSpheres<1>(m_sphereList, slot, 1, ray, hitSlot);
+	}
+}
+
+
+template <int N>
+void GridAccelerator::IntersectGrid(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	if (m_grid.numLargeSlots > 0)
+	{
+		IntersectSpheres<N>(m_sphereList, 0, m_grid.numLargeSlots, ray, hitSlot);
+	}
+
+	const float pos[3] = { ray.posX, ray.posY, ray.posZ };
+	const float dir[3] = { ray.dirX, ray.dirY, ray.dirZ };
+	const float minPos[3] = { m_grid.minX, m_grid.minY, m_grid.minZ };
+	const float cellSize[3] = { m_grid.cellSizeX, m_grid.cellSizeY, m_grid.cellSizeZ };
+	const uint32_t res[3] = { m_grid.resX, m_grid.resY, m_grid.resZ };
+
+	// Clip the ray to the grid
+	float tEntry = ray.tmin;
+	float tExit = ray.tmax;
+	float invDir[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		invDir[axis] = 1.0f / dir[axis];
+		float t0 = (minPos[axis] - pos[axis]) * invDir[axis];
+		float t1 = (minPos[axis] + res[axis] * cellSize[axis] - pos[axis]) * invDir[axis];
+		if (t0 > t1)
+		{
+			swap(t0, t1);
+		}
+		tEntry = max(tEntry, t0);
+		tExit = min(tExit, t1);
+	}
+
+	if (m_grid.GetNumCells() > 0 && tEntry <= tExit)
+	{
+		// 3D-DDA setup: the cell the ray enters, and for each axis the distance to its next cell boundary
+		int cell[3];
+		int step[3];
+		int stop[3];
+		float tNext[3];
+		float tDelta[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			cell[axis] = static_cast<int>(CellCoord(pos[axis] + tEntry * dir[axis], minPos[axis], cellSize[axis], res[axis]));
+			if (dir[axis] > 0.0f)
+			{
+				step[axis] = 1;
+				stop[axis] = static_cast<int>(res[axis]);
+				tNext[axis] = (minPos[axis] + (cell[axis] + 1) * cellSize[axis] - pos[axis]) * invDir[axis];
+				tDelta[axis] = cellSize[axis] * invDir[axis];
+			}
+			else if (dir[axis] < 0.0f)
+			{
+				step[axis] = -1;
+				stop[axis] = -1;
+				tNext[axis] = (minPos[axis] + cell[axis] * cellSize[axis] - pos[axis]) * invDir[axis];
+				tDelta[axis] = -cellSize[axis] * invDir[axis];
+			}
+			else
+			{
+				step[axis] = 0;
+				stop[axis] = -1;
+				tNext[axis] = FLT_MAX;
+				tDelta[axis] = 0.0f;
+			}
+		}
+
+		uint32_t mailbox[GRID_MAILBOX_SIZE];
+		if (N == 1)
+		{
+			fill(begin(mailbox), end(mailbox), INVALID_PRIMITIVE);
+		}
+
+		const int strideY = static_cast<int>(res[0]);
+		const int strideZ = static_cast<int>(res[0] * res[1]);
+		for (;;)
+		{
+			IntersectCell<N>(static_cast<uint32_t>(cell[0] + cell[1] * strideY + cell[2] * strideZ), ray, hitSlot, mailbox);
+
+			const int axis = (tNext[0] < tNext[1]) ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+
+			// A hit before the ray leaves the cell can't be beaten by anything in later cells
+			if (ray.tmax <= tNext[axis])
+			{
+				break;
+			}
+
+			cell[axis] += step[axis];
+			if (cell[axis] == stop[axis])
+			{
+				break;
+			}
+			tNext[axis] += tDelta[axis];
+		}
+	}
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float invRadius = m_sphereList.invRadius[hitSlot];
+
+		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - m_sphereList.centerX[hitSlot];
+		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - m_sphereList.centerY[hitSlot];
+		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - m_sphereList.centerZ[hitSlot];
+		hit.normalX *= invRadius;
+		hit.normalY *= invRadius;
+		hit.normalZ *= invRadius;
+		hit.geomId = m_sphereList.id[hitSlot];
+	}
+}
+
+
+void GridAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectGrid<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectGrid<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectGrid<8>(ray, hit);
+	}
+}
+
+
+void GridAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const size_t simdSize = static_cast<size_t>(m_scene->GetSimdSize());
+	const size_t numSpheres = m_inputId.size();
+
+	m_grid = UniformGrid();
+
+	// Split off the spheres that are far larger than the typical one
+	float largeRadius = FLT_MAX;
+	if (numSpheres > 0)
+	{
+		vector<float> radii(m_inputRadius);
+		nth_element(radii.begin(), radii.begin() + numSpheres / 2, radii.end());
+		largeRadius = GRID_LARGE_SPHERE_FACTOR * radii[numSpheres / 2];
+	}
+
+	vector<uint32_t> largeSpheres;
+	vector<uint32_t> gridSpheres;
+	BvhBounds gridBounds;
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const float radius = m_inputRadius[i];
+		BvhBounds bounds;
+		bounds.Grow(m_inputCenterX[i] - radius, m_inputCenterY[i] - radius, m_inputCenterZ[i] - radius);
+		bounds.Grow(m_inputCenterX[i] + radius, m_inputCenterY[i] + radius, m_inputCenterZ[i] + radius);
+		m_grid.bounds.Grow(bounds);
+
+		if (radius > largeRadius)
+		{
+			largeSpheres.push_back(static_cast<uint32_t>(i));
+		}
+		else
+		{
+			gridSpheres.push_back(static_cast<uint32_t>(i));
+			gridBounds.Grow(bounds);
+		}
+	}
+
+	if (!gridSpheres.empty())
+	{
+		const float extents[3] = { gridBounds.maxX - gridBounds.minX, gridBounds.maxY - gridBounds.minY, gridBounds.maxZ - gridBounds.minZ };
+		uint32_t res[3];
+		ChooseResolution(extents, max<size_t>(gridSpheres.size() / simdSize, 1), res);
+
+		m_grid.minX = gridBounds.minX;
+		m_grid.minY = gridBounds.minY;
+		m_grid.minZ = gridBounds.minZ;
+		m_grid.cellSizeX = max(extents[0] / res[0], FLT_MIN);
+		m_grid.cellSizeY = max(extents[1] / res[1], FLT_MIN);
+		m_grid.cellSizeZ = max(extents[2] / res[2], FLT_MIN);
+		m_grid.resX = res[0];
+		m_grid.resY = res[1];
+		m_grid.resZ = res[2];
+	}
+
+	const size_t numCells = m_grid.GetNumCells();
+	m_grid.numLargeSlots = static_cast<uint32_t>(AlignUp(largeSpheres.size(), simdSize));
+
+	// Cells a sphere's bounds overlap, as a range of cell coordinates per axis
+	auto getCellRange = [&](uint32_t index, uint32_t(&lo)[3], uint32_t(&hi)[3])
+	{
+		const float radius = m_inputRadius[index];
+		lo[0] = CellCoord(m_inputCenterX[index] - radius, m_grid.minX, m_grid.cellSizeX, m_grid.resX);
+		lo[1] = CellCoord(m_inputCenterY[index] - radius, m_grid.minY, m_grid.cellSizeY, m_grid.resY);
+		lo[2] = CellCoord(m_inputCenterZ[index] - radius, m_grid.minZ, m_grid.cellSizeZ, m_grid.resZ);
+		hi[0] = CellCoord(m_inputCenterX[index] + radius, m_grid.minX, m_grid.cellSizeX, m_grid.resX);
+		hi[1] = CellCoord(m_inputCenterY[index] + radius, m_grid.minY, m_grid.cellSizeY, m_grid.resY);
+		hi[2] = CellCoord(m_inputCenterZ[index] + radius, m_grid.minZ, m_grid.cellSizeZ, m_grid.resZ);
+	};
+
+	auto forEachCell = [&](uint32_t index, auto&& cellFunc)
+	{
+		uint32_t lo[3];
+		uint32_t hi[3];
+		getCellRange(index, lo, hi);
+		for (uint32_t z = lo[2]; z <= hi[2]; ++z)
+		{
+			for (uint32_t y = lo[1]; y <= hi[1]; ++y)
+			{
+				for (uint32_t x = lo[0]; x <= hi[0]; ++x)
+				{
+					cellFunc((size_t(z) * m_grid.resY + y) * m_grid.resX + x);
+				}
+			}
+		}
+	};
+
+	// Count the spheres per cell, then pad every cell to the SIMD width and turn the counts into start slots
+	m_ownedCellStart.assign(numCells + 1, 0);
+	for (uint32_t index : gridSpheres)
+	{
+		forEachCell(index, [&](size_t cell) { ++m_ownedCellStart[cell]; });
+	}
+
+	size_t numSlots = m_grid.numLargeSlots;
+	for (size_t cell = 0; cell < numCells; ++cell)
+	{
+		const size_t count = m_ownedCellStart[cell];
+		m_ownedCellStart[cell] = static_cast<uint32_t>(numSlots);
+		numSlots += AlignUp(count, simdSize);
+	}
+	m_ownedCellStart[numCells] = static_cast<uint32_t>(numSlots);
+	assert(numSlots < INVALID_PRIMITIVE);
+
+	// Padding slots get a NaN radius, which fails every comparison
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+
+	m_centerX.assign(numSlots, 0.0f);
+	m_centerY.assign(numSlots, 0.0f);
+	m_centerZ.assign(numSlots, 0.0f);
+	m_radiusSq.assign(numSlots, nan);
+	m_invRadius.assign(numSlots, nan);
+	m_id.assign(numSlots, INVALID_PRIMITIVE);
+	m_ownedSphereIndex.assign(numSlots, INVALID_PRIMITIVE);
+
+	auto setSlot = [&](size_t slot, uint32_t index)
+	{
+		const float radius = m_inputRadius[index];
+		m_centerX[slot] = m_inputCenterX[index];
+		m_centerY[slot] = m_inputCenterY[index];
+		m_centerZ[slot] = m_inputCenterZ[index];
+		m_radiusSq[slot] = radius * radius;
+		m_invRadius[slot] = 1.0f / radius;
+		m_id[slot] = m_inputId[index];
+		m_ownedSphereIndex[slot] = index;
+	};
+
+	for (size_t i = 0; i < largeSpheres.size(); ++i)
+	{
+		setSlot(i, largeSpheres[i]);
+	}
+
+	vector<uint32_t> cellFill(m_ownedCellStart.begin(), m_ownedCellStart.end() - 1);
+	for (uint32_t index : gridSpheres)
+	{
+		forEachCell(index, [&](size_t cell) { setSlot(cellFill[cell]++, index); });
+	}
+
+	m_sphereList.centerX = m_centerX.data();
+	m_sphereList.centerY = m_centerY.data();
+	m_sphereList.centerZ = m_centerZ.data();
+	m_sphereList.radiusSq = m_radiusSq.data();
+	m_sphereList.invRadius = m_invRadius.data();
+	m_sphereList.id = m_id.data();
+	m_sphereList.numSlots = numSlots;
+	m_sphereIndex = m_ownedSphereIndex.data();
+	m_cellStart = m_ownedCellStart.data();
+
+	m_dirty = false;
+}
+
+
+BvhBounds GridAccelerator::GetBounds() const
+{
+	return m_grid.bounds;
+}
+
+
+size_t GridAccelerator::GetMemoryUsage() const
+{
+	return m_sphereList.numSlots * (5 * sizeof(float) + 2 * sizeof(uint32_t)) + (m_grid.GetNumCells() + 1) * sizeof(uint32_t);
+}
+
+
+uint64_t GridAccelerator::GetContentHash() const
+{
+	uint64_t hash = HashVector(m_inputCenterX);
+	hash = HashVector(m_inputCenterY, hash);
+	hash = HashVector(m_inputCenterZ, hash);
+	hash = HashVector(m_inputRadius, hash);
+	return HashVector(m_inputId, hash);
+}
+
+
+void GridAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	const float* arrays[5] =
+	{
+		m_sphereList.centerX, m_sphereList.centerY, m_sphereList.centerZ, m_sphereList.radiusSq, m_sphereList.invRadius
+	};
+
+	writer.AddSection(TAG_GRID_INFO, &m_grid, sizeof(UniformGrid));
+	writer.AddSection(TAG_GRID_CELLS, m_cellStart, (m_grid.GetNumCells() + 1) * sizeof(uint32_t));
+	writer.AddSection(TAG_GRID_IDS, m_sphereList.id, m_sphereList.numSlots * sizeof(uint32_t));
+	writer.AddSection(TAG_GRID_INDICES, m_sphereIndex, m_sphereList.numSlots * sizeof(uint32_t));
+	for (size_t i = 0; i < 5; ++i)
+	{
+		writer.AddSection(TAG_GRID_DATA[i], arrays[i], m_sphereList.numSlots * sizeof(float));
+	}
+}
+
+
+bool GridAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	// Cells padded for a wider SIMD width are still valid for a narrower one, but not the other way around
+	const auto simdSize = m_scene->GetSimdSize();
+	if (reader.GetSimdSize() % simdSize != 0)
+	{
+		return false;
+	}
+
+	size_t numInfos = 0;
+	const UniformGrid* grid = reader.FindSection<UniformGrid>(TAG_GRID_INFO, numInfos);
+	if (!grid || numInfos != 1)
+	{
+		return false;
+	}
+
+	size_t numCellStarts = 0;
+	const uint32_t* cellStart = reader.FindSection<uint32_t>(TAG_GRID_CELLS, numCellStarts);
+	if (!cellStart || numCellStarts != grid->GetNumCells() + 1)
+	{
+		return false;
+	}
+
+	size_t numSlots = 0;
+	const uint32_t* ids = reader.FindSection<uint32_t>(TAG_GRID_IDS, numSlots);
+	if (!ids || numSlots != cellStart[numCellStarts - 1])
+	{
+		return false;
+	}
+
+	size_t numIndices = 0;
+	const uint32_t* sphereIndex = reader.FindSection<uint32_t>(TAG_GRID_INDICES, numIndices);
+	if (!sphereIndex || numIndices != numSlots)
+	{
+		return false;
+	}
+
+	const float* arrays[5];
+	for (size_t i = 0; i < 5; ++i)
+	{
+		size_t count = 0;
+		arrays[i] = reader.FindSection<float>(TAG_GRID_DATA[i], count);
+		if (!arrays[i] || count != numSlots)
+		{
+			return false;
+		}
+	}
+
+	// A damaged file is rebuilt rather than read out of bounds.  Cells run in slot order after the large spheres,
+	// each padded to the SIMD width.
+	if (grid->numLargeSlots % simdSize != 0 || grid->numLargeSlots > cellStart[0])
+	{
+		return false;
+	}
+	for (size_t cell = 0; cell < numCellStarts; ++cell)
+	{
+		if (cellStart[cell] % simdSize != 0 || (cell > 0 && cellStart[cell] < cellStart[cell - 1]))
+		{
+			return false;
+		}
+	}
+
+	const size_t numInputs = m_inputId.size();
+	if (!AreSlotIdsValid(ids, numSlots, GetIdCount(m_inputId.data(), numInputs)) || !AreSlotIdsValid(sphereIndex, numSlots, numInputs))
+	{
+		return false;
+	}
+
+	FreeVector(m_centerX);
+	FreeVector(m_centerY);
+	FreeVector(m_centerZ);
+	FreeVector(m_radiusSq);
+	FreeVector(m_invRadius);
+	FreeVector(m_id);
+	FreeVector(m_ownedSphereIndex);
+	FreeVector(m_ownedCellStart);
+
+	m_sphereList.centerX = arrays[0];
+	m_sphereList.centerY = arrays[1];
+	m_sphereList.centerZ = arrays[2];
+	m_sphereList.radiusSq = arrays[3];
+	m_sphereList.invRadius = arrays[4];
+	m_sphereList.id = ids;
+	m_sphereList.numSlots = numSlots;
+	m_sphereIndex = sphereIndex;
+	m_cellStart = cellStart;
+	m_grid = *grid;
+
+	m_loaded = true;
+	m_dirty = false;
+
+	return true;
+}
+
+
+void GridAccelerator::UnloadAccel()
+{
+	if (!m_loaded)
+	{
+		return;
+	}
+
+	// The input spheres are kept while loaded, so the next Commit() can rebuild from them
+	m_sphereList = SphereList();
+	m_sphereIndex = nullptr;
+	m_cellStart = nullptr;
+	m_grid = UniformGrid();
+
+	m_loaded = false;
+	m_dirty = true;
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+#include "IAccelerator.h"
+#include "SphereAccel.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// Placement of the grid cells, saved as is in accelerator caches
+struct UniformGrid
+{
+	float		minX;
+	float		minY;
+	float		minZ;
+	float		cellSizeX;
+	float		cellSizeY;
+	float		cellSizeZ;
+	uint32_t	resX;
+	uint32_t	resY;
+	uint32_t	resZ;
+	uint32_t	numLargeSlots;	// Slots of the spheres kept out of the grid, ahead of the first cell
+	BvhBounds	bounds;			// Every sphere, in the grid or not
+
+	size_t GetNumCells() const { return size_t(resX) * resY * resZ; }
+};
+
+
+// Spheres in a uniform grid, for scenes of many similar-sized spheres spread evenly through space, where the
+// grid builds in O(n) and traversal needs no stack.  The resolution is chosen for about one SIMD width of spheres
+// per cell.  Cells are stored CSR style: each cell holds copies of the spheres overlapping it, as a run of SoA
+// slots padded to the SIMD width, so a cell is tested with the same Float<N> kernel as a BVH leaf.  Rays walk the
+// cells with a 3D-DDA and stop at the first cell that contains their closest hit.  Spheres much larger than
+// the median, such as a ground sphere, would stretch the grid over mostly empty space, so they are kept out of
+// it and tested against every ray.
+class GridAccelerator : public IAccelerator
+{
+public:
+	GridAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::SphereGrid;
+	}
+
+	void AddSphere(const Math::Vector3& center, float radius, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+	const UniformGrid& GetGrid() const { return m_grid; }
+
+private:
+	template <int N>
+	void IntersectGrid(Ray& ray, Hit& hit) const;
+
+	template <int N>
+	void IntersectCell(uint32_t cell, Ray& ray, uint32_t& hitSlot, uint32_t* mailbox) const;
+
+private:
+	Scene*			m_scene;
+
+	// Input spheres
+	std::vector<float>		m_inputCenterX;
+	std::vector<float>		m_inputCenterY;
+	std::vector<float>		m_inputCenterZ;
+	std::vector<float>		m_inputRadius;
+	std::vector<uint32_t>	m_inputId;
+
+	// Built data: the large spheres, then the slots of every cell in order
+	std::vector<float, aligned_allocator<float, 64>>		m_centerX;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerY;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerZ;
+	std::vector<float, aligned_allocator<float, 64>>		m_radiusSq;
+	std::vector<float, aligned_allocator<float, 64>>		m_invRadius;
+	std::vector<uint32_t, aligned_allocator<uint32_t, 64>>	m_id;
+	std::vector<uint32_t>									m_ownedSphereIndex;
+	std::vector<uint32_t>									m_ownedCellStart;
+
+	SphereList		m_sphereList;
+	const uint32_t*	m_sphereIndex{ nullptr };	// Input sphere of each slot, for mailboxing
+	const uint32_t*	m_cellStart{ nullptr };		// First slot of each cell, plus one past the last cell
+	UniformGrid		m_grid{};
+
+	bool			m_loaded{ false };
+	bool			m_dirty{ false };
+};
\ No newline at end of file
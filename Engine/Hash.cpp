@@ -0,0 +1,86 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Hash.h"
+
+#include <cstring>
+
+
+using namespace std;
+
+
+namespace
+{
+
+constexpr uint64_t PRIME1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t PRIME2 = 0xc2b2ae3d27d4eb4full;
+
+
+__forceinline uint64_t RotateLeft(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+
+__forceinline uint64_t Mix(uint64_t h, uint64_t k)
+{
+	k *= PRIME2;
+	k = RotateLeft(k, 31);
+	k *= PRIME1;
+	h ^= k;
+	return RotateLeft(h, 27) * PRIME1 + PRIME2;
+}
+
+} // anonymous namespace
+
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+
+	// Four independent lanes, so the multiplies can overlap
+	uint64_t h[4] = { seed, seed + PRIME1, seed - PRIME2, seed ^ PRIME2 };
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		uint64_t k[4];
+		memcpy(k, bytes + i, 32);
+		h[0] = Mix(h[0], k[0]);
+		h[1] = Mix(h[1], k[1]);
+		h[2] = Mix(h[2], k[2]);
+		h[3] = Mix(h[3], k[3]);
+	}
+
+	uint64_t result = RotateLeft(h[0], 1) + RotateLeft(h[1], 7) + RotateLeft(h[2], 12) + RotateLeft(h[3], 18);
+
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t k;
+		memcpy(&k, bytes + i, 8);
+		result = Mix(result, k);
+	}
+
+	if (i < size)
+	{
+		uint64_t k = 0;
+		memcpy(&k, bytes + i, size - i);
+		result = Mix(result, k);
+	}
+
+	// Final avalanche
+	result ^= size;
+	result ^= result >> 33;
+	result *= PRIME2;
+	result ^= result >> 29;
+	result *= PRIME1;
+	result ^= result >> 32;
+	return result;
+}
\ No newline at end of file
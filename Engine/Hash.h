@@ -0,0 +1,29 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+
+constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+
+// Fast non-cryptographic 64-bit hash, used to key cached acceleration structures on their input data
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = HASH_SEED);
+
+
+template <typename T, typename Alloc>
+uint64_t HashVector(const std::vector<T, Alloc>& data, uint64_t seed = HASH_SEED)
+{
+	return HashBytes(data.data(), data.size() * sizeof(T), seed);
+}
+
+
+__forceinline uint64_t HashCombine(uint64_t seed, uint64_t value)
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
\ No newline at end of file
@@ -10,15 +10,55 @@
 
 
 enum class PrimitiveType;
+class BakedFileReader;
+class BakedFileWriter;
+class ScratchArena;
+struct BvhBounds;
+struct SphereList;
+struct TileFrustum;
 
 
 class IAccelerator
 {
 public:
+	virtual ~IAccelerator() = default;
+
 	virtual PrimitiveType GetPrimitiveType() const = 0;
 
 	// Intersection methods
 	virtual void Intersect1(Ray& ray, Hit& hit) const = 0;
 
+	// Intersects count independent rays.  Accelerators that trace groups of rays faster than one at a time
+	// override this; coherent is a hint that the rays share an origin and have similar directions.
+	virtual void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			Intersect1(rays[i], hits[i]);
+		}
+	}
+
+	// Primary ray culling, see ITracer::CullTile.  Sphere accelerators that support it fill culled with copies of
+	// their spheres that may intersect the frustum, allocated from scratch.  They return false where they cannot
+	// cull, or where the culled list would trace slower than the accelerator itself.
+	virtual bool CullTile(const TileFrustum& frustum, ScratchArena& scratch, SphereList& culled) const
+	{
+		return false;
+	}
+
 	virtual void Commit() = 0;
+
+	// World space bounds of the committed primitives, used to place instances of a scene in a top-level BVH
+	virtual BvhBounds GetBounds() const = 0;
+
+	// Bytes of built acceleration data, whether owned or mapped from an accelerator cache
+	virtual size_t GetMemoryUsage() const = 0;
+
+	// Built state caching.  The content hash covers the input primitives, so a saved state is only reused for
+	// identical input.  LoadAccel references the reader's mapped memory in place, and UnloadAccel drops that
+	// reference again so the next Commit() rebuilds.
+	virtual uint64_t GetContentHash() const = 0;
+	virtual void SaveAccel(BakedFileWriter& writer) const = 0;
+	virtual bool LoadAccel(const BakedFileReader& reader) = 0;
+	virtual void UnloadAccel() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,59 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+
+class ScratchArena;
+struct SceneDesc;
+struct TileCull;
+struct TileFrustum;
+
+
+// A ray tracing backend.  The render loop and benchmark harness only see this interface, so the native engine
+// and the Embree reference can be driven with identical scenes and render configurations.
+class ITracer
+{
+public:
+	virtual ~ITracer() = default;
+
+	virtual const char* GetName() const = 0;
+
+	// Builds the acceleration structures for a scene, once.  Hit ids are the primitive ids of the description.
+	virtual void Build(const SceneDesc& desc) = 0;
+
+	// Same contract as Scene::Intersect1: shrinks ray.tmax and fills in hit on a closer hit
+	virtual void Intersect1(Ray& ray, Hit& hit) const = 0;
+
+	// Intersects count rays, each against its own hit, with the Intersect1 contract per ray.  Coherent batches,
+	// such as the camera rays of a tile, suit packet tracing, the others stream tracing.  Backends without either
+	// trace one ray at a time.
+	virtual void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			Intersect1(rays[i], hits[i]);
+		}
+	}
+
+	// Primary ray culling.  CullTile gathers what the primary rays through one tile's frustum can hit, in memory
+	// from scratch that stays valid until the arena is reset, and returns nullptr where the backend does not cull.
+	// IntersectCulled then traces one of those rays against the gathered primitives only.
+	virtual const TileCull* CullTile(const TileFrustum& frustum, ScratchArena& scratch) const
+	{
+		return nullptr;
+	}
+
+	virtual void IntersectCulled(const TileCull& cull, Ray& ray, Hit& hit) const
+	{
+		Intersect1(ray, hit);
+	}
+
+	// Bytes of acceleration data after Build()
+	virtual size_t GetMemoryUsage() const = 0;
+};
\ No newline at end of file
@@ -10,11 +10,22 @@
 
 #include "Image.h"
 
+#include "Profiler.h"
+
 
 using namespace std;
 using namespace Math;
 
 
+Vector3 LinearToSRGB(Vector3 linearRGB)
+{
+	XMVECTOR T = XMVectorSaturate(linearRGB);
+	XMVECTOR result = XMVectorSubtract(XMVectorScale(XMVectorPow(T, XMVectorReplicate(1.0f / 2.4f)), 1.055f), XMVectorReplicate(0.055f));
+	result = XMVectorSelect(result, XMVectorScale(T, 12.92f), XMVectorLess(T, XMVectorReplicate(0.0031308f)));
+	return Vector3(XMVectorSelect(T, result, g_XMSelect1110));
+}
+
+
 Image::Image(int width, int height)
 	: m_width(width)
 	, m_height(height)
@@ -44,6 +55,12 @@ Vector3* Image::GetData()
 }
 
 
+const Vector3* Image::GetData() const
+{
+	return m_imageData.get();
+}
+
+
 void Image::Init()
 {
 	m_invWidth = 1.0f / static_cast<float>(m_width);
@@ -55,6 +72,8 @@ void Image::Init()
 
 void Image::SaveAs(const char* filename)
 {
+	PROFILE_ZONE("Image::SaveAs");
+
 	ofstream outfile;
 	outfile.open(filename, ios::out | ios::trunc);
 
@@ -64,7 +83,7 @@ void Image::SaveAs(const char* filename)
 	{
 		for (int i = 0; i < m_width; ++i)
 		{
-			const Vector3& color = m_imageData[i + j * m_width];
+			const Vector3 color = LinearToSRGB(m_imageData[i + j * m_width]);
 			int ir = int(255.99f * color.GetX());
 			int ig = int(255.99f * color.GetY());
 			int ib = int(255.99f * color.GetZ());
@@ -74,4 +93,82 @@ void Image::SaveAs(const char* filename)
 	}
 
 	outfile.close();
+}
+
+
+bool Image::SaveAsPFM(const char* filename) const
+{
+	PROFILE_ZONE("Image::SaveAsPFM");
+
+	ofstream outfile;
+	outfile.open(filename, ios::out | ios::trunc | ios::binary);
+	if (!outfile.is_open())
+	{
+		return false;
+	}
+
+	// A negative scale marks little-endian data.  Rows are stored bottom to top, same as the image.
+	outfile << "PF\n" << m_width << " " << m_height << "\n-1.0\n";
+
+	vector<float> row(3 * m_width);
+	for (int j = 0; j < m_height; ++j)
+	{
+		for (int i = 0; i < m_width; ++i)
+		{
+			const Vector3& color = m_imageData[i + j * m_width];
+			row[3 * i + 0] = color.GetX();
+			row[3 * i + 1] = color.GetY();
+			row[3 * i + 2] = color.GetZ();
+		}
+		outfile.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+	}
+
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+bool LoadPFM(const char* filename, unique_ptr<Image>& image)
+{
+	ifstream infile;
+	infile.open(filename, ios::in | ios::binary);
+	if (!infile.is_open())
+	{
+		return false;
+	}
+
+	string magic;
+	int width = 0;
+	int height = 0;
+	float scale = 0.0f;
+	infile >> magic >> width >> height >> scale;
+
+	// Big-endian and greyscale PFMs are not supported
+	if (!infile || magic != "PF" || width <= 0 || height <= 0 || scale >= 0.0f)
+	{
+		return false;
+	}
+
+	// Exactly one whitespace character separates the header from the data
+	infile.get();
+
+	auto loaded = make_unique<Image>(width, height);
+
+	vector<float> row(3 * width);
+	for (int j = 0; j < height; ++j)
+	{
+		infile.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(float));
+		if (!infile)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < width; ++i)
+		{
+			loaded->SetPixel(i, j, Vector3(row[3 * i + 0], row[3 * i + 1], row[3 * i + 2]));
+		}
+	}
+
+	image = move(loaded);
+	return true;
 }
\ No newline at end of file
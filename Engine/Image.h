@@ -22,11 +22,18 @@ public:
 	float GetInvWidth() const { return m_invWidth; }
 	float GetInvHeight() const { return m_invHeight; }
 
+	// Pixels hold linear color, with (0, 0) at the bottom left
 	void SetPixel(int i, int j, Math::Vector3 color);
+	Math::Vector3 GetPixel(int i, int j) const { return m_imageData[i + j * m_width]; }
 	Math::Vector3* GetData();
+	const Math::Vector3* GetData() const;
 
+	// 8-bit PPM, sRGB encoded
 	void SaveAs(const char* filename);
 
+	// 32-bit float PFM, linear and lossless
+	bool SaveAsPFM(const char* filename) const;
+
 private:
 	void Init();
 
@@ -37,4 +44,12 @@ private:
 	float m_invHeight;
 
 	std::unique_ptr<Math::Vector3[]> m_imageData;
-};
\ No newline at end of file
+};
+
+
+// Loads an RGB PFM written by SaveAsPFM (or any other little-endian RGB PFM)
+bool LoadPFM(const char* filename, std::unique_ptr<Image>& image);
+
+
+// Encodes a linear color with the sRGB transfer curve, after clamping to [0, 1]
+Math::Vector3 LinearToSRGB(Math::Vector3 linearRGB);
\ No newline at end of file
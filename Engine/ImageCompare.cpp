@@ -0,0 +1,125 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "ImageCompare.h"
+
+#include "Image.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+Vector3 HeatmapColor(float t)
+{
+	float r = min(max(3.0f * t, 0.0f), 1.0f);
+	float g = min(max(3.0f * t - 1.0f, 0.0f), 1.0f);
+	float b = min(max(3.0f * t - 2.0f, 0.0f), 1.0f);
+	return Vector3(r, g, b);
+}
+
+} // anonymous namespace
+
+
+bool CompareImages(const Image& reference, const Image& test, ImageDiff& diff, Image* heatmap)
+{
+	const int width = reference.GetWidth();
+	const int height = reference.GetHeight();
+
+	if (test.GetWidth() != width || test.GetHeight() != height)
+	{
+		return false;
+	}
+
+	if (heatmap && (heatmap->GetWidth() != width || heatmap->GetHeight() != height))
+	{
+		return false;
+	}
+
+	diff = ImageDiff();
+
+	// Largest channel error per pixel, for the heatmap
+	vector<float> pixelErrors(static_cast<size_t>(width) * height);
+
+	double sumSquaredError = 0.0;
+	double sumError = 0.0;
+
+	// Summed error per block and channel
+	const int numBlocksX = (width + COMPARE_BLOCK_SIZE - 1) / COMPARE_BLOCK_SIZE;
+	const int numBlocksY = (height + COMPARE_BLOCK_SIZE - 1) / COMPARE_BLOCK_SIZE;
+	vector<double> blockErrors(3 * static_cast<size_t>(numBlocksX) * numBlocksY, 0.0);
+	vector<int> blockCounts(static_cast<size_t>(numBlocksX) * numBlocksY, 0);
+
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const Vector3 error = LinearToSRGB(test.GetPixel(i, j)) - LinearToSRGB(reference.GetPixel(i, j));
+			const float errors[3] = { error.GetX(), error.GetY(), error.GetZ() };
+
+			const size_t block = (i / COMPARE_BLOCK_SIZE) + (j / COMPARE_BLOCK_SIZE) * numBlocksX;
+			++blockCounts[block];
+
+			float pixelError = 0.0f;
+			for (int c = 0; c < 3; ++c)
+			{
+				const float e = errors[c];
+				sumSquaredError += static_cast<double>(e) * e;
+				sumError += e;
+				blockErrors[3 * block + c] += e;
+				pixelError = max(pixelError, fabsf(e));
+			}
+
+			pixelErrors[i + j * width] = pixelError;
+
+			if (pixelError > diff.maxError)
+			{
+				diff.maxError = pixelError;
+				diff.maxErrorX = i;
+				diff.maxErrorY = j;
+			}
+		}
+	}
+
+	const double numValues = 3.0 * width * height;
+	const double mse = sumSquaredError / numValues;
+
+	diff.rmse = sqrt(mse);
+	diff.psnr = (mse > 0.0) ? -10.0 * log10(mse) : numeric_limits<double>::infinity();
+	diff.meanError = sumError / numValues;
+
+	double sumSquaredBlockError = 0.0;
+	for (size_t block = 0; block < blockCounts.size(); ++block)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			const double e = blockErrors[3 * block + c] / blockCounts[block];
+			sumSquaredBlockError += e * e;
+		}
+	}
+	diff.blockRmse = sqrt(sumSquaredBlockError / (3.0 * blockCounts.size()));
+
+	if (heatmap)
+	{
+		const float scale = (diff.maxError > 0.0f) ? 1.0f / diff.maxError : 0.0f;
+		for (int j = 0; j < height; ++j)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				heatmap->SetPixel(i, j, HeatmapColor(pixelErrors[i + j * width] * scale));
+			}
+		}
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+
+// Forward declarations
+class Image;
+
+
+// Block size for ImageDiff::blockRmse.  Averaging over blocks mostly cancels sampling noise, so two renders
+// that differ only in their random paths have a much smaller block RMSE than RMSE, while a real change in the
+// image keeps both high.
+constexpr int COMPARE_BLOCK_SIZE = 8;
+
+
+struct ImageDiff
+{
+	double	rmse{ 0.0 };
+	double	psnr{ 0.0 };		// In dB, infinite for identical images
+	double	meanError{ 0.0 };	// Signed mean of test - reference; noise averages out, bias does not
+	double	blockRmse{ 0.0 };	// RMSE of the block averages, see COMPARE_BLOCK_SIZE
+	float	maxError{ 0.0f };
+	int		maxErrorX{ 0 };
+	int		maxErrorY{ 0 };
+
+	bool IsIdentical() const { return maxError == 0.0f; }
+};
+
+
+// Compares the sRGB encoded images, so errors are weighted roughly as they are seen, against a peak value of 1.
+// When a heatmap image is given, each of its pixels is set to a black-red-yellow-white ramp of that pixel's
+// largest channel error, scaled to the maximum error.  Fails if the image sizes differ.
+bool CompareImages(const Image& reference, const Image& test, ImageDiff& diff, Image* heatmap = nullptr);
\ No newline at end of file
@@ -0,0 +1,293 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "InstanceAccel.h"
+
+#include "BakedFile.h"
+#include "Hash.h"
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr uint32_t TAG_INSTANCE_NODES = MakeBakedTag('I', 'N', 'O', 'D');
+constexpr uint32_t TAG_INSTANCE_SLOTS = MakeBakedTag('I', 'S', 'L', 'T');
+
+// Instances are expensive to test, so leaves are kept small
+constexpr size_t INSTANCE_LEAF_SIZE = 2;
+
+
+__forceinline void TransformPoint(const float (&m)[3][4], float x, float y, float z, float& outX, float& outY, float& outZ)
+{
+	outX = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+	outY = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+	outZ = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+}
+
+
+__forceinline void TransformVector(const float (&m)[3][4], float x, float y, float z, float& outX, float& outY, float& outZ)
+{
+	outX = m[0][0] * x + m[0][1] * y + m[0][2] * z;
+	outY = m[1][0] * x + m[1][1] * y + m[1][2] * z;
+	outZ = m[2][0] * x + m[2][1] * y + m[2][2] * z;
+}
+
+
+// Normals go back to world space through the inverse transpose of the object to world transform, which is the
+// transpose of the stored world to object transform
+__forceinline void TransformNormal(const float (&m)[3][4], float x, float y, float z, float& outX, float& outY, float& outZ)
+{
+	outX = m[0][0] * x + m[1][0] * y + m[2][0] * z;
+	outY = m[0][1] * x + m[1][1] * y + m[2][1] * z;
+	outZ = m[0][2] * x + m[1][2] * y + m[2][2] * z;
+}
+
+
+// DirectXMath matrices act on row vectors, so their rows are the columns of the column vector form
+void GetRows(const Matrix4& mat, float (&m)[3][4])
+{
+	const Vector4 rows[4] = { mat.GetX(), mat.GetY(), mat.GetZ(), mat.GetW() };
+	for (int i = 0; i < 4; ++i)
+	{
+		m[0][i] = rows[i].GetX();
+		m[1][i] = rows[i].GetY();
+		m[2][i] = rows[i].GetZ();
+	}
+}
+
+} // anonymous namespace
+
+
+InstanceAccelerator::InstanceAccelerator(Scene* scene)
+	: m_scene(scene)
+{}
+
+
+void InstanceAccelerator::AddInstance(Scene* object, const AffineTransform& objectToWorld)
+{
+	if (m_loaded)
+	{
+		UnloadAccel();
+	}
+
+	InstanceInput input;
+	input.instance.object = object;
+	GetRows(Matrix4(objectToWorld), input.objectToWorld);
+	GetRows(Invert(Matrix4(objectToWorld)), input.instance.worldToObject);
+
+	m_inputInstances.push_back(input);
+
+	m_dirty = true;
+}
+
+
+void InstanceAccelerator::IntersectInstance(const Instance& instance, Ray& ray, Hit& hit) const
+{
+	const auto& m = instance.worldToObject;
+
+	Ray objectRay;
+	TransformPoint(m, ray.posX, ray.posY, ray.posZ, objectRay.posX, objectRay.posY, objectRay.posZ);
+	TransformVector(m, ray.dirX, ray.dirY, ray.dirZ, objectRay.dirX, objectRay.dirY, objectRay.dirZ);
+
+	// The primitive kernels expect a unit direction, so renormalize and rescale the ray interval to match
+	const float scale = sqrtf(objectRay.dirX * objectRay.dirX + objectRay.dirY * objectRay.dirY + objectRay.dirZ * objectRay.dirZ);
+	const float invScale = 1.0f / scale;
+
+	objectRay.dirX *= invScale;
+	objectRay.dirY *= invScale;
+	objectRay.dirZ *= invScale;
+	objectRay.tmin = ray.tmin * scale;
+	objectRay.tmax = ray.tmax * scale;
+
+	const float objectTMax = objectRay.tmax;
+
+	Hit objectHit;
+	instance.object->Intersect1(objectRay, objectHit);
+
+	if (objectRay.tmax < objectTMax)
+	{
+		ray.tmax = objectRay.tmax * invScale;
+
+		float normalX, normalY, normalZ;
+		TransformNormal(m, objectHit.normalX, objectHit.normalY, objectHit.normalZ, normalX, normalY, normalZ);
+
+		const float invLength = 1.0f / sqrtf(normalX * normalX + normalY * normalY + normalZ * normalZ);
+		hit.normalX = normalX * invLength;
+		hit.normalY = normalY * invLength;
+		hit.normalZ = normalZ * invLength;
+		hit.geomId = objectHit.geomId;
+	}
+}
+
+
+void InstanceAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	m_bvh.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		const uint32_t last = first + count;
+		for (uint32_t i = first; i < last; ++i)
+		{
+			IntersectInstance(m_instances[i], ray, hit);
+		}
+	});
+}
+
+
+void InstanceAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	CommitObjects();
+
+	// World space bounds of each instance, from the eight transformed corners of its object bounds
+	const size_t numInstances = m_inputInstances.size();
+	vector<BvhBounds> bounds(numInstances);
+	for (size_t i = 0; i < numInstances; ++i)
+	{
+		const InstanceInput& input = m_inputInstances[i];
+		const BvhBounds objectBounds = input.instance.object->GetBounds();
+		if (objectBounds.IsEmpty())
+		{
+			continue;
+		}
+
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			float x, y, z;
+			TransformPoint(input.objectToWorld,
+				(corner & 1) ? objectBounds.maxX : objectBounds.minX,
+				(corner & 2) ? objectBounds.maxY : objectBounds.minY,
+				(corner & 4) ? objectBounds.maxZ : objectBounds.minZ,
+				x, y, z);
+			bounds[i].Grow(x, y, z);
+		}
+	}
+
+	m_bvh.Build(bounds, 1, INSTANCE_LEAF_SIZE);
+
+	const auto& slots = m_bvh.GetPrimitiveSlots();
+	GatherInstances(slots.data(), slots.size());
+
+	m_dirty = false;
+}
+
+
+BvhBounds InstanceAccelerator::GetBounds() const
+{
+	return m_bvh.GetBounds();
+}
+
+
+size_t InstanceAccelerator::GetMemoryUsage() const
+{
+	// The object scenes are shared, so they are not counted here
+	return m_instances.size() * sizeof(Instance) + m_slots.size() * sizeof(uint32_t) + m_bvh.GetMemoryUsage();
+}
+
+
+uint64_t InstanceAccelerator::GetContentHash() const
+{
+	uint64_t hash = HASH_SEED;
+	for (const auto& input : m_inputInstances)
+	{
+		hash = HashBytes(input.objectToWorld, sizeof(input.objectToWorld), hash);
+		hash = HashCombine(hash, input.instance.object->GetContentHash());
+	}
+	return hash;
+}
+
+
+void InstanceAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	writer.AddSection(TAG_INSTANCE_NODES, m_bvh.GetNodes(), m_bvh.GetNumNodes() * sizeof(BvhNode));
+	writer.AddSection(TAG_INSTANCE_SLOTS, m_slots);
+}
+
+
+bool InstanceAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	size_t numNodes = 0;
+	const BvhNode* nodes = reader.FindSection<BvhNode>(TAG_INSTANCE_NODES, numNodes);
+
+	size_t numSlots = 0;
+	const uint32_t* slots = reader.FindSection<uint32_t>(TAG_INSTANCE_SLOTS, numSlots);
+
+	if (!nodes || !slots || numNodes == 0 || numSlots != m_inputInstances.size())
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		if (slots[i] >= m_inputInstances.size())
+		{
+			return false;
+		}
+	}
+
+	CommitObjects();
+	GatherInstances(slots, numSlots);
+
+	m_bvh.Attach(nodes, numNodes);
+
+	m_loaded = true;
+	m_dirty = false;
+
+	return true;
+}
+
+
+void InstanceAccelerator::UnloadAccel()
+{
+	if (!m_loaded)
+	{
+		return;
+	}
+
+	m_bvh.Clear();
+	m_instances.clear();
+	m_slots.clear();
+
+	m_loaded = false;
+	m_dirty = true;
+}
+
+
+void InstanceAccelerator::CommitObjects()
+{
+	for (auto& input : m_inputInstances)
+	{
+		input.instance.object->Commit();
+	}
+}
+
+
+void InstanceAccelerator::GatherInstances(const uint32_t* slots, size_t numSlots)
+{
+	m_slots.assign(slots, slots + numSlots);
+
+	m_instances.resize(numSlots);
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		m_instances[i] = m_inputInstances[slots[i]].instance;
+	}
+}
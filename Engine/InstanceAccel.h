@@ -0,0 +1,83 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+#include "IAccelerator.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// One placement of a bottom-level scene.  The world to object transform is stored as the three rows of a 3x4
+// matrix acting on column vectors, which is also the transpose of the normal transform back to world space.
+struct Instance
+{
+	Scene*	object{ nullptr };
+	float	worldToObject[3][4];
+};
+
+
+// Top-level accelerator.  A BVH over the world space bounds of the instances; rays reaching an instance are
+// transformed into object space and traced against the shared bottom-level scene.
+class InstanceAccelerator : public IAccelerator
+{
+public:
+	InstanceAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Instance;
+	}
+
+	// The object scene must stay alive while instanced.  It is committed along with this accelerator, so
+	// it can be shared between any number of instances (and scenes).
+	void AddInstance(Scene* object, const Math::AffineTransform& objectToWorld);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching.  Only the top-level BVH is cached; the object scenes are committed (or loaded)
+	// on their own.
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	struct InstanceInput
+	{
+		Instance	instance;
+		float		objectToWorld[3][4];
+	};
+
+	void IntersectInstance(const Instance& instance, Ray& ray, Hit& hit) const;
+	void CommitObjects();
+	void GatherInstances(const uint32_t* slots, size_t numSlots);
+
+private:
+	Scene*						m_scene;
+
+	// Input instances
+	std::vector<InstanceInput>	m_inputInstances;
+
+	// Instances in leaf order
+	std::vector<Instance>		m_instances;
+	std::vector<uint32_t>		m_slots;
+
+	Bvh							m_bvh;
+
+	bool						m_loaded{ false };
+	bool						m_dirty{ false };
+};
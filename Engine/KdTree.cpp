@@ -0,0 +1,325 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "KdTree.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// SAH costs, relative to one traversal step.  Leaves are charged per Float<N> test, not per primitive.
+constexpr float KD_TRAVERSAL_COST = 1.0f;
+constexpr float KD_INTERSECT_COST = 2.0f;
+constexpr float KD_EMPTY_BONUS = 0.5f;
+constexpr int KD_MAX_BAD_REFINES = 3;
+
+// Traversal keeps a KD_STACK_SIZE entry stack
+constexpr int KD_MAX_DEPTH = 60;
+
+
+enum KdSide : uint8_t
+{
+	KD_BELOW,
+	KD_ABOVE,
+	KD_BOTH
+};
+
+
+__forceinline float BoundsMin(const BvhBounds& bounds, int axis)
+{
+	switch (axis)
+	{
+	case 0: return bounds.minX;
+	case 1: return bounds.minY;
+	default: return bounds.minZ;
+	}
+}
+
+
+__forceinline float BoundsMax(const BvhBounds& bounds, int axis)
+{
+	switch (axis)
+	{
+	case 0: return bounds.maxX;
+	case 1: return bounds.maxY;
+	default: return bounds.maxZ;
+	}
+}
+
+} // anonymous namespace
+
+
+// Primitive bounds entering or leaving along one axis.  Ends sort before starts at the same position, so a split
+// there puts the primitives ending on the plane below it and the ones starting on it above.
+struct KdTree::Event
+{
+	float		pos;
+	uint32_t	prim;
+	uint32_t	isStart;
+
+	bool operator<(const Event& other) const
+	{
+		return (pos < other.pos) || (pos == other.pos && isStart < other.isStart);
+	}
+};
+
+
+struct KdTree::BuildState
+{
+	const std::vector<BvhBounds>&	primBounds;
+	std::vector<uint8_t>			side;		// KdSide of each primitive at the node being split
+	int								maxDepth;
+};
+
+
+void KdTree::Build(const vector<BvhBounds>& primBounds, size_t simdSize)
+{
+	m_simdSize = simdSize;
+	m_nodeStorage.clear();
+	m_primSlots.clear();
+	m_bounds = BvhBounds();
+
+	const size_t numPrims = primBounds.size();
+	for (const auto& bounds : primBounds)
+	{
+		m_bounds.Grow(bounds);
+	}
+
+	if (numPrims == 0)
+	{
+		m_nodes = nullptr;
+		m_numNodes = 0;
+		return;
+	}
+
+	// Sorting the events once here, and keeping them sorted through every split, is what makes the build
+	// O(n log n) instead of O(n log^2 n)
+	vector<Event> events[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		events[axis].reserve(2 * numPrims);
+		for (size_t i = 0; i < numPrims; ++i)
+		{
+			events[axis].push_back(Event{ BoundsMin(primBounds[i], axis), static_cast<uint32_t>(i), 1 });
+			events[axis].push_back(Event{ BoundsMax(primBounds[i], axis), static_cast<uint32_t>(i), 0 });
+		}
+		sort(events[axis].begin(), events[axis].end());
+	}
+
+	BuildState state{ primBounds, vector<uint8_t>(numPrims, KD_BOTH), min(KD_MAX_DEPTH, static_cast<int>(8.0f + 1.3f * log2f(static_cast<float>(numPrims)))) };
+	BuildRecursive(state, events, m_bounds, 0, 0);
+
+	m_nodes = m_nodeStorage.data();
+	m_numNodes = m_nodeStorage.size();
+}
+
+
+void KdTree::Attach(const KdNode* nodes, size_t numNodes, const BvhBounds& bounds)
+{
+	FreeVector(m_nodeStorage);
+	FreeVector(m_primSlots);
+	m_nodes = nodes;
+	m_numNodes = numNodes;
+	m_bounds = bounds;
+}
+
+
+bool KdTree::IsValid(const KdNode* nodes, size_t numNodes, size_t numSlots, size_t simdSize)
+{
+	// Both children come after their parent, so one pass in index order sees every parent before its children
+	vector<uint8_t> depths(numNodes, 0);
+	for (size_t i = 0; i < numNodes; ++i)
+	{
+		const KdNode& node = nodes[i];
+		if (node.IsLeaf())
+		{
+			if (node.offset % simdSize != 0 || node.GetCount() % simdSize != 0 || uint64_t(node.offset) + node.GetCount() > numSlots)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		const size_t depth = depths[i] + 1;
+		const uint32_t aboveChild = node.GetAboveChild();
+		if (aboveChild <= i + 1 || aboveChild >= numNodes || depth >= KD_STACK_SIZE)
+		{
+			return false;
+		}
+
+		depths[i + 1] = max(depths[i + 1], static_cast<uint8_t>(depth));
+		depths[aboveChild] = max(depths[aboveChild], static_cast<uint8_t>(depth));
+	}
+
+	return true;
+}
+
+
+void KdTree::Clear()
+{
+	FreeVector(m_nodeStorage);
+	FreeVector(m_primSlots);
+	m_nodes = nullptr;
+	m_numNodes = 0;
+	m_bounds = BvhBounds();
+}
+
+
+void KdTree::BuildRecursive(BuildState& state, vector<Event>(&events)[3], const BvhBounds& nodeBounds, int depth, int badRefines)
+{
+	const uint32_t nodeIndex = static_cast<uint32_t>(m_nodeStorage.size());
+	m_nodeStorage.emplace_back();
+
+	const size_t numPrims = events[0].size() / 2;
+	auto numTests = [&](size_t count) { return static_cast<float>((count + m_simdSize - 1) / m_simdSize); };
+	const float leafCost = KD_INTERSECT_COST * numTests(numPrims);
+
+	// Sweep the sorted events of each axis, counting the primitives on either side of each candidate plane
+	int bestAxis = -1;
+	float bestPos = 0.0f;
+	float bestCost = FLT_MAX;
+
+	const float totalArea = nodeBounds.SurfaceArea();
+	if (numPrims > m_simdSize && depth < state.maxDepth && totalArea > 0.0f)
+	{
+		const float invTotalArea = 1.0f / totalArea;
+		const float extents[3] = { nodeBounds.maxX - nodeBounds.minX, nodeBounds.maxY - nodeBounds.minY, nodeBounds.maxZ - nodeBounds.minZ };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float nodeMin = BoundsMin(nodeBounds, axis);
+			const float nodeMax = BoundsMax(nodeBounds, axis);
+			const float sideArea = extents[(axis + 1) % 3] * extents[(axis + 2) % 3];
+			const float sidePerimeter = extents[(axis + 1) % 3] + extents[(axis + 2) % 3];
+
+			size_t numBelow = 0;
+			size_t numAbove = numPrims;
+			for (const Event& event : events[axis])
+			{
+				if (!event.isStart)
+				{
+					--numAbove;
+				}
+
+				if (event.pos > nodeMin && event.pos < nodeMax)
+				{
+					const float belowArea = 2.0f * (sideArea + (event.pos - nodeMin) * sidePerimeter);
+					const float aboveArea = 2.0f * (sideArea + (nodeMax - event.pos) * sidePerimeter);
+					const float emptyBonus = (numBelow == 0 || numAbove == 0) ? KD_EMPTY_BONUS : 0.0f;
+					const float cost = KD_TRAVERSAL_COST + KD_INTERSECT_COST * (1.0f - emptyBonus) * invTotalArea * (belowArea * numTests(numBelow) + aboveArea * numTests(numAbove));
+
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestPos = event.pos;
+					}
+				}
+
+				if (event.isStart)
+				{
+					++numBelow;
+				}
+			}
+		}
+	}
+
+	if (bestCost > leafCost)
+	{
+		++badRefines;
+	}
+
+	if (bestAxis < 0 || (bestCost > 4.0f * leafCost && numPrims < 16) || badRefines >= KD_MAX_BAD_REFINES)
+	{
+		// Leaf, padded to the SIMD width
+		const size_t first = m_primSlots.size();
+		for (const Event& event : events[0])
+		{
+			if (event.isStart)
+			{
+				m_primSlots.push_back(event.prim);
+			}
+		}
+		m_primSlots.resize(AlignUp(m_primSlots.size(), m_simdSize), INVALID_PRIMITIVE);
+
+		KdNode& node = m_nodeStorage[nodeIndex];
+		node.offset = static_cast<uint32_t>(first);
+		node.flags = KD_LEAF | static_cast<uint32_t>((m_primSlots.size() - first) << 2);
+
+		for (auto& axisEvents : events)
+		{
+			FreeVector(axisEvents);
+		}
+		return;
+	}
+
+	// Classify the primitives against the plane, then split every axis' events in order, so the children's lists
+	// come out sorted without another sort
+	for (const Event& event : events[0])
+	{
+		if (event.isStart)
+		{
+			const BvhBounds& bounds = state.primBounds[event.prim];
+			if (BoundsMax(bounds, bestAxis) <= bestPos)
+			{
+				state.side[event.prim] = KD_BELOW;
+			}
+			else if (BoundsMin(bounds, bestAxis) >= bestPos)
+			{
+				state.side[event.prim] = KD_ABOVE;
+			}
+			else
+			{
+				state.side[event.prim] = KD_BOTH;
+			}
+		}
+	}
+
+	vector<Event> below[3];
+	vector<Event> above[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (const Event& event : events[axis])
+		{
+			const uint8_t side = state.side[event.prim];
+			if (side != KD_ABOVE)
+			{
+				below[axis].push_back(event);
+			}
+			if (side != KD_BELOW)
+			{
+				above[axis].push_back(event);
+			}
+		}
+		FreeVector(events[axis]);
+	}
+
+	BvhBounds belowBounds = nodeBounds;
+	BvhBounds aboveBounds = nodeBounds;
+	switch (bestAxis)
+	{
+	case 0: belowBounds.maxX = aboveBounds.minX = bestPos; break;
+	case 1: belowBounds.maxY = aboveBounds.minY = bestPos; break;
+	default: belowBounds.maxZ = aboveBounds.minZ = bestPos; break;
+	}
+
+	BuildRecursive(state, below, belowBounds, depth + 1, badRefines);
+
+	const uint32_t aboveIndex = static_cast<uint32_t>(m_nodeStorage.size());
+	KdNode& node = m_nodeStorage[nodeIndex];
+	node.split = bestPos;
+	node.flags = static_cast<uint32_t>(bestAxis) | (aboveIndex << 2);
+
+	BuildRecursive(state, above, aboveBounds, depth + 1, badRefines);
+}
\ No newline at end of file
@@ -0,0 +1,179 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+
+
+constexpr uint32_t KD_LEAF = 3;
+
+// Entries in the traversal stack, which bounds the depth of a tree
+constexpr size_t KD_STACK_SIZE = 64;
+
+
+// 8 bytes, eight nodes per cache line.  Interior nodes store the split position and axis, their below child
+// immediately after themselves (depth-first order), and the index of the above child in the upper 30 bits of
+// flags.  Leaf nodes store the first primitive slot in offset and the number of slots in the upper bits of flags.
+struct KdNode
+{
+	union
+	{
+		float		split;
+		uint32_t	offset;
+	};
+	uint32_t	flags;
+
+	__forceinline bool IsLeaf() const { return (flags & 3) == KD_LEAF; }
+	__forceinline uint32_t GetAxis() const { return flags & 3; }
+	__forceinline uint32_t GetAboveChild() const { return flags >> 2; }
+	__forceinline uint32_t GetCount() const { return flags >> 2; }
+};
+static_assert(sizeof(KdNode) == 8, "KdNode must be 8 bytes");
+
+
+class KdTree
+{
+public:
+	// Builds a SAH kd-tree over the primitive bounds in O(n log n), from event lists sorted once up front.
+	// Primitives straddling a split are referenced from both sides.  Leaves are padded out to a multiple of
+	// simdSize primitive slots so that accelerators can run their Float<N> kernels directly over a leaf.
+	void Build(const std::vector<BvhBounds>& primBounds, size_t simdSize);
+
+	// Attach externally owned (e.g. memory-mapped) nodes instead of building.  Check them with IsValid first when
+	// they come from a file.
+	void Attach(const KdNode* nodes, size_t numNodes, const BvhBounds& bounds);
+	void Clear();
+
+	// Whether every child index and leaf slot range stays inside the given arrays, and the tree fits the
+	// traversal stack
+	static bool IsValid(const KdNode* nodes, size_t numNodes, size_t numSlots, size_t simdSize);
+
+	// Maps each padded primitive slot to the original primitive index, or INVALID_PRIMITIVE for padding.  A
+	// primitive has a slot in every leaf it overlaps.
+	const std::vector<uint32_t>& GetPrimitiveSlots() const { return m_primSlots; }
+
+	const KdNode* GetNodes() const { return m_nodes; }
+	size_t GetNumNodes() const { return m_numNodes; }
+	const BvhBounds& GetBounds() const { return m_bounds; }
+	size_t GetMemoryUsage() const { return m_numNodes * sizeof(KdNode); }
+
+	// Front-to-back traversal that stops at the first leaf beyond the closest hit.  leafFunc(firstSlot, numSlots)
+	// is expected to shrink ray.tmax on a hit.
+	template <typename LeafFunc>
+	void Intersect(Ray& ray, LeafFunc&& leafFunc) const;
+
+private:
+	struct Event;
+	struct BuildState;
+
+	void BuildRecursive(BuildState& state, std::vector<Event>(&events)[3], const BvhBounds& nodeBounds, int depth, int badRefines);
+
+private:
+	std::vector<KdNode, aligned_allocator<KdNode, 64>>	m_nodeStorage;
+	std::vector<uint32_t>								m_primSlots;
+
+	const KdNode*	m_nodes{ nullptr };
+	size_t			m_numNodes{ 0 };
+	BvhBounds		m_bounds;
+
+	size_t			m_simdSize{ 1 };
+};
+
+
+template <typename LeafFunc>
+void KdTree::Intersect(Ray& ray, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0)
+	{
+		return;
+	}
+
+	const float pos[3] = { ray.posX, ray.posY, ray.posZ };
+	const float invDir[3] = { 1.0f / ray.dirX, 1.0f / ray.dirY, 1.0f / ray.dirZ };
+
+	// Clip the ray to the tree bounds
+	const float boundsMin[3] = { m_bounds.minX, m_bounds.minY, m_bounds.minZ };
+	const float boundsMax[3] = { m_bounds.maxX, m_bounds.maxY, m_bounds.maxZ };
+	float tMin = ray.tmin;
+	float tMax = ray.tmax;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float t0 = (boundsMin[axis] - pos[axis]) * invDir[axis];
+		const float t1 = (boundsMax[axis] - pos[axis]) * invDir[axis];
+		tMin = std::max(tMin, std::min(t0, t1));
+		tMax = std::min(tMax, std::max(t0, t1));
+	}
+
+	if (tMin > tMax)
+	{
+		return;
+	}
+
+	uint32_t stack[KD_STACK_SIZE];
+	float stackTMin[KD_STACK_SIZE];
+	float stackTMax[KD_STACK_SIZE];
+	int stackSize = 0;
+
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		// Nodes are visited front to back, so nothing from here on can beat a hit in front of this one
+		if (ray.tmax < tMin)
+		{
+			return;
+		}
+
+		const KdNode& node = m_nodes[nodeIndex];
+
+		if (!node.IsLeaf())
+		{
+			const uint32_t axis = node.GetAxis();
+			const float tPlane = (node.split - pos[axis]) * invDir[axis];
+
+			// The child on the ray origin's side of the plane comes first
+			const bool belowFirst = (pos[axis] < node.split) || (pos[axis] == node.split && invDir[axis] <= 0.0f);
+			const uint32_t firstChild = belowFirst ? nodeIndex + 1 : node.GetAboveChild();
+			const uint32_t secondChild = belowFirst ? node.GetAboveChild() : nodeIndex + 1;
+
+			// Written so that a NaN tPlane, from a ray running inside the plane, takes the first child only
+			if (tPlane > tMax || !(tPlane > 0.0f))
+			{
+				nodeIndex = firstChild;
+			}
+			else if (tPlane < tMin)
+			{
+				nodeIndex = secondChild;
+			}
+			else
+			{
+				stack[stackSize] = secondChild;
+				stackTMin[stackSize] = tPlane;
+				stackTMax[stackSize++] = tMax;
+				nodeIndex = firstChild;
+				tMax = tPlane;
+			}
+			continue;
+		}
+
+		if (node.GetCount() > 0)
+		{
+			leafFunc(node.offset, node.GetCount());
+		}
+
+		if (stackSize == 0)
+		{
+			return;
+		}
+
+		--stackSize;
+		nodeIndex = stack[stackSize];
+		tMin = stackTMin[stackSize];
+		tMax = stackTMax[stackSize];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,287 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "KdTreeAccel.h"
+
+#include "BakedFile.h"
+#include "Hash.h"
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr uint32_t TAG_KD_NODES = MakeBakedTag('K', 'N', 'O', 'D');
+constexpr uint32_t TAG_KD_BOUNDS = MakeBakedTag('K', 'B', 'N', 'D');
+constexpr uint32_t TAG_KD_IDS = MakeBakedTag('K', 'I', 'D', 'S');
+constexpr uint32_t TAG_KD_DATA[5] =
+{
+	MakeBakedTag('K', 'C', 'X', ' '),
+	MakeBakedTag('K', 'C', 'Y', ' '),
+	MakeBakedTag('K', 'C', 'Z', ' '),
+	MakeBakedTag('K', 'R', 'S', 'Q'),
+	MakeBakedTag('K', 'I', 'R', 'D')
+};
+
+} // anonymous namespace
+
+
+KdTreeAccelerator::KdTreeAccelerator(Scene* scene)
+	: m_scene(scene)
+{}
+
+
+void KdTreeAccelerator::AddSphere(const Vector3& center, float radius, uint32_t id)
+{
+	if (m_loaded)
+	{
+		UnloadAccel();
+	}
+
+	m_inputCenterX.push_back(center.GetX());
+	m_inputCenterY.push_back(center.GetY());
+	m_inputCenterZ.push_back(center.GetZ());
+	m_inputRadius.push_back(radius);
+	m_inputId.push_back(id);
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void KdTreeAccelerator::IntersectKdTree(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	m_kdTree.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectSpheres<N>(m_sphereList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float invRadius = m_sphereList.invRadius[hitSlot];
+
+		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - m_sphereList.centerX[hitSlot];
+		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - m_sphereList.centerY[hitSlot];
+		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - m_sphereList.centerZ[hitSlot];
+		hit.normalX *= invRadius;
+		hit.normalY *= invRadius;
+		hit.normalZ *= invRadius;
+		hit.geomId = m_sphereList.id[hitSlot];
+	}
+}
+
+
+void KdTreeAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectKdTree<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectKdTree<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectKdTree<8>(ray, hit);
+	}
+}
+
+
+void KdTreeAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const auto simdSize = m_scene->GetSimdSize();
+	const size_t numSpheres = m_inputId.size();
+
+	vector<BvhBounds> bounds(numSpheres);
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const float radius = m_inputRadius[i];
+		bounds[i].Grow(m_inputCenterX[i] - radius, m_inputCenterY[i] - radius, m_inputCenterZ[i] - radius);
+		bounds[i].Grow(m_inputCenterX[i] + radius, m_inputCenterY[i] + radius, m_inputCenterZ[i] + radius);
+	}
+
+	m_kdTree.Build(bounds, simdSize);
+
+	// Lay the spheres out in leaf order.  Padding slots get a NaN radius, which fails every comparison.
+	const auto& slots = m_kdTree.GetPrimitiveSlots();
+	const size_t numSlots = slots.size();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+
+	m_centerX.assign(numSlots, 0.0f);
+	m_centerY.assign(numSlots, 0.0f);
+	m_centerZ.assign(numSlots, 0.0f);
+	m_radiusSq.assign(numSlots, nan);
+	m_invRadius.assign(numSlots, nan);
+	m_id.assign(numSlots, INVALID_PRIMITIVE);
+
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		const uint32_t index = slots[i];
+		if (index == INVALID_PRIMITIVE)
+		{
+			continue;
+		}
+
+		const float radius = m_inputRadius[index];
+		m_centerX[i] = m_inputCenterX[index];
+		m_centerY[i] = m_inputCenterY[index];
+		m_centerZ[i] = m_inputCenterZ[index];
+		m_radiusSq[i] = radius * radius;
+		m_invRadius[i] = 1.0f / radius;
+		m_id[i] = m_inputId[index];
+	}
+
+	m_sphereList.centerX = m_centerX.data();
+	m_sphereList.centerY = m_centerY.data();
+	m_sphereList.centerZ = m_centerZ.data();
+	m_sphereList.radiusSq = m_radiusSq.data();
+	m_sphereList.invRadius = m_invRadius.data();
+	m_sphereList.id = m_id.data();
+	m_sphereList.numSlots = numSlots;
+
+	m_dirty = false;
+}
+
+
+BvhBounds KdTreeAccelerator::GetBounds() const
+{
+	return m_kdTree.GetBounds();
+}
+
+
+size_t KdTreeAccelerator::GetMemoryUsage() const
+{
+	return m_sphereList.numSlots * (5 * sizeof(float) + sizeof(uint32_t)) + m_kdTree.GetMemoryUsage();
+}
+
+
+uint64_t KdTreeAccelerator::GetContentHash() const
+{
+	uint64_t hash = HashVector(m_inputCenterX);
+	hash = HashVector(m_inputCenterY, hash);
+	hash = HashVector(m_inputCenterZ, hash);
+	hash = HashVector(m_inputRadius, hash);
+	return HashVector(m_inputId, hash);
+}
+
+
+void KdTreeAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	const float* arrays[5] =
+	{
+		m_sphereList.centerX, m_sphereList.centerY, m_sphereList.centerZ, m_sphereList.radiusSq, m_sphereList.invRadius
+	};
+
+	writer.AddSection(TAG_KD_NODES, m_kdTree.GetNodes(), m_kdTree.GetNumNodes() * sizeof(KdNode));
+	writer.AddSection(TAG_KD_BOUNDS, &m_kdTree.GetBounds(), sizeof(BvhBounds));
+	writer.AddSection(TAG_KD_IDS, m_sphereList.id, m_sphereList.numSlots * sizeof(uint32_t));
+	for (size_t i = 0; i < 5; ++i)
+	{
+		writer.AddSection(TAG_KD_DATA[i], arrays[i], m_sphereList.numSlots * sizeof(float));
+	}
+}
+
+
+bool KdTreeAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	// Leaves padded for a wider SIMD width are still valid for a narrower one, but not the other way around
+	const auto simdSize = m_scene->GetSimdSize();
+	if (reader.GetSimdSize() % simdSize != 0)
+	{
+		return false;
+	}
+
+	size_t numNodes = 0;
+	const KdNode* nodes = reader.FindSection<KdNode>(TAG_KD_NODES, numNodes);
+
+	size_t numBounds = 0;
+	const BvhBounds* bounds = reader.FindSection<BvhBounds>(TAG_KD_BOUNDS, numBounds);
+
+	size_t numSlots = 0;
+	const uint32_t* ids = reader.FindSection<uint32_t>(TAG_KD_IDS, numSlots);
+
+	const float* arrays[5];
+	for (size_t i = 0; i < 5; ++i)
+	{
+		size_t count = 0;
+		arrays[i] = reader.FindSection<float>(TAG_KD_DATA[i], count);
+		if (!arrays[i] || count != numSlots)
+		{
+			return false;
+		}
+	}
+
+	if (!nodes || !ids || numNodes == 0 || !bounds || numBounds != 1)
+	{
+		return false;
+	}
+
+	// A damaged file is rebuilt rather than read out of bounds
+	if (!KdTree::IsValid(nodes, numNodes, numSlots, simdSize) || !AreSlotIdsValid(ids, numSlots, GetIdCount(m_inputId.data(), m_inputId.size())))
+	{
+		return false;
+	}
+
+	FreeVector(m_centerX);
+	FreeVector(m_centerY);
+	FreeVector(m_centerZ);
+	FreeVector(m_radiusSq);
+	FreeVector(m_invRadius);
+	FreeVector(m_id);
+
+	m_sphereList.centerX = arrays[0];
+	m_sphereList.centerY = arrays[1];
+	m_sphereList.centerZ = arrays[2];
+	m_sphereList.radiusSq = arrays[3];
+	m_sphereList.invRadius = arrays[4];
+	m_sphereList.id = ids;
+	m_sphereList.numSlots = numSlots;
+
+	m_kdTree.Attach(nodes, numNodes, *bounds);
+
+	m_loaded = true;
+	m_dirty = false;
+
+	return true;
+}
+
+
+void KdTreeAccelerator::UnloadAccel()
+{
+	if (!m_loaded)
+	{
+		return;
+	}
+
+	// The input spheres are kept while loaded, so the next Commit() can rebuild from them
+	m_sphereList = SphereList();
+	m_kdTree.Clear();
+
+	m_loaded = false;
+	m_dirty = true;
+}
\ No newline at end of file
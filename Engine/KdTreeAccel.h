@@ -0,0 +1,75 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "IAccelerator.h"
+#include "KdTree.h"
+#include "SphereAccel.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// Spheres in a SAH kd-tree, for static scenes where traversal speed matters more than build time.  The sphere
+// data is laid out in leaf order like SphereAccelerator's, except that spheres straddling a split plane have a
+// slot in every leaf they overlap.
+class KdTreeAccelerator : public IAccelerator
+{
+public:
+	KdTreeAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::SphereKdTree;
+	}
+
+	void AddSphere(const Math::Vector3& center, float radius, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectKdTree(Ray& ray, Hit& hit) const;
+
+private:
+	Scene*			m_scene;
+
+	// Input spheres
+	std::vector<float>		m_inputCenterX;
+	std::vector<float>		m_inputCenterY;
+	std::vector<float>		m_inputCenterZ;
+	std::vector<float>		m_inputRadius;
+	std::vector<uint32_t>	m_inputId;
+
+	// Built data in leaf order
+	std::vector<float, aligned_allocator<float, 64>>		m_centerX;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerY;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerZ;
+	std::vector<float, aligned_allocator<float, 64>>		m_radiusSq;
+	std::vector<float, aligned_allocator<float, 64>>		m_invRadius;
+	std::vector<uint32_t, aligned_allocator<uint32_t, 64>>	m_id;
+
+	SphereList		m_sphereList;
+	KdTree			m_kdTree;
+
+	bool			m_loaded{ false };
+	bool			m_dirty{ false };
+};
\ No newline at end of file
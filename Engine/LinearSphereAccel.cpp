@@ -0,0 +1,135 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "LinearSphereAccel.h"
+
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+LinearSphereAccelerator::LinearSphereAccelerator(Scene* scene)
+	: m_scene(scene)
+	, m_streams('L')
+{}
+
+
+void LinearSphereAccelerator::AddSphere(const Vector3& center, float radius, uint32_t id)
+{
+	if (m_streams.IsLoaded())
+	{
+		UnloadAccel();
+	}
+
+	const float values[5] = { center.GetX(), center.GetY(), center.GetZ(), radius * radius, 1.0f / radius };
+
+	BvhBounds bounds;
+	bounds.Grow(values[0] - radius, values[1] - radius, values[2] - radius);
+	bounds.Grow(values[0] + radius, values[1] + radius, values[2] + radius);
+
+	m_streams.Add(values, id, bounds);
+	m_bounds.Grow(bounds);
+
+	m_dirty = true;
+}
+
+
+void LinearSphereAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	IntersectSphereList(m_sphereList, m_scene->GetSimdSize(), ray, hit);
+}
+
+
+void LinearSphereAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	// One run padded to the SIMD width.  Padding slots get a NaN radius, which fails every comparison.
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	const float padValues[5] = { 0.0f, 0.0f, 0.0f, nan, nan };
+
+	m_streams.Build(m_scene->GetSimdSize(), false, padValues);
+	UpdateList();
+
+	m_dirty = false;
+}
+
+
+BvhBounds LinearSphereAccelerator::GetBounds() const
+{
+	return m_bounds;
+}
+
+
+size_t LinearSphereAccelerator::GetMemoryUsage() const
+{
+	return m_streams.GetMemoryUsage();
+}
+
+
+uint64_t LinearSphereAccelerator::GetContentHash() const
+{
+	return m_streams.GetContentHash();
+}
+
+
+void LinearSphereAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	m_streams.Save(writer);
+}
+
+
+bool LinearSphereAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	if (!m_streams.Load(reader, m_scene->GetSimdSize()))
+	{
+		return false;
+	}
+
+	UpdateList();
+
+	m_dirty = false;
+	return true;
+}
+
+
+void LinearSphereAccelerator::UnloadAccel()
+{
+	if (!m_streams.IsLoaded())
+	{
+		return;
+	}
+
+	m_streams.Unload();
+	UpdateList();
+
+	m_dirty = true;
+}
+
+
+void LinearSphereAccelerator::UpdateList()
+{
+	m_sphereList.centerX = m_streams.GetStream(0);
+	m_sphereList.centerY = m_streams.GetStream(1);
+	m_sphereList.centerZ = m_streams.GetStream(2);
+	m_sphereList.radiusSq = m_streams.GetStream(3);
+	m_sphereList.invRadius = m_streams.GetStream(4);
+	m_sphereList.id = m_streams.GetIds();
+	m_sphereList.numSlots = m_streams.GetNumSlots();
+}
\ No newline at end of file
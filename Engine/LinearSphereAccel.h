@@ -0,0 +1,58 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "IAccelerator.h"
+#include "PrimitiveStreams.h"
+#include "SphereAccel.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// Spheres with no acceleration structure at all: every ray runs the sphere kernel over every slot.  The
+// baseline the other sphere backends are measured against.
+class LinearSphereAccelerator : public IAccelerator
+{
+public:
+	LinearSphereAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::SphereLinear;
+	}
+
+	void AddSphere(const Math::Vector3& center, float radius, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	void UpdateList();
+
+private:
+	Scene*				m_scene;
+
+	PrimitiveStreams<5>	m_streams;
+	SphereList			m_sphereList;
+	BvhBounds			m_bounds;
+
+	bool				m_dirty{ false };
+};
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 #include "MaterialSet.h"
 
+#include "BakedFile.h"
 #include "Sampling.h"
 #include "Math\Random.h"
 
@@ -17,6 +18,16 @@
 using namespace Math;
 
 
+namespace
+{
+
+constexpr uint32_t TAG_MATERIAL_TYPES = MakeBakedTag('M', 'T', 'Y', 'P');
+constexpr uint32_t TAG_MATERIAL_ALBEDO = MakeBakedTag('M', 'A', 'L', 'B');
+constexpr uint32_t TAG_MATERIAL_MISC = MakeBakedTag('M', 'M', 'S', 'C');
+
+} // anonymous namespace
+
+
 void MaterialSet::Reserve(size_t numMaterials)
 {
 	m_albedoList.reserve(numMaterials);
@@ -61,6 +72,55 @@ size_t MaterialSet::AddDielectric(float refractionIndex)
 }
 
 
+void MaterialSet::Append(const MaterialSet& other)
+{
+	m_albedoList.insert(m_albedoList.end(), other.m_albedoList.begin(), other.m_albedoList.end());
+	m_miscFloatList.insert(m_miscFloatList.end(), other.m_miscFloatList.begin(), other.m_miscFloatList.end());
+	m_materialTypeList.insert(m_materialTypeList.end(), other.m_materialTypeList.begin(), other.m_materialTypeList.end());
+}
+
+
+void MaterialSet::SaveBaked(BakedFileWriter& writer, size_t first, size_t count) const
+{
+	assert(first + count <= GetNumMaterials());
+
+	writer.AddSection(TAG_MATERIAL_TYPES, m_materialTypeList.data() + first, count * sizeof(MaterialType));
+	writer.AddSection(TAG_MATERIAL_ALBEDO, m_albedoList.data() + first, count * sizeof(Vector3));
+	writer.AddSection(TAG_MATERIAL_MISC, m_miscFloatList.data() + first, count * sizeof(float));
+}
+
+
+bool MaterialSet::LoadBaked(const BakedFileReader& reader)
+{
+	size_t numTypes = 0;
+	const MaterialType* types = reader.FindSection<MaterialType>(TAG_MATERIAL_TYPES, numTypes);
+
+	size_t numAlbedos = 0;
+	const Vector3* albedos = reader.FindSection<Vector3>(TAG_MATERIAL_ALBEDO, numAlbedos);
+
+	size_t numMiscFloats = 0;
+	const float* miscFloats = reader.FindSection<float>(TAG_MATERIAL_MISC, numMiscFloats);
+
+	if (!types || !albedos || !miscFloats || numAlbedos != numTypes || numMiscFloats != numTypes)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < numTypes; ++i)
+	{
+		if (types[i] != MaterialType::Lambertian && types[i] != MaterialType::Metallic && types[i] != MaterialType::Dielectric)
+		{
+			return false;
+		}
+	}
+
+	m_materialTypeList.assign(types, types + numTypes);
+	m_albedoList.assign(albedos, albedos + numTypes);
+	m_miscFloatList.assign(miscFloats, miscFloats + numTypes);
+	return true;
+}
+
+
 bool Refract(Vector3 v, Vector3 n, float ni_over_nt, Vector3& refracted)
 {
 	Vector3 uv = Normalize(v);
@@ -84,20 +144,29 @@ float Schlick(float cosine, float refractionIdx)
 }
 
 
-bool MaterialSet::Scatter(const Ray& ray, const Hit& hit, Math::Vector3& attenuation, Ray& scattered, uint32_t& state)
+bool MaterialSet::Scatter(const Ray& ray, const Hit& hit, Math::Vector3& attenuation, Ray& scattered, uint32_t& state) const
 {
 	Vector3 pos(
 		ray.posX + ray.tmax * ray.dirX,
 		ray.posY + ray.tmax * ray.dirY,
 		ray.posZ + ray.tmax * ray.dirZ);
 
+	// Outward normal, whichever side the ray hit
 	Vector3 normal(hit.normalX, hit.normalY, hit.normalZ);
 
+	// Opaque materials scatter back to the side the ray came from, so open surfaces (triangles, disks, quads) look
+	// the same from behind.  Dielectrics use the outward normal to tell entering from leaving.
+	Vector3 facingNormal = normal;
+	if (ray.dirX * hit.normalX + ray.dirY * hit.normalY + ray.dirZ * hit.normalZ > 0.0f)
+	{
+		facingNormal = -normal;
+	}
+
 	switch (m_materialTypeList[hit.geomId])
 	{
 	case MaterialType::Lambertian:
 	{
-		Vector3 target = pos + normal + UniformUnitSphere3d(state);
+		Vector3 target = pos + facingNormal + UniformUnitSphere3d(state);
 
 		scattered.posX = pos.GetX();
 		scattered.posY = pos.GetY();
@@ -117,7 +186,7 @@ bool MaterialSet::Scatter(const Ray& ray, const Hit& hit, Math::Vector3& attenua
 
 	case MaterialType::Metallic:
 	{
-		Vector3 reflected = Reflect(Vector3(ray.dirX, ray.dirY, ray.dirZ), normal);
+		Vector3 reflected = Reflect(Vector3(ray.dirX, ray.dirY, ray.dirZ), facingNormal);
 
 		scattered.posX = pos.GetX();
 		scattered.posY = pos.GetY();
@@ -131,7 +200,7 @@ bool MaterialSet::Scatter(const Ray& ray, const Hit& hit, Math::Vector3& attenua
 		scattered.tmax = FLT_MAX;
 
 		attenuation = m_albedoList[hit.geomId];
-		return (Dot(Vector3(scattered.dirX, scattered.dirY, scattered.dirZ), normal) > 0.0f);
+		return (Dot(Vector3(scattered.dirX, scattered.dirY, scattered.dirZ), facingNormal) > 0.0f);
 	}
 	break;
 
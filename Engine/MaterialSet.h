@@ -8,6 +8,12 @@
 
 #pragma once
 
+
+// Forward declarations
+class BakedFileReader;
+class BakedFileWriter;
+
+
 enum class MaterialType
 {
 	Lambertian,
@@ -24,7 +30,17 @@ public:
 	size_t AddMetallic(const Math::Vector3& albedo, float fuzz);
 	size_t AddDielectric(float refractionIndex);
 
-	bool Scatter(const Ray& ray, const Hit& hit, Math::Vector3& attenuation, Ray& scattered, uint32_t& state);
+	size_t GetNumMaterials() const { return m_materialTypeList.size(); }
+
+	// Appends every material of another set, keeping their order
+	void Append(const MaterialSet& other);
+
+	// Baked file sections holding materials [first, first + count), which must stay unchanged until the writer is
+	// done.  LoadBaked replaces the set with the baked materials, and fails if the file has none or they are damaged.
+	void SaveBaked(BakedFileWriter& writer, size_t first, size_t count) const;
+	bool LoadBaked(const BakedFileReader& reader);
+
+	bool Scatter(const Ray& ray, const Hit& hit, Math::Vector3& attenuation, Ray& scattered, uint32_t& state) const;
 
 private:
 	std::vector<Math::Vector3>	m_albedoList;
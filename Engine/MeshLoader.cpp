@@ -0,0 +1,520 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "MeshLoader.h"
+
+#include <cstring>
+#include <map>
+
+
+using namespace std;
+
+
+namespace
+{
+
+// Current OBJ material before the first usemtl
+constexpr uint32_t NO_MATERIAL = 0xFFFFFFFF;
+
+
+__forceinline const char* SkipSpace(const char* p)
+{
+	while (*p == ' ' || *p == '\t')
+	{
+		++p;
+	}
+	return p;
+}
+
+
+// Resolves a 1-based (or negative, relative) OBJ index to a 0-based one
+__forceinline bool ResolveObjIndex(long index, size_t numVertices, uint32_t& result)
+{
+	if (index > 0 && static_cast<size_t>(index) <= numVertices)
+	{
+		result = static_cast<uint32_t>(index - 1);
+		return true;
+	}
+	if (index < 0 && static_cast<size_t>(-index) <= numVertices)
+	{
+		result = static_cast<uint32_t>(numVertices + index);
+		return true;
+	}
+	return false;
+}
+
+
+// Converts a count or index read from a PLY file, which may have any numeric type, to one below limit.  The
+// range is checked before the cast, since converting a negative or too large double is undefined.
+__forceinline bool ResolvePlyIndex(double value, size_t limit, size_t& result)
+{
+	if (!(value >= 0.0) || value >= static_cast<double>(limit) || value != floor(value))
+	{
+		return false;
+	}
+	result = static_cast<size_t>(value);
+	return true;
+}
+
+
+enum class PlyFormat
+{
+	Ascii,
+	BinaryLittleEndian,
+	BinaryBigEndian
+};
+
+
+enum class PlyType
+{
+	Int8,
+	UInt8,
+	Int16,
+	UInt16,
+	Int32,
+	UInt32,
+	Float32,
+	Float64,
+	Invalid
+};
+
+
+struct PlyProperty
+{
+	string	name;
+	PlyType	type{ PlyType::Invalid };
+	PlyType	countType{ PlyType::Invalid };	// Only valid for list properties
+	bool	isList{ false };
+};
+
+
+struct PlyElement
+{
+	string				name;
+	size_t				count{ 0 };
+	vector<PlyProperty>	properties;
+};
+
+
+PlyType ParsePlyType(const string& name)
+{
+	if (name == "char" || name == "int8") return PlyType::Int8;
+	if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+	if (name == "short" || name == "int16") return PlyType::Int16;
+	if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+	if (name == "int" || name == "int32") return PlyType::Int32;
+	if (name == "uint" || name == "uint32") return PlyType::UInt32;
+	if (name == "float" || name == "float32") return PlyType::Float32;
+	if (name == "double" || name == "float64") return PlyType::Float64;
+	return PlyType::Invalid;
+}
+
+
+size_t GetPlyTypeSize(PlyType type)
+{
+	switch (type)
+	{
+	case PlyType::Int8:
+	case PlyType::UInt8: return 1;
+	case PlyType::Int16:
+	case PlyType::UInt16: return 2;
+	case PlyType::Int32:
+	case PlyType::UInt32:
+	case PlyType::Float32: return 4;
+	case PlyType::Float64: return 8;
+	default: return 0;
+	}
+}
+
+
+class PlyValueReader
+{
+public:
+	PlyValueReader(istream& stream, PlyFormat format)
+		: m_stream(stream)
+		, m_format(format)
+	{}
+
+	bool Read(PlyType type, double& value)
+	{
+		if (m_format == PlyFormat::Ascii)
+		{
+			m_stream >> value;
+			return !m_stream.fail();
+		}
+
+		const size_t size = GetPlyTypeSize(type);
+		uint8_t bytes[8];
+		if (!m_stream.read(reinterpret_cast<char*>(bytes), size))
+		{
+			return false;
+		}
+
+		if (m_format == PlyFormat::BinaryBigEndian)
+		{
+			reverse(bytes, bytes + size);
+		}
+
+		switch (type)
+		{
+		case PlyType::Int8:		{ int8_t v; memcpy(&v, bytes, 1); value = v; break; }
+		case PlyType::UInt8:	{ uint8_t v; memcpy(&v, bytes, 1); value = v; break; }
+		case PlyType::Int16:	{ int16_t v; memcpy(&v, bytes, 2); value = v; break; }
+		case PlyType::UInt16:	{ uint16_t v; memcpy(&v, bytes, 2); value = v; break; }
+		case PlyType::Int32:	{ int32_t v; memcpy(&v, bytes, 4); value = v; break; }
+		case PlyType::UInt32:	{ uint32_t v; memcpy(&v, bytes, 4); value = v; break; }
+		case PlyType::Float32:	{ float v; memcpy(&v, bytes, 4); value = v; break; }
+		case PlyType::Float64:	{ double v; memcpy(&v, bytes, 8); value = v; break; }
+		default: return false;
+		}
+		return true;
+	}
+
+private:
+	istream&	m_stream;
+	PlyFormat	m_format;
+};
+
+} // anonymous namespace
+
+
+void TriangleMesh::Clear()
+{
+	positions.clear();
+	indices.clear();
+	materialIds.clear();
+	materialNames.clear();
+}
+
+
+bool LoadObj(const char* filename, TriangleMesh& mesh)
+{
+	ifstream infile(filename, ios::in);
+	if (!infile.is_open())
+	{
+		return false;
+	}
+
+	mesh.Clear();
+
+	map<string, uint32_t> materialLookup;
+	uint32_t curMaterial = NO_MATERIAL;
+
+	vector<uint32_t> faceIndices;
+	string line;
+	while (getline(infile, line))
+	{
+		const char* p = SkipSpace(line.c_str());
+
+		if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			char* end = nullptr;
+			float x = strtof(p + 2, &end);
+			float y = strtof(end, &end);
+			float z = strtof(end, &end);
+			mesh.positions.push_back(x);
+			mesh.positions.push_back(y);
+			mesh.positions.push_back(z);
+		}
+		else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+		{
+			const size_t numVertices = mesh.GetNumVertices();
+
+			faceIndices.clear();
+			p = SkipSpace(p + 2);
+			while (*p != '\0' && *p != '\r' && *p != '#')
+			{
+				// Each vertex is v, v/vt, v/vt/vn or v//vn.  Only the position index is used.
+				char* end = nullptr;
+				long index = strtol(p, &end, 10);
+				if (end == p)
+				{
+					return false;
+				}
+
+				uint32_t resolved = 0;
+				if (!ResolveObjIndex(index, numVertices, resolved))
+				{
+					return false;
+				}
+				faceIndices.push_back(resolved);
+
+				p = end;
+				while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r')
+				{
+					++p;
+				}
+				p = SkipSpace(p);
+			}
+
+			// Faces before the first usemtl get a default material of their own, never shared with a named one
+			if (curMaterial == NO_MATERIAL)
+			{
+				curMaterial = static_cast<uint32_t>(mesh.materialNames.size());
+				mesh.materialNames.push_back("default");
+			}
+
+			// Triangulate as a fan
+			for (size_t i = 2; i < faceIndices.size(); ++i)
+			{
+				mesh.indices.push_back(faceIndices[0]);
+				mesh.indices.push_back(faceIndices[i - 1]);
+				mesh.indices.push_back(faceIndices[i]);
+				mesh.materialIds.push_back(curMaterial);
+			}
+		}
+		else if (strncmp(p, "usemtl", 6) == 0)
+		{
+			string name = SkipSpace(p + 6);
+			while (!name.empty() && (name.back() == '\r' || name.back() == ' ' || name.back() == '\t'))
+			{
+				name.pop_back();
+			}
+
+			auto it = materialLookup.find(name);
+			if (it == materialLookup.end())
+			{
+				curMaterial = static_cast<uint32_t>(mesh.materialNames.size());
+				materialLookup[name] = curMaterial;
+				mesh.materialNames.push_back(name);
+			}
+			else
+			{
+				curMaterial = it->second;
+			}
+		}
+	}
+
+	if (mesh.materialNames.empty())
+	{
+		mesh.materialNames.push_back("default");
+	}
+
+	return true;
+}
+
+
+bool LoadPly(const char* filename, TriangleMesh& mesh)
+{
+	ifstream infile(filename, ios::in | ios::binary);
+	if (!infile.is_open())
+	{
+		return false;
+	}
+
+	mesh.Clear();
+
+	// Parse the header
+	string line;
+	if (!getline(infile, line) || line.compare(0, 3, "ply") != 0)
+	{
+		return false;
+	}
+
+	PlyFormat format = PlyFormat::Ascii;
+	vector<PlyElement> elements;
+	bool headerDone = false;
+	while (getline(infile, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+
+		istringstream tokens(line);
+		string keyword;
+		tokens >> keyword;
+
+		if (keyword == "format")
+		{
+			string formatName;
+			tokens >> formatName;
+			if (formatName == "ascii")
+			{
+				format = PlyFormat::Ascii;
+			}
+			else if (formatName == "binary_little_endian")
+			{
+				format = PlyFormat::BinaryLittleEndian;
+			}
+			else if (formatName == "binary_big_endian")
+			{
+				format = PlyFormat::BinaryBigEndian;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (keyword == "element")
+		{
+			PlyElement element;
+			tokens >> element.name >> element.count;
+			elements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			if (elements.empty())
+			{
+				return false;
+			}
+
+			PlyProperty prop;
+			string typeName;
+			tokens >> typeName;
+			if (typeName == "list")
+			{
+				string countTypeName;
+				tokens >> countTypeName >> typeName;
+				prop.isList = true;
+				prop.countType = ParsePlyType(countTypeName);
+				if (prop.countType == PlyType::Invalid)
+				{
+					return false;
+				}
+			}
+			prop.type = ParsePlyType(typeName);
+			tokens >> prop.name;
+			if (prop.type == PlyType::Invalid)
+			{
+				return false;
+			}
+			elements.back().properties.push_back(prop);
+		}
+		else if (keyword == "end_header")
+		{
+			headerDone = true;
+			break;
+		}
+	}
+
+	if (!headerDone)
+	{
+		return false;
+	}
+
+	// Faces are checked against the vertex count from the header, since the elements can come in any order
+	size_t numVertices = 0;
+	for (const auto& element : elements)
+	{
+		if (element.name == "vertex")
+		{
+			numVertices = element.count;
+		}
+	}
+
+	// Read the element data
+	PlyValueReader reader(infile, format);
+	vector<uint32_t> faceIndices;
+	for (const auto& element : elements)
+	{
+		const bool isVertex = (element.name == "vertex");
+		const bool isFace = (element.name == "face");
+
+		if (isVertex)
+		{
+			mesh.positions.reserve(element.count * 3);
+		}
+		else if (isFace)
+		{
+			mesh.indices.reserve(element.count * 3);
+			mesh.materialIds.reserve(element.count);
+		}
+
+		for (size_t i = 0; i < element.count; ++i)
+		{
+			float position[3] = { 0.0f, 0.0f, 0.0f };
+			for (const auto& prop : element.properties)
+			{
+				double value = 0.0;
+				if (prop.isList)
+				{
+					double countValue = 0.0;
+					size_t count = 0;
+					if (!reader.Read(prop.countType, countValue) || !ResolvePlyIndex(countValue, numeric_limits<uint32_t>::max(), count))
+					{
+						return false;
+					}
+
+					const bool isFaceIndices = isFace && (prop.name == "vertex_indices" || prop.name == "vertex_index");
+					faceIndices.clear();
+					for (size_t j = 0; j < count; ++j)
+					{
+						if (!reader.Read(prop.type, value))
+						{
+							return false;
+						}
+						if (isFaceIndices)
+						{
+							size_t index = 0;
+							if (!ResolvePlyIndex(value, numVertices, index))
+							{
+								return false;
+							}
+							faceIndices.push_back(static_cast<uint32_t>(index));
+						}
+					}
+
+					for (size_t j = 2; j < faceIndices.size(); ++j)
+					{
+						mesh.indices.push_back(faceIndices[0]);
+						mesh.indices.push_back(faceIndices[j - 1]);
+						mesh.indices.push_back(faceIndices[j]);
+						mesh.materialIds.push_back(0);
+					}
+				}
+				else
+				{
+					if (!reader.Read(prop.type, value))
+					{
+						return false;
+					}
+
+					if (isVertex)
+					{
+						if (prop.name == "x") position[0] = static_cast<float>(value);
+						else if (prop.name == "y") position[1] = static_cast<float>(value);
+						else if (prop.name == "z") position[2] = static_cast<float>(value);
+					}
+				}
+			}
+
+			if (isVertex)
+			{
+				mesh.positions.insert(mesh.positions.end(), position, position + 3);
+			}
+		}
+	}
+
+	mesh.materialNames.push_back("default");
+
+	return true;
+}
+
+
+bool LoadMesh(const char* filename, TriangleMesh& mesh)
+{
+	const char* extension = strrchr(filename, '.');
+	if (!extension)
+	{
+		return false;
+	}
+
+	if (_stricmp(extension, ".obj") == 0)
+	{
+		return LoadObj(filename, mesh);
+	}
+	else if (_stricmp(extension, ".ply") == 0)
+	{
+		return LoadPly(filename, mesh);
+	}
+
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include <string>
+
+
+// Indexed triangle mesh, as produced by the importers
+struct TriangleMesh
+{
+	std::vector<float>			positions;		// x, y, z per vertex
+	std::vector<uint32_t>		indices;		// 3 per triangle
+	std::vector<uint32_t>		materialIds;	// 1 per triangle, indexes materialNames
+	std::vector<std::string>	materialNames;
+
+	size_t GetNumVertices() const { return positions.size() / 3; }
+	size_t GetNumTriangles() const { return indices.size() / 3; }
+
+	void Clear();
+};
+
+
+// Wavefront OBJ.  Only positions, faces (triangulated as fans) and usemtl groups are read.  Faces before the first
+// usemtl get a material of their own, named "default".
+bool LoadObj(const char* filename, TriangleMesh& mesh);
+
+// Stanford PLY, binary little/big endian or ascii.  Reads vertex x/y/z and the face vertex_indices list.
+bool LoadPly(const char* filename, TriangleMesh& mesh);
+
+// Picks the importer from the file extension
+bool LoadMesh(const char* filename, TriangleMesh& mesh);
\ No newline at end of file
@@ -0,0 +1,80 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "NativeTracer.h"
+
+#include "SceneGenerator.h"
+
+
+using namespace std;
+
+
+namespace
+{
+
+const char* GetBackendName(SceneBackend backend)
+{
+	switch (backend)
+	{
+	case SceneBackend::Grid: return "Grid";
+	case SceneBackend::KdTree: return "KdTree";
+	case SceneBackend::Sorted: return "Sorted";
+	case SceneBackend::Linear: return "Linear";
+	case SceneBackend::Embree: return "Embree";
+	default: return "Native";
+	}
+}
+
+
+const char* GetLayoutName(SphereLayout layout)
+{
+	return (layout == SphereLayout::SoA) ? "SoA" : "AoSoA";
+}
+
+
+const char* GetNodeFormatName(BvhNodeFormat nodeFormat)
+{
+	switch (nodeFormat)
+	{
+	case BvhNodeFormat::Quantized: return "Quantized";
+	case BvhNodeFormat::Treelet: return "Treelet";
+	default: return "Full";
+	}
+}
+
+} // anonymous namespace
+
+
+NativeTracer::NativeTracer(const NativeTracerConfig& config)
+{
+	m_scene.SetMemory(config.memory);
+	m_scene.SetBackend(config.backend);
+	m_scene.SetSphereLayout(config.layout);
+	m_scene.SetBvhNodeFormat(config.nodeFormat);
+
+	m_name = GetBackendName(config.backend);
+	if (config.backend == SceneBackend::Native)
+	{
+		m_name = m_name + " (" + GetLayoutName(config.layout) + ", " + GetNodeFormatName(config.nodeFormat) + ")";
+	}
+}
+
+
+void NativeTracer::Build(const SceneDesc& desc)
+{
+	AddToScene(desc, m_scene);
+	m_scene.Commit();
+}
+
+
+size_t NativeTracer::GetMemoryUsage() const
+{
+	return m_scene.GetMemoryUsage();
+}
\ No newline at end of file
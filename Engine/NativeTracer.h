@@ -0,0 +1,68 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "ITracer.h"
+#include "Scene.h"
+
+#include <string>
+
+
+// How a NativeTracer sets up its scene.  The sphere layout and BVH node format only apply to the Native backend.
+struct NativeTracerConfig
+{
+	SceneMemory		memory{ SceneMemory::Heap };
+	SceneBackend	backend{ SceneBackend::Native };
+	SphereLayout	layout{ SphereLayout::SoA };
+	BvhNodeFormat	nodeFormat{ BvhNodeFormat::Full };
+};
+
+
+// The engine's own accelerators, behind the tracer interface.  With another SceneBackend the spheres go to a
+// GridAccelerator, KdTreeAccelerator, SortedSphereAccelerator, LinearSphereAccelerator or EmbreeAccelerator instead, while the rest of the
+// engine (scene setup, renderer, caches) stays the same.
+class NativeTracer : public ITracer
+{
+public:
+	explicit NativeTracer(const NativeTracerConfig& config = NativeTracerConfig());
+
+	// The backend, plus the sphere layout and BVH node format for the Native backend, e.g. "Native (AoSoA, Treelet)"
+	const char* GetName() const final { return m_name.c_str(); }
+
+	void Build(const SceneDesc& desc) final;
+
+	void Intersect1(Ray& ray, Hit& hit) const final
+	{
+		m_scene.Intersect1(ray, hit);
+	}
+
+	void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const final
+	{
+		m_scene.IntersectBatch(rays, hits, count, coherent);
+	}
+
+	const TileCull* CullTile(const TileFrustum& frustum, ScratchArena& scratch) const final
+	{
+		return m_scene.CullTile(frustum, scratch);
+	}
+
+	void IntersectCulled(const TileCull& cull, Ray& ray, Hit& hit) const final
+	{
+		m_scene.IntersectCulled(cull, ray, hit);
+	}
+
+	size_t GetMemoryUsage() const final;
+
+	// For front-ends that add more primitives, or commit through the accelerator cache, instead of Build()
+	Scene& GetScene() { return m_scene; }
+
+private:
+	Scene		m_scene;
+	std::string	m_name;
+};
\ No newline at end of file
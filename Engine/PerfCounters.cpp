@@ -0,0 +1,237 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "PerfCounters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+using namespace std;
+
+
+namespace
+{
+
+const char* s_counterNames[NUM_PERF_COUNTERS] =
+{
+	"cycles",
+	"instructions",
+	"L1D misses",
+	"LLC misses",
+	"branch misses",
+	"dTLB misses",
+	"BVH node lines",
+	"BVH node pages"
+};
+
+
+#if defined(__linux__)
+
+int OpenCounter(PerfCounterType type)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	// Counters are opened separately rather than as a group, so the kernel can multiplex them when the CPU has
+	// fewer counters than requested.  Read() scales the counts by the fraction of time each one was running.
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	switch (type)
+	{
+	case PERF_CYCLES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PERF_INSTRUCTIONS:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PERF_L1D_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	case PERF_LLC_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case PERF_BRANCH_MISSES:
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	case PERF_DTLB_MISSES:
+		attr.type = PERF_TYPE_HW_CACHE;
+		attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	default:
+		return -1;
+	}
+
+	// This thread, any CPU
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+
+bool ReadCounter(int fd, uint64_t& value)
+{
+	uint64_t data[3];	// value, time enabled, time running
+	if (read(fd, data, sizeof(data)) != sizeof(data) || data[2] == 0)
+	{
+		return false;
+	}
+
+	value = (data[2] < data[1]) ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+	return true;
+}
+
+#endif // __linux__
+
+} // anonymous namespace
+
+
+atomic<bool> g_nodeFetchCounting{ false };
+thread_local NodeFetchCounts g_nodeFetchCounts;
+
+
+void EnableNodeFetchCounting(bool enable)
+{
+	g_nodeFetchCounting.store(enable, memory_order_relaxed);
+}
+
+
+const char* GetPerfCounterName(PerfCounterType type)
+{
+	return s_counterNames[type];
+}
+
+
+double PerfCounts::GetIPC() const
+{
+	if (!IsValid(PERF_CYCLES) || !IsValid(PERF_INSTRUCTIONS) || values[PERF_CYCLES] == 0)
+	{
+		return 0.0;
+	}
+	return static_cast<double>(values[PERF_INSTRUCTIONS]) / static_cast<double>(values[PERF_CYCLES]);
+}
+
+
+PerfCounts& PerfCounts::operator+=(const PerfCounts& other)
+{
+	// Summing over threads where some had no counters would undercount, so only counters valid in both survive
+	validMask = IsAnyValid() ? (validMask & other.validMask) : other.validMask;
+	for (int i = 0; i < NUM_PERF_COUNTERS; ++i)
+	{
+		values[i] += other.values[i];
+	}
+	return *this;
+}
+
+
+PerfCounts PerfCounts::operator-(const PerfCounts& other) const
+{
+	PerfCounts result;
+	result.validMask = validMask & other.validMask;
+	for (int i = 0; i < NUM_PERF_COUNTERS; ++i)
+	{
+		result.values[i] = values[i] - other.values[i];
+	}
+	return result;
+}
+
+
+ThreadPerfCounters::ThreadPerfCounters()
+{
+	for (int i = 0; i < NUM_PERF_COUNTERS; ++i)
+	{
+#if defined(__linux__)
+		m_fds[i] = OpenCounter(static_cast<PerfCounterType>(i));
+#else
+		m_fds[i] = -1;
+#endif
+	}
+}
+
+
+ThreadPerfCounters::~ThreadPerfCounters()
+{
+#if defined(__linux__)
+	for (int fd : m_fds)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+#endif
+}
+
+
+PerfCounts ThreadPerfCounters::Read() const
+{
+	PerfCounts counts;
+#if defined(__linux__)
+	for (int i = 0; i < NUM_PERF_COUNTERS; ++i)
+	{
+		if (m_fds[i] >= 0 && ReadCounter(m_fds[i], counts.values[i]))
+		{
+			counts.validMask |= 1u << i;
+		}
+	}
+#endif
+
+	if (IsNodeFetchCountingEnabled())
+	{
+		counts.values[PERF_NODE_LINES] = g_nodeFetchCounts.lines;
+		counts.values[PERF_NODE_PAGES] = g_nodeFetchCounts.pages;
+		counts.validMask |= (1u << PERF_NODE_LINES) | (1u << PERF_NODE_PAGES);
+	}
+	return counts;
+}
+
+
+ThreadPerfCounters& GetThreadPerfCounters()
+{
+	thread_local ThreadPerfCounters counters;
+	return counters;
+}
+
+
+void LogPerfCounts(ostream& stream, const PerfCounts& counts, size_t numRays)
+{
+	if (!counts.IsAnyValid())
+	{
+		return;
+	}
+
+	if (counts.GetIPC() > 0.0)
+	{
+		stream << "  IPC: " << counts.GetIPC() << endl;
+	}
+
+	for (int i = 0; i < NUM_PERF_COUNTERS; ++i)
+	{
+		const auto type = static_cast<PerfCounterType>(i);
+		if (counts.IsValid(type))
+		{
+			stream << "  " << GetPerfCounterName(type) << ": " << counts.values[i];
+			if (numRays > 0)
+			{
+				stream << " (" << static_cast<double>(counts.values[i]) / static_cast<double>(numRays) << " per ray)";
+			}
+			stream << endl;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+
+enum PerfCounterType
+{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+
+	// Software counters, see CountNodeFetch
+	PERF_NODE_LINES,
+	PERF_NODE_PAGES,
+
+	NUM_PERF_COUNTERS
+};
+
+
+const char* GetPerfCounterName(PerfCounterType type);
+
+
+// Hardware event counts, user mode only, and the software node fetch counts while those are enabled.  A counter the
+// CPU or OS could not provide is left out of the valid mask.
+struct PerfCounts
+{
+	uint64_t	values[NUM_PERF_COUNTERS]{};
+	uint32_t	validMask{ 0 };
+
+	bool IsValid(PerfCounterType type) const { return (validMask & (1u << type)) != 0; }
+	bool IsAnyValid() const { return validMask != 0; }
+	bool IsAnyHardwareValid() const { return (validMask & ((1u << PERF_NODE_LINES) - 1)) != 0; }
+
+	// Instructions per cycle, or 0 when either counter is missing
+	double GetIPC() const;
+
+	PerfCounts& operator+=(const PerfCounts& other);
+	PerfCounts operator-(const PerfCounts& other) const;
+};
+
+
+/**
+*  Hardware performance counters of the calling thread, read through perf_event_open on Linux.  Every other
+*  platform, and Linux without PMU access (e.g. most VMs), reports no valid counters, so callers fall back to
+*  timing only.
+*/
+class ThreadPerfCounters
+{
+public:
+	ThreadPerfCounters();
+	~ThreadPerfCounters();
+
+	ThreadPerfCounters(const ThreadPerfCounters&) = delete;
+	ThreadPerfCounters& operator=(const ThreadPerfCounters&) = delete;
+
+	// Running totals since the counters were opened; take the difference of two reads to measure a phase
+	PerfCounts Read() const;
+
+private:
+	int m_fds[NUM_PERF_COUNTERS];
+};
+
+
+// Counters for the calling thread, opened on first use and kept until the thread exits
+ThreadPerfCounters& GetThreadPerfCounters();
+
+
+/**
+*  Software counts of the BVH node memory that traversal reads on the calling thread, to compare node layouts
+*  where no hardware counters are available: 64 byte cache lines, and 4 KB pages.  A read from the line just read
+*  is not counted again, nor is a read from the page just read.  Counting is off until EnableNodeFetchCounting()
+*  is called, and traversals check it once per ray.  Only the native sphere BVHs count their fetches.
+*/
+struct NodeFetchCounts
+{
+	uintptr_t	lastLine{ 0 };
+	uint64_t	lines{ 0 };
+	uint64_t	pages{ 0 };
+};
+
+
+extern std::atomic<bool> g_nodeFetchCounting;
+extern thread_local NodeFetchCounts g_nodeFetchCounts;
+
+
+void EnableNodeFetchCounting(bool enable);
+
+__forceinline bool IsNodeFetchCountingEnabled()
+{
+	return g_nodeFetchCounting.load(std::memory_order_relaxed);
+}
+
+
+__forceinline void CountNodeFetch(const void* node)
+{
+	NodeFetchCounts& counts = g_nodeFetchCounts;
+	const uintptr_t line = reinterpret_cast<uintptr_t>(node) >> 6;
+	if (line != counts.lastLine)
+	{
+		counts.pages += ((line >> 6) != (counts.lastLine >> 6)) ? 1 : 0;
+		counts.lines += 1;
+		counts.lastLine = line;
+	}
+}
+
+
+// Appends IPC, misses per ray and raw counts, or nothing when no counter is valid
+void LogPerfCounts(std::ostream& stream, const PerfCounts& counts, size_t numRays);
\ No newline at end of file
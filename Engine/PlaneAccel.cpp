@@ -0,0 +1,241 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "PlaneAccel.h"
+
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+// Shrinks ray.tmax and records the slot on a closer hit
+template<int N>
+void IntersectPlanes(const PlaneList& planeList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
+	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
+	Float<N> rayOrigZ = Float<N>::Broadcast(ray.posZ);
+	Float<N> rayDirX = Float<N>::Broadcast(ray.dirX);
+	Float<N> rayDirY = Float<N>::Broadcast(ray.dirY);
+	Float<N> rayDirZ = Float<N>::Broadcast(ray.dirZ);
+
+	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
+	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
+	UInt<N> slot(0xffffffff);
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
+	{
+		Float<N> normalX = Float<N>::Load(planeList.normalX + i);
+		Float<N> normalY = Float<N>::Load(planeList.normalY + i);
+		Float<N> normalZ = Float<N>::Load(planeList.normalZ + i);
+		Float<N> distance = Float<N>::Load(planeList.distance + i);
+
+		Float<N> denom = normalX * rayDirX + normalY * rayDirY + normalZ * rayDirZ;
+		Float<N> num = distance - (normalX * rayOrigX + normalY * rayOrigY + normalZ * rayOrigZ);
+
+		// Parallel rays give an infinite or NaN t, and padding slots have a NaN distance; both fail here
+		Float<N> t = num / denom;
+		Bool<N> mask = (t > tmin) & (t < hitT);
+
+		if (Any(mask))
+		{
+			hitT = Select(mask, t, hitT);
+			slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
+		}
+	}
+
+	float minT = ReduceMin(hitT);
+	if (minT < ray.tmax)
+	{
+		uint32_t minMask = Mask(hitT == Float<N>(minT));
+		uint32_t slots[N];
+		UInt<N>::StoreU(slots, slot);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
+			{
+				hitSlot = slots[lane] + lane;
+				ray.tmax = minT;
+				break;
+			}
+		}
+	}
+}
+
+
+template<>
+void IntersectPlanes<1>(const PlaneList& planeList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
+	{
+		const float normalX = planeList.normalX[i];
+		const float normalY = planeList.normalY[i];
+		const float normalZ = planeList.normalZ[i];
+
+		float denom = normalX * ray.dirX + normalY * ray.dirY + normalZ * ray.dirZ;
+		float num = planeList.distance[i] - (normalX * ray.posX + normalY * ray.posY + normalZ * ray.posZ);
+
+		float t = num / denom;
+		if (t > ray.tmin && t < ray.tmax)
+		{
+			ray.tmax = t;
+			hitSlot = static_cast<uint32_t>(i);
+		}
+	}
+}
+
+
+PlaneAccelerator::PlaneAccelerator(Scene* scene)
+	: m_scene(scene)
+	, m_streams('P')
+{}
+
+
+void PlaneAccelerator::AddPlane(const Vector3& normal, float distance, uint32_t id)
+{
+	if (m_streams.IsLoaded())
+	{
+		UnloadAccel();
+	}
+
+	Vector3 n = Normalize(normal);
+	const float values[4] = { n.GetX(), n.GetY(), n.GetZ(), distance };
+
+	m_streams.Add(values, id, BvhBounds());
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void PlaneAccelerator::IntersectAll(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	m_streams.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectPlanes<N>(m_planeList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		hit.normalX = m_planeList.normalX[hitSlot];
+		hit.normalY = m_planeList.normalY[hitSlot];
+		hit.normalZ = m_planeList.normalZ[hitSlot];
+		hit.geomId = m_planeList.id[hitSlot];
+	}
+}
+
+
+void PlaneAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectAll<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectAll<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectAll<8>(ray, hit);
+	}
+}
+
+
+void PlaneAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	const float padValues[4] = { 0.0f, 0.0f, 0.0f, nan };
+
+	m_streams.Build(m_scene->GetSimdSize(), false, padValues);
+	UpdateList();
+
+	m_dirty = false;
+}
+
+
+BvhBounds PlaneAccelerator::GetBounds() const
+{
+	return m_streams.GetBounds();
+}
+
+
+size_t PlaneAccelerator::GetMemoryUsage() const
+{
+	return m_streams.GetMemoryUsage();
+}
+
+
+uint64_t PlaneAccelerator::GetContentHash() const
+{
+	return m_streams.GetContentHash();
+}
+
+
+void PlaneAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	m_streams.Save(writer);
+}
+
+
+bool PlaneAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	if (!m_streams.Load(reader, m_scene->GetSimdSize()))
+	{
+		return false;
+	}
+
+	UpdateList();
+
+	m_dirty = false;
+	return true;
+}
+
+
+void PlaneAccelerator::UnloadAccel()
+{
+	if (!m_streams.IsLoaded())
+	{
+		return;
+	}
+
+	m_streams.Unload();
+	UpdateList();
+
+	m_dirty = true;
+}
+
+
+void PlaneAccelerator::UpdateList()
+{
+	m_planeList.normalX = m_streams.GetStream(0);
+	m_planeList.normalY = m_streams.GetStream(1);
+	m_planeList.normalZ = m_streams.GetStream(2);
+	m_planeList.distance = m_streams.GetStream(3);
+	m_planeList.id = m_streams.GetIds();
+	m_planeList.numSlots = m_streams.GetNumSlots();
+}
@@ -0,0 +1,71 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "IAccelerator.h"
+#include "PrimitiveStreams.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// View over infinite planes, dot(normal, p) == distance, padded to a multiple of the SIMD width
+struct PlaneList
+{
+	const float*	normalX{ nullptr };
+	const float*	normalY{ nullptr };
+	const float*	normalZ{ nullptr };
+	const float*	distance{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
+};
+
+
+// Planes have no finite bounds, so there is no BVH; every ray tests every plane
+class PlaneAccelerator : public IAccelerator
+{
+public:
+	PlaneAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Plane;
+	}
+
+	void AddPlane(const Math::Vector3& normal, float distance, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectAll(Ray& ray, Hit& hit) const;
+
+	void UpdateList();
+
+private:
+	Scene*				m_scene;
+
+	PrimitiveStreams<4>	m_streams;
+	PlaneList			m_planeList;
+
+	bool				m_dirty{ false };
+};
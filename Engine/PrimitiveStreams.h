@@ -0,0 +1,266 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "BakedFile.h"
+#include "Bvh.h"
+#include "Hash.h"
+
+
+// Shared storage for the simple analytic primitive accelerators.  Each primitive is NumStreams floats plus an id.
+// Build() lays the primitives out as SoA streams in BVH leaf order, padded per leaf to the SIMD width, or as one
+// padded run when there is no BVH (for unbounded primitives).  The streams are either owned, or point into a
+// mapped accelerator cache.
+template <size_t NumStreams>
+class PrimitiveStreams
+{
+public:
+	explicit PrimitiveStreams(char tagPrefix)
+		: m_tagPrefix(tagPrefix)
+	{}
+
+	void Add(const float(&values)[NumStreams], uint32_t id, const BvhBounds& bounds);
+
+	// Padding slots get the given values and an invalid id
+	void Build(size_t simdSize, bool useBvh, const float(&padValues)[NumStreams]);
+
+	size_t GetNumSlots() const { return m_numSlots; }
+	const float* GetStream(size_t index) const { return m_streams[index]; }
+	const uint32_t* GetIds() const { return m_ids; }
+
+	// Calls leafFunc(firstSlot, numSlots) for each leaf the ray reaches, or once for everything without a BVH
+	template <typename LeafFunc>
+	void Intersect(Ray& ray, LeafFunc&& leafFunc) const;
+
+	// Without a BVH the primitives are taken to be unbounded
+	BvhBounds GetBounds() const;
+
+	size_t GetMemoryUsage() const { return m_numSlots * (NumStreams * sizeof(float) + sizeof(uint32_t)) + m_bvh.GetMemoryUsage(); }
+
+	// Built state caching
+	uint64_t GetContentHash() const;
+	void Save(BakedFileWriter& writer) const;
+	bool Load(const BakedFileReader& reader, size_t simdSize);
+	void Unload();
+
+	bool IsLoaded() const { return m_loaded; }
+
+private:
+	uint32_t GetTag(char a, char b, char c) const { return MakeBakedTag(m_tagPrefix, a, b, c); }
+
+private:
+	const char				m_tagPrefix;
+
+	// Input primitives
+	std::vector<float>		m_inputValues;
+	std::vector<uint32_t>	m_inputIds;
+	std::vector<BvhBounds>	m_inputBounds;
+
+	// Built data in leaf order
+	std::vector<float, aligned_allocator<float, 64>>		m_ownedStreams[NumStreams];
+	std::vector<uint32_t, aligned_allocator<uint32_t, 64>>	m_ownedIds;
+
+	const float*	m_streams[NumStreams] = {};
+	const uint32_t*	m_ids{ nullptr };
+	size_t			m_numSlots{ 0 };
+
+	Bvh				m_bvh;
+	bool			m_loaded{ false };
+};
+
+
+template <size_t NumStreams>
+void PrimitiveStreams<NumStreams>::Add(const float(&values)[NumStreams], uint32_t id, const BvhBounds& bounds)
+{
+	m_inputValues.insert(m_inputValues.end(), values, values + NumStreams);
+	m_inputIds.push_back(id);
+	m_inputBounds.push_back(bounds);
+}
+
+
+template <size_t NumStreams>
+void PrimitiveStreams<NumStreams>::Build(size_t simdSize, bool useBvh, const float(&padValues)[NumStreams])
+{
+	const size_t numPrims = m_inputIds.size();
+
+	std::vector<uint32_t> slots;
+	if (useBvh)
+	{
+		m_bvh.Build(m_inputBounds, simdSize, 2 * simdSize);
+		slots = m_bvh.GetPrimitiveSlots();
+	}
+	else
+	{
+		m_bvh.Clear();
+		slots.resize(Math::AlignUp(numPrims, simdSize), INVALID_PRIMITIVE);
+		for (size_t i = 0; i < numPrims; ++i)
+		{
+			slots[i] = static_cast<uint32_t>(i);
+		}
+	}
+
+	const size_t numSlots = slots.size();
+	for (size_t s = 0; s < NumStreams; ++s)
+	{
+		m_ownedStreams[s].assign(numSlots, padValues[s]);
+	}
+	m_ownedIds.assign(numSlots, INVALID_PRIMITIVE);
+
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		const uint32_t index = slots[i];
+		if (index == INVALID_PRIMITIVE)
+		{
+			continue;
+		}
+
+		for (size_t s = 0; s < NumStreams; ++s)
+		{
+			m_ownedStreams[s][i] = m_inputValues[index * NumStreams + s];
+		}
+		m_ownedIds[i] = m_inputIds[index];
+	}
+
+	for (size_t s = 0; s < NumStreams; ++s)
+	{
+		m_streams[s] = m_ownedStreams[s].data();
+	}
+	m_ids = m_ownedIds.data();
+	m_numSlots = numSlots;
+	m_loaded = false;
+}
+
+
+template <size_t NumStreams>
+template <typename LeafFunc>
+void PrimitiveStreams<NumStreams>::Intersect(Ray& ray, LeafFunc&& leafFunc) const
+{
+	if (m_bvh.GetNumNodes() > 0)
+	{
+		m_bvh.Intersect(ray, leafFunc);
+	}
+	else if (m_numSlots > 0)
+	{
+		leafFunc(0, static_cast<uint32_t>(m_numSlots));
+	}
+}
+
+
+template <size_t NumStreams>
+BvhBounds PrimitiveStreams<NumStreams>::GetBounds() const
+{
+	if (m_bvh.GetNumNodes() > 0 || m_numSlots == 0)
+	{
+		return m_bvh.GetBounds();
+	}
+
+	BvhBounds bounds;
+	bounds.Grow(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	bounds.Grow(FLT_MAX, FLT_MAX, FLT_MAX);
+	return bounds;
+}
+
+
+template <size_t NumStreams>
+uint64_t PrimitiveStreams<NumStreams>::GetContentHash() const
+{
+	return HashVector(m_inputIds, HashVector(m_inputValues));
+}
+
+
+template <size_t NumStreams>
+void PrimitiveStreams<NumStreams>::Save(BakedFileWriter& writer) const
+{
+	writer.AddSection(GetTag('N', 'O', 'D'), m_bvh.GetNodes(), m_bvh.GetNumNodes() * sizeof(BvhNode));
+	writer.AddSection(GetTag('I', 'D', 'S'), m_ids, m_numSlots * sizeof(uint32_t));
+	for (size_t s = 0; s < NumStreams; ++s)
+	{
+		writer.AddSection(GetTag('S', 'T', static_cast<char>('0' + s)), m_streams[s], m_numSlots * sizeof(float));
+	}
+}
+
+
+template <size_t NumStreams>
+bool PrimitiveStreams<NumStreams>::Load(const BakedFileReader& reader, size_t simdSize)
+{
+	// Leaves padded for a wider SIMD width are still valid for a narrower one, but not the other way around
+	if (reader.GetSimdSize() % simdSize != 0)
+	{
+		return false;
+	}
+
+	size_t numNodes = 0;
+	const BvhNode* nodes = reader.FindSection<BvhNode>(GetTag('N', 'O', 'D'), numNodes);
+
+	size_t numSlots = 0;
+	const uint32_t* ids = reader.FindSection<uint32_t>(GetTag('I', 'D', 'S'), numSlots);
+
+	if (!nodes || !ids)
+	{
+		return false;
+	}
+
+	// A damaged file is rebuilt rather than read out of bounds.  Without a BVH the kernels run over all slots at once.
+	if (numNodes > 0 ? !Bvh::IsValid(nodes, numNodes, numSlots, simdSize) : (numSlots % simdSize != 0))
+	{
+		return false;
+	}
+	if (!AreSlotIdsValid(ids, numSlots, GetIdCount(m_inputIds.data(), m_inputIds.size())))
+	{
+		return false;
+	}
+
+	const float* streams[NumStreams];
+	for (size_t s = 0; s < NumStreams; ++s)
+	{
+		size_t count = 0;
+		streams[s] = reader.FindSection<float>(GetTag('S', 'T', static_cast<char>('0' + s)), count);
+		if (!streams[s] || count != numSlots)
+		{
+			return false;
+		}
+	}
+
+	for (size_t s = 0; s < NumStreams; ++s)
+	{
+		FreeVector(m_ownedStreams[s]);
+		m_streams[s] = streams[s];
+	}
+	FreeVector(m_ownedIds);
+	m_ids = ids;
+	m_numSlots = numSlots;
+
+	if (numNodes > 0)
+	{
+		m_bvh.Attach(nodes, numNodes);
+	}
+	else
+	{
+		m_bvh.Clear();
+	}
+
+	m_loaded = true;
+	return true;
+}
+
+
+template <size_t NumStreams>
+void PrimitiveStreams<NumStreams>::Unload()
+{
+	// The input primitives are kept while loaded, so the next Build() can start from them
+	for (size_t s = 0; s < NumStreams; ++s)
+	{
+		m_streams[s] = nullptr;
+	}
+	m_ids = nullptr;
+	m_numSlots = 0;
+
+	m_bvh.Clear();
+	m_loaded = false;
+}
\ No newline at end of file
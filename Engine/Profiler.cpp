@@ -0,0 +1,179 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Profiler.h"
+
+#include <mutex>
+
+
+using namespace std;
+
+
+namespace
+{
+
+// Shortest interval used to relate rdtsc ticks to QueryPerformanceCounter time
+constexpr double MIN_CALIBRATION_MICROSECONDS = 1000.0;
+
+
+struct ProfileEvent
+{
+	const char*	name;
+	uint64_t	start;
+	uint64_t	end;
+};
+
+
+struct ThreadBuffer
+{
+	DWORD					threadId{ 0 };
+	uint32_t				threadIndex{ 0 };
+	size_t					count{ 0 };
+	vector<ProfileEvent>	events;
+};
+
+
+mutex g_bufferMutex;
+vector<unique_ptr<ThreadBuffer>> g_buffers;
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+uint64_t g_baseTicks = 0;
+double g_baseMicroseconds = 0.0;
+
+
+double GetMicroseconds()
+{
+	LARGE_INTEGER ticksPerSec;
+	LARGE_INTEGER ticks;
+	QueryPerformanceFrequency(&ticksPerSec);
+	QueryPerformanceCounter(&ticks);
+	return 1000000.0 * static_cast<double>(ticks.QuadPart) / static_cast<double>(ticksPerSec.QuadPart);
+}
+
+
+// Buffers are owned by the registry, so they outlive the worker threads that recorded into them
+ThreadBuffer* RegisterThread()
+{
+	auto buffer = make_unique<ThreadBuffer>();
+	buffer->threadId = GetCurrentThreadId();
+	buffer->events.resize(PROFILER_EVENTS_PER_THREAD);
+
+	lock_guard<mutex> lock(g_bufferMutex);
+	buffer->threadIndex = static_cast<uint32_t>(g_buffers.size());
+	g_buffers.push_back(move(buffer));
+	return g_buffers.back().get();
+}
+
+} // anonymous namespace
+
+
+namespace Profiler
+{
+
+atomic<bool> g_enabled{ false };
+
+
+void Enable(bool enable)
+{
+	if (enable && !g_enabled)
+	{
+		Reset();
+	}
+	g_enabled = enable;
+}
+
+
+bool IsEnabled()
+{
+	return g_enabled;
+}
+
+
+void Reset()
+{
+	lock_guard<mutex> lock(g_bufferMutex);
+	for (auto& buffer : g_buffers)
+	{
+		buffer->count = 0;
+	}
+
+	g_baseTicks = __rdtsc();
+	g_baseMicroseconds = GetMicroseconds();
+}
+
+
+void RecordZone(const char* name, uint64_t start, uint64_t end)
+{
+	if (!t_buffer)
+	{
+		t_buffer = RegisterThread();
+	}
+
+	ThreadBuffer& buffer = *t_buffer;
+	buffer.events[buffer.count % PROFILER_EVENTS_PER_THREAD] = ProfileEvent{ name, start, end };
+	++buffer.count;
+}
+
+
+bool SaveChromeTrace(const char* filename)
+{
+	// rdtsc runs at a constant rate on every core of current CPUs, but that rate is not exposed directly
+	double elapsedMicroseconds = GetMicroseconds() - g_baseMicroseconds;
+	while (elapsedMicroseconds < MIN_CALIBRATION_MICROSECONDS)
+	{
+		elapsedMicroseconds = GetMicroseconds() - g_baseMicroseconds;
+	}
+	const double microsecondsPerTick = elapsedMicroseconds / static_cast<double>(__rdtsc() - g_baseTicks);
+
+	ofstream outfile;
+	outfile.open(filename, ios::out | ios::trunc);
+	if (!outfile.is_open())
+	{
+		return false;
+	}
+
+	lock_guard<mutex> lock(g_bufferMutex);
+
+	outfile << fixed;
+	outfile.precision(3);
+	outfile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << endl;
+
+	bool first = true;
+	for (const auto& buffer : g_buffers)
+	{
+		outfile << (first ? "" : ",\n");
+		outfile << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId;
+		outfile << ",\"args\":{\"name\":\"Thread " << buffer->threadIndex << "\"}}";
+		first = false;
+
+		const size_t numEvents = min(buffer->count, PROFILER_EVENTS_PER_THREAD);
+		for (size_t i = buffer->count - numEvents; i < buffer->count; ++i)
+		{
+			const ProfileEvent& event = buffer->events[i % PROFILER_EVENTS_PER_THREAD];
+
+			// Zones that started before the last Reset()
+			if (event.start < g_baseTicks)
+			{
+				continue;
+			}
+
+			outfile << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId;
+			outfile << ",\"ts\":" << microsecondsPerTick * static_cast<double>(event.start - g_baseTicks);
+			outfile << ",\"dur\":" << microsecondsPerTick * static_cast<double>(event.end - event.start) << "}";
+		}
+	}
+
+	outfile << endl << "]}" << endl;
+
+	outfile.close();
+	return !outfile.fail();
+}
+
+} // namespace Profiler
\ No newline at end of file
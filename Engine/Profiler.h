@@ -0,0 +1,73 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include <intrin.h>
+
+
+// Number of zones each thread keeps.  When a thread records more, its oldest zones are overwritten.
+constexpr size_t PROFILER_EVENTS_PER_THREAD = 1 << 16;
+
+
+/**
+*  Scoped zone profiler.  Zones are timestamped with rdtsc and recorded into a ring buffer owned by the
+*  recording thread, so recording never takes a lock.  Zones nest, and the trace shows one timeline per thread.
+*  Recording is off until Enable() is called, and costs a single branch per zone while off.
+*/
+namespace Profiler
+{
+
+void Enable(bool enable);
+bool IsEnabled();
+
+// Discards every recorded zone.  Must not be called while other threads are still recording.
+void Reset();
+
+// Writes the recorded zones as Chrome trace_event JSON, viewable in chrome://tracing or ui.perfetto.dev.
+// Must not be called while other threads are still recording.
+bool SaveChromeTrace(const char* filename);
+
+// Used by ProfileZone
+void RecordZone(const char* name, uint64_t start, uint64_t end);
+
+extern std::atomic<bool> g_enabled;
+
+} // namespace Profiler
+
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name)
+		: m_name(name)
+		, m_start(Profiler::g_enabled.load(std::memory_order_relaxed) ? __rdtsc() : 0)
+	{}
+
+	~ProfileZone()
+	{
+		if (m_start != 0)
+		{
+			Profiler::RecordZone(m_name, m_start, __rdtsc());
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char*		m_name;
+	const uint64_t	m_start;
+};
+
+
+#define PROFILE_ZONE_CONCAT_(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_(a, b)
+
+// Profiles the rest of the enclosing scope.  The name must be a string literal, or otherwise outlive the trace.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
\ No newline at end of file
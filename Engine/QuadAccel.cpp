@@ -0,0 +1,316 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "QuadAccel.h"
+
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+// Moller-Trumbore with the barycentric test widened to the full parallelogram, u and v both in [0, 1].
+// Shrinks ray.tmax and records the slot on a closer hit.
+template<int N>
+void IntersectQuads(const QuadList& quadList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
+	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
+	Float<N> rayOrigZ = Float<N>::Broadcast(ray.posZ);
+	Float<N> rayDirX = Float<N>::Broadcast(ray.dirX);
+	Float<N> rayDirY = Float<N>::Broadcast(ray.dirY);
+	Float<N> rayDirZ = Float<N>::Broadcast(ray.dirZ);
+
+	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
+	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
+	UInt<N> slot(0xffffffff);
+
+	const Float<N> zero(0.0f);
+	const Float<N> one(1.0f);
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
+	{
+		Float<N> e1X = Float<N>::Load(quadList.edgeUX + i);
+		Float<N> e1Y = Float<N>::Load(quadList.edgeUY + i);
+		Float<N> e1Z = Float<N>::Load(quadList.edgeUZ + i);
+		Float<N> e2X = Float<N>::Load(quadList.edgeVX + i);
+		Float<N> e2Y = Float<N>::Load(quadList.edgeVY + i);
+		Float<N> e2Z = Float<N>::Load(quadList.edgeVZ + i);
+
+		// p = dir x e2
+		Float<N> pX = rayDirY * e2Z - rayDirZ * e2Y;
+		Float<N> pY = rayDirZ * e2X - rayDirX * e2Z;
+		Float<N> pZ = rayDirX * e2Y - rayDirY * e2X;
+
+		Float<N> det = e1X * pX + e1Y * pY + e1Z * pZ;
+		Float<N> invDet = one / det;
+
+		Float<N> tX = rayOrigX - Float<N>::Load(quadList.cornerX + i);
+		Float<N> tY = rayOrigY - Float<N>::Load(quadList.cornerY + i);
+		Float<N> tZ = rayOrigZ - Float<N>::Load(quadList.cornerZ + i);
+
+		Float<N> u = (tX * pX + tY * pY + tZ * pZ) * invDet;
+
+		// q = t x e1
+		Float<N> qX = tY * e1Z - tZ * e1Y;
+		Float<N> qY = tZ * e1X - tX * e1Z;
+		Float<N> qZ = tX * e1Y - tY * e1X;
+
+		Float<N> v = (rayDirX * qX + rayDirY * qY + rayDirZ * qZ) * invDet;
+		Float<N> t = (e2X * qX + e2Y * qY + e2Z * qZ) * invDet;
+
+		// Padding slots have zero edges, so det == 0 rejects them
+		Bool<N> mask = (det != zero) & (u >= zero) & (v >= zero) & (u <= one) & (v <= one) & (t > tmin) & (t < hitT);
+
+		if (Any(mask))
+		{
+			hitT = Select(mask, t, hitT);
+			slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
+		}
+	}
+
+	float minT = ReduceMin(hitT);
+	if (minT < ray.tmax)
+	{
+		uint32_t minMask = Mask(hitT == Float<N>(minT));
+		uint32_t slots[N];
+		UInt<N>::StoreU(slots, slot);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
+			{
+				hitSlot = slots[lane] + lane;
+				ray.tmax = minT;
+				break;
+			}
+		}
+	}
+}
+
+
+template<>
+void IntersectQuads<1>(const QuadList& quadList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
+	{
+		const float e1X = quadList.edgeUX[i];
+		const float e1Y = quadList.edgeUY[i];
+		const float e1Z = quadList.edgeUZ[i];
+		const float e2X = quadList.edgeVX[i];
+		const float e2Y = quadList.edgeVY[i];
+		const float e2Z = quadList.edgeVZ[i];
+
+		float pX = ray.dirY * e2Z - ray.dirZ * e2Y;
+		float pY = ray.dirZ * e2X - ray.dirX * e2Z;
+		float pZ = ray.dirX * e2Y - ray.dirY * e2X;
+
+		float det = e1X * pX + e1Y * pY + e1Z * pZ;
+		if (det == 0.0f)
+		{
+			continue;
+		}
+		float invDet = 1.0f / det;
+
+		float tX = ray.posX - quadList.cornerX[i];
+		float tY = ray.posY - quadList.cornerY[i];
+		float tZ = ray.posZ - quadList.cornerZ[i];
+
+		float u = (tX * pX + tY * pY + tZ * pZ) * invDet;
+		if (u < 0.0f || u > 1.0f)
+		{
+			continue;
+		}
+
+		float qX = tY * e1Z - tZ * e1Y;
+		float qY = tZ * e1X - tX * e1Z;
+		float qZ = tX * e1Y - tY * e1X;
+
+		float v = (ray.dirX * qX + ray.dirY * qY + ray.dirZ * qZ) * invDet;
+		if (v < 0.0f || v > 1.0f)
+		{
+			continue;
+		}
+
+		float t = (e2X * qX + e2Y * qY + e2Z * qZ) * invDet;
+		if (t > ray.tmin && t < ray.tmax)
+		{
+			ray.tmax = t;
+			hitSlot = static_cast<uint32_t>(i);
+		}
+	}
+}
+
+
+QuadAccelerator::QuadAccelerator(Scene* scene)
+	: m_scene(scene)
+	, m_streams('Q')
+{}
+
+
+void QuadAccelerator::AddQuad(const Vector3& corner, const Vector3& edgeU, const Vector3& edgeV, uint32_t id)
+{
+	if (m_streams.IsLoaded())
+	{
+		UnloadAccel();
+	}
+
+	const float values[9] =
+	{
+		corner.GetX(), corner.GetY(), corner.GetZ(),
+		edgeU.GetX(), edgeU.GetY(), edgeU.GetZ(),
+		edgeV.GetX(), edgeV.GetY(), edgeV.GetZ()
+	};
+
+	const Vector3 corners[4] = { corner, corner + edgeU, corner + edgeV, corner + edgeU + edgeV };
+
+	BvhBounds bounds;
+	for (const auto& c : corners)
+	{
+		bounds.Grow(c.GetX(), c.GetY(), c.GetZ());
+	}
+
+	m_streams.Add(values, id, bounds);
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void QuadAccelerator::IntersectBvh(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	m_streams.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectQuads<N>(m_quadList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		Vector3 edgeU(m_quadList.edgeUX[hitSlot], m_quadList.edgeUY[hitSlot], m_quadList.edgeUZ[hitSlot]);
+		Vector3 edgeV(m_quadList.edgeVX[hitSlot], m_quadList.edgeVY[hitSlot], m_quadList.edgeVZ[hitSlot]);
+		Vector3 normal = Normalize(Cross(edgeU, edgeV));
+
+		hit.normalX = normal.GetX();
+		hit.normalY = normal.GetY();
+		hit.normalZ = normal.GetZ();
+		hit.geomId = m_quadList.id[hitSlot];
+	}
+}
+
+
+void QuadAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectBvh<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectBvh<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectBvh<8>(ray, hit);
+	}
+}
+
+
+void QuadAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const float padValues[9] = {};
+
+	m_streams.Build(m_scene->GetSimdSize(), true, padValues);
+	UpdateList();
+
+	m_dirty = false;
+}
+
+
+BvhBounds QuadAccelerator::GetBounds() const
+{
+	return m_streams.GetBounds();
+}
+
+
+size_t QuadAccelerator::GetMemoryUsage() const
+{
+	return m_streams.GetMemoryUsage();
+}
+
+
+uint64_t QuadAccelerator::GetContentHash() const
+{
+	return m_streams.GetContentHash();
+}
+
+
+void QuadAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	m_streams.Save(writer);
+}
+
+
+bool QuadAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	if (!m_streams.Load(reader, m_scene->GetSimdSize()))
+	{
+		return false;
+	}
+
+	UpdateList();
+
+	m_dirty = false;
+	return true;
+}
+
+
+void QuadAccelerator::UnloadAccel()
+{
+	if (!m_streams.IsLoaded())
+	{
+		return;
+	}
+
+	m_streams.Unload();
+	UpdateList();
+
+	m_dirty = true;
+}
+
+
+void QuadAccelerator::UpdateList()
+{
+	m_quadList.cornerX = m_streams.GetStream(0);
+	m_quadList.cornerY = m_streams.GetStream(1);
+	m_quadList.cornerZ = m_streams.GetStream(2);
+	m_quadList.edgeUX = m_streams.GetStream(3);
+	m_quadList.edgeUY = m_streams.GetStream(4);
+	m_quadList.edgeUZ = m_streams.GetStream(5);
+	m_quadList.edgeVX = m_streams.GetStream(6);
+	m_quadList.edgeVY = m_streams.GetStream(7);
+	m_quadList.edgeVZ = m_streams.GetStream(8);
+	m_quadList.id = m_streams.GetIds();
+	m_quadList.numSlots = m_streams.GetNumSlots();
+}
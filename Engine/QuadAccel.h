@@ -0,0 +1,77 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "IAccelerator.h"
+#include "PrimitiveStreams.h"
+
+
+// Forward declarations
+class Scene;
+
+
+// View over quad (parallelogram) data in BVH leaf order, a corner plus the two edges from it, padded per leaf
+// to a multiple of the SIMD width
+struct QuadList
+{
+	const float*	cornerX{ nullptr };
+	const float*	cornerY{ nullptr };
+	const float*	cornerZ{ nullptr };
+	const float*	edgeUX{ nullptr };
+	const float*	edgeUY{ nullptr };
+	const float*	edgeUZ{ nullptr };
+	const float*	edgeVX{ nullptr };
+	const float*	edgeVY{ nullptr };
+	const float*	edgeVZ{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
+};
+
+
+class QuadAccelerator : public IAccelerator
+{
+public:
+	QuadAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Quad;
+	}
+
+	// The normal faces along cross(edgeU, edgeV)
+	void AddQuad(const Math::Vector3& corner, const Math::Vector3& edgeU, const Math::Vector3& edgeV, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectBvh(Ray& ray, Hit& hit) const;
+
+	void UpdateList();
+
+private:
+	Scene*				m_scene;
+
+	PrimitiveStreams<9>	m_streams;
+	QuadList			m_quadList;
+
+	bool				m_dirty{ false };
+};
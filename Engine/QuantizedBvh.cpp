@@ -0,0 +1,206 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "QuantizedBvh.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Normal floats only, so that every step, and every multiple of it up to 255, is exact
+constexpr int MIN_EXPONENT = -126;
+constexpr int MAX_EXPONENT = 127;
+
+
+// The smallest power of two step whose 255 steps from minValue reach maxValue
+int8_t ChooseExponent(float minValue, float maxValue)
+{
+	int exponent = MIN_EXPONENT;
+	if (maxValue > minValue)
+	{
+		frexpf((maxValue - minValue) / 255.0f, &exponent);
+		exponent = max(exponent - 1, MIN_EXPONENT);
+	}
+
+	while (exponent < MAX_EXPONENT && minValue + 255.0f * QuantizedBvhNode::ExponentToScale(exponent) < maxValue)
+	{
+		++exponent;
+	}
+	return static_cast<int8_t>(exponent);
+}
+
+
+// Rounded down and up to the grid, checked against the exact dequantization that traversal performs
+uint8_t QuantizeMin(float value, float origin, int8_t exponent)
+{
+	const float scale = QuantizedBvhNode::ExponentToScale(exponent);
+	int q = min(max(static_cast<int>(floorf((value - origin) / scale)), 0), 255);
+	while (q > 0 && origin + static_cast<float>(q) * scale > value)
+	{
+		--q;
+	}
+	return static_cast<uint8_t>(q);
+}
+
+
+uint8_t QuantizeMax(float value, float origin, int8_t exponent)
+{
+	const float scale = QuantizedBvhNode::ExponentToScale(exponent);
+	int q = min(max(static_cast<int>(ceilf((value - origin) / scale)), 0), 255);
+	while (q < 255 && origin + static_cast<float>(q) * scale < value)
+	{
+		++q;
+	}
+	return static_cast<uint8_t>(q);
+}
+
+
+// The node's grid, over its own bounds
+void SetOrigin(QuantizedBvhNode& node, const BvhBounds& bounds)
+{
+	node.originX = bounds.minX;
+	node.originY = bounds.minY;
+	node.originZ = bounds.minZ;
+	node.exponentX = ChooseExponent(bounds.minX, bounds.maxX);
+	node.exponentY = ChooseExponent(bounds.minY, bounds.maxY);
+	node.exponentZ = ChooseExponent(bounds.minZ, bounds.maxZ);
+}
+
+
+// One child's bounds on the node's grid
+void SetChildBounds(QuantizedBvhNode& node, int child, const BvhBounds& bounds)
+{
+	node.planesX[child] = QuantizeMin(bounds.minX, node.originX, node.exponentX);
+	node.planesY[child] = QuantizeMin(bounds.minY, node.originY, node.exponentY);
+	node.planesZ[child] = QuantizeMin(bounds.minZ, node.originZ, node.exponentZ);
+	node.planesX[child + 2] = QuantizeMax(bounds.maxX, node.originX, node.exponentX);
+	node.planesY[child + 2] = QuantizeMax(bounds.maxY, node.originY, node.exponentY);
+	node.planesZ[child + 2] = QuantizeMax(bounds.maxZ, node.originZ, node.exponentZ);
+}
+
+} // anonymous namespace
+
+
+void QuantizedBvh::Build(const Bvh& bvh, size_t simdSize)
+{
+	Clear();
+
+	m_simdSize = simdSize;
+
+	const BvhNode* nodes = bvh.GetNodes();
+	const size_t numNodes = bvh.GetNumNodes();
+	if (numNodes == 0)
+	{
+		return;
+	}
+
+	m_bounds = nodes[0].GetBounds();
+	m_nodeStorage.reserve(numNodes / 2 + 1);
+
+	if (nodes[0].IsLeaf())
+	{
+		// A single leaf becomes the left child of a root node, next to an empty right leaf
+		const uint32_t batches = nodes[0].count / static_cast<uint32_t>(simdSize);
+		assert(batches <= QUANTIZED_BVH_MAX_LEAF_BATCHES);
+
+		QuantizedBvhNode node{};
+		SetOrigin(node, m_bounds);
+		SetChildBounds(node, 0, m_bounds);
+		SetChildBounds(node, 1, m_bounds);
+		node.leafSizes = static_cast<uint8_t>((1 + batches) | (1 << 4));
+		node.offset = nodes[0].offset;
+		m_nodeStorage.push_back(node);
+	}
+	else
+	{
+		BuildRecursive(nodes, 0);
+	}
+
+	m_nodes = m_nodeStorage.data();
+	m_numNodes = m_nodeStorage.size();
+}
+
+
+void QuantizedBvh::Attach(const QuantizedBvhNode* nodes, size_t numNodes, const BvhBounds& bounds, size_t simdSize)
+{
+	Clear();
+
+	m_nodes = nodes;
+	m_numNodes = numNodes;
+	m_bounds = bounds;
+	m_simdSize = simdSize;
+}
+
+
+void QuantizedBvh::Clear()
+{
+	FreeVector(m_nodeStorage);
+	m_nodes = nullptr;
+	m_numNodes = 0;
+	m_bounds = BvhBounds();
+}
+
+
+uint32_t QuantizedBvh::BuildRecursive(const BvhNode* nodes, uint32_t nodeIndex)
+{
+	const BvhNode& fullNode = nodes[nodeIndex];
+	const uint32_t children[2] = { nodeIndex + 1, fullNode.offset };
+
+	QuantizedBvhNode node{};
+	SetOrigin(node, fullNode.GetBounds());
+
+	uint32_t interiorChildren[2];
+	int numInteriorChildren = 0;
+	bool hasLeafOffset = false;
+
+	for (int child = 0; child < 2; ++child)
+	{
+		const BvhNode& childNode = nodes[children[child]];
+		SetChildBounds(node, child, childNode.GetBounds());
+
+		if (childNode.IsLeaf())
+		{
+			const uint32_t batches = childNode.count / static_cast<uint32_t>(m_simdSize);
+			assert(batches <= QUANTIZED_BVH_MAX_LEAF_BATCHES);
+			node.leafSizes |= static_cast<uint8_t>((1 + batches) << (4 * child));
+
+			// Two leaf siblings are neighbours in depth-first order, so the left one's slots come first
+			if (!hasLeafOffset)
+			{
+				node.offset = childNode.offset;
+				hasLeafOffset = true;
+			}
+		}
+		else
+		{
+			interiorChildren[numInteriorChildren++] = children[child];
+		}
+	}
+
+	const uint32_t index = static_cast<uint32_t>(m_nodeStorage.size());
+	m_nodeStorage.push_back(node);
+
+	if (numInteriorChildren > 0)
+	{
+		BuildRecursive(nodes, interiorChildren[0]);
+	}
+	if (numInteriorChildren > 1)
+	{
+		// Note: don't hold on to the node reference across the recursive calls, since the storage may grow
+		const uint32_t secondIndex = BuildRecursive(nodes, interiorChildren[1]);
+		m_nodeStorage[index].offset = secondIndex;
+	}
+
+	return index;
+}
\ No newline at end of file
@@ -0,0 +1,330 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+
+
+// Leaf sizes are stored in 4 bits per child, in SIMD batches
+constexpr uint32_t QUANTIZED_BVH_MAX_LEAF_BATCHES = 14;
+
+
+// 32 bytes, two nodes per cache line, and one node per interior node of the full precision tree: each node holds
+// the boxes of both its children, on a grid of 255 steps over its own box.  The steps are powers of two, so a
+// quantized plane dequantizes exactly, and the planes are rounded outwards, so a child's quantized box always
+// contains its full precision box.
+//
+// The planes of each axis are stored together, the min planes of both children then their max planes, so that one
+// Float4 slab-tests both children along the axis.  Children are either interior nodes or leaves.  The first
+// interior child immediately follows its parent (depth-first order).  offset holds the index of the second
+// interior child when both are interior, and the first primitive slot of the leaf children otherwise; when both
+// are leaves, the right one's slots follow the left one's.
+struct QuantizedBvhNode
+{
+	float		originX;
+	float		originY;
+	float		originZ;
+	int8_t		exponentX;
+	int8_t		exponentY;
+	int8_t		exponentZ;
+	uint8_t		leafSizes;		// 4 bits per child, left in the low bits: 0 for interior children, else 1 + SIMD batches
+	uint8_t		planesX[4];		// minX of both children, then maxX of both children
+	uint8_t		planesY[4];
+	uint8_t		planesZ[4];
+	uint32_t	offset;
+
+	__forceinline bool IsLeaf(int child) const { return ((leafSizes >> (4 * child)) & 0xF) != 0; }
+	__forceinline uint32_t GetLeafBatches(int child) const { return ((leafSizes >> (4 * child)) & 0xF) - 1; }
+
+	__forceinline BvhBounds GetChildBounds(int child) const
+	{
+		const float scaleX = ExponentToScale(exponentX);
+		const float scaleY = ExponentToScale(exponentY);
+		const float scaleZ = ExponentToScale(exponentZ);
+
+		BvhBounds bounds;
+		bounds.minX = originX + static_cast<float>(planesX[child]) * scaleX;
+		bounds.minY = originY + static_cast<float>(planesY[child]) * scaleY;
+		bounds.minZ = originZ + static_cast<float>(planesZ[child]) * scaleZ;
+		bounds.maxX = originX + static_cast<float>(planesX[child + 2]) * scaleX;
+		bounds.maxY = originY + static_cast<float>(planesY[child + 2]) * scaleY;
+		bounds.maxZ = originZ + static_cast<float>(planesZ[child + 2]) * scaleZ;
+		return bounds;
+	}
+
+	// 2^exponent, built directly from the exponent bits
+	static __forceinline float ExponentToScale(int exponent)
+	{
+		const uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+		float scale;
+		memcpy(&scale, &bits, sizeof(scale));
+		return scale;
+	}
+};
+static_assert(sizeof(QuantizedBvhNode) == 32, "QuantizedBvhNode must be 32 bytes");
+
+
+__forceinline bool IntersectBvhBounds(const BvhBounds& bounds, float posX, float posY, float posZ, float invDirX, float invDirY, float invDirZ, float tmin, float tmax, float& tEntry)
+{
+	float tx0 = (bounds.minX - posX) * invDirX;
+	float tx1 = (bounds.maxX - posX) * invDirX;
+	float ty0 = (bounds.minY - posY) * invDirY;
+	float ty1 = (bounds.maxY - posY) * invDirY;
+	float tz0 = (bounds.minZ - posZ) * invDirZ;
+	float tz1 = (bounds.maxZ - posZ) * invDirZ;
+
+	float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), tmin));
+	float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), tmax));
+
+	tEntry = tNear;
+	return tNear <= tFar;
+}
+
+
+// Ray constants of QuantizedBvh::Intersect, broadcast
+struct QuantizedBvhRay
+{
+	Float4	posX;
+	Float4	posY;
+	Float4	posZ;
+	Float4	invDirX;
+	Float4	invDirY;
+	Float4	invDirZ;
+	Float4	tmin;
+};
+
+
+// Dequantizes the 4 planes of one axis, exactly as QuantizedBvhNode::GetChildBounds does
+__forceinline Float4 GetQuantizedPlanes(const uint8_t* planes, float origin, int8_t exponent)
+{
+	uint32_t packed;
+	memcpy(&packed, planes, sizeof(packed));
+	const Float4 steps(Int4(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(packed)))));
+	return Float4(origin) + steps * Float4(QuantizedBvhNode::ExponentToScale(exponent));
+}
+
+
+// Slab-tests both children of a node at once, with the same results as IntersectBvhBounds on each child's
+// dequantized bounds, NaNs included.  Returns a mask of the children hit in bits 0 and 1, and their entry
+// distances in lanes 0 and 1 of tEntry.
+__forceinline uint32_t IntersectQuantizedChildren(const QuantizedBvhNode& node, const QuantizedBvhRay& ray, float tmax, Float4& tEntry)
+{
+	const Float4 tx = (GetQuantizedPlanes(node.planesX, node.originX, node.exponentX) - ray.posX) * ray.invDirX;
+	const Float4 ty = (GetQuantizedPlanes(node.planesY, node.originY, node.exponentY) - ray.posY) * ray.invDirY;
+	const Float4 tz = (GetQuantizedPlanes(node.planesZ, node.originZ, node.exponentZ) - ray.posZ) * ray.invDirZ;
+
+	// Each child's far plane distances against its near ones.  std::min(a, b) and std::max(a, b) return a when
+	// either is NaN, as do Min(b, a) and Max(b, a).
+	const Float4 sx = Shuffle<2, 3, 0, 1>(tx);
+	const Float4 sy = Shuffle<2, 3, 0, 1>(ty);
+	const Float4 sz = Shuffle<2, 3, 0, 1>(tz);
+
+	const Float4 tNear = Max(Max(Min(sz, tz), ray.tmin), Max(Min(sy, ty), Min(sx, tx)));
+	const Float4 tFar = Min(Min(Max(sz, tz), Float4(tmax)), Min(Max(sy, ty), Max(sx, tx)));
+
+	tEntry = tNear;
+	return Mask((tNear < tFar) | (tNear == tFar)) & 3;
+}
+
+
+class QuantizedBvh
+{
+public:
+	// Compresses a built hierarchy, whose leaves must hold at most QUANTIZED_BVH_MAX_LEAF_BATCHES batches of
+	// simdSize slots.  The primitive slots stay where the full precision tree put them.
+	void Build(const Bvh& bvh, size_t simdSize);
+
+	// Attach externally owned (e.g. memory-mapped) nodes instead of building.  simdSize is the one the nodes were
+	// built with, which sets the size of their leaves.
+	void Attach(const QuantizedBvhNode* nodes, size_t numNodes, const BvhBounds& bounds, size_t simdSize);
+	void Clear();
+
+	const QuantizedBvhNode* GetNodes() const { return m_nodes; }
+	size_t GetNumNodes() const { return m_numNodes; }
+	const BvhBounds& GetBounds() const { return m_bounds; }
+	size_t GetMemoryUsage() const { return m_numNodes * sizeof(QuantizedBvhNode); }
+
+	// Front-to-back traversal, same as Bvh::Intersect
+	template <bool CountNodeFetches = false, typename LeafFunc>
+	void Intersect(Ray& ray, LeafFunc&& leafFunc) const;
+
+	// Same as Bvh::Visit, with nodeFunc(bounds) given the dequantized bounds of every node
+	template <typename NodeFunc, typename LeafFunc>
+	void Visit(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const;
+
+private:
+	uint32_t BuildRecursive(const BvhNode* nodes, uint32_t nodeIndex);
+
+	// Slots of a leaf child
+	__forceinline uint32_t GetLeafOffset(const QuantizedBvhNode& node, int child) const
+	{
+		return (child == 1 && node.IsLeaf(0)) ? node.offset + GetLeafSize(node, 0) : node.offset;
+	}
+
+	__forceinline uint32_t GetLeafSize(const QuantizedBvhNode& node, int child) const
+	{
+		return node.GetLeafBatches(child) * static_cast<uint32_t>(m_simdSize);
+	}
+
+	// Index of an interior child
+	__forceinline uint32_t GetChildIndex(const QuantizedBvhNode& node, uint32_t nodeIndex, int child) const
+	{
+		return (child == 1 && !node.IsLeaf(0)) ? node.offset : nodeIndex + 1;
+	}
+
+private:
+	std::vector<QuantizedBvhNode, aligned_allocator<QuantizedBvhNode, 64>>	m_nodeStorage;
+
+	const QuantizedBvhNode*	m_nodes{ nullptr };
+	size_t					m_numNodes{ 0 };
+	BvhBounds				m_bounds;
+
+	size_t					m_simdSize{ 1 };
+};
+
+
+template <bool CountNodeFetches, typename LeafFunc>
+void QuantizedBvh::Intersect(Ray& ray, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0)
+	{
+		return;
+	}
+
+	const float invDirX = 1.0f / ray.dirX;
+	const float invDirY = 1.0f / ray.dirY;
+	const float invDirZ = 1.0f / ray.dirZ;
+
+	float tEntry = 0.0f;
+	if (!IntersectBvhBounds(m_bounds, ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tEntry))
+	{
+		return;
+	}
+
+	const QuantizedBvhRay nodeRay{ ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin };
+
+	// Leaves have no node of their own, so the stack holds children: an interior node index with a size of 0, or
+	// the slots of a leaf
+	uint32_t stack[64];
+	uint32_t stackSize[64];
+	float stackT[64];
+	int stackCount = 0;
+
+	uint32_t index = 0;
+	uint32_t leafSize = 0;
+	for (;;)
+	{
+		if (leafSize != 0)
+		{
+			leafFunc(index, leafSize);
+		}
+		else
+		{
+			const QuantizedBvhNode& node = m_nodes[index];
+
+			if (CountNodeFetches)
+			{
+				CountNodeFetch(&node);
+			}
+
+			Float4 tChild;
+			const uint32_t hitMask = IntersectQuantizedChildren(node, nodeRay, ray.tmax, tChild);
+
+			uint32_t childIndex[2];
+			uint32_t childSize[2];
+			bool hitChild[2];
+			for (int child = 0; child < 2; ++child)
+			{
+				childIndex[child] = node.IsLeaf(child) ? GetLeafOffset(node, child) : GetChildIndex(node, index, child);
+				childSize[child] = node.IsLeaf(child) ? GetLeafSize(node, child) : 0;
+
+				// Empty leaves only pad out a root that is a single leaf
+				hitChild[child] = ((hitMask >> child) & 1) != 0 && (!node.IsLeaf(child) || childSize[child] != 0);
+			}
+
+			if (hitChild[0] && hitChild[1])
+			{
+				// Visit the nearer child first, defer the other one
+				const int nearChild = (tChild[1] < tChild[0]) ? 1 : 0;
+				const int farChild = nearChild ^ 1;
+				stack[stackCount] = childIndex[farChild];
+				stackSize[stackCount] = childSize[farChild];
+				stackT[stackCount++] = tChild[farChild];
+				index = childIndex[nearChild];
+				leafSize = childSize[nearChild];
+				continue;
+			}
+			else if (hitChild[0] || hitChild[1])
+			{
+				const int child = hitChild[0] ? 0 : 1;
+				index = childIndex[child];
+				leafSize = childSize[child];
+				continue;
+			}
+		}
+
+		// Pop the next child, skipping any that are now further away than the closest hit
+		do
+		{
+			if (stackCount == 0)
+			{
+				return;
+			}
+			--stackCount;
+		} while (stackT[stackCount] > ray.tmax);
+
+		index = stack[stackCount];
+		leafSize = stackSize[stackCount];
+	}
+}
+
+
+template <typename NodeFunc, typename LeafFunc>
+void QuantizedBvh::Visit(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0 || !nodeFunc(m_bounds))
+	{
+		return;
+	}
+
+	uint32_t stack[64];
+	int stackSize = 0;
+
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const QuantizedBvhNode& node = m_nodes[nodeIndex];
+
+		for (int child = 0; child < 2; ++child)
+		{
+			if (!nodeFunc(node.GetChildBounds(child)))
+			{
+				continue;
+			}
+
+			if (node.IsLeaf(child))
+			{
+				if (node.GetLeafBatches(child) > 0)
+				{
+					leafFunc(GetLeafOffset(node, child), GetLeafSize(node, child));
+				}
+			}
+			else
+			{
+				stack[stackSize++] = GetChildIndex(node, nodeIndex, child);
+			}
+		}
+
+		if (stackSize == 0)
+		{
+			return;
+		}
+		nodeIndex = stack[--stackSize];
+	}
+}
\ No newline at end of file
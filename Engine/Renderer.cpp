@@ -0,0 +1,582 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Renderer.h"
+
+#include "Arena.h"
+#include "Camera.h"
+#include "Image.h"
+#include "ITracer.h"
+#include "MaterialSet.h"
+#include "Profiler.h"
+#include "Sampling.h"
+#include "TileFrustum.h"
+#include "Timer.h"
+#include "WorkerPool.h"
+
+
+using namespace Math;
+using namespace std;
+using namespace concurrency;
+
+
+namespace
+{
+
+constexpr uint32_t NO_HIT = 0xFFFFFFFF;
+
+
+struct RenderContext;
+
+// Renders a whole tile at (xStart, yStart) into colors, one row of the tile after the other, returning the number
+// of rays traced.  cull is the tile's culled spheres, or null.
+using FullTileFunc = size_t(*)(const RenderContext& context, const TileCull* cull, int xStart, int yStart, Vector3* colors);
+
+
+struct RenderContext
+{
+	const ITracer&		tracer;
+	const MaterialSet&	materials;
+	const Camera&		camera;
+	const RenderConfig&	config;
+	Image&				image;
+	const RenderAovs*	aovs;
+	int					numTilesX;
+	FullTileFunc		fullTileFunc;	// Null for tile sizes without a specialization
+	atomic_size_t&		scratchHighWaterMark;
+};
+
+
+__forceinline Vector3 GetSkyColor(const Ray& ray)
+{
+	Vector3 unitDir = Normalize(Vector3(ray.dirX, ray.dirY, ray.dirZ));
+	float t = 0.5f * (unitDir.GetY() + 1.0f);
+	return (1.0f - t) * Vector3(1.0f, 1.0f, 1.0f) + t * Vector3(0.5f, 0.7f, 1.0f);
+}
+
+
+// Camera rays go through the tile's culled spheres when it has them
+__forceinline void IntersectCamera(const RenderContext& context, const TileCull* cull, Ray& ray, Hit& hit)
+{
+	if (cull)
+	{
+		context.tracer.IntersectCulled(*cull, ray, hit);
+	}
+	else
+	{
+		context.tracer.Intersect1(ray, hit);
+	}
+}
+
+
+// cull only applies at depth 0, to the camera ray
+Vector3 GetColor_Recursive(const RenderContext& context, const TileCull* cull, Ray& ray, int depth, uint32_t& state, size_t& numRays)
+{
+	Hit hit;
+	hit.geomId = NO_HIT;
+	++numRays;
+
+	IntersectCamera(context, cull, ray, hit);
+
+	if (hit.geomId != NO_HIT)
+	{
+		Ray scattered;
+		Vector3 attenuation;
+		if (depth < context.config.maxDepth && context.materials.Scatter(ray, hit, attenuation, scattered, state))
+		{
+			return attenuation * GetColor_Recursive(context, nullptr, scattered, depth + 1, state, numRays);
+		}
+		else
+		{
+			return Vector3(kZero);
+		}
+	}
+
+	return GetSkyColor(ray);
+}
+
+
+// cull only applies to the camera ray
+Vector3 GetColor_Iterative(const RenderContext& context, const TileCull* cull, Ray& ray, uint32_t& state, size_t& numRays)
+{
+	Vector3 color(kOne);
+
+	Hit hit;
+	int depth = 0;
+	++numRays;
+	do
+	{
+		hit.geomId = NO_HIT;
+		IntersectCamera(context, cull, ray, hit);
+		cull = nullptr;
+
+		if (hit.geomId != NO_HIT)
+		{
+			++depth;
+			Ray scattered;
+			Vector3 attenuation;
+
+			if (!context.materials.Scatter(ray, hit, attenuation, scattered, state))
+			{
+				color *= Vector3(kZero);
+				break;
+			}
+
+			color *= attenuation;
+			ray = scattered;
+			++numRays;
+		}
+	} while (hit.geomId != NO_HIT && depth < context.config.maxDepth);
+
+	color *= GetSkyColor(ray);
+
+	return color;
+}
+
+
+void WriteAovs(const RenderAovs& aovs, int i, int j, int numSamples, uint64_t numCycles, size_t numRays)
+{
+	if (aovs.cycles)
+	{
+		const float cycles = static_cast<float>(numCycles);
+		aovs.cycles->SetPixel(i, j, Vector3(cycles, cycles, cycles));
+	}
+
+	if (aovs.rays)
+	{
+		const float rays = static_cast<float>(numRays);
+		aovs.rays->SetPixel(i, j, Vector3(rays, rays, rays));
+	}
+
+	// Every sample traces its camera ray, then one more ray per bounce
+	if (aovs.depth)
+	{
+		const float depth = static_cast<float>(numRays) / static_cast<float>(numSamples) - 1.0f;
+		aovs.depth->SetPixel(i, j, Vector3(depth, depth, depth));
+	}
+}
+
+
+Vector3 RenderSinglePixel(const RenderContext& context, const TileCull* cull, int i, int j, size_t& numRays)
+{
+	const int numSamples = context.config.samples;
+
+	const uint64_t startCycles = context.aovs ? __rdtsc() : 0;
+	const size_t startRays = numRays;
+
+	uint32_t state = PixelSeed(context.config.seed, i, j);
+
+	Vector3 color(kZero);
+	for (int s = 0; s < numSamples; ++s)
+	{
+		float u = (float(i) + UniformFloat01(state)) * context.image.GetInvWidth();
+		float v = (float(j) + UniformFloat01(state)) * context.image.GetInvHeight();
+
+		auto ray = context.camera.GetRay(u, v, state);
+		if (context.config.recursive)
+		{
+			color += GetColor_Recursive(context, cull, ray, 0, state, numRays);
+		}
+		else
+		{
+			color += GetColor_Iterative(context, cull, ray, state, numRays);
+		}
+	}
+
+	color = color * (1.0f / static_cast<float>(numSamples));
+
+	if (context.aovs)
+	{
+		WriteAovs(*context.aovs, i, j, numSamples, __rdtsc() - startCycles, numRays - startRays);
+	}
+
+	return color;
+}
+
+
+// Batched counterpart of RenderSinglePixel over a whole tile.  Every pixel keeps its own random sequence and
+// draws from it in the same order as GetColor_Iterative, so the image is the same.  Returns the number of rays,
+// counted as GetColor_Iterative counts them.
+size_t RenderBatchedTile(const RenderContext& context, const TileCull* cull, int xStart, int yStart, int width, int height, Vector3* colors)
+{
+	const RenderConfig& config = context.config;
+	const int numPixels = width * height;
+	const int numSamples = config.samples;
+
+	const uint64_t startCycles = context.aovs ? __rdtsc() : 0;
+
+	// Per pixel state, and per path state of the current sample.  Paths are compacted after every bounce, so the
+	// first numPaths entries are always the ones still bouncing.
+	ScratchArena& scratch = GetThreadScratchArena();
+	uint32_t* states = scratch.Allocate<uint32_t>(numPixels);
+	uint32_t* pixelRays = scratch.Allocate<uint32_t>(numPixels);
+	Ray* rays = scratch.Allocate<Ray>(numPixels);
+	Hit* hits = scratch.Allocate<Hit>(numPixels);
+	Vector3* throughputs = scratch.Allocate<Vector3>(numPixels);
+	uint32_t* pathPixels = scratch.Allocate<uint32_t>(numPixels);
+
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			const int pixel = j * width + i;
+			states[pixel] = PixelSeed(config.seed, xStart + i, yStart + j);
+			pixelRays[pixel] = 0;
+			colors[pixel] = Vector3(kZero);
+		}
+	}
+
+	for (int s = 0; s < numSamples; ++s)
+	{
+		for (int pixel = 0; pixel < numPixels; ++pixel)
+		{
+			const int j = pixel / width;
+			const int i = pixel - j * width;
+			uint32_t& state = states[pixel];
+
+			float u = (float(xStart + i) + UniformFloat01(state)) * context.image.GetInvWidth();
+			float v = (float(yStart + j) + UniformFloat01(state)) * context.image.GetInvHeight();
+
+			rays[pixel] = context.camera.GetRay(u, v, state);
+			throughputs[pixel] = Vector3(kOne);
+			pathPixels[pixel] = pixel;
+			++pixelRays[pixel];
+		}
+
+		int numPaths = numPixels;
+		for (int depth = 1; numPaths > 0; ++depth)
+		{
+			for (int path = 0; path < numPaths; ++path)
+			{
+				hits[path].geomId = NO_HIT;
+			}
+
+			// Only the camera rays are coherent, and only they can use the culled spheres
+			if (cull && depth == 1)
+			{
+				for (int path = 0; path < numPaths; ++path)
+				{
+					context.tracer.IntersectCulled(*cull, rays[path], hits[path]);
+				}
+			}
+			else
+			{
+				context.tracer.IntersectBatch(rays, hits, numPaths, depth == 1);
+			}
+
+			int numNextPaths = 0;
+			for (int path = 0; path < numPaths; ++path)
+			{
+				const uint32_t pixel = pathPixels[path];
+
+				if (hits[path].geomId == NO_HIT)
+				{
+					colors[pixel] += throughputs[path] * GetSkyColor(rays[path]);
+					continue;
+				}
+
+				// Absorbed paths contribute nothing
+				Ray scattered;
+				Vector3 attenuation;
+				if (!context.materials.Scatter(rays[path], hits[path], attenuation, scattered, states[pixel]))
+				{
+					continue;
+				}
+
+				const Vector3 throughput = throughputs[path] * attenuation;
+				++pixelRays[pixel];
+
+				if (depth >= config.maxDepth)
+				{
+					colors[pixel] += throughput * GetSkyColor(scattered);
+					continue;
+				}
+
+				rays[numNextPaths] = scattered;
+				throughputs[numNextPaths] = throughput;
+				pathPixels[numNextPaths] = pixel;
+				++numNextPaths;
+			}
+			numPaths = numNextPaths;
+		}
+	}
+
+	size_t numRays = 0;
+	const float invNumSamples = 1.0f / static_cast<float>(numSamples);
+	for (int pixel = 0; pixel < numPixels; ++pixel)
+	{
+		colors[pixel] = colors[pixel] * invNumSamples;
+		numRays += pixelRays[pixel];
+	}
+
+	// The pixels of a batched tile are traced together, so each is charged an equal share of the tile's cycles
+	if (context.aovs)
+	{
+		const uint64_t pixelCycles = (__rdtsc() - startCycles) / numPixels;
+		for (int pixel = 0; pixel < numPixels; ++pixel)
+		{
+			const int j = pixel / width;
+			const int i = pixel - j * width;
+			WriteAovs(*context.aovs, xStart + i, yStart + j, numSamples, pixelCycles, pixelRays[pixel]);
+		}
+	}
+
+	return numRays;
+}
+
+
+// Full tiles of the common sizes get constant loop bounds, so the pixel loops can be unrolled.  Edge tiles, and
+// tile sizes without a specialization, use the run-time bounds in RenderTile.
+template <int TILE_WIDTH, int TILE_HEIGHT>
+size_t RenderFullTile(const RenderContext& context, const TileCull* cull, int xStart, int yStart, Vector3* colors)
+{
+	size_t numRays = 0;
+	for (int j = TILE_HEIGHT - 1; j >= 0; --j)
+	{
+		for (int i = 0; i < TILE_WIDTH; ++i)
+		{
+			colors[j * TILE_WIDTH + i] = RenderSinglePixel(context, cull, xStart + i, yStart + j, numRays);
+		}
+	}
+
+	return numRays;
+}
+
+
+FullTileFunc GetFullTileFunc(int tileWidth, int tileHeight)
+{
+	if (tileWidth == 4 && tileHeight == 4)
+	{
+		return RenderFullTile<4, 4>;
+	}
+	else if (tileWidth == 8 && tileHeight == 8)
+	{
+		return RenderFullTile<8, 8>;
+	}
+	else if (tileWidth == 16 && tileHeight == 16)
+	{
+		return RenderFullTile<16, 16>;
+	}
+	else if (tileWidth == 32 && tileHeight == 32)
+	{
+		return RenderFullTile<32, 32>;
+	}
+	return nullptr;
+}
+
+
+// Returns the number of rays traced for the tile
+size_t RenderTile(const RenderContext& context, int tileIndex)
+{
+	PROFILE_ZONE("RenderTile");
+
+	const RenderConfig& config = context.config;
+
+	const int tileY = tileIndex / context.numTilesX;
+	const int tileX = tileIndex - tileY * context.numTilesX;
+	const int xStart = tileX * config.tileWidth;
+	const int xEnd = min(xStart + config.tileWidth, config.width);
+	const int yStart = tileY * config.tileHeight;
+	const int yEnd = min(yStart + config.tileHeight, config.height);
+
+	const int width = xEnd - xStart;
+	const int height = yEnd - yStart;
+
+	// The tile is accumulated in the thread's scratch arena, and written to the image in one go at the end
+	ScratchArena& scratch = GetThreadScratchArena();
+	scratch.Reserve(config.scratchArenaSize);
+
+	Vector3* colors = scratch.Allocate<Vector3>(width * height);
+
+	const TileCull* cull = nullptr;
+	if (config.tileCulling)
+	{
+		const float invWidth = context.image.GetInvWidth();
+		const float invHeight = context.image.GetInvHeight();
+		cull = context.tracer.CullTile(context.camera.GetTileFrustum(xStart * invWidth, yStart * invHeight, xEnd * invWidth, yEnd * invHeight), scratch);
+	}
+
+	size_t numRays = 0;
+	if (config.rayBatches)
+	{
+		numRays = RenderBatchedTile(context, cull, xStart, yStart, width, height, colors);
+	}
+	else if (context.fullTileFunc && width == config.tileWidth && height == config.tileHeight)
+	{
+		numRays = context.fullTileFunc(context, cull, xStart, yStart, colors);
+	}
+	else
+	{
+		for (int j = height - 1; j >= 0; --j)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				colors[j * width + i] = RenderSinglePixel(context, cull, xStart + i, yStart + j, numRays);
+			}
+		}
+	}
+
+	for (int j = 0; j < height; ++j)
+	{
+		for (int i = 0; i < width; ++i)
+		{
+			context.image.SetPixel(xStart + i, yStart + j, colors[j * width + i]);
+		}
+	}
+
+	// Only the thread that raised the high water mark touches the shared value
+	const size_t used = scratch.GetUsed();
+	size_t highWaterMark = context.scratchHighWaterMark.load(memory_order_relaxed);
+	while (used > highWaterMark && !context.scratchHighWaterMark.compare_exchange_weak(highWaterMark, used, memory_order_relaxed))
+	{
+	}
+	scratch.Reset();
+
+	return numRays;
+}
+
+
+// Each node takes tiles from its own contiguous band first, so the framebuffer pages of that band are first
+// touched, and placed, on the node.  Workers that run out of tiles move on to the other nodes' bands.
+template <typename TileFunc>
+void RenderTilesOnPool(WorkerPool& pool, int numTiles, const TileFunc& renderTile)
+{
+	const int numNodes = pool.GetNumNodes();
+
+	// One counter per cache line
+	struct alignas(64) Band
+	{
+		atomic_int	next;
+		int			end;
+	};
+
+	vector<Band, aligned_allocator<Band, 64>> bands(numNodes);
+	for (int node = 0; node < numNodes; ++node)
+	{
+		bands[node].next = static_cast<int>(static_cast<int64_t>(numTiles) * node / numNodes);
+		bands[node].end = static_cast<int>(static_cast<int64_t>(numTiles) * (node + 1) / numNodes);
+	}
+
+	pool.Run([&](int threadIndex)
+	{
+		const int homeNode = pool.GetThreadNode(threadIndex);
+		for (int i = 0; i < numNodes; ++i)
+		{
+			Band& band = bands[(homeNode + i) % numNodes];
+			for (int tileIndex = band.next++; tileIndex < band.end; tileIndex = band.next++)
+			{
+				renderTile(tileIndex);
+			}
+		}
+	});
+}
+
+} // anonymous namespace
+
+
+RenderStats RenderImage(const ITracer& tracer, const MaterialSet& materials, const Camera& camera, const RenderConfig& config, Image& image, const RenderAovs* aovs)
+{
+	PROFILE_ZONE("RenderImage");
+
+	assert(image.GetWidth() == config.width && image.GetHeight() == config.height);
+
+	const int numTilesX = (config.width + config.tileWidth - 1) / config.tileWidth;
+	const int numTilesY = (config.height + config.tileHeight - 1) / config.tileHeight;
+	const int numTiles = numTilesX * numTilesY;
+
+	atomic_size_t scratchHighWaterMark{ 0 };
+
+	RenderContext context{ tracer, materials, camera, config, image, aovs, numTilesX, GetFullTileFunc(config.tileWidth, config.tileHeight), scratchHighWaterMark };
+
+	// Each tile adds its ray count once, instead of every ray touching a shared counter
+	atomic_size_t totalRays{ 0 };
+
+	// Per-thread ray counts and hardware counters, only gathered when requested
+	combinable<ThreadRenderStats> threadStats;
+
+	auto renderTile = [&](int tileIndex)
+	{
+		if (!config.perfCounters)
+		{
+			totalRays += RenderTile(context, tileIndex);
+			return;
+		}
+
+		const ThreadPerfCounters& counters = GetThreadPerfCounters();
+		const PerfCounts start = counters.Read();
+		const size_t numRays = RenderTile(context, tileIndex);
+		totalRays += numRays;
+
+		ThreadRenderStats& local = threadStats.local();
+		local.rays += numRays;
+		local.counters += counters.Read() - start;
+	};
+
+	const bool countNodeFetches = config.perfCounters && config.countNodeFetches;
+	if (countNodeFetches)
+	{
+		EnableNodeFetchCounting(true);
+	}
+
+	Timer timer;
+	timer.Start();
+
+	if (config.pool)
+	{
+		RenderTilesOnPool(*config.pool, numTiles, renderTile);
+	}
+	else if (config.numThreads == 1)
+	{
+		for (int tileIndex = 0; tileIndex < numTiles; ++tileIndex)
+		{
+			renderTile(tileIndex);
+		}
+	}
+	else
+	{
+		// A dedicated scheduler caps the number of worker threads, for thread scaling measurements
+		Scheduler* scheduler = nullptr;
+		if (config.numThreads > 1)
+		{
+			SchedulerPolicy policy(2, MinConcurrency, config.numThreads, MaxConcurrency, config.numThreads);
+			scheduler = Scheduler::Create(policy);
+			scheduler->Attach();
+		}
+
+		parallel_for(0, numTiles, renderTile);
+
+		if (scheduler)
+		{
+			CurrentScheduler::Detach();
+			scheduler->Release();
+		}
+	}
+
+	timer.Stop();
+
+	if (countNodeFetches)
+	{
+		EnableNodeFetchCounting(false);
+	}
+
+	RenderStats stats;
+	stats.seconds = timer.GetElapsedSeconds();
+	stats.primaryRays = static_cast<size_t>(config.width) * config.height * config.samples;
+	stats.totalRays = totalRays;
+	stats.scratchHighWaterMark = scratchHighWaterMark;
+
+	threadStats.combine_each([&](const ThreadRenderStats& thread)
+	{
+		stats.threads.push_back(thread);
+		stats.counters += thread.counters;
+	});
+
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "PerfCounters.h"
+
+
+// Forward declarations
+class Camera;
+class Image;
+class ITracer;
+class MaterialSet;
+class WorkerPool;
+
+
+struct RenderConfig
+{
+	int			width{ 1280 };
+	int			height{ 720 };
+	int			samples{ 16 };
+	int			maxDepth{ 50 };
+	int			tileWidth{ 8 };
+	int			tileHeight{ 8 };
+
+	// 0 uses every hardware thread, 1 renders serially on the calling thread.  When a worker pool is given, its
+	// workers render instead, and each NUMA node of the pool renders (and first touches) its own band of tiles
+	// before helping the other nodes.
+	int			numThreads{ 0 };
+	WorkerPool*	pool{ nullptr };
+	bool		recursive{ false };
+
+	// Traces each tile one sample per pixel at a time: the camera rays of all its pixels as one coherent batch,
+	// then the paths still bouncing as one incoherent batch per bounce, through ITracer::IntersectBatch.  Renders
+	// the same image as the iterative path tracer, and ignores recursive.
+	bool		rayBatches{ false };
+
+	// Culls the spheres of each tile to the frustum of its camera rays before tracing them, see ITracer::CullTile.
+	// Only the camera rays see the culled spheres; the image is the same either way.
+	bool		tileCulling{ false };
+
+	// Every pixel draws its samples from its own sequence derived from this seed, so the same configuration
+	// always renders the same image, whatever the thread count
+	uint32_t	seed{ 1 };
+
+	// Reads the hardware counters of each worker thread around every tile, see RenderStats
+	bool		perfCounters{ false };
+
+	// Also counts the BVH node lines and pages traversal reads, see CountNodeFetch.  Only with perfCounters.
+	// Counting slows traversal down, so time the same render without it.
+	bool		countNodeFetches{ false };
+
+	// Pre-sizes the scratch arena of every worker thread, e.g. to RenderStats::scratchHighWaterMark of an earlier
+	// run.  0 keeps the default size, and the arenas grow as needed either way.
+	size_t		scratchArenaSize{ 0 };
+
+	float GetAspect() const { return static_cast<float>(width) / static_cast<float>(height); }
+};
+
+
+// Optional per-pixel cost images (AOVs), each the size of the render.  Every pixel stores its value in all three
+// channels; save them with Image::SaveAsPFM.
+struct RenderAovs
+{
+	Image*	cycles{ nullptr };	// rdtsc ticks spent on the pixel
+	Image*	rays{ nullptr };	// Rays traced for the pixel, over all samples
+	Image*	depth{ nullptr };	// Average number of bounces per sample
+};
+
+
+struct ThreadRenderStats
+{
+	size_t		rays{ 0 };
+	PerfCounts	counters;
+};
+
+
+struct RenderStats
+{
+	double	seconds{ 0.0 };
+	size_t	primaryRays{ 0 };
+	size_t	totalRays{ 0 };
+
+	// Most per-tile scratch arena memory any thread used for one tile
+	size_t	scratchHighWaterMark{ 0 };
+
+	// Only with RenderConfig::perfCounters.  Counters are summed over the threads, and have no valid counters
+	// where the platform provides none.
+	PerfCounts						counters;
+	std::vector<ThreadRenderStats>	threads;
+};
+
+
+// Path traces the image in tiles through any tracer backend, storing linear color.  The hit ids index the
+// material set.  Any AOV images that are given are filled in alongside.
+RenderStats RenderImage(const ITracer& tracer, const MaterialSet& materials, const Camera& camera, const RenderConfig& config, Image& image, const RenderAovs* aovs = nullptr);
\ No newline at end of file
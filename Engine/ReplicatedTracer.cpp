@@ -0,0 +1,73 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "ReplicatedTracer.h"
+
+#include "Profiler.h"
+#include "WorkerPool.h"
+
+
+using namespace std;
+
+
+ReplicatedTracer::ReplicatedTracer(WorkerPool& pool, const Factory& factory)
+	: m_pool(pool)
+{
+	for (int node = 0; node < pool.GetNumNodes(); ++node)
+	{
+		m_replicas.push_back(factory());
+	}
+}
+
+
+void ReplicatedTracer::Build(const SceneDesc& desc)
+{
+	PROFILE_ZONE("ReplicatedTracer::Build");
+
+	m_pool.RunOnNodes([&](int node)
+	{
+		m_replicas[node]->Build(desc);
+	});
+}
+
+
+void ReplicatedTracer::Intersect1(Ray& ray, Hit& hit) const
+{
+	m_replicas[WorkerPool::GetCurrentNode()]->Intersect1(ray, hit);
+}
+
+
+void ReplicatedTracer::IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const
+{
+	m_replicas[WorkerPool::GetCurrentNode()]->IntersectBatch(rays, hits, count, coherent);
+}
+
+
+const TileCull* ReplicatedTracer::CullTile(const TileFrustum& frustum, ScratchArena& scratch) const
+{
+	return m_replicas[WorkerPool::GetCurrentNode()]->CullTile(frustum, scratch);
+}
+
+
+void ReplicatedTracer::IntersectCulled(const TileCull& cull, Ray& ray, Hit& hit) const
+{
+	m_replicas[WorkerPool::GetCurrentNode()]->IntersectCulled(cull, ray, hit);
+}
+
+
+size_t ReplicatedTracer::GetMemoryUsage() const
+{
+	size_t memoryUsage = 0;
+	for (const auto& replica : m_replicas)
+	{
+		memoryUsage += replica->GetMemoryUsage();
+	}
+	return memoryUsage;
+}
\ No newline at end of file
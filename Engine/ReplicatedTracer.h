@@ -0,0 +1,49 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "ITracer.h"
+
+#include <functional>
+
+
+// Forward declarations
+class WorkerPool;
+
+
+// One replica of a tracer per NUMA node of a worker pool.  Each replica is built by a worker on its node, so its
+// acceleration data is first touched, and placed, there.  The data is read-only after the build, so Intersect1
+// simply uses the replica of the calling worker's node, as does IntersectBatch.
+class ReplicatedTracer : public ITracer
+{
+public:
+	using Factory = std::function<std::unique_ptr<ITracer>()>;
+
+	ReplicatedTracer(WorkerPool& pool, const Factory& factory);
+
+	const char* GetName() const final { return m_replicas[0]->GetName(); }
+
+	void Build(const SceneDesc& desc) final;
+
+	void Intersect1(Ray& ray, Hit& hit) const final;
+	void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const final;
+
+	// A tile's culled set comes from the replica of the worker's node, which also traces against it
+	const TileCull* CullTile(const TileFrustum& frustum, ScratchArena& scratch) const final;
+	void IntersectCulled(const TileCull& cull, Ray& ray, Hit& hit) const final;
+
+	// Summed over the replicas
+	size_t GetMemoryUsage() const final;
+
+	int GetNumReplicas() const { return static_cast<int>(m_replicas.size()); }
+
+private:
+	WorkerPool&								m_pool;
+	std::vector<std::unique_ptr<ITracer>>	m_replicas;
+};
\ No newline at end of file
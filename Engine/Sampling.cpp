@@ -19,6 +19,21 @@ static uint32_t XorShift32(uint32_t& state)
 }
 
 
+uint32_t PixelSeed(uint32_t seed, int i, int j)
+{
+	// Murmur3 finalizer over the seed and pixel coordinates
+	uint32_t h = seed ^ (static_cast<uint32_t>(i) * 0x9E3779B1u) ^ (static_cast<uint32_t>(j) * 0x85EBCA77u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+
+	// XorShift32 gets stuck on zero
+	return h ? h : 1u;
+}
+
+
 float UniformFloat01(uint32_t& state)
 {
 	return (XorShift32(state) & 0xFFFFFF) / 16777216.0f;
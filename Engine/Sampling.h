@@ -1,5 +1,9 @@
 #pragma once
 
+// Starting state for the samples of pixel (i, j).  It only depends on the seed and the pixel, so a render
+// is identical no matter how it is split into tiles or threads.
+uint32_t PixelSeed(uint32_t seed, int i, int j);
+
 float UniformFloat01(uint32_t& state);
 Math::Vector3 UniformUnitSphere3d(uint32_t& state);
 Math::Vector3 UniformUnitDisk(uint32_t& state);
\ No newline at end of file
@@ -10,14 +10,46 @@
 
 #include "Scene.h"
 
+#include "Arena.h"
+#include "BakedFile.h"
+#include "BoxAccel.h"
+#include "ConeAccel.h"
+#include "DiskAccel.h"
+#include "EmbreeAccel.h"
+#include "GridAccel.h"
+#include "Hash.h"
+#include "InstanceAccel.h"
+#include "KdTreeAccel.h"
+#include "LinearSphereAccel.h"
+#include "MaterialSet.h"
+#include "PlaneAccel.h"
+#include "Profiler.h"
+#include "QuadAccel.h"
 #include "Ray.h"
+#include "SortedSphereAccel.h"
 #include "SphereAccel.h"
+#include "TileFrustum.h"
+#include "TriangleAccel.h"
 
 
 using namespace std;
 using namespace Math;
 
 
+// The spheres of the one accelerator that culled them to a tile, and the accelerator they replace
+struct TileCull
+{
+	SphereList			spheres;
+	const IAccelerator*	source;
+};
+
+
+Scene::Scene() = default;
+
+
+Scene::~Scene() = default;
+
+
 void Scene::Intersect1(Ray& ray, Hit& hit) const
 {
 	for (auto& p : m_accelList)
@@ -27,12 +59,65 @@ void Scene::Intersect1(Ray& ray, Hit& hit) const
 }
 
 
+void Scene::IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const
+{
+	for (auto& p : m_accelList)
+	{
+		p->IntersectBatch(rays, hits, count, coherent);
+	}
+}
+
+
+const TileCull* Scene::CullTile(const TileFrustum& frustum, ScratchArena& scratch) const
+{
+	for (auto& p : m_accelList)
+	{
+		SphereList spheres;
+		if (p->CullTile(frustum, scratch, spheres))
+		{
+			return new (scratch.Allocate<TileCull>(1)) TileCull{ spheres, p.get() };
+		}
+	}
+	return nullptr;
+}
+
+
+void Scene::IntersectCulled(const TileCull& cull, Ray& ray, Hit& hit) const
+{
+	for (auto& p : m_accelList)
+	{
+		if (p.get() == cull.source)
+		{
+			IntersectSphereList(cull.spheres, GetSimdSize(), ray, hit);
+		}
+		else
+		{
+			p->Intersect1(ray, hit);
+		}
+	}
+}
+
+
 void Scene::Commit()
 {
+	PROFILE_ZONE("Scene::Commit");
+
 	for (auto& p : m_accelList)
 	{
 		p->Commit();
 	}
+
+	// Nothing to move when the arena already holds the built state of the current input
+	if (m_memory != SceneMemory::Heap && !(m_arena && m_mappedFile->GetContentHash() == GetContentHash()))
+	{
+		MoveToArena();
+	}
+}
+
+
+bool Scene::HasLargePages() const
+{
+	return m_arena && m_arena->HasLargePages();
 }
 
 
@@ -49,30 +134,303 @@ int Scene::GetSimdSize() const
 }
 
 
+bool Scene::IsBackendAvailable(SceneBackend backend)
+{
+#if USE_EMBREE
+	return true;
+#else
+	return backend != SceneBackend::Embree;
+#endif
+}
+
+
+BvhBounds Scene::GetBounds() const
+{
+	BvhBounds bounds;
+	for (auto& p : m_accelList)
+	{
+		bounds.Grow(p->GetBounds());
+	}
+	return bounds;
+}
+
+
+size_t Scene::GetMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (auto& p : m_accelList)
+	{
+		bytes += p->GetMemoryUsage();
+	}
+	return bytes;
+}
+
+
 void Scene::AddSphere(const Vector3& center, float radius, uint32_t id)
 {
-	GetSphereAccelerator()->AddSphere(center, radius, id);
+#if USE_EMBREE
+	if (m_backend == SceneBackend::Embree)
+	{
+		GetAccelerator<EmbreeAccelerator>(PrimitiveType::Embree)->AddSphere(center, radius, id);
+		return;
+	}
+#endif
+
+	if (m_backend == SceneBackend::Grid)
+	{
+		GetAccelerator<GridAccelerator>(PrimitiveType::SphereGrid)->AddSphere(center, radius, id);
+		return;
+	}
+	else if (m_backend == SceneBackend::KdTree)
+	{
+		GetAccelerator<KdTreeAccelerator>(PrimitiveType::SphereKdTree)->AddSphere(center, radius, id);
+		return;
+	}
+	else if (m_backend == SceneBackend::Sorted)
+	{
+		GetAccelerator<SortedSphereAccelerator>(PrimitiveType::SphereSorted)->AddSphere(center, radius, id);
+		return;
+	}
+	else if (m_backend == SceneBackend::Linear)
+	{
+		GetAccelerator<LinearSphereAccelerator>(PrimitiveType::SphereLinear)->AddSphere(center, radius, id);
+		return;
+	}
+
+	GetAccelerator<SphereAccelerator>(PrimitiveType::Sphere)->AddSphere(center, radius, id);
+}
+
+
+void Scene::AddCone(const Vector3& center, float radius, float height, uint32_t id)
+{
+	GetAccelerator<ConeAccelerator>(PrimitiveType::Cone)->AddCone(center, radius, height, id);
+}
+
+
+void Scene::AddPlane(const Vector3& normal, float distance, uint32_t id)
+{
+	GetAccelerator<PlaneAccelerator>(PrimitiveType::Plane)->AddPlane(normal, distance, id);
+}
+
+
+void Scene::AddBox(const Vector3& minCorner, const Vector3& maxCorner, uint32_t id)
+{
+	GetAccelerator<BoxAccelerator>(PrimitiveType::Box)->AddBox(minCorner, maxCorner, id);
+}
+
+
+void Scene::AddDisk(const Vector3& center, const Vector3& normal, float radius, uint32_t id)
+{
+	GetAccelerator<DiskAccelerator>(PrimitiveType::Disk)->AddDisk(center, normal, radius, id);
+}
+
+
+void Scene::AddQuad(const Vector3& corner, const Vector3& edgeU, const Vector3& edgeV, uint32_t id)
+{
+	GetAccelerator<QuadAccelerator>(PrimitiveType::Quad)->AddQuad(corner, edgeU, edgeV, id);
+}
+
+
+void Scene::AddMesh(const TriangleMesh& mesh, uint32_t baseId)
+{
+	GetTriangleAccelerator()->AddMesh(mesh, baseId);
+}
+
+
+void Scene::AddInstance(Scene* object, const AffineTransform& objectToWorld)
+{
+	assert(object != this);
+
+	GetAccelerator<InstanceAccelerator>(PrimitiveType::Instance)->AddInstance(object, objectToWorld);
+}
+
+
+bool Scene::SaveBaked(const char* filename, const MaterialSet& materials, const char* sourceFilename) const
+{
+	TriangleAccelerator* accel = FindTriangleAccelerator();
+	if (!accel)
+	{
+		return false;
+	}
+
+	BakedFileWriter writer(static_cast<uint32_t>(GetSimdSize()), accel->GetContentHash());
+	if (sourceFilename && !writer.SetSource(sourceFilename))
+	{
+		return false;
+	}
+	accel->SaveAccel(writer);
+	materials.SaveBaked(writer, accel->GetIdBase(), accel->GetIdCount());
+	return writer.Write(filename);
+}
+
+
+bool Scene::LoadBaked(const char* filename, MaterialSet& materials, const char* sourceFilename)
+{
+	auto bakedFile = make_unique<BakedFileReader>();
+	if (!bakedFile->Open(filename) || (sourceFilename && !bakedFile->MatchesSource(sourceFilename)))
+	{
+		return false;
+	}
+
+	MaterialSet bakedMaterials;
+	if (!bakedMaterials.LoadBaked(*bakedFile) || !TriangleAccelerator::AreBakedIdsValid(*bakedFile, bakedMaterials.GetNumMaterials()))
+	{
+		return false;
+	}
+
+	TriangleAccelerator* accel = GetTriangleAccelerator();
+	if (!accel->LoadAccel(*bakedFile))
+	{
+		return false;
+	}
+
+	accel->SetIdBase(static_cast<uint32_t>(materials.GetNumMaterials()));
+	materials.Append(bakedMaterials);
+
+	m_mappedFile = move(bakedFile);
+	return true;
+}
+
+
+bool Scene::SaveAccel(const char* filename) const
+{
+	BakedFileWriter writer(static_cast<uint32_t>(GetSimdSize()), GetContentHash());
+	for (auto& p : m_accelList)
+	{
+		p->SaveAccel(writer);
+	}
+	return writer.Write(filename);
+}
+
+
+bool Scene::LoadAccel(const char* filename)
+{
+	PROFILE_ZONE("Scene::LoadAccel");
+
+	auto accelFile = make_unique<BakedFileReader>();
+	if (!accelFile->Open(filename) || accelFile->GetContentHash() != GetContentHash())
+	{
+		return false;
+	}
+
+	return AttachAccel(move(accelFile));
+}
+
+
+uint64_t Scene::GetContentHash() const
+{
+	uint64_t hash = HASH_SEED;
+	for (auto& p : m_accelList)
+	{
+		hash = HashCombine(hash, static_cast<uint64_t>(p->GetPrimitiveType()));
+		hash = HashCombine(hash, p->GetContentHash());
+	}
+	return hash;
 }
 
 
-SphereAccelerator* Scene::GetSphereAccelerator()
+template <typename T>
+T* Scene::GetAccelerator(PrimitiveType type)
 {
-	SphereAccelerator* accel = nullptr;
+	T* accel = nullptr;
 	for (auto& p : m_accelList)
 	{
-		if (p->GetPrimitiveType() == PrimitiveType::Sphere)
+		if (p->GetPrimitiveType() == type)
 		{
-			accel = (SphereAccelerator*)p.get();
+			accel = (T*)p.get();
 			break;
 		}
 	}
 
 	if (!accel)
 	{
-		auto newAccel = make_unique<SphereAccelerator>(this);
+		auto newAccel = make_unique<T>(this);
 		accel = newAccel.get();
 		m_accelList.emplace_back(move(newAccel));
 	}
 
 	return accel;
+}
+
+
+TriangleAccelerator* Scene::GetTriangleAccelerator()
+{
+	TriangleAccelerator* accel = FindTriangleAccelerator();
+
+	if (!accel)
+	{
+		auto newAccel = make_unique<TriangleAccelerator>(this);
+		accel = newAccel.get();
+		m_accelList.emplace_back(move(newAccel));
+	}
+
+	return accel;
+}
+
+
+bool Scene::AttachAccel(unique_ptr<BakedFileReader> file)
+{
+	for (auto& p : m_accelList)
+	{
+		if (!p->LoadAccel(*file))
+		{
+			// Don't leave any accelerator pointing into the file
+			for (auto& q : m_accelList)
+			{
+				q->UnloadAccel();
+			}
+			return false;
+		}
+	}
+
+	m_mappedFile = move(file);
+	m_arena.reset();
+	return true;
+}
+
+
+void Scene::MoveToArena()
+{
+	PROFILE_ZONE("Scene::MoveToArena");
+
+	// The arena holds the same image SaveAccel() writes to disk, so the accelerators attach to it exactly like
+	// they attach to a mapped accelerator cache.  Their owned copies are freed as they do.
+	BakedFileWriter writer(static_cast<uint32_t>(GetSimdSize()), GetContentHash());
+	for (auto& p : m_accelList)
+	{
+		p->SaveAccel(writer);
+	}
+
+	const size_t size = writer.GetSize();
+	const size_t alignment = writer.GetAlignment();
+	auto arena = make_unique<MemoryArena>(size, m_memory == SceneMemory::LargePageArena ? ArenaPages::Large : ArenaPages::Small, alignment);
+	uint8_t* data = static_cast<uint8_t*>(arena->Allocate(size, alignment));
+	writer.WriteTo(data);
+
+	// Attaching replaces the previous arena or mapped file, which the writer may have read from, so it comes last
+	auto file = make_unique<BakedFileReader>();
+	if (!file->Open(data, size) || !AttachAccel(move(file)))
+	{
+		// Every accelerator was unloaded, so rebuild on the heap
+		for (auto& p : m_accelList)
+		{
+			p->Commit();
+		}
+		return;
+	}
+
+	m_arena = move(arena);
+}
+
+
+TriangleAccelerator* Scene::FindTriangleAccelerator() const
+{
+	for (auto& p : m_accelList)
+	{
+		if (p->GetPrimitiveType() == PrimitiveType::Triangle)
+		{
+			return (TriangleAccelerator*)p.get();
+		}
+	}
+	return nullptr;
 }
\ No newline at end of file
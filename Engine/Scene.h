@@ -8,28 +8,152 @@
 
 #pragma once
 
+#include "Enums.h"
 #include "IAccelerator.h"
 
 
 // Forward declarations
-class SphereAccelerator;
+class BakedFileReader;
+class MaterialSet;
+class MemoryArena;
+class ScratchArena;
+class TriangleAccelerator;
+struct TileCull;
+struct TileFrustum;
+struct TriangleMesh;
+
+
+// Where Commit() leaves the built acceleration data
+enum class SceneMemory
+{
+	Heap,			// One aligned heap allocation per accelerator array
+	Arena,			// Every array packed into one cache line aligned arena
+	LargePageArena	// Same, on 2 MB pages where the OS grants them
+};
+
+
+// Which acceleration structures trace the scene's spheres
+enum class SceneBackend
+{
+	Native,		// The engine's own BVHs
+	Grid,		// A uniform grid, for many similar-sized spheres spread evenly through the scene
+	KdTree,		// A SAH kd-tree, for static scenes where traversal speed matters more than build time
+	Sorted,		// Morton-sorted blocks with bounding boxes and no hierarchy, for mid-size scenes
+	Linear,		// No acceleration structure, every ray tests every sphere: the baseline for the others
+	Embree		// An Embree scene, when the engine is built with USE_EMBREE
+};
 
 
 class Scene
 {
 public:
-	
+	Scene();
+	~Scene();
+
 	void Intersect1(Ray& ray, Hit& hit) const;
+	void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const;
+
+	// Primary ray culling, see ITracer::CullTile.  The spheres are culled to the frustum when their accelerator
+	// supports it; every other primitive is traced as usual.
+	const TileCull* CullTile(const TileFrustum& frustum, ScratchArena& scratch) const;
+	void IntersectCulled(const TileCull& cull, Ray& ray, Hit& hit) const;
+
 	void Commit();
+
+	// Applies to spheres added afterwards.  Only spheres move to the grid, kd-tree, sorted blocks, linear list or
+	// Embree; every other primitive type keeps its native accelerator, and both are traced together.
+	void SetBackend(SceneBackend backend) { m_backend = backend; }
+	SceneBackend GetBackend() const { return m_backend; }
+	static bool IsBackendAvailable(SceneBackend backend);
+
+	// Takes effect on the next Commit().  The arenas pack the BVH nodes and primitive arrays of every accelerator
+	// into one contiguous region, so traversal touches fewer pages (and, on large pages, far fewer TLB entries)
+	// than with separate heap allocations.  Instanced object scenes have their own setting.
+	void SetMemory(SceneMemory memory) { m_memory = memory; }
+	SceneMemory GetMemory() const { return m_memory; }
+
+	// Layout of the native sphere BVH's leaf data, used when the spheres are next built.  The grid and kd-tree
+	// backends always use SoA.
+	void SetSphereLayout(SphereLayout layout) { m_sphereLayout = layout; }
+	SphereLayout GetSphereLayout() const { return m_sphereLayout; }
+
+	// Node format of the native sphere BVH, used when the spheres are next built.  Quantized nodes take about half
+	// the memory of full precision ones, for scenes where node fetches are the bottleneck.
+	void SetBvhNodeFormat(BvhNodeFormat format) { m_bvhNodeFormat = format; }
+	BvhNodeFormat GetBvhNodeFormat() const { return m_bvhNodeFormat; }
+
+	// Whether the committed data actually sits on large pages
+	bool HasLargePages() const;
 	
 	int GetSimdSize() const;
 
+	// World space bounds of the committed scene
+	BvhBounds GetBounds() const;
+
+	// Bytes of acceleration data in the committed scene, not counting instanced object scenes
+	size_t GetMemoryUsage() const;
+
 	// Spheres
 	void AddSphere(const Math::Vector3& center, float radius, uint32_t id);
+
+	// Cones, with the base disk centered on center and the apex at center + (0, height, 0)
+	void AddCone(const Math::Vector3& center, float radius, float height, uint32_t id);
+
+	// Infinite planes, the points p with dot(normal, p) == distance
+	void AddPlane(const Math::Vector3& normal, float distance, uint32_t id);
+
+	// Axis-aligned boxes
+	void AddBox(const Math::Vector3& minCorner, const Math::Vector3& maxCorner, uint32_t id);
+
+	// Disks, facing along normal
+	void AddDisk(const Math::Vector3& center, const Math::Vector3& normal, float radius, uint32_t id);
+
+	// Quads (parallelograms) spanned by two edges from a corner, facing along cross(edgeU, edgeV)
+	void AddQuad(const Math::Vector3& corner, const Math::Vector3& edgeU, const Math::Vector3& edgeV, uint32_t id);
+
+	// Triangle meshes
+	void AddMesh(const TriangleMesh& mesh, uint32_t baseId);
+
+	// Instances of another scene, which keeps its own primitive ids.  The object scene is committed along with
+	// this one, must outlive it, and may be instanced any number of times.  Object scenes need finite bounds,
+	// so they cannot contain planes.
+	void AddInstance(Scene* object, const Math::AffineTransform& objectToWorld);
+
+	// Baked triangle data.  SaveBaked requires a committed scene, and also writes the materials the triangles use.
+	// LoadBaked maps the file and uses it in place, so no Commit() is needed for the baked triangles afterwards,
+	// and appends the baked materials to materials, pointing the triangle ids at them.  When given the mesh file
+	// the data was imported from, SaveBaked records its path, size and modification time, and LoadBaked fails if
+	// any of them differ, so a changed mesh is imported again.
+	bool SaveBaked(const char* filename, const MaterialSet& materials, const char* sourceFilename = nullptr) const;
+	bool LoadBaked(const char* filename, MaterialSet& materials, const char* sourceFilename = nullptr);
+
+	// Acceleration structure cache.  SaveAccel writes the built state of every accelerator in a committed scene,
+	// keyed by a hash of the input primitives.  LoadAccel maps a cache written for identical input, replacing
+	// Commit(); it fails (leaving the scene to be committed as usual) on a hash mismatch or unusable file.
+	bool SaveAccel(const char* filename) const;
+	bool LoadAccel(const char* filename);
+	uint64_t GetContentHash() const;
 	
 private:
-	SphereAccelerator * GetSphereAccelerator();
+	// Finds or creates the accelerator for one primitive type
+	template <typename T>
+	T* GetAccelerator(PrimitiveType type);
+
+	TriangleAccelerator* GetTriangleAccelerator();
+	TriangleAccelerator* FindTriangleAccelerator() const;
+
+	// Points every accelerator at the built state in file, which becomes the scene's mapped file
+	bool AttachAccel(std::unique_ptr<BakedFileReader> file);
+
+	// Copies the built state of every accelerator into a new arena and attaches it
+	void MoveToArena();
 
 private:
 	std::vector<std::unique_ptr<IAccelerator>> m_accelList;
+	std::unique_ptr<BakedFileReader> m_mappedFile;
+	std::unique_ptr<MemoryArena> m_arena;
+	SceneMemory m_memory{ SceneMemory::Heap };
+	SceneBackend m_backend{ SceneBackend::Native };
+	SphereLayout m_sphereLayout{ SphereLayout::SoA };
+	BvhNodeFormat m_bvhNodeFormat{ BvhNodeFormat::Full };
 };
\ No newline at end of file
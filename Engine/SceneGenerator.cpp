@@ -0,0 +1,95 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "SceneGenerator.h"
+
+#include "Profiler.h"
+#include "Scene.h"
+#include "Math\Random.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+void GenerateRandomScene(uint32_t seed, int gridSize, SceneDesc& desc)
+{
+	PROFILE_ZONE("GenerateRandomScene");
+
+	RandomNumberGenerator rng;
+	rng.SetSeed(seed);
+
+	desc.spheres.clear();
+	desc.materials = MaterialSet();
+	desc.materials.Reserve(4 * gridSize * gridSize + 4);
+	desc.spheres.reserve(4 * gridSize * gridSize + 3);
+
+	desc.groundNormal = Vector3(0.0f, 1.0f, 0.0f);
+	desc.groundDistance = 0.0f;
+	desc.materials.AddLambertian(Vector3(0.5f, 0.5f, 0.5f));
+
+	for (int a = -gridSize; a < gridSize; ++a)
+	{
+		for (int b = -gridSize; b < gridSize; ++b)
+		{
+			float radius = 0.2f + rng.NextFloat(-0.1f, 0.1f);
+			Vector3 center(a + 0.9f * rng.NextFloat(), radius, b + 0.9f * rng.NextFloat());
+
+			if (Length(center - Vector3(4.0f, 0.2f, 0.0f)) > 0.9f)
+			{
+				float chooseMat = rng.NextFloat();
+
+				if (chooseMat < 0.8f) // Lambertian
+				{
+					desc.materials.AddLambertian(Vector3(rng.NextFloat() * rng.NextFloat(), rng.NextFloat() * rng.NextFloat(), rng.NextFloat() * rng.NextFloat()));
+				}
+				else if (chooseMat < 0.95f) // Metal
+				{
+					desc.materials.AddMetallic(Vector3(0.5f * (1.0f + rng.NextFloat()), 0.5f * (1.0f + rng.NextFloat()), 0.5f * (1.0f + rng.NextFloat())), 0.5f * rng.NextFloat());
+				}
+				else // Dielectric
+				{
+					desc.materials.AddDielectric(1.5f);
+				}
+
+				desc.spheres.push_back(SceneSphere{ center, radius });
+			}
+		}
+	}
+
+	desc.spheres.push_back(SceneSphere{ Vector3(0.0f, 1.0f, 0.0f), 1.0f });
+	desc.materials.AddDielectric(1.5f);
+
+	desc.spheres.push_back(SceneSphere{ Vector3(-4.0f, 1.0f, 0.0f), 1.0f });
+	desc.materials.AddLambertian(Vector3(0.4f, 0.2f, 0.1f));
+
+	desc.spheres.push_back(SceneSphere{ Vector3(4.0f, 1.0f, 0.0f), 1.0f });
+	desc.materials.AddMetallic(Vector3(0.7f, 0.6f, 0.5f), 0.0f);
+
+	desc.cameraPos = Vector3(13.0f, 2.0f, 3.0f);
+	desc.cameraTarget = Vector3(0.0f, 0.0f, 0.0f);
+	desc.fovY = 20.0f;
+	desc.aperture = 0.1f;
+	desc.focusDist = 10.0f;
+}
+
+
+void AddToScene(const SceneDesc& desc, Scene& scene)
+{
+	PROFILE_ZONE("AddToScene");
+
+	uint32_t id = 0;
+	scene.AddPlane(desc.groundNormal, desc.groundDistance, id++);
+
+	for (const auto& sphere : desc.spheres)
+	{
+		scene.AddSphere(sphere.center, sphere.radius, id++);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "MaterialSet.h"
+
+
+// Forward declarations
+class Scene;
+
+
+struct SceneSphere
+{
+	Math::Vector3	center;
+	float			radius;
+};
+
+
+// Backend-neutral scene description, so that every front-end traces identical input.  Primitive ids are
+// material indices: the ground plane is id 0, and spheres[i] is id i + 1.
+struct SceneDesc
+{
+	// Ground plane, the points p with dot(groundNormal, p) == groundDistance
+	Math::Vector3				groundNormal;
+	float						groundDistance{ 0.0f };
+
+	std::vector<SceneSphere>	spheres;
+	MaterialSet					materials;
+
+	// Camera
+	Math::Vector3				cameraPos;
+	Math::Vector3				cameraTarget;
+	float						fovY{ 20.0f };
+	float						aperture{ 0.0f };
+	float						focusDist{ 1.0f };
+
+	size_t GetNumPrimitives() const { return spheres.size() + 1; }
+};
+
+
+// The cover scene of Ray Tracing in One Weekend: three large spheres in a (2 * gridSize)^2 grid of small random
+// spheres.  The same seed always generates the same scene.
+void GenerateRandomScene(uint32_t seed, int gridSize, SceneDesc& desc);
+
+// Adds the primitives of a scene description to a native scene
+void AddToScene(const SceneDesc& desc, Scene& scene);
\ No newline at end of file
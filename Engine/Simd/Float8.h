@@ -135,7 +135,7 @@ __forceinline Bool8 operator<(const Float8& a, const Float8& b) { return _mm256_
 __forceinline Bool8 operator>(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
 __forceinline Bool8 operator!=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
 __forceinline Bool8 operator<=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
-__forceinline Bool8 operator>=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+__forceinline Bool8 operator>=(const Float8& a, const Float8& b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
 
 __forceinline Bool8 operator==(const Float8& a, float b) { return a == Float8(b); }
 __forceinline Bool8 operator==(float a, const Float8& b) { return Float8(a) == b; }
@@ -0,0 +1,602 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "SortedSphereAccel.h"
+
+#include "Arena.h"
+#include "BakedFile.h"
+#include "Hash.h"
+#include "Scene.h"
+#include "TileFrustum.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr uint32_t TAG_SORTED_LAYOUT = MakeBakedTag('O', 'L', 'A', 'Y');
+constexpr uint32_t TAG_SORTED_IDS = MakeBakedTag('O', 'I', 'D', 'S');
+constexpr uint32_t TAG_SORTED_DATA[5] =
+{
+	MakeBakedTag('O', 'C', 'X', ' '),
+	MakeBakedTag('O', 'C', 'Y', ' '),
+	MakeBakedTag('O', 'C', 'Z', ' '),
+	MakeBakedTag('O', 'R', 'S', 'Q'),
+	MakeBakedTag('O', 'I', 'R', 'D')
+};
+constexpr uint32_t TAG_SORTED_BLOCK_BOUNDS[6] =
+{
+	MakeBakedTag('O', 'B', 'X', '0'),
+	MakeBakedTag('O', 'B', 'Y', '0'),
+	MakeBakedTag('O', 'B', 'Z', '0'),
+	MakeBakedTag('O', 'B', 'X', '1'),
+	MakeBakedTag('O', 'B', 'Y', '1'),
+	MakeBakedTag('O', 'B', 'Z', '1')
+};
+constexpr uint32_t TAG_SORTED_SUPER_BOUNDS[6] =
+{
+	MakeBakedTag('O', 'S', 'X', '0'),
+	MakeBakedTag('O', 'S', 'Y', '0'),
+	MakeBakedTag('O', 'S', 'Z', '0'),
+	MakeBakedTag('O', 'S', 'X', '1'),
+	MakeBakedTag('O', 'S', 'Y', '1'),
+	MakeBakedTag('O', 'S', 'Z', '1')
+};
+
+// Box arrays are padded so that a Float<8> load at any multiple of 8 boxes stays inside them
+constexpr size_t BOX_PADDING = 8;
+
+
+// Spreads the low 10 bits of value out to every third bit
+uint32_t ExpandBits(uint32_t value)
+{
+	value = (value * 0x00010001u) & 0xFF0000FFu;
+	value = (value * 0x00000101u) & 0x0F00F00Fu;
+	value = (value * 0x00000011u) & 0xC30C30C3u;
+	value = (value * 0x00000005u) & 0x49249249u;
+	return value;
+}
+
+
+uint32_t MortonCode(float x, float y, float z)
+{
+	auto quantize = [](float value) { return static_cast<uint32_t>(min(max(value * 1024.0f, 0.0f), 1023.0f)); };
+	return (ExpandBits(quantize(x)) << 2) | (ExpandBits(quantize(y)) << 1) | ExpandBits(quantize(z));
+}
+
+
+// The ray, broadcast for N box slab tests at a time
+template <int N>
+struct BoxRay
+{
+	Float<N>	posX;
+	Float<N>	posY;
+	Float<N>	posZ;
+	Float<N>	invDirX;
+	Float<N>	invDirY;
+	Float<N>	invDirZ;
+	Float<N>	tmin;
+
+	explicit BoxRay(const Ray& ray)
+		: posX(Float<N>::Broadcast(ray.posX))
+		, posY(Float<N>::Broadcast(ray.posY))
+		, posZ(Float<N>::Broadcast(ray.posZ))
+		, invDirX(Float<N>::Broadcast(1.0f / ray.dirX))
+		, invDirY(Float<N>::Broadcast(1.0f / ray.dirY))
+		, invDirZ(Float<N>::Broadcast(1.0f / ray.dirZ))
+		, tmin(Float<N>::Broadcast(ray.tmin))
+	{}
+};
+
+
+template <>
+struct BoxRay<1>
+{
+	float	posX;
+	float	posY;
+	float	posZ;
+	float	invDirX;
+	float	invDirY;
+	float	invDirZ;
+	float	tmin;
+
+	explicit BoxRay(const Ray& ray)
+		: posX(ray.posX)
+		, posY(ray.posY)
+		, posZ(ray.posZ)
+		, invDirX(1.0f / ray.dirX)
+		, invDirY(1.0f / ray.dirY)
+		, invDirZ(1.0f / ray.dirZ)
+		, tmin(ray.tmin)
+	{}
+};
+
+
+// Slab tests the boxes [first, first + N), returning a bit per box the ray enters before tmax
+template <int N>
+__forceinline uint32_t IntersectBoxes(const float* const* bounds, size_t first, const BoxRay<N>& ray, float tmax)
+{
+	Float<N> tx0 = (Float<N>::Load(bounds[0] + first) - ray.posX) * ray.invDirX;
+	Float<N> ty0 = (Float<N>::Load(bounds[1] + first) - ray.posY) * ray.invDirY;
+	Float<N> tz0 = (Float<N>::Load(bounds[2] + first) - ray.posZ) * ray.invDirZ;
+	Float<N> tx1 = (Float<N>::Load(bounds[3] + first) - ray.posX) * ray.invDirX;
+	Float<N> ty1 = (Float<N>::Load(bounds[4] + first) - ray.posY) * ray.invDirY;
+	Float<N> tz1 = (Float<N>::Load(bounds[5] + first) - ray.posZ) * ray.invDirZ;
+
+	Float<N> tNear = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Max(Min(tz0, tz1), ray.tmin));
+	Float<N> tFar = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Min(Max(tz0, tz1), Float<N>(tmax)));
+
+	return Mask(tNear <= tFar);
+}
+
+
+template <>
+__forceinline uint32_t IntersectBoxes<1>(const float* const* bounds, size_t first, const BoxRay<1>& ray, float tmax)
+{
+	float tx0 = (bounds[0][first] - ray.posX) * ray.invDirX;
+	float ty0 = (bounds[1][first] - ray.posY) * ray.invDirY;
+	float tz0 = (bounds[2][first] - ray.posZ) * ray.invDirZ;
+	float tx1 = (bounds[3][first] - ray.posX) * ray.invDirX;
+	float ty1 = (bounds[4][first] - ray.posY) * ray.invDirY;
+	float tz1 = (bounds[5][first] - ray.posZ) * ray.invDirZ;
+
+	float tNear = max(max(min(tx0, tx1), min(ty0, ty1)), max(min(tz0, tz1), ray.tmin));
+	float tFar = min(min(max(tx0, tx1), max(ty0, ty1)), min(max(tz0, tz1), tmax));
+
+	return (tNear <= tFar) ? 1 : 0;
+}
+
+
+// Bits for the boxes that exist out of the next N, when fewer than N remain
+template <int N>
+__forceinline uint32_t LaneMask(size_t remaining)
+{
+	return (remaining >= N) ? (1u << N) - 1 : (1u << remaining) - 1;
+}
+
+
+BvhBounds GetBox(const float* const (&bounds)[6], size_t index)
+{
+	return BvhBounds{ bounds[0][index], bounds[1][index], bounds[2][index], bounds[3][index], bounds[4][index], bounds[5][index] };
+}
+
+} // anonymous namespace
+
+
+SortedSphereAccelerator::SortedSphereAccelerator(Scene* scene)
+	: m_scene(scene)
+{}
+
+
+void SortedSphereAccelerator::AddSphere(const Vector3& center, float radius, uint32_t id)
+{
+	if (m_loaded)
+	{
+		UnloadAccel();
+	}
+
+	m_inputCenterX.push_back(center.GetX());
+	m_inputCenterY.push_back(center.GetY());
+	m_inputCenterZ.push_back(center.GetZ());
+	m_inputRadius.push_back(radius);
+	m_inputId.push_back(id);
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void SortedSphereAccelerator::IntersectSorted(Ray& ray, Hit& hit) const
+{
+	const size_t blockSize = m_layout.blockSize;
+	const size_t blocksPerSuperblock = m_layout.GetBlocksPerSuperblock();
+	const size_t numBlocks = m_layout.numBlocks;
+	const size_t numSuperblocks = m_layout.numSuperblocks;
+
+	const BoxRay<N> boxRay(ray);
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	// Boxes are tested against the current closest hit, so they cull more as the ray finds nearer spheres
+	for (size_t super = 0; super < numSuperblocks; super += N)
+	{
+		uint32_t superMask = IntersectBoxes<N>(m_superBounds, super, boxRay, ray.tmax) & LaneMask<N>(numSuperblocks - super);
+		while (superMask != 0)
+		{
+			unsigned long lane = 0;
+			_BitScanForward(&lane, superMask);
+			superMask &= superMask - 1;
+
+			const size_t firstBlock = (super + lane) * blocksPerSuperblock;
+			const size_t lastBlock = min(firstBlock + blocksPerSuperblock, numBlocks);
+			for (size_t block = firstBlock; block < lastBlock; block += N)
+			{
+				uint32_t blockMask = IntersectBoxes<N>(m_blockBounds, block, boxRay, ray.tmax) & LaneMask<N>(lastBlock - block);
+				while (blockMask != 0)
+				{
+					unsigned long blockLane = 0;
+					_BitScanForward(&blockLane, blockMask);
+					blockMask &= blockMask - 1;
+
+					IntersectSpheres<N>(m_sphereList, (block + blockLane) * blockSize, blockSize, ray, hitSlot);
+				}
+			}
+		}
+	}
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float invRadius = m_sphereList.invRadius[hitSlot];
+
+		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - m_sphereList.centerX[hitSlot];
+		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - m_sphereList.centerY[hitSlot];
+		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - m_sphereList.centerZ[hitSlot];
+		hit.normalX *= invRadius;
+		hit.normalY *= invRadius;
+		hit.normalZ *= invRadius;
+		hit.geomId = m_sphereList.id[hitSlot];
+	}
+}
+
+
+void SortedSphereAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectSorted<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectSorted<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectSorted<8>(ray, hit);
+	}
+}
+
+
+bool SortedSphereAccelerator::CullTile(const TileFrustum& frustum, ScratchArena& scratch, SphereList& culled) const
+{
+	assert(!m_dirty);
+
+	const size_t blockSize = m_layout.blockSize;
+	const size_t blocksPerSuperblock = m_layout.GetBlocksPerSuperblock();
+	const size_t numBlocks = m_layout.numBlocks;
+
+	// Calls blockFunc(block) for every block in the frustum, for as long as it returns true
+	auto visitBlocks = [&](auto&& blockFunc)
+	{
+		for (size_t super = 0; super < m_layout.numSuperblocks; ++super)
+		{
+			if (!frustum.IntersectsBox(GetBox(m_superBounds, super)))
+			{
+				continue;
+			}
+
+			const size_t firstBlock = super * blocksPerSuperblock;
+			const size_t lastBlock = min(firstBlock + blocksPerSuperblock, numBlocks);
+			for (size_t block = firstBlock; block < lastBlock; ++block)
+			{
+				if (frustum.IntersectsBox(GetBox(m_blockBounds, block)) && !blockFunc(block))
+				{
+					return;
+				}
+			}
+		}
+	};
+
+	// Count the slots first, to size the list, and give up early on tiles that see too many spheres
+	size_t numSlots = 0;
+	visitBlocks([&](size_t block)
+	{
+		numSlots += blockSize;
+		return numSlots <= TILE_CULL_MAX_SPHERES;
+	});
+
+	if (numSlots > TILE_CULL_MAX_SPHERES)
+	{
+		return false;
+	}
+
+	SphereListBuilder builder(scratch, numSlots, m_scene->GetSimdSize());
+
+	visitBlocks([&](size_t block)
+	{
+		for (size_t i = block * blockSize; i < (block + 1) * blockSize; ++i)
+		{
+			const Vector3 center(m_sphereList.centerX[i], m_sphereList.centerY[i], m_sphereList.centerZ[i]);
+			if (m_sphereList.id[i] != INVALID_PRIMITIVE && frustum.IntersectsSphere(center, sqrtf(m_sphereList.radiusSq[i])))
+			{
+				builder.Add(m_sphereList.centerX[i], m_sphereList.centerY[i], m_sphereList.centerZ[i], m_sphereList.radiusSq[i], m_sphereList.invRadius[i], m_sphereList.id[i]);
+			}
+		}
+		return true;
+	});
+
+	culled = builder.Finish();
+	return true;
+}
+
+
+void SortedSphereAccelerator::BuildBoxes(const vector<BvhBounds>& boxes, vector<float, aligned_allocator<float, 64>>(&bounds)[6])
+{
+	const size_t numPadded = AlignUp(boxes.size(), BOX_PADDING);
+	for (auto& array : bounds)
+	{
+		array.assign(numPadded, 0.0f);
+	}
+
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		bounds[0][i] = boxes[i].minX;
+		bounds[1][i] = boxes[i].minY;
+		bounds[2][i] = boxes[i].minZ;
+		bounds[3][i] = boxes[i].maxX;
+		bounds[4][i] = boxes[i].maxY;
+		bounds[5][i] = boxes[i].maxZ;
+	}
+}
+
+
+void SortedSphereAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const auto simdSize = m_scene->GetSimdSize();
+	const size_t numSpheres = m_inputId.size();
+
+	// Morton codes of the sphere centers, normalized to the bounds of the centers
+	BvhBounds centerBounds;
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		centerBounds.Grow(m_inputCenterX[i], m_inputCenterY[i], m_inputCenterZ[i]);
+	}
+
+	const float scaleX = (centerBounds.maxX > centerBounds.minX) ? 1.0f / (centerBounds.maxX - centerBounds.minX) : 0.0f;
+	const float scaleY = (centerBounds.maxY > centerBounds.minY) ? 1.0f / (centerBounds.maxY - centerBounds.minY) : 0.0f;
+	const float scaleZ = (centerBounds.maxZ > centerBounds.minZ) ? 1.0f / (centerBounds.maxZ - centerBounds.minZ) : 0.0f;
+
+	// Code in the upper half, sphere index in the lower half, so equal codes keep their input order
+	vector<uint64_t> keys(numSpheres);
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const uint32_t code = MortonCode(
+			(m_inputCenterX[i] - centerBounds.minX) * scaleX,
+			(m_inputCenterY[i] - centerBounds.minY) * scaleY,
+			(m_inputCenterZ[i] - centerBounds.minZ) * scaleZ);
+		keys[i] = (static_cast<uint64_t>(code) << 32) | i;
+	}
+	sort(keys.begin(), keys.end());
+
+	// Lay the spheres out in Morton order.  Padding slots at the end get a NaN radius, which fails every
+	// comparison.
+	const size_t numSlots = AlignUp(numSpheres, static_cast<size_t>(simdSize));
+	const size_t numBlocks = numSlots / simdSize;
+	const size_t blocksPerSuperblock = SORTED_SUPERBLOCK_SIZE / simdSize;
+	const size_t numSuperblocks = (numBlocks + blocksPerSuperblock - 1) / blocksPerSuperblock;
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+
+	m_centerX.assign(numSlots, 0.0f);
+	m_centerY.assign(numSlots, 0.0f);
+	m_centerZ.assign(numSlots, 0.0f);
+	m_radiusSq.assign(numSlots, nan);
+	m_invRadius.assign(numSlots, nan);
+	m_id.assign(numSlots, INVALID_PRIMITIVE);
+
+	vector<BvhBounds> blockBoxes(numBlocks);
+	vector<BvhBounds> superBoxes(numSuperblocks);
+	BvhBounds bounds;
+
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const uint32_t index = static_cast<uint32_t>(keys[i]);
+
+		const float radius = m_inputRadius[index];
+		m_centerX[i] = m_inputCenterX[index];
+		m_centerY[i] = m_inputCenterY[index];
+		m_centerZ[i] = m_inputCenterZ[index];
+		m_radiusSq[i] = radius * radius;
+		m_invRadius[i] = 1.0f / radius;
+		m_id[i] = m_inputId[index];
+
+		BvhBounds sphereBounds;
+		sphereBounds.Grow(m_centerX[i] - radius, m_centerY[i] - radius, m_centerZ[i] - radius);
+		sphereBounds.Grow(m_centerX[i] + radius, m_centerY[i] + radius, m_centerZ[i] + radius);
+
+		const size_t block = i / simdSize;
+		blockBoxes[block].Grow(sphereBounds);
+		superBoxes[block / blocksPerSuperblock].Grow(sphereBounds);
+		bounds.Grow(sphereBounds);
+	}
+
+	BuildBoxes(blockBoxes, m_ownedBlockBounds);
+	BuildBoxes(superBoxes, m_ownedSuperBounds);
+
+	m_sphereList.centerX = m_centerX.data();
+	m_sphereList.centerY = m_centerY.data();
+	m_sphereList.centerZ = m_centerZ.data();
+	m_sphereList.radiusSq = m_radiusSq.data();
+	m_sphereList.invRadius = m_invRadius.data();
+	m_sphereList.id = m_id.data();
+	m_sphereList.numSlots = numSlots;
+
+	for (size_t i = 0; i < 6; ++i)
+	{
+		m_blockBounds[i] = m_ownedBlockBounds[i].data();
+		m_superBounds[i] = m_ownedSuperBounds[i].data();
+	}
+
+	m_layout.blockSize = static_cast<uint32_t>(simdSize);
+	m_layout.numBlocks = static_cast<uint32_t>(numBlocks);
+	m_layout.numSuperblocks = static_cast<uint32_t>(numSuperblocks);
+	m_layout.bounds = bounds;
+
+	m_dirty = false;
+}
+
+
+BvhBounds SortedSphereAccelerator::GetBounds() const
+{
+	return m_layout.bounds;
+}
+
+
+size_t SortedSphereAccelerator::GetMemoryUsage() const
+{
+	const size_t boxBytes = 6 * sizeof(float) * (AlignUp(size_t(m_layout.numBlocks), BOX_PADDING) + AlignUp(size_t(m_layout.numSuperblocks), BOX_PADDING));
+	return m_sphereList.numSlots * (5 * sizeof(float) + sizeof(uint32_t)) + boxBytes;
+}
+
+
+uint64_t SortedSphereAccelerator::GetContentHash() const
+{
+	uint64_t hash = HashVector(m_inputCenterX);
+	hash = HashVector(m_inputCenterY, hash);
+	hash = HashVector(m_inputCenterZ, hash);
+	hash = HashVector(m_inputRadius, hash);
+	return HashVector(m_inputId, hash);
+}
+
+
+void SortedSphereAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	const float* arrays[5] =
+	{
+		m_sphereList.centerX, m_sphereList.centerY, m_sphereList.centerZ, m_sphereList.radiusSq, m_sphereList.invRadius
+	};
+
+	writer.AddSection(TAG_SORTED_LAYOUT, &m_layout, sizeof(SortedSphereLayout));
+	writer.AddSection(TAG_SORTED_IDS, m_sphereList.id, m_sphereList.numSlots * sizeof(uint32_t));
+	for (size_t i = 0; i < 5; ++i)
+	{
+		writer.AddSection(TAG_SORTED_DATA[i], arrays[i], m_sphereList.numSlots * sizeof(float));
+	}
+
+	const size_t numBlockBoxes = AlignUp(size_t(m_layout.numBlocks), BOX_PADDING);
+	const size_t numSuperBoxes = AlignUp(size_t(m_layout.numSuperblocks), BOX_PADDING);
+	for (size_t i = 0; i < 6; ++i)
+	{
+		writer.AddSection(TAG_SORTED_BLOCK_BOUNDS[i], m_blockBounds[i], numBlockBoxes * sizeof(float));
+		writer.AddSection(TAG_SORTED_SUPER_BOUNDS[i], m_superBounds[i], numSuperBoxes * sizeof(float));
+	}
+}
+
+
+bool SortedSphereAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	// Blocks laid out for a wider SIMD width are still valid for a narrower one, but not the other way around
+	const auto simdSize = m_scene->GetSimdSize();
+	if (reader.GetSimdSize() % simdSize != 0)
+	{
+		return false;
+	}
+
+	size_t numLayouts = 0;
+	const SortedSphereLayout* layout = reader.FindSection<SortedSphereLayout>(TAG_SORTED_LAYOUT, numLayouts);
+	if (!layout || numLayouts != 1 || layout->blockSize == 0 || layout->blockSize % simdSize != 0)
+	{
+		return false;
+	}
+
+	size_t numSlots = 0;
+	const uint32_t* ids = reader.FindSection<uint32_t>(TAG_SORTED_IDS, numSlots);
+	if (!ids || numSlots != layout->GetNumSlots())
+	{
+		return false;
+	}
+
+	const float* arrays[5];
+	for (size_t i = 0; i < 5; ++i)
+	{
+		size_t count = 0;
+		arrays[i] = reader.FindSection<float>(TAG_SORTED_DATA[i], count);
+		if (!arrays[i] || count != numSlots)
+		{
+			return false;
+		}
+	}
+
+	const float* blockBounds[6];
+	const float* superBounds[6];
+	for (size_t i = 0; i < 6; ++i)
+	{
+		size_t numBlockBoxes = 0;
+		size_t numSuperBoxes = 0;
+		blockBounds[i] = reader.FindSection<float>(TAG_SORTED_BLOCK_BOUNDS[i], numBlockBoxes);
+		superBounds[i] = reader.FindSection<float>(TAG_SORTED_SUPER_BOUNDS[i], numSuperBoxes);
+		if (!blockBounds[i] || numBlockBoxes != AlignUp(size_t(layout->numBlocks), BOX_PADDING) ||
+			!superBounds[i] || numSuperBoxes != AlignUp(size_t(layout->numSuperblocks), BOX_PADDING))
+		{
+			return false;
+		}
+	}
+
+	FreeVector(m_centerX);
+	FreeVector(m_centerY);
+	FreeVector(m_centerZ);
+	FreeVector(m_radiusSq);
+	FreeVector(m_invRadius);
+	FreeVector(m_id);
+	for (size_t i = 0; i < 6; ++i)
+	{
+		FreeVector(m_ownedBlockBounds[i]);
+		FreeVector(m_ownedSuperBounds[i]);
+		m_blockBounds[i] = blockBounds[i];
+		m_superBounds[i] = superBounds[i];
+	}
+
+	m_sphereList.centerX = arrays[0];
+	m_sphereList.centerY = arrays[1];
+	m_sphereList.centerZ = arrays[2];
+	m_sphereList.radiusSq = arrays[3];
+	m_sphereList.invRadius = arrays[4];
+	m_sphereList.id = ids;
+	m_sphereList.numSlots = numSlots;
+
+	m_layout = *layout;
+
+	m_loaded = true;
+	m_dirty = false;
+
+	return true;
+}
+
+
+void SortedSphereAccelerator::UnloadAccel()
+{
+	if (!m_loaded)
+	{
+		return;
+	}
+
+	// The input spheres are kept while loaded, so the next Commit() can rebuild from them
+	m_sphereList = SphereList();
+	for (size_t i = 0; i < 6; ++i)
+	{
+		m_blockBounds[i] = nullptr;
+		m_superBounds[i] = nullptr;
+	}
+	m_layout = SortedSphereLayout();
+
+	m_loaded = false;
+	m_dirty = true;
+}
\ No newline at end of file
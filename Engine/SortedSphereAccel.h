@@ -0,0 +1,105 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+#include "IAccelerator.h"
+#include "SphereAccel.h"
+
+
+// Forward declarations
+class Scene;
+
+
+constexpr size_t SORTED_SUPERBLOCK_SIZE = 64;
+
+
+// Block structure of a built SortedSphereAccelerator, saved as is in accelerator caches
+struct SortedSphereLayout
+{
+	uint32_t	blockSize;			// Slots per block: the SIMD width the spheres were laid out for
+	uint32_t	numBlocks;
+	uint32_t	numSuperblocks;
+	uint32_t	reserved;
+	BvhBounds	bounds;
+
+	size_t GetNumSlots() const { return size_t(numBlocks) * blockSize; }
+	size_t GetBlocksPerSuperblock() const { return SORTED_SUPERBLOCK_SIZE / blockSize; }
+};
+
+
+// Spheres in Morton order with no hierarchy, for mid-size scenes where a BVH build costs more than it saves.
+// Sorting keeps neighbouring spheres in neighbouring slots, which are cut into blocks of one SIMD width and
+// superblocks of SORTED_SUPERBLOCK_SIZE slots, each with a bounding box.  A ray slab-tests the superblock boxes
+// N at a time, then the block boxes of every superblock it hits, and runs the sphere kernel only on the blocks
+// it hits.  The build is one sort.
+class SortedSphereAccelerator : public IAccelerator
+{
+public:
+	SortedSphereAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::SphereSorted;
+	}
+
+	void AddSphere(const Math::Vector3& center, float radius, uint32_t id);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	bool CullTile(const TileFrustum& frustum, ScratchArena& scratch, SphereList& culled) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+	const SortedSphereLayout& GetLayout() const { return m_layout; }
+
+private:
+	template <int N>
+	void IntersectSorted(Ray& ray, Hit& hit) const;
+
+	// Box bounds are stored as six arrays, minX, minY, minZ, maxX, maxY, maxZ, padded to a multiple of 8 boxes
+	static void BuildBoxes(const std::vector<BvhBounds>& boxes, std::vector<float, aligned_allocator<float, 64>>(&bounds)[6]);
+
+private:
+	Scene*			m_scene;
+
+	// Input spheres
+	std::vector<float>		m_inputCenterX;
+	std::vector<float>		m_inputCenterY;
+	std::vector<float>		m_inputCenterZ;
+	std::vector<float>		m_inputRadius;
+	std::vector<uint32_t>	m_inputId;
+
+	// Built data in Morton order
+	std::vector<float, aligned_allocator<float, 64>>		m_centerX;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerY;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerZ;
+	std::vector<float, aligned_allocator<float, 64>>		m_radiusSq;
+	std::vector<float, aligned_allocator<float, 64>>		m_invRadius;
+	std::vector<uint32_t, aligned_allocator<uint32_t, 64>>	m_id;
+	std::vector<float, aligned_allocator<float, 64>>		m_ownedBlockBounds[6];
+	std::vector<float, aligned_allocator<float, 64>>		m_ownedSuperBounds[6];
+
+	SphereList			m_sphereList;
+	const float*		m_blockBounds[6]{};
+	const float*		m_superBounds[6]{};
+	SortedSphereLayout	m_layout{};
+
+	bool				m_loaded{ false };
+	bool				m_dirty{ false };
+};
\ No newline at end of file
@@ -10,15 +10,63 @@
 
 #include "SphereAccel.h"
 
+#include "Arena.h"
+#include "BakedFile.h"
+#include "Hash.h"
 #include "Scene.h"
+#include "TileFrustum.h"
 
 
 using namespace Math;
 using namespace std;
 
 
-template<int N>
-void IntersectSpheres(const SphereList& sphereList, Ray& ray, Hit& hit)
+namespace
+{
+
+constexpr uint32_t TAG_SPHERE_NODES = MakeBakedTag('S', 'N', 'O', 'D');
+constexpr uint32_t TAG_SPHERE_IDS = MakeBakedTag('S', 'I', 'D', 'S');
+constexpr uint32_t TAG_SPHERE_DATA[5] =
+{
+	MakeBakedTag('S', 'C', 'X', ' '),
+	MakeBakedTag('S', 'C', 'Y', ' '),
+	MakeBakedTag('S', 'C', 'Z', ' '),
+	MakeBakedTag('S', 'R', 'S', 'Q'),
+	MakeBakedTag('S', 'I', 'R', 'D')
+};
+constexpr uint32_t TAG_SPHERE_BLOCKS = MakeBakedTag('S', 'B', 'L', 'K');
+constexpr uint32_t TAG_SPHERE_QUANTIZED_NODES = MakeBakedTag('S', 'Q', 'N', 'D');
+constexpr uint32_t TAG_SPHERE_QUANTIZED_BOUNDS = MakeBakedTag('S', 'Q', 'B', 'D');
+constexpr uint32_t TAG_SPHERE_TREELET_NODES = MakeBakedTag('S', 'T', 'N', 'D');
+
+
+// Where IntersectSpheresT finds the fields of slot i, in either layout
+struct SoaSpheres
+{
+	const SphereList& list;
+
+	__forceinline const float* CenterX(size_t i) const { return list.centerX + i; }
+	__forceinline const float* CenterY(size_t i) const { return list.centerY + i; }
+	__forceinline const float* CenterZ(size_t i) const { return list.centerZ + i; }
+	__forceinline const float* RadiusSq(size_t i) const { return list.radiusSq + i; }
+};
+
+
+struct BlockSpheres
+{
+	const SphereBlock* blocks;
+
+	__forceinline const SphereBlock& Block(size_t i) const { return blocks[i / SPHERE_BLOCK_SIZE]; }
+	__forceinline const float* CenterX(size_t i) const { return Block(i).centerX + i % SPHERE_BLOCK_SIZE; }
+	__forceinline const float* CenterY(size_t i) const { return Block(i).centerY + i % SPHERE_BLOCK_SIZE; }
+	__forceinline const float* CenterZ(size_t i) const { return Block(i).centerZ + i % SPHERE_BLOCK_SIZE; }
+	__forceinline const float* RadiusSq(size_t i) const { return Block(i).radiusSq + i % SPHERE_BLOCK_SIZE; }
+};
+
+
+// Shrinks ray.tmax and records the slot on a closer hit
+template <int N, typename Spheres>
+void IntersectSpheresT(const Spheres& spheres, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
 {
 	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
 	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
@@ -30,18 +78,16 @@ void IntersectSpheres(const SphereList& sphereList, Ray& ray, Hit& hit)
 	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
 	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
 
-	UInt<N> id(0xffffffff);
+	UInt<N> slot(0xffffffff);
 
-	const size_t numSpheres = sphereList.GetNumSpheres();
-	for (size_t i = 0; i < numSpheres; i += N)
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
 	{
-		// Load data for 4 spheres
-		Float<N> centerX = Float<N>::Load(sphereList.centerX.data() + i);
-		Float<N> centerY = Float<N>::Load(sphereList.centerY.data() + i);
-		Float<N> centerZ = Float<N>::Load(sphereList.centerZ.data() + i);
-		Float<N> radiusSq = Float<N>::Load(sphereList.radiusSq.data() + i);
-
-		UInt<N> curId = UInt<N>::Load(sphereList.id.data() + i);
+		// Load data for N spheres
+		Float<N> centerX = Float<N>::Load(spheres.CenterX(i));
+		Float<N> centerY = Float<N>::Load(spheres.CenterY(i));
+		Float<N> centerZ = Float<N>::Load(spheres.CenterZ(i));
+		Float<N> radiusSq = Float<N>::Load(spheres.RadiusSq(i));
 
 		Float<N> ocX = rayOrigX - centerX;
 		Float<N> ocY = rayOrigY - centerY;
@@ -63,7 +109,7 @@ void IntersectSpheres(const SphereList& sphereList, Ray& ray, Hit& hit)
 			Float<N> t = Select(t0 > tmin, t0, t1);
 			Bool<N> mask = discrPos & (t > tmin) & (t < hitT);
 
-			id = Select(mask, curId, id);
+			slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
 			hitT = Select(mask, t, hitT);
 		}
 	}
@@ -72,43 +118,26 @@ void IntersectSpheres(const SphereList& sphereList, Ray& ray, Hit& hit)
 	if (minT < ray.tmax)
 	{
 		uint32_t minMask = Mask(hitT == Float<N>(minT));
-		if (minMask != 0x0)
-		{
-			uint32_t ids[N];
-			float hits[N];
-			UInt<N>::StoreU(ids, id);
-			Float<N>::StoreU(hits, hitT);
-			
-			float bestT = hits[0];
-			hit.geomId = ids[0];
-			for (int i = 1; i < N; ++i)
+		uint32_t slots[N];
+		UInt<N>::StoreU(slots, slot);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
 			{
-				if (hits[i] < bestT)
-				{
-					bestT = hits[i];
-					hit.geomId = ids[i];
-				}
+				hitSlot = slots[lane] + lane;
+				ray.tmax = minT;
+				break;
 			}
-
-			ray.tmax = bestT;
-			
-			const float invRadius = sphereList.invRadius[hit.geomId];
-
-			hit.normalX = (ray.posX + ray.tmax * ray.dirX) - sphereList.centerX[hit.geomId];
-			hit.normalY = (ray.posY + ray.tmax * ray.dirY) - sphereList.centerY[hit.geomId];
-			hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - sphereList.centerZ[hit.geomId];
-			hit.normalX *= invRadius;
-			hit.normalY *= invRadius;
-			hit.normalZ *= invRadius;
 		}
 	}
 }
 
 
-void IntersectSphere1(const SphereList& sphereList, size_t index, Ray& ray, Hit& hit)
+template <typename Spheres>
+void IntersectSphere1(const Spheres& spheres, size_t index, Ray& ray, uint32_t& hitSlot)
 {
-	Vector3 center = sphereList.Center(index);
-	float radiusSq = sphereList.radiusSq[index];
+	Vector3 center = Vector3(*spheres.CenterX(index), *spheres.CenterY(index), *spheres.CenterZ(index));
+	float radiusSq = *spheres.RadiusSq(index);
 
 	Vector3 oc = Vector3(ray.posX, ray.posY, ray.posZ) - center;
 	float b = Dot(oc, Vector3(ray.dirX, ray.dirY, ray.dirZ));
@@ -117,53 +146,149 @@ void IntersectSphere1(const SphereList& sphereList, size_t index, Ray& ray, Hit&
 
 	if (discriminant > 0.0f)
 	{
-		float invRadius = sphereList.invRadius[index];
 		float discrSqrt = sqrtf(discriminant);
 
 		float temp = (-b - discrSqrt);
 		if (temp < ray.tmax && temp > ray.tmin)
 		{
 			ray.tmax = temp;
-			hit.geomId = sphereList.id[index];
+			hitSlot = static_cast<uint32_t>(index);
 			return;
 		}
 		temp = (-b + discrSqrt);
 		if (temp < ray.tmax && temp > ray.tmin)
 		{
 			ray.tmax = temp;
-			hit.geomId = sphereList.id[index];
+			hitSlot = static_cast<uint32_t>(index);
 		}
 	}
 }
 
+} // anonymous namespace
+
 
-template<>
-void IntersectSpheres<1>(const SphereList& sphereList, Ray& ray, Hit& hit)
+template <int N>
+void IntersectSpheres(const SphereList& sphereList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
 {
-	Hit tempHit;
-	float closestHit = ray.tmax;
+	IntersectSpheresT<N>(SoaSpheres{ sphereList }, first, count, ray, hitSlot);
+}
+
 
-	for (size_t i = 0; i < sphereList.GetNumSpheres(); ++i)
+template <>
+void IntersectSpheres<1>(const SphereList& sphereList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const SoaSpheres spheres{ sphereList };
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
 	{
-		IntersectSphere1(sphereList, i, ray, tempHit);
-		if(tempHit.geomId != 0xFFFFFFFF)
-		{
-			closestHit = ray.tmax;
-			hit = tempHit;
-		}
+		IntersectSphere1(spheres, i, ray, hitSlot);
 	}
+}
+
 
-	if (tempHit.geomId != 0xFFFFFFFF)
+template void IntersectSpheres<4>(const SphereList& sphereList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+template void IntersectSpheres<8>(const SphereList& sphereList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+
+
+template <int N>
+void IntersectSphereBlocks(const SphereBlock* blocks, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	static_assert(SPHERE_BLOCK_SIZE % N == 0, "A Float<N> load must not cross a block");
+	IntersectSpheresT<N>(BlockSpheres{ blocks }, first, count, ray, hitSlot);
+}
+
+
+template <>
+void IntersectSphereBlocks<1>(const SphereBlock* blocks, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const BlockSpheres spheres{ blocks };
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
 	{
-		const float invRadius = sphereList.invRadius[hit.geomId];
+		IntersectSphere1(spheres, i, ray, hitSlot);
+	}
+}
+
+
+template void IntersectSphereBlocks<4>(const SphereBlock* blocks, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+template void IntersectSphereBlocks<8>(const SphereBlock* blocks, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+
 
-		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - sphereList.centerX[hit.geomId];
-		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - sphereList.centerY[hit.geomId];
-		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - sphereList.centerZ[hit.geomId];
+void IntersectSphereList(const SphereList& sphereList, size_t simdSize, Ray& ray, Hit& hit)
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	if (simdSize == 1)
+	{
+		IntersectSpheres<1>(sphereList, 0, sphereList.numSlots, ray, hitSlot);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectSpheres<4>(sphereList, 0, sphereList.numSlots, ray, hitSlot);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectSpheres<8>(sphereList, 0, sphereList.numSlots, ray, hitSlot);
+	}
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float invRadius = sphereList.invRadius[hitSlot];
+
+		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - sphereList.centerX[hitSlot];
+		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - sphereList.centerY[hitSlot];
+		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - sphereList.centerZ[hitSlot];
 		hit.normalX *= invRadius;
 		hit.normalY *= invRadius;
 		hit.normalZ *= invRadius;
+		hit.geomId = sphereList.id[hitSlot];
+	}
+}
+
+
+SphereListBuilder::SphereListBuilder(ScratchArena& scratch, size_t capacity, size_t simdSize)
+	: m_simdSize(simdSize)
+{
+	const size_t numSlots = AlignUp(capacity, simdSize);
+	m_centerX = scratch.AllocateSimdArray<float>(numSlots);
+	m_centerY = scratch.AllocateSimdArray<float>(numSlots);
+	m_centerZ = scratch.AllocateSimdArray<float>(numSlots);
+	m_radiusSq = scratch.AllocateSimdArray<float>(numSlots);
+	m_invRadius = scratch.AllocateSimdArray<float>(numSlots);
+	m_id = scratch.AllocateSimdArray<uint32_t>(numSlots);
+}
+
+
+void SphereListBuilder::Add(float centerX, float centerY, float centerZ, float radiusSq, float invRadius, uint32_t id)
+{
+	m_centerX[m_count] = centerX;
+	m_centerY[m_count] = centerY;
+	m_centerZ[m_count] = centerZ;
+	m_radiusSq[m_count] = radiusSq;
+	m_invRadius[m_count] = invRadius;
+	m_id[m_count] = id;
+	++m_count;
+}
+
+
+SphereList SphereListBuilder::Finish()
+{
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	const size_t numSlots = AlignUp(m_count, m_simdSize);
+	while (m_count < numSlots)
+	{
+		Add(0.0f, 0.0f, 0.0f, nan, nan, INVALID_PRIMITIVE);
 	}
+
+	SphereList sphereList;
+	sphereList.centerX = m_centerX;
+	sphereList.centerY = m_centerY;
+	sphereList.centerZ = m_centerZ;
+	sphereList.radiusSq = m_radiusSq;
+	sphereList.invRadius = m_invRadius;
+	sphereList.id = m_id;
+	sphereList.numSlots = numSlots;
+	return sphereList;
 }
 
 
@@ -174,55 +299,566 @@ SphereAccelerator::SphereAccelerator(Scene* scene)
 
 void SphereAccelerator::AddSphere(const Vector3& center, float radius, uint32_t id)
 {
-	m_sphereList.centerX.push_back(center.GetX());
-	m_sphereList.centerY.push_back(center.GetY());
-	m_sphereList.centerZ.push_back(center.GetZ());
-	m_sphereList.radiusSq.push_back(radius * radius);
-	m_sphereList.invRadius.push_back(1.0f / radius);
-	m_sphereList.id.push_back(id);
+	if (m_loaded)
+	{
+		UnloadAccel();
+	}
+
+	m_inputCenterX.push_back(center.GetX());
+	m_inputCenterY.push_back(center.GetY());
+	m_inputCenterZ.push_back(center.GetZ());
+	m_inputRadius.push_back(radius);
+	m_inputId.push_back(id);
 
 	m_dirty = true;
 }
 
 
+template <typename LeafFunc>
+__forceinline void SphereAccelerator::TraverseBvh(Ray& ray, LeafFunc&& leafFunc) const
+{
+	if (IsNodeFetchCountingEnabled())
+	{
+		TraverseNodes<true>(ray, leafFunc);
+	}
+	else
+	{
+		TraverseNodes<false>(ray, leafFunc);
+	}
+}
+
+
+template <bool CountNodeFetches, typename LeafFunc>
+__forceinline void SphereAccelerator::TraverseNodes(Ray& ray, LeafFunc&& leafFunc) const
+{
+	switch (m_nodeFormat)
+	{
+	case BvhNodeFormat::Quantized:
+		m_quantizedBvh.Intersect<CountNodeFetches>(ray, leafFunc);
+		break;
+	case BvhNodeFormat::Treelet:
+		m_treeletBvh.Intersect<CountNodeFetches>(ray, leafFunc);
+		break;
+	default:
+		m_bvh.Intersect<CountNodeFetches>(ray, leafFunc);
+		break;
+	}
+}
+
+
+template <typename NodeFunc, typename LeafFunc>
+void SphereAccelerator::VisitBvh(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const
+{
+	switch (m_nodeFormat)
+	{
+	case BvhNodeFormat::Quantized:
+		m_quantizedBvh.Visit(nodeFunc, leafFunc);
+		break;
+	case BvhNodeFormat::Treelet:
+		m_treeletBvh.Visit([&](const BvhNode& node) { return nodeFunc(node.GetBounds()); }, leafFunc);
+		break;
+	default:
+		m_bvh.Visit([&](const BvhNode& node) { return nodeFunc(node.GetBounds()); }, leafFunc);
+		break;
+	}
+}
+
+
+template <int N>
+void SphereAccelerator::IntersectBvh(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	TraverseBvh(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectSpheres<N>(m_sphereList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float invRadius = m_sphereList.invRadius[hitSlot];
+
+		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - m_sphereList.centerX[hitSlot];
+		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - m_sphereList.centerY[hitSlot];
+		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - m_sphereList.centerZ[hitSlot];
+		hit.normalX *= invRadius;
+		hit.normalY *= invRadius;
+		hit.normalZ *= invRadius;
+		hit.geomId = m_sphereList.id[hitSlot];
+	}
+}
+
+
+template <int N>
+void SphereAccelerator::IntersectBvhBlocks(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	TraverseBvh(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectSphereBlocks<N>(m_sphereBlocks, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const SphereBlock& block = m_sphereBlocks[hitSlot / SPHERE_BLOCK_SIZE];
+		const size_t lane = hitSlot % SPHERE_BLOCK_SIZE;
+		const float invRadius = block.invRadius[lane];
+
+		hit.normalX = (ray.posX + ray.tmax * ray.dirX) - block.centerX[lane];
+		hit.normalY = (ray.posY + ray.tmax * ray.dirY) - block.centerY[lane];
+		hit.normalZ = (ray.posZ + ray.tmax * ray.dirZ) - block.centerZ[lane];
+		hit.normalX *= invRadius;
+		hit.normalY *= invRadius;
+		hit.normalZ *= invRadius;
+		hit.geomId = block.id[lane];
+	}
+}
+
+
 void SphereAccelerator::Intersect1(Ray& ray, Hit& hit) const
 {
 	assert(!m_dirty);
 
 	const auto simdSize = m_scene->GetSimdSize();
 
-	if (simdSize == 1)
+	if (m_layout == SphereLayout::AoSoA)
+	{
+		if (simdSize == 1)
+		{
+			IntersectBvhBlocks<1>(ray, hit);
+		}
+		else if (simdSize == 4)
+		{
+			IntersectBvhBlocks<4>(ray, hit);
+		}
+		else if (simdSize == 8)
+		{
+			IntersectBvhBlocks<8>(ray, hit);
+		}
+	}
+	else if (simdSize == 1)
 	{
-		IntersectSpheres<1>(m_sphereList, ray, hit);
+		IntersectBvh<1>(ray, hit);
 	}
 	else if (simdSize == 4)
 	{
-		IntersectSpheres<4>(m_sphereList, ray, hit);
+		IntersectBvh<4>(ray, hit);
 	}
 	else if (simdSize == 8)
 	{
-		IntersectSpheres<8>(m_sphereList, ray, hit);
+		IntersectBvh<8>(ray, hit);
 	}
 }
 
 
+bool SphereAccelerator::CullTile(const TileFrustum& frustum, ScratchArena& scratch, SphereList& culled) const
+{
+	assert(!m_dirty);
+
+	// Count the slots of the leaves in the frustum first, to size the list, and give up early on tiles that see
+	// too many spheres
+	size_t numSlots = 0;
+	auto nodeFunc = [&](const BvhBounds& bounds)
+	{
+		return numSlots <= TILE_CULL_MAX_SPHERES && frustum.IntersectsBox(bounds);
+	};
+
+	VisitBvh(nodeFunc, [&](uint32_t first, uint32_t count)
+	{
+		numSlots += count;
+	});
+
+	if (numSlots > TILE_CULL_MAX_SPHERES)
+	{
+		return false;
+	}
+
+	SphereListBuilder builder(scratch, numSlots, m_scene->GetSimdSize());
+
+	auto addSphere = [&](float centerX, float centerY, float centerZ, float radiusSq, float invRadius, uint32_t id)
+	{
+		if (id != INVALID_PRIMITIVE && frustum.IntersectsSphere(Vector3(centerX, centerY, centerZ), sqrtf(radiusSq)))
+		{
+			builder.Add(centerX, centerY, centerZ, radiusSq, invRadius, id);
+		}
+	};
+
+	numSlots = 0;
+	VisitBvh(nodeFunc, [&](uint32_t first, uint32_t count)
+	{
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			if (m_layout == SphereLayout::AoSoA)
+			{
+				const SphereBlock& block = m_sphereBlocks[i / SPHERE_BLOCK_SIZE];
+				const size_t lane = i % SPHERE_BLOCK_SIZE;
+				addSphere(block.centerX[lane], block.centerY[lane], block.centerZ[lane], block.radiusSq[lane], block.invRadius[lane], block.id[lane]);
+			}
+			else
+			{
+				addSphere(m_sphereList.centerX[i], m_sphereList.centerY[i], m_sphereList.centerZ[i], m_sphereList.radiusSq[i], m_sphereList.invRadius[i], m_sphereList.id[i]);
+			}
+		}
+	});
+
+	culled = builder.Finish();
+	return true;
+}
+
+
 void SphereAccelerator::Commit()
 {
+	if (!m_dirty)
+	{
+		return;
+	}
+
 	const auto simdSize = m_scene->GetSimdSize();
+	const size_t numSpheres = m_inputId.size();
+
+	vector<BvhBounds> bounds(numSpheres);
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const float radius = m_inputRadius[i];
+		bounds[i].Grow(m_inputCenterX[i] - radius, m_inputCenterY[i] - radius, m_inputCenterZ[i] - radius);
+		bounds[i].Grow(m_inputCenterX[i] + radius, m_inputCenterY[i] + radius, m_inputCenterZ[i] + radius);
+	}
+
+	m_bvh.Build(bounds, simdSize, 2 * simdSize);
 
-	size_t curSize = m_sphereList.GetNumSpheres();
-	size_t targetSize = AlignUp(curSize, simdSize);
+	// Lay the spheres out in leaf order.  Padding slots get a NaN radius, which fails every comparison.
+	const auto& slots = m_bvh.GetPrimitiveSlots();
+	const size_t numSlots = slots.size();
 
-	// Pad out the sphere arrays with dummy data until we're a multiple of m_simdSize
-	for (size_t i = curSize; i < targetSize; ++i)
+	m_layout = m_scene->GetSphereLayout();
+	m_sphereList = SphereList();
+	m_sphereList.numSlots = numSlots;
+	m_sphereBlocks = nullptr;
+
+	if (m_layout == SphereLayout::AoSoA)
+	{
+		FreeVector(m_centerX);
+		FreeVector(m_centerY);
+		FreeVector(m_centerZ);
+		FreeVector(m_radiusSq);
+		FreeVector(m_invRadius);
+		FreeVector(m_id);
+
+		BuildBlocks(slots);
+		m_sphereBlocks = m_blocks.data();
+	}
+	else
+	{
+		FreeVector(m_blocks);
+
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+
+		m_centerX.assign(numSlots, 0.0f);
+		m_centerY.assign(numSlots, 0.0f);
+		m_centerZ.assign(numSlots, 0.0f);
+		m_radiusSq.assign(numSlots, nan);
+		m_invRadius.assign(numSlots, nan);
+		m_id.assign(numSlots, INVALID_PRIMITIVE);
+
+		for (size_t i = 0; i < numSlots; ++i)
+		{
+			const uint32_t index = slots[i];
+			if (index == INVALID_PRIMITIVE)
+			{
+				continue;
+			}
+
+			const float radius = m_inputRadius[index];
+			m_centerX[i] = m_inputCenterX[index];
+			m_centerY[i] = m_inputCenterY[index];
+			m_centerZ[i] = m_inputCenterZ[index];
+			m_radiusSq[i] = radius * radius;
+			m_invRadius[i] = 1.0f / radius;
+			m_id[i] = m_inputId[index];
+		}
+
+		m_sphereList.centerX = m_centerX.data();
+		m_sphereList.centerY = m_centerY.data();
+		m_sphereList.centerZ = m_centerZ.data();
+		m_sphereList.radiusSq = m_radiusSq.data();
+		m_sphereList.invRadius = m_invRadius.data();
+		m_sphereList.id = m_id.data();
+	}
+
+	// The quantized or reordered tree replaces the depth-first one, which is only kept for its slot order up to here
+	m_nodeFormat = m_scene->GetBvhNodeFormat();
+	m_quantizedBvh.Clear();
+	m_treeletBvh.Clear();
+	if (m_nodeFormat == BvhNodeFormat::Quantized)
+	{
+		m_quantizedBvh.Build(m_bvh, simdSize);
+		m_bvh.Clear();
+	}
+	else if (m_nodeFormat == BvhNodeFormat::Treelet)
 	{
-		m_sphereList.centerX.push_back(0.0f);
-		m_sphereList.centerY.push_back(0.0f);
-		m_sphereList.centerZ.push_back(0.0f);
-		m_sphereList.radiusSq.push_back(0.0f);
-		m_sphereList.invRadius.push_back(std::numeric_limits<float>::quiet_NaN());
-		m_sphereList.id.push_back(0xFFFFFFFF); // TODO: Make this a constant somewhere
+		m_treeletBvh.Build(m_bvh);
+		m_bvh.Clear();
 	}
 
 	m_dirty = false;
+}
+
+
+void SphereAccelerator::BuildBlocks(const vector<uint32_t>& slots)
+{
+	// Leaves are padded to the SIMD width, which divides the block size, so a leaf never straddles a block
+	// boundary in the middle of a Float<N> load.  The tail of the last block is padding like any other.
+	const size_t numSlots = slots.size();
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+
+	SphereBlock padding;
+	fill(begin(padding.centerX), end(padding.centerX), 0.0f);
+	fill(begin(padding.centerY), end(padding.centerY), 0.0f);
+	fill(begin(padding.centerZ), end(padding.centerZ), 0.0f);
+	fill(begin(padding.radiusSq), end(padding.radiusSq), nan);
+	fill(begin(padding.invRadius), end(padding.invRadius), nan);
+	fill(begin(padding.id), end(padding.id), INVALID_PRIMITIVE);
+
+	m_blocks.assign((numSlots + SPHERE_BLOCK_SIZE - 1) / SPHERE_BLOCK_SIZE, padding);
+
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		const uint32_t index = slots[i];
+		if (index == INVALID_PRIMITIVE)
+		{
+			continue;
+		}
+
+		SphereBlock& block = m_blocks[i / SPHERE_BLOCK_SIZE];
+		const size_t lane = i % SPHERE_BLOCK_SIZE;
+		const float radius = m_inputRadius[index];
+		block.centerX[lane] = m_inputCenterX[index];
+		block.centerY[lane] = m_inputCenterY[index];
+		block.centerZ[lane] = m_inputCenterZ[index];
+		block.radiusSq[lane] = radius * radius;
+		block.invRadius[lane] = 1.0f / radius;
+		block.id[lane] = m_inputId[index];
+	}
+}
+
+
+BvhBounds SphereAccelerator::GetBounds() const
+{
+	switch (m_nodeFormat)
+	{
+	case BvhNodeFormat::Quantized: return m_quantizedBvh.GetBounds();
+	case BvhNodeFormat::Treelet: return m_treeletBvh.GetBounds();
+	default: return m_bvh.GetBounds();
+	}
+}
+
+
+size_t SphereAccelerator::GetMemoryUsage() const
+{
+	size_t nodeMemory = m_bvh.GetMemoryUsage();
+	if (m_nodeFormat == BvhNodeFormat::Quantized)
+	{
+		nodeMemory = m_quantizedBvh.GetMemoryUsage();
+	}
+	else if (m_nodeFormat == BvhNodeFormat::Treelet)
+	{
+		nodeMemory = m_treeletBvh.GetMemoryUsage();
+	}
+
+	if (m_layout == SphereLayout::AoSoA)
+	{
+		const size_t numBlocks = (m_sphereList.numSlots + SPHERE_BLOCK_SIZE - 1) / SPHERE_BLOCK_SIZE;
+		return numBlocks * sizeof(SphereBlock) + nodeMemory;
+	}
+	return m_sphereList.numSlots * (5 * sizeof(float) + sizeof(uint32_t)) + nodeMemory;
+}
+
+
+uint64_t SphereAccelerator::GetContentHash() const
+{
+	// The built state depends on the layout settings as well as the spheres, so a cache built with other
+	// settings is rebuilt rather than loaded
+	uint64_t hash = HashCombine(HASH_SEED, static_cast<uint64_t>(m_scene->GetSimdSize()));
+	hash = HashCombine(hash, static_cast<uint64_t>(m_scene->GetSphereLayout()));
+	hash = HashCombine(hash, static_cast<uint64_t>(m_scene->GetBvhNodeFormat()));
+	hash = HashVector(m_inputCenterX, hash);
+	hash = HashVector(m_inputCenterY, hash);
+	hash = HashVector(m_inputCenterZ, hash);
+	hash = HashVector(m_inputRadius, hash);
+	return HashVector(m_inputId, hash);
+}
+
+
+void SphereAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	if (m_nodeFormat == BvhNodeFormat::Quantized)
+	{
+		writer.AddSection(TAG_SPHERE_QUANTIZED_NODES, m_quantizedBvh.GetNodes(), m_quantizedBvh.GetNumNodes() * sizeof(QuantizedBvhNode));
+		writer.AddSection(TAG_SPHERE_QUANTIZED_BOUNDS, &m_quantizedBvh.GetBounds(), sizeof(BvhBounds));
+	}
+	else if (m_nodeFormat == BvhNodeFormat::Treelet)
+	{
+		// Page aligned, so each treelet stays on the page it was built for
+		writer.AddSection(TAG_SPHERE_TREELET_NODES, m_treeletBvh.GetNodes(), m_treeletBvh.GetNumNodes() * sizeof(BvhNode), TREELET_BVH_PAGE_SIZE);
+	}
+	else
+	{
+		writer.AddSection(TAG_SPHERE_NODES, m_bvh.GetNodes(), m_bvh.GetNumNodes() * sizeof(BvhNode));
+	}
+
+	if (m_layout == SphereLayout::AoSoA)
+	{
+		const size_t numBlocks = (m_sphereList.numSlots + SPHERE_BLOCK_SIZE - 1) / SPHERE_BLOCK_SIZE;
+		writer.AddSection(TAG_SPHERE_BLOCKS, m_sphereBlocks, numBlocks * sizeof(SphereBlock));
+		return;
+	}
+
+	const float* arrays[5] =
+	{
+		m_sphereList.centerX, m_sphereList.centerY, m_sphereList.centerZ, m_sphereList.radiusSq, m_sphereList.invRadius
+	};
+
+	writer.AddSection(TAG_SPHERE_IDS, m_sphereList.id, m_sphereList.numSlots * sizeof(uint32_t));
+	for (size_t i = 0; i < 5; ++i)
+	{
+		writer.AddSection(TAG_SPHERE_DATA[i], arrays[i], m_sphereList.numSlots * sizeof(float));
+	}
+}
+
+
+bool SphereAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	// Leaves padded for a wider SIMD width are still valid for a narrower one, but not the other way around
+	const auto simdSize = m_scene->GetSimdSize();
+	if (reader.GetSimdSize() % simdSize != 0)
+	{
+		return false;
+	}
+
+	// A cache only holds the node format and layout it was saved with.  Loading it into a scene set to another
+	// one fails, and the scene is rebuilt in the format and layout asked for.
+	const BvhNodeFormat nodeFormat = m_scene->GetBvhNodeFormat();
+	size_t numNodes = 0;
+	const BvhNode* nodes = nullptr;
+	const QuantizedBvhNode* quantizedNodes = nullptr;
+	const BvhBounds* quantizedBounds = nullptr;
+
+	if (nodeFormat == BvhNodeFormat::Quantized)
+	{
+		size_t numBounds = 0;
+		quantizedNodes = reader.FindSection<QuantizedBvhNode>(TAG_SPHERE_QUANTIZED_NODES, numNodes);
+		quantizedBounds = reader.FindSection<BvhBounds>(TAG_SPHERE_QUANTIZED_BOUNDS, numBounds);
+		if (!quantizedNodes || numNodes == 0 || !quantizedBounds || numBounds != 1)
+		{
+			return false;
+		}
+	}
+	else
+	{
+		nodes = reader.FindSection<BvhNode>((nodeFormat == BvhNodeFormat::Treelet) ? TAG_SPHERE_TREELET_NODES : TAG_SPHERE_NODES, numNodes);
+		if (!nodes || numNodes == 0)
+		{
+			return false;
+		}
+	}
+
+	const SphereLayout layout = m_scene->GetSphereLayout();
+	SphereList sphereList;
+	const SphereBlock* blocks = nullptr;
+
+	if (layout == SphereLayout::AoSoA)
+	{
+		size_t numBlocks = 0;
+		blocks = reader.FindSection<SphereBlock>(TAG_SPHERE_BLOCKS, numBlocks);
+		if (!blocks || numBlocks == 0)
+		{
+			return false;
+		}
+		sphereList.numSlots = numBlocks * SPHERE_BLOCK_SIZE;
+	}
+	else
+	{
+		size_t numSlots = 0;
+		sphereList.id = reader.FindSection<uint32_t>(TAG_SPHERE_IDS, numSlots);
+		if (!sphereList.id)
+		{
+			return false;
+		}
+
+		const float* arrays[5];
+		for (size_t i = 0; i < 5; ++i)
+		{
+			size_t count = 0;
+			arrays[i] = reader.FindSection<float>(TAG_SPHERE_DATA[i], count);
+			if (!arrays[i] || count != numSlots)
+			{
+				return false;
+			}
+		}
+
+		sphereList.centerX = arrays[0];
+		sphereList.centerY = arrays[1];
+		sphereList.centerZ = arrays[2];
+		sphereList.radiusSq = arrays[3];
+		sphereList.invRadius = arrays[4];
+		sphereList.numSlots = numSlots;
+	}
+
+	FreeVector(m_centerX);
+	FreeVector(m_centerY);
+	FreeVector(m_centerZ);
+	FreeVector(m_radiusSq);
+	FreeVector(m_invRadius);
+	FreeVector(m_id);
+	FreeVector(m_blocks);
+
+	m_layout = layout;
+	m_sphereList = sphereList;
+	m_sphereBlocks = blocks;
+	m_nodeFormat = nodeFormat;
+
+	m_bvh.Clear();
+	m_quantizedBvh.Clear();
+	m_treeletBvh.Clear();
+	if (nodeFormat == BvhNodeFormat::Quantized)
+	{
+		// Leaf sizes are in batches of the SIMD width the nodes were built for
+		m_quantizedBvh.Attach(quantizedNodes, numNodes, *quantizedBounds, reader.GetSimdSize());
+	}
+	else if (nodeFormat == BvhNodeFormat::Treelet)
+	{
+		// The section is page aligned, so the treelets and pairs keep the pages and cache lines they were built for
+		m_treeletBvh.Attach(nodes, numNodes);
+	}
+	else
+	{
+		m_bvh.Attach(nodes, numNodes);
+	}
+
+	m_loaded = true;
+	m_dirty = false;
+
+	return true;
+}
+
+
+void SphereAccelerator::UnloadAccel()
+{
+	if (!m_loaded)
+	{
+		return;
+	}
+
+	// The input spheres are kept while loaded, so the next Commit() can rebuild from them
+	m_sphereList = SphereList();
+	m_sphereBlocks = nullptr;
+	m_bvh.Clear();
+	m_quantizedBvh.Clear();
+	m_treeletBvh.Clear();
+
+	m_loaded = false;
+	m_dirty = true;
 }
\ No newline at end of file
@@ -8,25 +8,32 @@
 
 #pragma once
 
+#include "Bvh.h"
 #include "IAccelerator.h"
+#include "QuantizedBvh.h"
+#include "TreeletBvh.h"
 
 
 // Forward declarations
 class Scene;
 
 
+// View over sphere data in BVH leaf order, padded per leaf to a multiple of the SIMD width.  The arrays are
+// either owned by the accelerator or point into a mapped accelerator cache.
 struct SphereList
 {
-	std::vector<float, aligned_allocator<float, 16>>		centerX;
-	std::vector<float, aligned_allocator<float, 16>>		centerY;
-	std::vector<float, aligned_allocator<float, 16>>		centerZ;
-	std::vector<float, aligned_allocator<float, 16>>		radiusSq;
-	std::vector<float, aligned_allocator<float, 16>>		invRadius;
-	std::vector<uint32_t, aligned_allocator<uint32_t, 16>>	id;
+	const float*	centerX{ nullptr };
+	const float*	centerY{ nullptr };
+	const float*	centerZ{ nullptr };
+	const float*	radiusSq{ nullptr };
+	const float*	invRadius{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
 
 	__forceinline size_t GetNumSpheres() const
 	{
-		return centerX.size();
+		return numSlots;
 	}
 
 	__forceinline Math::Vector3 Center(size_t index) const
@@ -36,6 +43,72 @@ struct SphereList
 };
 
 
+// Intersects the slots [first, first + count) with N spheres at a time; count must be a multiple of N.  Shrinks
+// ray.tmax and sets hitSlot on a closer hit.  Instantiated for N = 1, 4 and 8.
+template <int N>
+void IntersectSpheres(const SphereList& sphereList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+
+template <>
+void IntersectSpheres<1>(const SphereList& sphereList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+
+
+constexpr size_t SPHERE_BLOCK_SIZE = 8;
+
+
+// SPHERE_BLOCK_SIZE spheres with all of their fields packed together, for the AoSoA layout.  The fields the
+// intersection loop reads fill the first two cache lines of the block, so a leaf of 8 spheres is one contiguous
+// 128 byte read instead of four reads from separate arrays; invRadius and id are only read for the closest hit.
+// Slot i is lane i % SPHERE_BLOCK_SIZE of block i / SPHERE_BLOCK_SIZE.
+struct alignas(64) SphereBlock
+{
+	float		centerX[SPHERE_BLOCK_SIZE];
+	float		centerY[SPHERE_BLOCK_SIZE];
+	float		centerZ[SPHERE_BLOCK_SIZE];
+	float		radiusSq[SPHERE_BLOCK_SIZE];
+	float		invRadius[SPHERE_BLOCK_SIZE];
+	uint32_t	id[SPHERE_BLOCK_SIZE];
+};
+static_assert(sizeof(SphereBlock) == 192, "SphereBlock must be three cache lines");
+
+
+// Same as IntersectSpheres, over slots in blocks.  A Float<4> reads half a block.
+template <int N>
+void IntersectSphereBlocks(const SphereBlock* blocks, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+
+template <>
+void IntersectSphereBlocks<1>(const SphereBlock* blocks, size_t first, size_t count, Ray& ray, uint32_t& hitSlot);
+
+
+// Intersects every slot of the list, shrinking ray.tmax and filling in hit on a closer hit
+void IntersectSphereList(const SphereList& sphereList, size_t simdSize, Ray& ray, Hit& hit);
+
+
+// Tile culling gives up on tiles that would keep more spheres than this, where a brute-force loop over the
+// culled list would lose to the accelerator's own traversal
+constexpr size_t TILE_CULL_MAX_SPHERES = 256;
+
+
+// Copies of selected spheres in scratch memory, as a SphereList padded to the SIMD width with NaN radii
+class SphereListBuilder
+{
+public:
+	SphereListBuilder(ScratchArena& scratch, size_t capacity, size_t simdSize);
+
+	void Add(float centerX, float centerY, float centerZ, float radiusSq, float invRadius, uint32_t id);
+	SphereList Finish();
+
+private:
+	float*		m_centerX;
+	float*		m_centerY;
+	float*		m_centerZ;
+	float*		m_radiusSq;
+	float*		m_invRadius;
+	uint32_t*	m_id;
+	size_t		m_count{ 0 };
+	size_t		m_simdSize;
+};
+
+
 class SphereAccelerator : public IAccelerator
 {
 public:
@@ -51,11 +124,68 @@ public:
 	// Intersection methods
 	void Intersect1(Ray& ray, Hit& hit) const final;
 
-	void Commit() final;	
+	bool CullTile(const TileFrustum& frustum, ScratchArena& scratch, SphereList& culled) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectBvh(Ray& ray, Hit& hit) const;
+
+	template <int N>
+	void IntersectBvhBlocks(Ray& ray, Hit& hit) const;
+
+	void BuildBlocks(const std::vector<uint32_t>& slots);
+
+	// Whichever of the trees is built
+	template <typename LeafFunc>
+	void TraverseBvh(Ray& ray, LeafFunc&& leafFunc) const;
+
+	template <bool CountNodeFetches, typename LeafFunc>
+	void TraverseNodes(Ray& ray, LeafFunc&& leafFunc) const;
+
+	template <typename NodeFunc, typename LeafFunc>
+	void VisitBvh(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const;
 
 private:
 	Scene*			m_scene;
-	SphereList		m_sphereList;
 
+	// Input spheres
+	std::vector<float>		m_inputCenterX;
+	std::vector<float>		m_inputCenterY;
+	std::vector<float>		m_inputCenterZ;
+	std::vector<float>		m_inputRadius;
+	std::vector<uint32_t>	m_inputId;
+
+	// Built data in leaf order
+	std::vector<float, aligned_allocator<float, 64>>		m_centerX;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerY;
+	std::vector<float, aligned_allocator<float, 64>>		m_centerZ;
+	std::vector<float, aligned_allocator<float, 64>>		m_radiusSq;
+	std::vector<float, aligned_allocator<float, 64>>		m_invRadius;
+	std::vector<uint32_t, aligned_allocator<uint32_t, 64>>	m_id;
+	std::vector<SphereBlock, aligned_allocator<SphereBlock, 64>>	m_blocks;
+
+	// With SphereLayout::AoSoA, only m_sphereBlocks is set and m_sphereList holds just the slot count
+	SphereLayout		m_layout{ SphereLayout::SoA };
+	SphereList			m_sphereList;
+	const SphereBlock*	m_sphereBlocks{ nullptr };
+
+	// With BvhNodeFormat::Quantized or Treelet, m_bvh is only used during Commit(), and m_quantizedBvh or
+	// m_treeletBvh is the tree traversed
+	BvhNodeFormat		m_nodeFormat{ BvhNodeFormat::Full };
+	Bvh					m_bvh;
+	QuantizedBvh		m_quantizedBvh;
+	TreeletBvh			m_treeletBvh;
+
+	bool			m_loaded{ false };
 	bool			m_dirty{ false };
 };
\ No newline at end of file
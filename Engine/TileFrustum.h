@@ -0,0 +1,62 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+#include "Math\BoundingPlane.h"
+
+
+// Bounding volume of every primary ray through one image tile, from any point on the lens: four side planes,
+// facing inwards, and no near or far plane.  Built by Camera::GetTileFrustum.
+struct TileFrustum
+{
+	Math::BoundingPlane	planes[4];
+
+	bool IntersectsSphere(const Math::Vector3& center, float radius) const
+	{
+		for (const auto& plane : planes)
+		{
+			if (IsOutside(plane, center, radius))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IntersectsBox(const BvhBounds& bounds) const
+	{
+		for (const auto& plane : planes)
+		{
+			// The corner furthest along the plane normal
+			const Math::Vector3 normal = plane.GetNormal();
+			const Math::Vector3 corner(
+				(normal.GetX() >= 0.0f) ? bounds.maxX : bounds.minX,
+				(normal.GetY() >= 0.0f) ? bounds.maxY : bounds.minY,
+				(normal.GetZ() >= 0.0f) ? bounds.maxZ : bounds.minZ);
+
+			if (IsOutside(plane, corner, 0.0f))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	// Leaves slack for the rounding of the plane distance, so that a sphere grazing a plane is never culled from
+	// a ray that hits it
+	static bool IsOutside(const Math::BoundingPlane& plane, const Math::Vector3& point, float radius)
+	{
+		const Math::Vector4 repr = plane;
+		const float distance = plane.DistanceFromPoint(point);
+		const float scale = Math::Dot(Math::Abs(point), Math::Abs(plane.GetNormal())) + Math::Abs(float(repr.GetW())) + radius;
+		return distance + radius < -1e-5f * scale;
+	}
+};
\ No newline at end of file
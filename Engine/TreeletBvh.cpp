@@ -0,0 +1,136 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "TreeletBvh.h"
+
+#include <queue>
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr size_t PAIRS_PER_PAGE = TREELET_BVH_PAGE_SIZE / (2 * sizeof(BvhNode));
+
+
+// The children of an interior node of the Bvh, not placed yet
+struct PendingPair
+{
+	float		area;		// Surface area of the parent, in proportion to the chance a ray visits the pair
+	uint32_t	source;		// Parent in the Bvh
+	uint32_t	parent;		// Parent in the reordered nodes, whose offset is patched when the pair is placed
+
+	// Largest area first, then in depth-first order
+	bool operator<(const PendingPair& other) const
+	{
+		return (area != other.area) ? (area < other.area) : (source > other.source);
+	}
+};
+
+} // anonymous namespace
+
+
+void TreeletBvh::Build(const Bvh& bvh)
+{
+	Clear();
+
+	const BvhNode* nodes = bvh.GetNodes();
+	const size_t numNodes = bvh.GetNumNodes();
+	if (numNodes == 0)
+	{
+		return;
+	}
+
+	// The root shares its cache line with an unused node, so that every pair after it starts a line
+	m_nodeStorage.reserve(numNodes + 1);
+	m_nodeStorage.push_back(nodes[0]);
+	m_nodeStorage.push_back(BvhNode{});
+
+	priority_queue<PendingPair> treeletRoots;
+	priority_queue<PendingPair> frontier;
+
+	if (!nodes[0].IsLeaf())
+	{
+		treeletRoots.push(PendingPair{ nodes[0].GetBounds().SurfaceArea(), 0, 0 });
+	}
+
+	while (!treeletRoots.empty())
+	{
+		frontier.push(treeletRoots.top());
+		treeletRoots.pop();
+
+		// A treelet fills the rest of the current page, or ends early when its subtree does
+		size_t pairsLeft = PAIRS_PER_PAGE - (m_nodeStorage.size() / 2) % PAIRS_PER_PAGE;
+		while (!frontier.empty() && pairsLeft > 0)
+		{
+			const PendingPair pair = frontier.top();
+			frontier.pop();
+
+			const uint32_t index = static_cast<uint32_t>(m_nodeStorage.size());
+			m_nodeStorage[pair.parent].offset = index;
+
+			const uint32_t children[2] = { pair.source + 1, nodes[pair.source].offset };
+			for (uint32_t child = 0; child < 2; ++child)
+			{
+				BvhNode node = nodes[children[child]];
+				if (!node.IsLeaf())
+				{
+					frontier.push(PendingPair{ node.GetBounds().SurfaceArea(), children[child], index + child });
+					node.offset = 0;
+				}
+				m_nodeStorage.push_back(node);
+			}
+
+			--pairsLeft;
+		}
+
+		// Pairs the page could not hold root treelets of their own
+		while (!frontier.empty())
+		{
+			treeletRoots.push(frontier.top());
+			frontier.pop();
+		}
+	}
+
+	m_nodes = m_nodeStorage.data();
+	m_numNodes = m_nodeStorage.size();
+}
+
+
+void TreeletBvh::Attach(const BvhNode* nodes, size_t numNodes)
+{
+	Clear();
+
+	m_nodes = nodes;
+	m_numNodes = numNodes;
+}
+
+
+void TreeletBvh::Clear()
+{
+	FreeVector(m_nodeStorage);
+	m_nodes = nullptr;
+	m_numNodes = 0;
+}
+
+
+BvhBounds TreeletBvh::GetBounds() const
+{
+	BvhBounds bounds;
+	if (m_numNodes > 0)
+	{
+		bounds.Grow(m_nodes[0].minX, m_nodes[0].minY, m_nodes[0].minZ);
+		bounds.Grow(m_nodes[0].maxX, m_nodes[0].maxY, m_nodes[0].maxZ);
+	}
+	return bounds;
+}
\ No newline at end of file
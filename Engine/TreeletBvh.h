@@ -0,0 +1,204 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+
+
+// Treelets fill the pages of the node array
+constexpr size_t TREELET_BVH_PAGE_SIZE = 4096;
+
+
+// A built Bvh with its nodes reordered for the memory system.  Siblings are stored as pairs on one 64 byte cache
+// line, so testing both children of a node reads one line instead of two.  The pairs are then grouped into
+// treelets, each filling what is left of a 4 KB page: starting from the most probable pair not yet placed, a
+// treelet grows by the pair whose parent has the largest surface area, i.e. the pair a ray that reached the
+// treelet most likely visits next.  A ray walking down the tree then stays on one page for several levels.
+//
+// Nodes are BvhNodes, with the root at index 0 and an unused node at index 1.  Interior nodes store the index of
+// their pair of children in offset, and leaves are the same as in the Bvh.
+class TreeletBvh
+{
+public:
+	// The primitive slots stay where the Bvh put them
+	void Build(const Bvh& bvh);
+
+	// Attach externally owned (e.g. memory-mapped) nodes instead of building
+	void Attach(const BvhNode* nodes, size_t numNodes);
+	void Clear();
+
+	const BvhNode* GetNodes() const { return m_nodes; }
+	size_t GetNumNodes() const { return m_numNodes; }
+	BvhBounds GetBounds() const;
+	size_t GetMemoryUsage() const { return m_numNodes * sizeof(BvhNode); }
+
+	// Front-to-back traversal, same as Bvh::Intersect
+	template <bool CountNodeFetches = false, typename LeafFunc>
+	void Intersect(Ray& ray, LeafFunc&& leafFunc) const;
+
+	// Same as Bvh::Visit
+	template <typename NodeFunc, typename LeafFunc>
+	void Visit(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const;
+
+private:
+	std::vector<BvhNode, aligned_allocator<BvhNode, TREELET_BVH_PAGE_SIZE>>	m_nodeStorage;
+
+	const BvhNode*	m_nodes{ nullptr };
+	size_t			m_numNodes{ 0 };
+};
+
+
+template <bool CountNodeFetches, typename LeafFunc>
+void TreeletBvh::Intersect(Ray& ray, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0)
+	{
+		return;
+	}
+
+	const float invDirX = 1.0f / ray.dirX;
+	const float invDirY = 1.0f / ray.dirY;
+	const float invDirZ = 1.0f / ray.dirZ;
+
+	if (CountNodeFetches)
+	{
+		CountNodeFetch(&m_nodes[0]);
+	}
+
+	float tEntry = 0.0f;
+	if (!IntersectBvhNode(m_nodes[0], ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tEntry))
+	{
+		return;
+	}
+
+	uint32_t stack[64];
+	float stackT[64];
+	int stackSize = 0;
+
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const BvhNode& node = m_nodes[nodeIndex];
+
+		if (node.IsLeaf())
+		{
+			leafFunc(node.offset, node.count);
+		}
+		else
+		{
+			const uint32_t leftIndex = node.offset;
+			const uint32_t rightIndex = node.offset + 1;
+
+			if (CountNodeFetches)
+			{
+				CountNodeFetch(&m_nodes[leftIndex]);
+				CountNodeFetch(&m_nodes[rightIndex]);
+			}
+
+			float tLeft = 0.0f;
+			float tRight = 0.0f;
+			bool hitLeft = IntersectBvhNode(m_nodes[leftIndex], ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tLeft);
+			bool hitRight = IntersectBvhNode(m_nodes[rightIndex], ray.posX, ray.posY, ray.posZ, invDirX, invDirY, invDirZ, ray.tmin, ray.tmax, tRight);
+
+			if (hitLeft && hitRight)
+			{
+				// Visit the nearer child first, defer the other one
+				if (tRight < tLeft)
+				{
+					stack[stackSize] = leftIndex;
+					stackT[stackSize++] = tLeft;
+					nodeIndex = rightIndex;
+				}
+				else
+				{
+					stack[stackSize] = rightIndex;
+					stackT[stackSize++] = tRight;
+					nodeIndex = leftIndex;
+				}
+				continue;
+			}
+			else if (hitLeft)
+			{
+				nodeIndex = leftIndex;
+				continue;
+			}
+			else if (hitRight)
+			{
+				nodeIndex = rightIndex;
+				continue;
+			}
+		}
+
+		// Pop the next node, skipping any that are now further away than the closest hit
+		do
+		{
+			if (stackSize == 0)
+			{
+				return;
+			}
+			--stackSize;
+		} while (stackT[stackSize] > ray.tmax);
+
+		nodeIndex = stack[stackSize];
+	}
+}
+
+
+template <typename NodeFunc, typename LeafFunc>
+void TreeletBvh::Visit(NodeFunc&& nodeFunc, LeafFunc&& leafFunc) const
+{
+	if (m_numNodes == 0 || !nodeFunc(m_nodes[0]))
+	{
+		return;
+	}
+
+	uint32_t stack[64];
+	int stackSize = 0;
+
+	uint32_t nodeIndex = 0;
+	for (;;)
+	{
+		const BvhNode& node = m_nodes[nodeIndex];
+
+		if (node.IsLeaf())
+		{
+			leafFunc(node.offset, node.count);
+		}
+		else
+		{
+			const uint32_t leftIndex = node.offset;
+			const uint32_t rightIndex = node.offset + 1;
+			const bool visitLeft = nodeFunc(m_nodes[leftIndex]);
+			const bool visitRight = nodeFunc(m_nodes[rightIndex]);
+
+			if (visitLeft && visitRight)
+			{
+				stack[stackSize++] = rightIndex;
+				nodeIndex = leftIndex;
+				continue;
+			}
+			else if (visitLeft)
+			{
+				nodeIndex = leftIndex;
+				continue;
+			}
+			else if (visitRight)
+			{
+				nodeIndex = rightIndex;
+				continue;
+			}
+		}
+
+		if (stackSize == 0)
+		{
+			return;
+		}
+		nodeIndex = stack[--stackSize];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,501 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "TriangleAccel.h"
+
+#include "BakedFile.h"
+#include "Hash.h"
+#include "MeshLoader.h"
+#include "Scene.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+constexpr uint32_t TAG_TRIANGLE_NODES = MakeBakedTag('T', 'N', 'O', 'D');
+constexpr uint32_t TAG_TRIANGLE_IDS = MakeBakedTag('T', 'I', 'D', 'S');
+constexpr uint32_t TAG_TRIANGLE_DATA[9] =
+{
+	MakeBakedTag('T', 'V', '0', 'X'),
+	MakeBakedTag('T', 'V', '0', 'Y'),
+	MakeBakedTag('T', 'V', '0', 'Z'),
+	MakeBakedTag('T', 'E', '1', 'X'),
+	MakeBakedTag('T', 'E', '1', 'Y'),
+	MakeBakedTag('T', 'E', '1', 'Z'),
+	MakeBakedTag('T', 'E', '2', 'X'),
+	MakeBakedTag('T', 'E', '2', 'Y'),
+	MakeBakedTag('T', 'E', '2', 'Z')
+};
+
+} // anonymous namespace
+
+
+// Moller-Trumbore over a range of leaf slots.  Shrinks ray.tmax and records the slot on a closer hit.
+template<int N>
+void IntersectTriangles(const TriangleList& triangleList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	Float<N> rayOrigX = Float<N>::Broadcast(ray.posX);
+	Float<N> rayOrigY = Float<N>::Broadcast(ray.posY);
+	Float<N> rayOrigZ = Float<N>::Broadcast(ray.posZ);
+	Float<N> rayDirX = Float<N>::Broadcast(ray.dirX);
+	Float<N> rayDirY = Float<N>::Broadcast(ray.dirY);
+	Float<N> rayDirZ = Float<N>::Broadcast(ray.dirZ);
+
+	Float<N> tmin = Float<N>::Broadcast(ray.tmin);
+	Float<N> hitT = Float<N>::Broadcast(ray.tmax);
+	UInt<N> slot(0xffffffff);
+
+	const Float<N> zero(0.0f);
+	const Float<N> one(1.0f);
+
+	const size_t last = first + count;
+	for (size_t i = first; i < last; i += N)
+	{
+		Float<N> e1X = Float<N>::Load(triangleList.e1X + i);
+		Float<N> e1Y = Float<N>::Load(triangleList.e1Y + i);
+		Float<N> e1Z = Float<N>::Load(triangleList.e1Z + i);
+		Float<N> e2X = Float<N>::Load(triangleList.e2X + i);
+		Float<N> e2Y = Float<N>::Load(triangleList.e2Y + i);
+		Float<N> e2Z = Float<N>::Load(triangleList.e2Z + i);
+
+		// p = dir x e2
+		Float<N> pX = rayDirY * e2Z - rayDirZ * e2Y;
+		Float<N> pY = rayDirZ * e2X - rayDirX * e2Z;
+		Float<N> pZ = rayDirX * e2Y - rayDirY * e2X;
+
+		Float<N> det = e1X * pX + e1Y * pY + e1Z * pZ;
+		Float<N> invDet = one / det;
+
+		Float<N> tX = rayOrigX - Float<N>::Load(triangleList.v0X + i);
+		Float<N> tY = rayOrigY - Float<N>::Load(triangleList.v0Y + i);
+		Float<N> tZ = rayOrigZ - Float<N>::Load(triangleList.v0Z + i);
+
+		Float<N> u = (tX * pX + tY * pY + tZ * pZ) * invDet;
+
+		// q = t x e1
+		Float<N> qX = tY * e1Z - tZ * e1Y;
+		Float<N> qY = tZ * e1X - tX * e1Z;
+		Float<N> qZ = tX * e1Y - tY * e1X;
+
+		Float<N> v = (rayDirX * qX + rayDirY * qY + rayDirZ * qZ) * invDet;
+		Float<N> t = (e2X * qX + e2Y * qY + e2Z * qZ) * invDet;
+
+		// Padding slots have zero edges, so det == 0 rejects them
+		Bool<N> mask = (det != zero) & (u >= zero) & (v >= zero) & ((u + v) <= one) & (t > tmin) & (t < hitT);
+
+		if (Any(mask))
+		{
+			hitT = Select(mask, t, hitT);
+			slot = Select(mask, UInt<N>(static_cast<uint32_t>(i)), slot);
+		}
+	}
+
+	float minT = ReduceMin(hitT);
+	if (minT < ray.tmax)
+	{
+		uint32_t minMask = Mask(hitT == Float<N>(minT));
+		uint32_t slots[N];
+		UInt<N>::StoreU(slots, slot);
+		for (int lane = 0; lane < N; ++lane)
+		{
+			if (minMask & (1 << lane))
+			{
+				hitSlot = slots[lane] + lane;
+				ray.tmax = minT;
+				break;
+			}
+		}
+	}
+}
+
+
+template<>
+void IntersectTriangles<1>(const TriangleList& triangleList, size_t first, size_t count, Ray& ray, uint32_t& hitSlot)
+{
+	const size_t last = first + count;
+	for (size_t i = first; i < last; ++i)
+	{
+		const float e1X = triangleList.e1X[i];
+		const float e1Y = triangleList.e1Y[i];
+		const float e1Z = triangleList.e1Z[i];
+		const float e2X = triangleList.e2X[i];
+		const float e2Y = triangleList.e2Y[i];
+		const float e2Z = triangleList.e2Z[i];
+
+		float pX = ray.dirY * e2Z - ray.dirZ * e2Y;
+		float pY = ray.dirZ * e2X - ray.dirX * e2Z;
+		float pZ = ray.dirX * e2Y - ray.dirY * e2X;
+
+		float det = e1X * pX + e1Y * pY + e1Z * pZ;
+		if (det == 0.0f)
+		{
+			continue;
+		}
+		float invDet = 1.0f / det;
+
+		float tX = ray.posX - triangleList.v0X[i];
+		float tY = ray.posY - triangleList.v0Y[i];
+		float tZ = ray.posZ - triangleList.v0Z[i];
+
+		float u = (tX * pX + tY * pY + tZ * pZ) * invDet;
+		if (u < 0.0f || u > 1.0f)
+		{
+			continue;
+		}
+
+		float qX = tY * e1Z - tZ * e1Y;
+		float qY = tZ * e1X - tX * e1Z;
+		float qZ = tX * e1Y - tY * e1X;
+
+		float v = (ray.dirX * qX + ray.dirY * qY + ray.dirZ * qZ) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			continue;
+		}
+
+		float t = (e2X * qX + e2Y * qY + e2Z * qZ) * invDet;
+		if (t > ray.tmin && t < ray.tmax)
+		{
+			ray.tmax = t;
+			hitSlot = static_cast<uint32_t>(i);
+		}
+	}
+}
+
+
+TriangleAccelerator::TriangleAccelerator(Scene* scene)
+	: m_scene(scene)
+{}
+
+
+void TriangleAccelerator::AddMesh(const TriangleMesh& mesh, uint32_t baseId)
+{
+	if (m_loaded)
+	{
+		UnloadAccel();
+	}
+
+	if (m_ids.empty())
+	{
+		m_idBase = baseId;
+	}
+	assert(baseId >= m_idBase);
+
+	const size_t numTriangles = mesh.GetNumTriangles();
+	m_positions.reserve(m_positions.size() + numTriangles * 9);
+	m_ids.reserve(m_ids.size() + numTriangles);
+
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		for (size_t j = 0; j < 3; ++j)
+		{
+			const float* vertex = &mesh.positions[3 * mesh.indices[3 * i + j]];
+			m_positions.insert(m_positions.end(), vertex, vertex + 3);
+		}
+		m_ids.push_back(baseId - m_idBase + (mesh.materialIds.empty() ? 0 : mesh.materialIds[i]));
+	}
+
+	m_dirty = true;
+}
+
+
+template <int N>
+void TriangleAccelerator::IntersectBvh(Ray& ray, Hit& hit) const
+{
+	uint32_t hitSlot = INVALID_PRIMITIVE;
+
+	m_bvh.Intersect(ray, [&](uint32_t first, uint32_t count)
+	{
+		IntersectTriangles<N>(m_triangleList, first, count, ray, hitSlot);
+	});
+
+	if (hitSlot != INVALID_PRIMITIVE)
+	{
+		const float e1X = m_triangleList.e1X[hitSlot];
+		const float e1Y = m_triangleList.e1Y[hitSlot];
+		const float e1Z = m_triangleList.e1Z[hitSlot];
+		const float e2X = m_triangleList.e2X[hitSlot];
+		const float e2Y = m_triangleList.e2Y[hitSlot];
+		const float e2Z = m_triangleList.e2Z[hitSlot];
+
+		// Geometric normal, following the winding order, so outward for counter-clockwise meshes
+		float nX = e1Y * e2Z - e1Z * e2Y;
+		float nY = e1Z * e2X - e1X * e2Z;
+		float nZ = e1X * e2Y - e1Y * e2X;
+		float invLength = 1.0f / sqrtf(nX * nX + nY * nY + nZ * nZ);
+
+		hit.normalX = nX * invLength;
+		hit.normalY = nY * invLength;
+		hit.normalZ = nZ * invLength;
+		hit.geomId = m_idBase + m_triangleList.id[hitSlot];
+	}
+}
+
+
+void TriangleAccelerator::Intersect1(Ray& ray, Hit& hit) const
+{
+	assert(!m_dirty);
+
+	const auto simdSize = m_scene->GetSimdSize();
+
+	if (simdSize == 1)
+	{
+		IntersectBvh<1>(ray, hit);
+	}
+	else if (simdSize == 4)
+	{
+		IntersectBvh<4>(ray, hit);
+	}
+	else if (simdSize == 8)
+	{
+		IntersectBvh<8>(ray, hit);
+	}
+}
+
+
+void TriangleAccelerator::Commit()
+{
+	if (!m_dirty)
+	{
+		return;
+	}
+
+	const auto simdSize = m_scene->GetSimdSize();
+	const size_t numTriangles = m_ids.size();
+
+	vector<BvhBounds> bounds(numTriangles);
+	for (size_t i = 0; i < numTriangles; ++i)
+	{
+		const float* p = &m_positions[9 * i];
+		bounds[i].Grow(p[0], p[1], p[2]);
+		bounds[i].Grow(p[3], p[4], p[5]);
+		bounds[i].Grow(p[6], p[7], p[8]);
+	}
+
+	m_bvh.Build(bounds, simdSize, 2 * simdSize);
+
+	// Lay the triangles out in leaf order.  Padding slots get zero edges and an invalid id.
+	const auto& slots = m_bvh.GetPrimitiveSlots();
+	const size_t numSlots = slots.size();
+
+	m_v0X.assign(numSlots, 0.0f);
+	m_v0Y.assign(numSlots, 0.0f);
+	m_v0Z.assign(numSlots, 0.0f);
+	m_e1X.assign(numSlots, 0.0f);
+	m_e1Y.assign(numSlots, 0.0f);
+	m_e1Z.assign(numSlots, 0.0f);
+	m_e2X.assign(numSlots, 0.0f);
+	m_e2Y.assign(numSlots, 0.0f);
+	m_e2Z.assign(numSlots, 0.0f);
+	m_slotIds.assign(numSlots, INVALID_PRIMITIVE);
+
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		const uint32_t index = slots[i];
+		if (index == INVALID_PRIMITIVE)
+		{
+			continue;
+		}
+
+		const float* p = &m_positions[9 * index];
+		m_v0X[i] = p[0];
+		m_v0Y[i] = p[1];
+		m_v0Z[i] = p[2];
+		m_e1X[i] = p[3] - p[0];
+		m_e1Y[i] = p[4] - p[1];
+		m_e1Z[i] = p[5] - p[2];
+		m_e2X[i] = p[6] - p[0];
+		m_e2Y[i] = p[7] - p[1];
+		m_e2Z[i] = p[8] - p[2];
+		m_slotIds[i] = m_ids[index];
+	}
+
+	m_triangleList.v0X = m_v0X.data();
+	m_triangleList.v0Y = m_v0Y.data();
+	m_triangleList.v0Z = m_v0Z.data();
+	m_triangleList.e1X = m_e1X.data();
+	m_triangleList.e1Y = m_e1Y.data();
+	m_triangleList.e1Z = m_e1Z.data();
+	m_triangleList.e2X = m_e2X.data();
+	m_triangleList.e2Y = m_e2Y.data();
+	m_triangleList.e2Z = m_e2Z.data();
+	m_triangleList.id = m_slotIds.data();
+	m_triangleList.numSlots = numSlots;
+
+	m_dirty = false;
+}
+
+
+BvhBounds TriangleAccelerator::GetBounds() const
+{
+	return m_bvh.GetBounds();
+}
+
+
+size_t TriangleAccelerator::GetMemoryUsage() const
+{
+	return m_triangleList.numSlots * (9 * sizeof(float) + sizeof(uint32_t)) + m_bvh.GetMemoryUsage();
+}
+
+
+size_t TriangleAccelerator::GetIdCount() const
+{
+	// A baked scene has no input triangles, only the loaded ones
+	return m_ids.empty() ? ::GetIdCount(m_triangleList.id, m_triangleList.numSlots) : ::GetIdCount(m_ids.data(), m_ids.size());
+}
+
+
+bool TriangleAccelerator::AreBakedIdsValid(const BakedFileReader& reader, size_t idCount)
+{
+	size_t numSlots = 0;
+	const uint32_t* ids = reader.FindSection<uint32_t>(TAG_TRIANGLE_IDS, numSlots);
+	return ids && AreSlotIdsValid(ids, numSlots, idCount);
+}
+
+
+uint64_t TriangleAccelerator::GetContentHash() const
+{
+	if (m_loaded && m_ids.empty())
+	{
+		return m_loadedHash;
+	}
+
+	return HashCombine(HashVector(m_positions), HashVector(m_ids));
+}
+
+
+void TriangleAccelerator::SaveAccel(BakedFileWriter& writer) const
+{
+	assert(!m_dirty);
+
+	const float* arrays[9] =
+	{
+		m_triangleList.v0X, m_triangleList.v0Y, m_triangleList.v0Z,
+		m_triangleList.e1X, m_triangleList.e1Y, m_triangleList.e1Z,
+		m_triangleList.e2X, m_triangleList.e2Y, m_triangleList.e2Z
+	};
+
+	writer.AddSection(TAG_TRIANGLE_NODES, m_bvh.GetNodes(), m_bvh.GetNumNodes() * sizeof(BvhNode));
+	writer.AddSection(TAG_TRIANGLE_IDS, m_triangleList.id, m_triangleList.numSlots * sizeof(uint32_t));
+	for (size_t i = 0; i < 9; ++i)
+	{
+		writer.AddSection(TAG_TRIANGLE_DATA[i], arrays[i], m_triangleList.numSlots * sizeof(float));
+	}
+}
+
+
+bool TriangleAccelerator::LoadAccel(const BakedFileReader& reader)
+{
+	// Leaves padded for a wider SIMD width are still valid for a narrower one, but not the other way around
+	const auto simdSize = m_scene->GetSimdSize();
+	if (reader.GetSimdSize() % simdSize != 0)
+	{
+		return false;
+	}
+
+	size_t numNodes = 0;
+	const BvhNode* nodes = reader.FindSection<BvhNode>(TAG_TRIANGLE_NODES, numNodes);
+
+	size_t numSlots = 0;
+	const uint32_t* ids = reader.FindSection<uint32_t>(TAG_TRIANGLE_IDS, numSlots);
+
+	const float* arrays[9];
+	for (size_t i = 0; i < 9; ++i)
+	{
+		size_t count = 0;
+		arrays[i] = reader.FindSection<float>(TAG_TRIANGLE_DATA[i], count);
+		if (!arrays[i] || count != numSlots)
+		{
+			return false;
+		}
+	}
+
+	if (!nodes || !ids || numNodes == 0)
+	{
+		return false;
+	}
+
+	// A damaged file is rebuilt rather than read out of bounds.  Ids must stay within those of the triangles added
+	// or loaded so far.  A baked scene is loaded into an empty accelerator, and Scene::LoadBaked checks its ids.
+	if (!Bvh::IsValid(nodes, numNodes, numSlots, simdSize))
+	{
+		return false;
+	}
+	if ((!m_ids.empty() || m_loaded) && !AreSlotIdsValid(ids, numSlots, GetIdCount()))
+	{
+		return false;
+	}
+
+	// The input triangles are kept, in case the accelerator gets unloaded and rebuilt later
+	FreeVector(m_v0X); FreeVector(m_v0Y); FreeVector(m_v0Z);
+	FreeVector(m_e1X); FreeVector(m_e1Y); FreeVector(m_e1Z);
+	FreeVector(m_e2X); FreeVector(m_e2Y); FreeVector(m_e2Z);
+	FreeVector(m_slotIds);
+
+	m_triangleList.v0X = arrays[0];
+	m_triangleList.v0Y = arrays[1];
+	m_triangleList.v0Z = arrays[2];
+	m_triangleList.e1X = arrays[3];
+	m_triangleList.e1Y = arrays[4];
+	m_triangleList.e1Z = arrays[5];
+	m_triangleList.e2X = arrays[6];
+	m_triangleList.e2Y = arrays[7];
+	m_triangleList.e2Z = arrays[8];
+	m_triangleList.id = ids;
+	m_triangleList.numSlots = numSlots;
+
+	m_bvh.Attach(nodes, numNodes);
+
+	m_loadedHash = reader.GetContentHash();
+	m_loaded = true;
+	m_dirty = false;
+
+	return true;
+}
+
+
+void TriangleAccelerator::UnloadAccel()
+{
+	if (!m_loaded)
+	{
+		return;
+	}
+
+	// A baked scene has no input triangles, so pull the loaded ones back into the input arrays before the
+	// mapping goes away
+	const size_t numSlots = m_ids.empty() ? m_triangleList.numSlots : 0;
+	for (size_t i = 0; i < numSlots; ++i)
+	{
+		if (m_triangleList.id[i] == INVALID_PRIMITIVE)
+		{
+			continue;
+		}
+
+		const float v0[3] = { m_triangleList.v0X[i], m_triangleList.v0Y[i], m_triangleList.v0Z[i] };
+		m_positions.insert(m_positions.end(), v0, v0 + 3);
+		m_positions.push_back(v0[0] + m_triangleList.e1X[i]);
+		m_positions.push_back(v0[1] + m_triangleList.e1Y[i]);
+		m_positions.push_back(v0[2] + m_triangleList.e1Z[i]);
+		m_positions.push_back(v0[0] + m_triangleList.e2X[i]);
+		m_positions.push_back(v0[1] + m_triangleList.e2Y[i]);
+		m_positions.push_back(v0[2] + m_triangleList.e2Z[i]);
+		m_ids.push_back(m_triangleList.id[i]);
+	}
+
+	m_triangleList = TriangleList();
+	m_bvh.Clear();
+
+	m_loaded = false;
+	m_dirty = true;
+}
\ No newline at end of file
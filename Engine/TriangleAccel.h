@@ -0,0 +1,111 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Bvh.h"
+#include "IAccelerator.h"
+
+
+// Forward declarations
+class BakedFileReader;
+class BakedFileWriter;
+class Scene;
+struct TriangleMesh;
+
+
+// View over triangle data in BVH leaf order (vertex 0 plus the two edges from it), padded per leaf to a
+// multiple of the SIMD width.  The arrays are either owned by the accelerator or point into a mapped baked file.
+// Ids are relative to the accelerator's id base.
+struct TriangleList
+{
+	const float*	v0X{ nullptr };
+	const float*	v0Y{ nullptr };
+	const float*	v0Z{ nullptr };
+	const float*	e1X{ nullptr };
+	const float*	e1Y{ nullptr };
+	const float*	e1Z{ nullptr };
+	const float*	e2X{ nullptr };
+	const float*	e2Y{ nullptr };
+	const float*	e2Z{ nullptr };
+	const uint32_t*	id{ nullptr };
+
+	size_t			numSlots{ 0 };
+};
+
+
+class TriangleAccelerator : public IAccelerator
+{
+public:
+	TriangleAccelerator(Scene* scene);
+
+	PrimitiveType GetPrimitiveType() const final
+	{
+		return PrimitiveType::Triangle;
+	}
+
+	// Each triangle gets id baseId + its material index in the mesh.  Ids are stored relative to the baseId of the
+	// first mesh, the id base, so that baked and cached data does not depend on where the mesh materials start in
+	// the scene's material table.  Later meshes need a baseId no smaller than the first.
+	void AddMesh(const TriangleMesh& mesh, uint32_t baseId);
+
+	// The id base is added to the stored id on every hit.  A baked scene sets it to where its materials start.
+	uint32_t GetIdBase() const { return m_idBase; }
+	void SetIdBase(uint32_t idBase) { m_idBase = idBase; }
+
+	// One more than the largest stored id, i.e. the number of materials from the id base that the triangles use
+	size_t GetIdCount() const;
+
+	// Whether every triangle in a baked file has a stored id below idCount
+	static bool AreBakedIdsValid(const BakedFileReader& reader, size_t idCount);
+
+	// Intersection methods
+	void Intersect1(Ray& ray, Hit& hit) const final;
+
+	void Commit() final;
+	BvhBounds GetBounds() const final;
+	size_t GetMemoryUsage() const final;
+
+	// Built state caching.  A baked scene may be loaded with no input triangles at all, in which case the
+	// content hash is taken from the file.
+	uint64_t GetContentHash() const final;
+	void SaveAccel(BakedFileWriter& writer) const final;
+	bool LoadAccel(const BakedFileReader& reader) final;
+	void UnloadAccel() final;
+
+private:
+	template <int N>
+	void IntersectBvh(Ray& ray, Hit& hit) const;
+
+private:
+	Scene*					m_scene;
+
+	// Input triangles, 9 floats each
+	std::vector<float>		m_positions;
+	std::vector<uint32_t>	m_ids;
+
+	// Built data in leaf order
+	std::vector<float, aligned_allocator<float, 64>>		m_v0X;
+	std::vector<float, aligned_allocator<float, 64>>		m_v0Y;
+	std::vector<float, aligned_allocator<float, 64>>		m_v0Z;
+	std::vector<float, aligned_allocator<float, 64>>		m_e1X;
+	std::vector<float, aligned_allocator<float, 64>>		m_e1Y;
+	std::vector<float, aligned_allocator<float, 64>>		m_e1Z;
+	std::vector<float, aligned_allocator<float, 64>>		m_e2X;
+	std::vector<float, aligned_allocator<float, 64>>		m_e2Y;
+	std::vector<float, aligned_allocator<float, 64>>		m_e2Z;
+	std::vector<uint32_t, aligned_allocator<uint32_t, 64>>	m_slotIds;
+
+	TriangleList	m_triangleList;
+	Bvh				m_bvh;
+
+	uint32_t		m_idBase{ 0 };
+	uint64_t		m_loadedHash{ 0 };
+	bool			m_loaded{ false };
+	bool			m_dirty{ false };
+};
\ No newline at end of file
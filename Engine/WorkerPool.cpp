@@ -0,0 +1,257 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "WorkerPool.h"
+
+
+using namespace std;
+
+
+namespace
+{
+
+struct NodeProcessors
+{
+	GROUP_AFFINITY		mask;			// Every logical processor of the node
+	vector<uint8_t>		processors;		// Bit indices into mask
+};
+
+
+// Logical processors of every NUMA node, in node order.  A node spanning more than one processor group (over 64
+// logical processors) only reports its first group.
+vector<NodeProcessors> GetNodeProcessors()
+{
+	vector<NodeProcessors> nodes;
+
+	DWORD length = 0;
+	GetLogicalProcessorInformationEx(RelationNumaNode, nullptr, &length);
+	if (length == 0)
+	{
+		return nodes;
+	}
+
+	vector<uint8_t> buffer(length);
+	if (!GetLogicalProcessorInformationEx(RelationNumaNode, reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(buffer.data()), &length))
+	{
+		return nodes;
+	}
+
+	for (DWORD offset = 0; offset < length; )
+	{
+		const auto& entry = *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+		if (entry.Relationship == RelationNumaNode)
+		{
+			NodeProcessors node;
+			node.mask = entry.NumaNode.GroupMask;
+			for (uint8_t bit = 0; bit < 64; ++bit)
+			{
+				if (node.mask.Mask & (KAFFINITY(1) << bit))
+				{
+					node.processors.push_back(bit);
+				}
+			}
+
+			if (!node.processors.empty())
+			{
+				nodes.push_back(node);
+			}
+		}
+		offset += entry.Size;
+	}
+
+	return nodes;
+}
+
+
+thread_local int t_node = 0;
+
+} // anonymous namespace
+
+
+WorkerPool::WorkerPool(const WorkerPoolConfig& config)
+{
+	const vector<NodeProcessors> nodes = GetNodeProcessors();
+
+	// The logical processors in the order workers are assigned to them, as (node, bit) pairs
+	vector<pair<int, uint8_t>> slots;
+	if (config.placement == NodePlacement::Compact)
+	{
+		for (size_t node = 0; node < nodes.size(); ++node)
+		{
+			for (uint8_t bit : nodes[node].processors)
+			{
+				slots.emplace_back(static_cast<int>(node), bit);
+			}
+		}
+	}
+	else
+	{
+		for (size_t i = 0; ; ++i)
+		{
+			bool added = false;
+			for (size_t node = 0; node < nodes.size(); ++node)
+			{
+				if (i < nodes[node].processors.size())
+				{
+					slots.emplace_back(static_cast<int>(node), nodes[node].processors[i]);
+					added = true;
+				}
+			}
+
+			if (!added)
+			{
+				break;
+			}
+		}
+	}
+
+	int numThreads = config.numThreads;
+	if (numThreads <= 0)
+	{
+		numThreads = slots.empty() ? max(static_cast<int>(thread::hardware_concurrency()), 1) : static_cast<int>(slots.size());
+	}
+
+	// Without pinning, or without topology information, the workers migrate freely, so there is a single node
+	const bool pinned = config.pinning != ThreadPinning::None && !slots.empty();
+
+	vector<GROUP_AFFINITY> affinities(numThreads);
+	m_threadNodes.resize(numThreads, 0);
+	m_numNodes = 1;
+
+	if (pinned)
+	{
+		// Nodes are numbered in order of first use, so the nodes with workers are 0 .. m_numNodes - 1
+		vector<int> nodeIndices(nodes.size(), -1);
+		int numNodes = 0;
+
+		for (int i = 0; i < numThreads; ++i)
+		{
+			// More workers than logical processors wrap around
+			const auto& slot = slots[i % slots.size()];
+			const NodeProcessors& node = nodes[slot.first];
+
+			if (nodeIndices[slot.first] < 0)
+			{
+				nodeIndices[slot.first] = numNodes++;
+			}
+			m_threadNodes[i] = nodeIndices[slot.first];
+
+			affinities[i] = node.mask;
+			if (config.pinning == ThreadPinning::Core)
+			{
+				affinities[i].Mask = KAFFINITY(1) << slot.second;
+			}
+		}
+
+		m_numNodes = numNodes;
+	}
+
+	m_threads.reserve(numThreads);
+	for (int i = 0; i < numThreads; ++i)
+	{
+		const GROUP_AFFINITY affinity = affinities[i];
+		m_threads.emplace_back([this, i, affinity, pinned]()
+		{
+			if (pinned)
+			{
+				SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+			}
+			WorkerMain(i);
+		});
+	}
+}
+
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_workReady.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+
+void WorkerPool::Run(const function<void(int)>& func)
+{
+	unique_lock<mutex> lock(m_mutex);
+
+	m_work = &func;
+	m_numBusy = GetNumThreads();
+	++m_generation;
+	m_workReady.notify_all();
+
+	m_workDone.wait(lock, [this] { return m_numBusy == 0; });
+	m_work = nullptr;
+}
+
+
+void WorkerPool::RunOnNodes(const function<void(int)>& func)
+{
+	// The first worker of each node runs func, the others return straight away
+	Run([this, &func](int threadIndex)
+	{
+		const int node = m_threadNodes[threadIndex];
+		if (find(m_threadNodes.begin(), m_threadNodes.end(), node) - m_threadNodes.begin() == threadIndex)
+		{
+			func(node);
+		}
+	});
+}
+
+
+int WorkerPool::GetCurrentNode()
+{
+	return t_node;
+}
+
+
+int WorkerPool::GetSystemNodeCount()
+{
+	return max(static_cast<int>(GetNodeProcessors().size()), 1);
+}
+
+
+void WorkerPool::WorkerMain(int threadIndex)
+{
+	t_node = m_threadNodes[threadIndex];
+
+	uint64_t generation = 0;
+	for (;;)
+	{
+		const function<void(int)>* work = nullptr;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_workReady.wait(lock, [this, generation] { return m_exit || m_generation != generation; });
+			if (m_exit)
+			{
+				return;
+			}
+
+			generation = m_generation;
+			work = m_work;
+		}
+
+		(*work)(threadIndex);
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (--m_numBusy == 0)
+			{
+				m_workDone.notify_one();
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+enum class ThreadPinning
+{
+	None,	// The OS places and migrates the workers freely
+	Node,	// Each worker may run on any logical processor of its NUMA node
+	Core	// Each worker is bound to a single logical processor
+};
+
+
+enum class NodePlacement
+{
+	Compact,	// Fill the logical processors of one node before using the next
+	Scatter		// Deal workers round-robin over the nodes
+};
+
+
+struct WorkerPoolConfig
+{
+	int				numThreads{ 0 };	// 0 uses every logical processor
+	ThreadPinning	pinning{ ThreadPinning::Core };
+	NodePlacement	placement{ NodePlacement::Compact };
+};
+
+
+/**
+*  Fixed set of worker threads, optionally pinned to logical processors or NUMA nodes.  Unlike the PPL scheduler,
+*  every worker keeps its node, so data a worker first touches stays local to the node that reads it.  Nodes are
+*  numbered 0 .. GetNumNodes() - 1 over the nodes that have at least one worker.
+*/
+class WorkerPool
+{
+public:
+	explicit WorkerPool(const WorkerPoolConfig& config);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	int GetNumThreads() const { return static_cast<int>(m_threads.size()); }
+	int GetNumNodes() const { return m_numNodes; }
+	int GetThreadNode(int threadIndex) const { return m_threadNodes[threadIndex]; }
+
+	// Runs func(threadIndex) once on every worker, and returns when all of them are done
+	void Run(const std::function<void(int)>& func);
+
+	// Runs func(node) once on one worker of every node, and returns when all of them are done
+	void RunOnNodes(const std::function<void(int)>& func);
+
+	// Node of the calling worker, or 0 for threads outside any pool
+	static int GetCurrentNode();
+
+	// Number of NUMA nodes in the system
+	static int GetSystemNodeCount();
+
+private:
+	void WorkerMain(int threadIndex);
+
+private:
+	std::vector<std::thread>	m_threads;
+	std::vector<int>			m_threadNodes;
+	int							m_numNodes{ 1 };
+
+	std::mutex							m_mutex;
+	std::condition_variable				m_workReady;
+	std::condition_variable				m_workDone;
+	const std::function<void(int)>*		m_work{ nullptr };
+	uint64_t							m_generation{ 0 };
+	int									m_numBusy{ 0 };
+	bool								m_exit{ false };
+};
\ No newline at end of file
@@ -0,0 +1,83 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Image.h"
+#include "ImageCompare.h"
+
+using namespace std;
+using namespace Math;
+
+
+// Two renders are equivalent when they only differ by sampling noise, e.g. after a change that reorders
+// floating point operations or traces through a different backend.  Noise averages out over a block and over
+// the image, a changed or biased image does not.
+constexpr double EQUIVALENT_BLOCK_RMSE = 0.01;
+constexpr double EQUIVALENT_MEAN_ERROR = 0.002;
+
+// Exit codes
+constexpr int RESULT_PASS = 0;
+constexpr int RESULT_DIFFERENT = 1;
+constexpr int RESULT_ERROR = 2;
+
+
+// Usage: ImageCompare reference.pfm test.pfm [heatmap.ppm]
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		cerr << "Usage: ImageCompare reference.pfm test.pfm [heatmap.ppm]" << endl;
+		return RESULT_ERROR;
+	}
+
+	unique_ptr<Image> reference;
+	unique_ptr<Image> test;
+	if (!LoadPFM(argv[1], reference))
+	{
+		cerr << "Failed to load " << argv[1] << endl;
+		return RESULT_ERROR;
+	}
+	if (!LoadPFM(argv[2], test))
+	{
+		cerr << "Failed to load " << argv[2] << endl;
+		return RESULT_ERROR;
+	}
+
+	unique_ptr<Image> heatmap;
+	if (argc > 3)
+	{
+		heatmap = make_unique<Image>(reference->GetWidth(), reference->GetHeight());
+	}
+
+	ImageDiff diff;
+	if (!CompareImages(*reference, *test, diff, heatmap.get()))
+	{
+		cerr << "Image sizes differ: " << reference->GetWidth() << " x " << reference->GetHeight() << " and ";
+		cerr << test->GetWidth() << " x " << test->GetHeight() << endl;
+		return RESULT_ERROR;
+	}
+
+	if (heatmap)
+	{
+		heatmap->SaveAs(argv[3]);
+	}
+
+	const bool equivalent = diff.blockRmse <= EQUIVALENT_BLOCK_RMSE && fabs(diff.meanError) <= EQUIVALENT_MEAN_ERROR;
+
+	stringstream sstr;
+	sstr.precision(6);
+	sstr << "RMSE: " << diff.rmse << ", PSNR: " << diff.psnr << " dB" << endl;
+	sstr << "  Mean error: " << diff.meanError << ", block RMSE: " << diff.blockRmse << endl;
+	sstr << "  Max error: " << diff.maxError << " at (" << diff.maxErrorX << ", " << diff.maxErrorY << ")" << endl;
+	sstr << (diff.IsIdentical() ? "Identical" : (equivalent ? "Equivalent" : "Different")) << endl;
+	OutputDebugStringA(sstr.str().c_str());
+	cout << sstr.str();
+
+	return equivalent ? RESULT_PASS : RESULT_DIFFERENT;
+}
\ No newline at end of file
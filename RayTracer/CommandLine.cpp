@@ -0,0 +1,416 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "CommandLine.h"
+
+using namespace std;
+
+
+namespace
+{
+
+bool ParseInt(const char* text, int minValue, int& value)
+{
+	char* end = nullptr;
+	const long long parsed = strtoll(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < minValue || parsed > INT_MAX)
+	{
+		return false;
+	}
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+
+bool ParseUint(const char* text, uint32_t& value)
+{
+	char* end = nullptr;
+	const unsigned long long parsed = strtoull(text, &end, 10);
+	if (end == text || *end != '\0' || text[0] == '-' || parsed > UINT_MAX)
+	{
+		return false;
+	}
+
+	value = static_cast<uint32_t>(parsed);
+	return true;
+}
+
+
+bool ParseStatsFormat(const string& text, StatsFormat& format)
+{
+	if (text == "text")
+	{
+		format = StatsFormat::Text;
+	}
+	else if (text == "csv")
+	{
+		format = StatsFormat::Csv;
+	}
+	else if (text == "json")
+	{
+		format = StatsFormat::Json;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+
+bool ParsePinning(const string& text, ThreadPinning& pinning)
+{
+	if (text == "none")
+	{
+		pinning = ThreadPinning::None;
+	}
+	else if (text == "node")
+	{
+		pinning = ThreadPinning::Node;
+	}
+	else if (text == "core")
+	{
+		pinning = ThreadPinning::Core;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+
+bool ParsePlacement(const string& text, NodePlacement& placement)
+{
+	if (text == "compact")
+	{
+		placement = NodePlacement::Compact;
+	}
+	else if (text == "scatter")
+	{
+		placement = NodePlacement::Scatter;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+
+bool ParseSceneMemory(const string& text, SceneMemory& memory)
+{
+	if (text == "heap")
+	{
+		memory = SceneMemory::Heap;
+	}
+	else if (text == "arena")
+	{
+		memory = SceneMemory::Arena;
+	}
+	else if (text == "large-pages")
+	{
+		memory = SceneMemory::LargePageArena;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+
+bool ParseSphereLayout(const string& text, SphereLayout& layout)
+{
+	if (text == "soa")
+	{
+		layout = SphereLayout::SoA;
+	}
+	else if (text == "aosoa")
+	{
+		layout = SphereLayout::AoSoA;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+
+bool ParseBvhNodeFormat(const string& text, BvhNodeFormat& format)
+{
+	if (text == "full")
+	{
+		format = BvhNodeFormat::Full;
+	}
+	else if (text == "quantized")
+	{
+		format = BvhNodeFormat::Quantized;
+	}
+	else if (text == "treelet")
+	{
+		format = BvhNodeFormat::Treelet;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+
+void PrintUsage(ostream& stream)
+{
+	const Options defaults;
+	const RenderConfig& render = defaults.render;
+
+	stream << "Usage: RayTracer [options]" << endl;
+	stream << endl;
+	stream << "Render:" << endl;
+	stream << "  --width <pixels>          Image width (" << render.width << ")" << endl;
+	stream << "  --height <pixels>         Image height (" << render.height << ")" << endl;
+	stream << "  --spp <samples>           Samples per pixel (" << render.samples << ")" << endl;
+	stream << "  --max-depth <bounces>     Maximum path depth (" << render.maxDepth << ")" << endl;
+	stream << "  --tile-width <pixels>     Tile width (" << render.tileWidth << ")" << endl;
+	stream << "  --tile-height <pixels>    Tile height (" << render.tileHeight << ")" << endl;
+	stream << "  --threads <count>         Worker threads, 0 for all, 1 for serial (" << render.numThreads << ")" << endl;
+	stream << "  --seed <seed>             Pixel sampling seed (" << render.seed << ")" << endl;
+	stream << "  --pinning <mode>          Render on a worker pool, pinned per none, node or core, with the scene" << endl;
+	stream << "                            replicated per NUMA node (default: PPL scheduler, no pinning)" << endl;
+	stream << "  --placement <mode>        Worker pool placement over NUMA nodes: compact or scatter (compact)" << endl;
+	stream << "  --recursive               Use the recursive path tracer" << endl;
+	stream << "  --ray-batches             Trace each tile in ray batches, one per bounce, with the iterative tracer" << endl;
+	stream << "  --tile-culling            Trace camera rays against the spheres culled to each tile's frustum" << endl;
+	stream << "  --perf-counters           Read hardware performance counters, where supported" << endl;
+	stream << "  --node-fetches            Also count the BVH node lines and pages read, which is slower (implies --perf-counters)" << endl;
+	stream << endl;
+	stream << "Scene:" << endl;
+	stream << "  --tracer <name>           Tracer backend: native, or grid, kdtree, sorted, linear or embree for the spheres (" << defaults.tracer << ")" << endl;
+	stream << "  --scene <name>            Scene generator: random (" << defaults.scene << ")" << endl;
+	stream << "  --scene-seed <seed>       Scene generator seed (" << defaults.sceneSeed << ")" << endl;
+	stream << "  --grid <size>             Scene size, up to (2 * size)^2 small spheres (" << defaults.gridSize << ")" << endl;
+	stream << "  --scene-memory <mode>     Built scene data in heap, arena or large-pages memory (heap)" << endl;
+	stream << "  --sphere-layout <layout>  Native sphere leaf data as soa arrays or aosoa blocks of 8 (soa)" << endl;
+	stream << "  --bvh-nodes <format>      Native sphere BVH nodes in full precision, quantized to 8 bits, or reordered" << endl;
+	stream << "                            into cache line pairs and page treelets: full, quantized or treelet (full)" << endl;
+	stream << "  --mesh <file>             Add an OBJ or PLY mesh to the scene" << endl;
+	stream << "  --mesh-bake <file>        Baked mesh file, created on the first run and whenever the mesh changes (" << defaults.meshBakedFilename << ")" << endl;
+	stream << "  --accel-cache <file>      Save the built scene, or map it if it was saved for identical input" << endl;
+	stream << endl;
+	stream << "Output:" << endl;
+	stream << "  --output <basename>       Writes <basename>.ppm and <basename>.pfm (" << defaults.outputBasename << ")" << endl;
+	stream << "  --aovs                    Also write cycles, rays and bounce depth per pixel as PFMs" << endl;
+	stream << "  --reference <file>        Compare the render against a reference PFM" << endl;
+	stream << "  --trace <file>            Write a Chrome trace of the run" << endl;
+	stream << "  --stats <format>          Stats on stdout: text, csv or json (text)" << endl;
+	stream << "  --help                    Show this message" << endl;
+}
+
+
+bool ParseCommandLine(int argc, char** argv, Options& options, int& exitCode)
+{
+	RenderConfig& render = options.render;
+	exitCode = 1;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string arg = argv[i];
+
+		// Flags
+		if (arg == "--help" || arg == "-h")
+		{
+			PrintUsage(cout);
+			exitCode = 0;
+			return false;
+		}
+		else if (arg == "--recursive")
+		{
+			render.recursive = true;
+			continue;
+		}
+		else if (arg == "--ray-batches")
+		{
+			render.rayBatches = true;
+			continue;
+		}
+		else if (arg == "--tile-culling")
+		{
+			render.tileCulling = true;
+			continue;
+		}
+		else if (arg == "--perf-counters")
+		{
+			render.perfCounters = true;
+			continue;
+		}
+		else if (arg == "--node-fetches")
+		{
+			render.perfCounters = true;
+			render.countNodeFetches = true;
+			continue;
+		}
+		else if (arg == "--aovs")
+		{
+			options.writeAovs = true;
+			continue;
+		}
+
+		// Everything else takes a value
+		if (i + 1 >= argc)
+		{
+			cerr << "Missing value for " << arg << endl;
+			return false;
+		}
+		const char* value = argv[++i];
+
+		bool valid = true;
+		if (arg == "--width")
+		{
+			valid = ParseInt(value, 1, render.width);
+		}
+		else if (arg == "--height")
+		{
+			valid = ParseInt(value, 1, render.height);
+		}
+		else if (arg == "--spp")
+		{
+			valid = ParseInt(value, 1, render.samples);
+		}
+		else if (arg == "--max-depth")
+		{
+			valid = ParseInt(value, 0, render.maxDepth);
+		}
+		else if (arg == "--tile-width")
+		{
+			valid = ParseInt(value, 1, render.tileWidth);
+		}
+		else if (arg == "--tile-height")
+		{
+			valid = ParseInt(value, 1, render.tileHeight);
+		}
+		else if (arg == "--threads")
+		{
+			valid = ParseInt(value, 0, render.numThreads);
+		}
+		else if (arg == "--seed")
+		{
+			valid = ParseUint(value, render.seed);
+		}
+		else if (arg == "--pinning")
+		{
+			valid = ParsePinning(value, options.pinning);
+			options.usePool = true;
+		}
+		else if (arg == "--placement")
+		{
+			valid = ParsePlacement(value, options.placement);
+			options.usePool = true;
+		}
+		else if (arg == "--tracer")
+		{
+			options.tracer = value;
+		}
+		else if (arg == "--scene")
+		{
+			options.scene = value;
+		}
+		else if (arg == "--scene-seed")
+		{
+			valid = ParseUint(value, options.sceneSeed);
+		}
+		else if (arg == "--grid")
+		{
+			valid = ParseInt(value, 0, options.gridSize);
+		}
+		else if (arg == "--scene-memory")
+		{
+			valid = ParseSceneMemory(value, options.sceneMemory);
+		}
+		else if (arg == "--sphere-layout")
+		{
+			valid = ParseSphereLayout(value, options.sphereLayout);
+		}
+		else if (arg == "--bvh-nodes")
+		{
+			valid = ParseBvhNodeFormat(value, options.bvhNodeFormat);
+		}
+		else if (arg == "--mesh")
+		{
+			options.meshFilename = value;
+		}
+		else if (arg == "--mesh-bake")
+		{
+			options.meshBakedFilename = value;
+		}
+		else if (arg == "--accel-cache")
+		{
+			options.accelCacheFilename = value;
+		}
+		else if (arg == "--output")
+		{
+			options.outputBasename = value;
+		}
+		else if (arg == "--reference")
+		{
+			options.referenceFilename = value;
+		}
+		else if (arg == "--trace")
+		{
+			options.traceFilename = value;
+		}
+		else if (arg == "--stats")
+		{
+			valid = ParseStatsFormat(value, options.statsFormat);
+		}
+		else
+		{
+			cerr << "Unknown option " << arg << endl << endl;
+			PrintUsage(cerr);
+			return false;
+		}
+
+		if (!valid)
+		{
+			cerr << "Invalid value " << value << " for " << arg << endl;
+			return false;
+		}
+	}
+
+	if (options.tracer != "native" && options.tracer != "grid" && options.tracer != "kdtree" && options.tracer != "sorted" && options.tracer != "linear" && options.tracer != "embree")
+	{
+		cerr << "Unknown tracer " << options.tracer << ", expected native, grid, kdtree, sorted, linear or embree" << endl;
+		return false;
+	}
+
+	if (!Scene::IsBackendAvailable(options.GetSceneBackend()))
+	{
+		cerr << "Tracer " << options.tracer << " is not available in this build" << endl;
+		return false;
+	}
+
+	if (options.scene != "random")
+	{
+		cerr << "Unknown scene " << options.scene << ", expected random" << endl;
+		return false;
+	}
+
+	if (options.usePool && (!options.meshFilename.empty() || !options.accelCacheFilename.empty()))
+	{
+		cerr << "--mesh and --accel-cache cannot be combined with the worker pool" << endl;
+		return false;
+	}
+
+	exitCode = 0;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "Renderer.h"
+#include "Scene.h"
+#include "WorkerPool.h"
+
+
+enum class StatsFormat
+{
+	Text,
+	Csv,
+	Json
+};
+
+
+// Everything a render run can be configured with.  The defaults reproduce the original hard-coded settings.
+struct Options
+{
+	RenderConfig	render;
+
+	// Renders on a dedicated worker pool instead of the PPL scheduler, with the scene replicated per NUMA node
+	bool			usePool{ false };
+	ThreadPinning	pinning{ ThreadPinning::Core };
+	NodePlacement	placement{ NodePlacement::Compact };
+
+	// Scene
+	std::string		tracer{ "native" };
+	std::string		scene{ "random" };
+	uint32_t		sceneSeed{ 1524374227u };	// Generated from SetSeedPIDTime
+	int				gridSize{ 11 };
+	SceneMemory		sceneMemory{ SceneMemory::Heap };
+	SphereLayout	sphereLayout{ SphereLayout::SoA };
+	BvhNodeFormat	bvhNodeFormat{ BvhNodeFormat::Full };
+
+	// Set meshFilename to an OBJ or PLY file to add it to the scene.  The first run bakes it to meshBakedFilename,
+	// and later runs map the baked file instead of parsing the source file.
+	std::string		meshFilename;
+	std::string		meshBakedFilename{ "mesh.rtbake" };
+
+	// When set, the built scene is saved here, and later runs with identical input map it instead of calling
+	// Scene::Commit()
+	std::string		accelCacheFilename;
+
+	// Output.  Writes <outputBasename>.ppm and a linear <outputBasename>.pfm, plus <outputBasename>_cycles.pfm,
+	// _rays.pfm and _depth.pfm with writeAovs.
+	std::string		outputBasename{ "image" };
+	bool			writeAovs{ false };
+	std::string		referenceFilename;		// Renders are compared against this PFM when set
+	std::string		traceFilename;			// Chrome trace of the run, when set
+	StatsFormat		statsFormat{ StatsFormat::Text };
+
+	SceneBackend GetSceneBackend() const
+	{
+		if (tracer == "grid")
+		{
+			return SceneBackend::Grid;
+		}
+		else if (tracer == "kdtree")
+		{
+			return SceneBackend::KdTree;
+		}
+		else if (tracer == "sorted")
+		{
+			return SceneBackend::Sorted;
+		}
+		else if (tracer == "linear")
+		{
+			return SceneBackend::Linear;
+		}
+		else if (tracer == "embree")
+		{
+			return SceneBackend::Embree;
+		}
+		return SceneBackend::Native;
+	}
+};
+
+
+// Parses argv over the defaults in options.  Returns false, after reporting the problem, on invalid arguments or
+// when only help was requested (then exitCode is 0).
+bool ParseCommandLine(int argc, char** argv, Options& options, int& exitCode);
+
+void PrintUsage(std::ostream& stream);
\ No newline at end of file
@@ -0,0 +1,694 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "EmbreeTracer.h"
+
+#include "Profiler.h"
+#include "SceneGenerator.h"
+
+
+using namespace Math;
+using namespace std;
+
+
+namespace
+{
+
+// Embree needs finite bounds, so planes are clipped to a box this large around the origin
+constexpr float PLANE_EXTENT = 1.0e5f;
+
+
+// Sphere lookup for the callbacks.  Per-sphere geometries have a single primitive, the shared one a primitive per sphere.
+__forceinline void GetSphere(const EmbreeTracer::Sphere* sphere, unsigned int primID, Vector3& center, float& radius)
+{
+	center = sphere->center;
+	radius = sphere->radius;
+}
+
+
+__forceinline void GetSphere(const EmbreeTracer::SphereArrays* spheres, unsigned int primID, Vector3& center, float& radius)
+{
+	center = Vector3(spheres->centerX[primID], spheres->centerY[primID], spheres->centerZ[primID]);
+	radius = spheres->radius[primID];
+}
+
+
+// Nearest intersection inside (tnear, tfar): shrinks tfar and returns the unnormalized normal on a hit
+__forceinline bool IntersectSphere(const Vector3& center, float radius, const Vector3& org, const Vector3& dir, float tnear, float& tfar, Vector3& Ng)
+{
+	const Vector3 v = org - center;
+	const float A = Dot(dir, dir);
+	const float B = 2.0f * Dot(v, dir);
+	const float C = Dot(v, v) - radius * radius;
+	const float D = B * B - 4.0f * A * C;
+	if (D < 0.0f) return false;
+	const float Q = sqrt(D);
+	const float rcpA = 1.0f / A;
+	const float t0 = 0.5f * rcpA * (-B - Q);
+	const float t1 = 0.5f * rcpA * (-B + Q);
+
+	float t = tfar;
+	if ((tnear < t0) & (t0 < t))
+	{
+		t = t0;
+	}
+	else if ((tnear < t1) & (t1 < t))
+	{
+		t = t1;
+	}
+	else
+	{
+		return false;
+	}
+
+	Ng = org + t * dir - center;
+	tfar = t;
+	return true;
+}
+
+
+template <typename SphereData>
+void SphereBoundsFunc(const RTCBoundsFunctionArguments* args)
+{
+	Vector3 center;
+	float radius;
+	GetSphere((const SphereData*)args->geometryUserPtr, args->primID, center, radius);
+
+	RTCBounds* bounds = args->bounds_o;
+	bounds->lower_x = center.GetX() - radius;
+	bounds->lower_y = center.GetY() - radius;
+	bounds->lower_z = center.GetZ() - radius;
+	bounds->upper_x = center.GetX() + radius;
+	bounds->upper_y = center.GetY() + radius;
+	bounds->upper_z = center.GetZ() + radius;
+}
+
+
+template <typename SphereData>
+void SphereIntersectFunc(const RTCIntersectFunctionNArguments* args)
+{
+	int* valid = args->valid;
+	unsigned int N = args->N;
+	RTCRayHitN* rayhit = (RTCRayHitN*)args->rayhit;
+	RTCRayN* rays = RTCRayHitN_RayN(rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(rayhit, N);
+
+	assert(args->N == 1);
+
+	if (!valid[0]) return;
+
+	Vector3 center;
+	float radius;
+	GetSphere((const SphereData*)args->geometryUserPtr, args->primID, center, radius);
+
+	const Vector3 org = Vector3(RTCRayN_org_x(rays, N, 0), RTCRayN_org_y(rays, N, 0), RTCRayN_org_z(rays, N, 0));
+	const Vector3 dir = Vector3(RTCRayN_dir_x(rays, N, 0), RTCRayN_dir_y(rays, N, 0), RTCRayN_dir_z(rays, N, 0));
+
+	Vector3 Ng;
+	if (IntersectSphere(center, radius, org, dir, RTCRayN_tnear(rays, N, 0), RTCRayN_tfar(rays, N, 0), Ng))
+	{
+		RTCHit potentialHit;
+		potentialHit.Ng_x = Ng.GetX();
+		potentialHit.Ng_y = Ng.GetY();
+		potentialHit.Ng_z = Ng.GetZ();
+		potentialHit.u = 0.0f;
+		potentialHit.v = 0.0f;
+		potentialHit.instID[0] = args->context->instID[0];
+		potentialHit.geomID = args->geomID;
+		potentialHit.primID = args->primID;
+
+		rtcCopyHitToHitN(hits, &potentialHit, N, 0);
+	}
+}
+
+
+// Intersects W lanes of an N-wide ray packet, starting at lane first, with one sphere.  Same math as
+// IntersectSphere, lane by lane; invalid lanes and misses keep their tfar and hit.
+template <int W>
+__forceinline void IntersectSphereLanes(const RTCIntersectFunctionNArguments* args, unsigned int first, const Vector3& center, float radius)
+{
+	const unsigned int N = args->N;
+	RTCRayHitN* rayhit = (RTCRayHitN*)args->rayhit;
+	RTCRayN* rays = RTCRayHitN_RayN(rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(rayhit, N);
+
+	const Bool<W> valid = Int<W>::LoadU(args->valid + first) == Int<W>(-1);
+	if (None(valid)) return;
+
+	const Float<W> centerX = Float<W>::Broadcast(center.GetX());
+	const Float<W> centerY = Float<W>::Broadcast(center.GetY());
+	const Float<W> centerZ = Float<W>::Broadcast(center.GetZ());
+
+	const Float<W> orgX = Float<W>::LoadU(&RTCRayN_org_x(rays, N, first));
+	const Float<W> orgY = Float<W>::LoadU(&RTCRayN_org_y(rays, N, first));
+	const Float<W> orgZ = Float<W>::LoadU(&RTCRayN_org_z(rays, N, first));
+	const Float<W> dirX = Float<W>::LoadU(&RTCRayN_dir_x(rays, N, first));
+	const Float<W> dirY = Float<W>::LoadU(&RTCRayN_dir_y(rays, N, first));
+	const Float<W> dirZ = Float<W>::LoadU(&RTCRayN_dir_z(rays, N, first));
+
+	const Float<W> vX = orgX - centerX;
+	const Float<W> vY = orgY - centerY;
+	const Float<W> vZ = orgZ - centerZ;
+
+	const Float<W> A = (dirX * dirX) + (dirY * dirY) + (dirZ * dirZ);
+	const Float<W> B = 2.0f * ((vX * dirX) + (vY * dirY) + (vZ * dirZ));
+	const Float<W> C = (vX * vX) + (vY * vY) + (vZ * vZ) - Float<W>(radius * radius);
+	const Float<W> D = B * B - 4.0f * A * C;
+
+	Bool<W> mask = valid & (D >= Float<W>(0.0f));
+	if (None(mask)) return;
+
+	// Lanes with a negative discriminant produce NaNs here, but are already masked out
+	const Float<W> Q = Sqrt(D);
+	const Float<W> rcpA = 1.0f / A;
+	const Float<W> t0 = 0.5f * rcpA * (-B - Q);
+	const Float<W> t1 = 0.5f * rcpA * (-B + Q);
+
+	const Float<W> tnear = Float<W>::LoadU(&RTCRayN_tnear(rays, N, first));
+	const Float<W> tfar = Float<W>::LoadU(&RTCRayN_tfar(rays, N, first));
+
+	const Bool<W> hit0 = (tnear < t0) & (t0 < tfar);
+	const Bool<W> hit1 = (tnear < t1) & (t1 < tfar);
+	mask &= hit0 | hit1;
+	if (None(mask)) return;
+
+	const Float<W> t = Select(hit0, t0, t1);
+	Float<W>::StoreU(&RTCRayN_tfar(rays, N, first), Select(mask, t, tfar));
+
+	float NgX[W], NgY[W], NgZ[W];
+	Float<W>::StoreU(NgX, orgX + t * dirX - centerX);
+	Float<W>::StoreU(NgY, orgY + t * dirY - centerY);
+	Float<W>::StoreU(NgZ, orgZ + t * dirZ - centerZ);
+
+	// Hits are rare next to the tests, so they are written out lane by lane
+	RTCHit potentialHit;
+	potentialHit.u = 0.0f;
+	potentialHit.v = 0.0f;
+	potentialHit.instID[0] = args->context->instID[0];
+	potentialHit.geomID = args->geomID;
+	potentialHit.primID = args->primID;
+
+	const uint32_t hitMask = Mask(mask);
+	for (int lane = 0; lane < W; ++lane)
+	{
+		if (hitMask & (1 << lane))
+		{
+			potentialHit.Ng_x = NgX[lane];
+			potentialHit.Ng_y = NgY[lane];
+			potentialHit.Ng_z = NgZ[lane];
+
+			rtcCopyHitToHitN(hits, &potentialHit, N, first + lane);
+		}
+	}
+}
+
+
+template <typename SphereData>
+void SphereIntersectFuncN(const RTCIntersectFunctionNArguments* args)
+{
+	int* valid = (int*)args->valid;
+	unsigned int N = args->N;
+	RTCRayHitN* rayhit = (RTCRayHitN*)args->rayhit;
+	RTCRayN* rays = RTCRayHitN_RayN(rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(rayhit, N);
+
+	Vector3 center;
+	float radius;
+	GetSphere((const SphereData*)args->geometryUserPtr, args->primID, center, radius);
+
+	// Packets go through 8 and then 4 lanes at a time.  Whatever is left, such as the single rays Embree hands
+	// over for rtcIntersect1 and incoherent streams, is intersected one ray at a time.
+	unsigned int first = 0;
+	for (; first + 8 <= N; first += 8)
+	{
+		IntersectSphereLanes<8>(args, first, center, radius);
+	}
+	for (; first + 4 <= N; first += 4)
+	{
+		IntersectSphereLanes<4>(args, first, center, radius);
+	}
+
+	for (unsigned int ui = first; ui < N; ++ui)
+	{
+		/* ignore inactive rays */
+		if (valid[ui] != -1) continue;
+
+		const Vector3 ray_org = Vector3(RTCRayN_org_x(rays, N, ui), RTCRayN_org_y(rays, N, ui), RTCRayN_org_z(rays, N, ui));
+		const Vector3 ray_dir = Vector3(RTCRayN_dir_x(rays, N, ui), RTCRayN_dir_y(rays, N, ui), RTCRayN_dir_z(rays, N, ui));
+
+		Vector3 Ng;
+		if (IntersectSphere(center, radius, ray_org, ray_dir, RTCRayN_tnear(rays, N, ui), RTCRayN_tfar(rays, N, ui), Ng))
+		{
+			RTCHit potentialhit;
+			potentialhit.Ng_x = Ng.GetX();
+			potentialhit.Ng_y = Ng.GetY();
+			potentialhit.Ng_z = Ng.GetZ();
+			potentialhit.u = 0.0f;
+			potentialhit.v = 0.0f;
+			potentialhit.instID[0] = args->context->instID[0];
+			potentialhit.geomID = args->geomID;
+			potentialhit.primID = args->primID;
+
+			rtcCopyHitToHitN(hits, &potentialhit, N, ui);
+		}
+	}
+}
+
+
+void PlaneBoundsFunc(const RTCBoundsFunctionArguments* args)
+{
+	const EmbreeTracer::Plane& plane = *(const EmbreeTracer::Plane*)args->geometryUserPtr;
+
+	float lower[3] = { -PLANE_EXTENT, -PLANE_EXTENT, -PLANE_EXTENT };
+	float upper[3] = { PLANE_EXTENT, PLANE_EXTENT, PLANE_EXTENT };
+
+	// Axis-aligned planes get a flat box
+	const float normal[3] = { plane.normal.GetX(), plane.normal.GetY(), plane.normal.GetZ() };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (normal[(axis + 1) % 3] == 0.0f && normal[(axis + 2) % 3] == 0.0f)
+		{
+			lower[axis] = upper[axis] = plane.distance / normal[axis];
+		}
+	}
+
+	RTCBounds* bounds = args->bounds_o;
+	bounds->lower_x = lower[0];
+	bounds->lower_y = lower[1];
+	bounds->lower_z = lower[2];
+	bounds->upper_x = upper[0];
+	bounds->upper_y = upper[1];
+	bounds->upper_z = upper[2];
+}
+
+
+void PlaneIntersectFuncN(const RTCIntersectFunctionNArguments* args)
+{
+	int* valid = (int*)args->valid;
+	unsigned int N = args->N;
+	RTCRayHitN* rayhit = (RTCRayHitN*)args->rayhit;
+	RTCRayN* rays = RTCRayHitN_RayN(rayhit, N);
+	RTCHitN* hits = RTCRayHitN_HitN(rayhit, N);
+
+	const EmbreeTracer::Plane& plane = *(const EmbreeTracer::Plane*)args->geometryUserPtr;
+
+	for (unsigned int ui = 0; ui < N; ++ui)
+	{
+		if (!valid[ui]) continue;
+
+		const Vector3 org = Vector3(RTCRayN_org_x(rays, N, ui), RTCRayN_org_y(rays, N, ui), RTCRayN_org_z(rays, N, ui));
+		const Vector3 dir = Vector3(RTCRayN_dir_x(rays, N, ui), RTCRayN_dir_y(rays, N, ui), RTCRayN_dir_z(rays, N, ui));
+		float& ray_tnear = RTCRayN_tnear(rays, N, ui);
+		float& ray_tfar = RTCRayN_tfar(rays, N, ui);
+
+		const float t = (plane.distance - Dot(plane.normal, org)) / Dot(plane.normal, dir);
+		if ((ray_tnear < t) & (t < ray_tfar))
+		{
+			RTCHit potentialHit;
+			potentialHit.Ng_x = plane.normal.GetX();
+			potentialHit.Ng_y = plane.normal.GetY();
+			potentialHit.Ng_z = plane.normal.GetZ();
+			potentialHit.u = 0.0f;
+			potentialHit.v = 0.0f;
+			potentialHit.instID[0] = args->context->instID[0];
+			potentialHit.geomID = plane.geomId;
+			potentialHit.primID = args->primID;
+
+			ray_tfar = t;
+			rtcCopyHitToHitN(hits, &potentialHit, N, ui);
+		}
+	}
+}
+
+void InitRayHit(const Ray& ray, RTCRayHit& rayHit)
+{
+	rayHit.ray.org_x = ray.posX;
+	rayHit.ray.org_y = ray.posY;
+	rayHit.ray.org_z = ray.posZ;
+	rayHit.ray.tnear = ray.tmin;
+	rayHit.ray.dir_x = ray.dirX;
+	rayHit.ray.dir_y = ray.dirY;
+	rayHit.ray.dir_z = ray.dirZ;
+	rayHit.ray.time = 0.0f;
+	rayHit.ray.tfar = ray.tmax;
+	rayHit.ray.mask = 0xFFFFFFFF;
+	rayHit.ray.id = 0;
+	rayHit.ray.flags = 0;
+	rayHit.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
+	rayHit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+	rayHit.hit.primID = RTC_INVALID_GEOMETRY_ID;
+}
+
+
+// Ray packet type and intersect call for each packet width
+template <int N>
+struct RayHitPacket;
+
+template <>
+struct RayHitPacket<4>
+{
+	using Type = RTCRayHit4;
+	static void Intersect(const int* valid, RTCScene scene, RTCIntersectContext* context, RTCRayHit4* rayHit) { rtcIntersect4(valid, scene, context, rayHit); }
+};
+
+template <>
+struct RayHitPacket<8>
+{
+	using Type = RTCRayHit8;
+	static void Intersect(const int* valid, RTCScene scene, RTCIntersectContext* context, RTCRayHit8* rayHit) { rtcIntersect8(valid, scene, context, rayHit); }
+};
+
+template <>
+struct RayHitPacket<16>
+{
+	using Type = RTCRayHit16;
+	static void Intersect(const int* valid, RTCScene scene, RTCIntersectContext* context, RTCRayHit16* rayHit) { rtcIntersect16(valid, scene, context, rayHit); }
+};
+
+} // anonymous namespace
+
+
+const char* GetEmbreeGeometryName(EmbreeGeometry geometry)
+{
+	switch (geometry)
+	{
+	case EmbreeGeometry::PerSphere:		return "per-sphere";
+	case EmbreeGeometry::UserGeometry:	return "user";
+	case EmbreeGeometry::SpherePoints:	return "sphere-points";
+	}
+	return "unknown";
+}
+
+
+const char* GetEmbreeBuildQualityName(RTCBuildQuality quality)
+{
+	switch (quality)
+	{
+	case RTC_BUILD_QUALITY_LOW:		return "low";
+	case RTC_BUILD_QUALITY_MEDIUM:	return "medium";
+	case RTC_BUILD_QUALITY_HIGH:	return "high";
+	default:						return "refit";
+	}
+}
+
+
+EmbreeTracer::EmbreeTracer(const EmbreeConfig& config)
+	: m_config(config)
+{
+	// Without native sphere points, fall back to the user geometry, and report that through GetConfig() and GetName()
+	if (m_config.geometry == EmbreeGeometry::SpherePoints && !EMBREE_HAS_SPHERE_POINTS)
+	{
+		m_config.geometry = EmbreeGeometry::UserGeometry;
+	}
+
+	m_name = string("Embree (") + GetEmbreeGeometryName(m_config.geometry) + ", " + GetEmbreeBuildQualityName(m_config.buildQuality) + ")";
+
+	m_device = rtcNewDevice(nullptr);
+	rtcSetDeviceMemoryMonitorFunction(m_device, MemoryMonitor, this);
+}
+
+
+EmbreeTracer::~EmbreeTracer()
+{
+	if (m_scene)
+	{
+		rtcReleaseScene(m_scene);
+		m_scene = nullptr;
+	}
+
+	rtcReleaseDevice(m_device);
+	m_device = nullptr;
+}
+
+
+void EmbreeTracer::Build(const SceneDesc& desc)
+{
+	PROFILE_ZONE("EmbreeTracer::Build");
+
+	// Geometry ids and the user data the callbacks point at are assigned from scratch, so a rebuild starts over
+	// from an empty scene
+	if (m_scene)
+	{
+		rtcReleaseScene(m_scene);
+	}
+	m_scene = rtcNewScene(m_device);
+	rtcSetSceneBuildQuality(m_scene, m_config.buildQuality);
+	rtcSetSceneFlags(m_scene, m_config.sceneFlags);
+
+	m_spheres.clear();
+	m_sphereArrays = SphereArrays();
+	m_sphereGeomId = RTC_INVALID_GEOMETRY_ID;
+	m_sphereBaseId = 0;
+
+	uint32_t id = 0;
+
+	m_ground.normal = desc.groundNormal;
+	m_ground.distance = desc.groundDistance;
+	m_ground.geomId = id++;
+
+	AttachUserGeometry(m_ground.geomId, 1, &m_ground, PlaneBoundsFunc, PlaneIntersectFuncN);
+
+	const uint32_t numSpheres = static_cast<uint32_t>(desc.spheres.size());
+	const EmbreeGeometry geometry = m_config.geometry;
+
+	if (geometry == EmbreeGeometry::PerSphere)
+	{
+		// The callbacks keep pointers into m_spheres, so it is filled in completely before attaching anything
+		m_spheres.reserve(numSpheres);
+		for (const auto& sphere : desc.spheres)
+		{
+			m_spheres.push_back(Sphere{ sphere.center, sphere.radius, id++ });
+		}
+
+		for (auto& sphere : m_spheres)
+		{
+			AttachUserGeometry(sphere.geomId, 1, &sphere, SphereBoundsFunc<Sphere>, m_config.useStreams ? SphereIntersectFuncN<Sphere> : SphereIntersectFunc<Sphere>);
+		}
+	}
+	else if (numSpheres > 0)
+	{
+		// All spheres in one geometry, whose id is the first sphere's
+		m_sphereGeomId = id;
+		m_sphereBaseId = id;
+
+		if (geometry == EmbreeGeometry::SpherePoints)
+		{
+			AttachSpherePoints(m_sphereGeomId, desc);
+		}
+		else
+		{
+			m_sphereArrays.centerX.reserve(numSpheres);
+			m_sphereArrays.centerY.reserve(numSpheres);
+			m_sphereArrays.centerZ.reserve(numSpheres);
+			m_sphereArrays.radius.reserve(numSpheres);
+			for (const auto& sphere : desc.spheres)
+			{
+				m_sphereArrays.centerX.push_back(sphere.center.GetX());
+				m_sphereArrays.centerY.push_back(sphere.center.GetY());
+				m_sphereArrays.centerZ.push_back(sphere.center.GetZ());
+				m_sphereArrays.radius.push_back(sphere.radius);
+			}
+
+			AttachUserGeometry(m_sphereGeomId, numSpheres, &m_sphereArrays, SphereBoundsFunc<SphereArrays>, m_config.useStreams ? SphereIntersectFuncN<SphereArrays> : SphereIntersectFunc<SphereArrays>);
+		}
+	}
+
+	rtcCommitScene(m_scene);
+}
+
+
+void EmbreeTracer::Intersect1(Ray& ray, Hit& hit) const
+{
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+
+	RTCRayHit rayHit;
+	InitRayHit(ray, rayHit);
+
+	rtcIntersect1(m_scene, &context, &rayHit);
+
+	ResolveHit(rayHit.hit.Ng_x, rayHit.hit.Ng_y, rayHit.hit.Ng_z, rayHit.hit.geomID, rayHit.hit.primID, rayHit.ray.tfar, ray, hit);
+}
+
+
+void EmbreeTracer::IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const
+{
+	if (!m_config.useStreams)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			Intersect1(rays[i], hits[i]);
+		}
+	}
+	else if (!coherent)
+	{
+		IntersectStream(rays, hits, count);
+	}
+	else if (m_config.packetWidth == 4)
+	{
+		IntersectPackets<4>(rays, hits, count);
+	}
+	else if (m_config.packetWidth == 16)
+	{
+		IntersectPackets<16>(rays, hits, count);
+	}
+	else
+	{
+		IntersectPackets<8>(rays, hits, count);
+	}
+}
+
+
+size_t EmbreeTracer::GetMemoryUsage() const
+{
+	const size_t userBytes = m_spheres.size() * sizeof(Sphere) + m_sphereArrays.radius.size() * 4 * sizeof(float);
+	return static_cast<size_t>(max<int64_t>(m_memoryUsage, 0)) + userBytes;
+}
+
+
+bool EmbreeTracer::MemoryMonitor(void* userPtr, ssize_t bytes, bool post)
+{
+	// Frees are reported with negative sizes
+	auto tracer = (EmbreeTracer*)userPtr;
+	tracer->m_memoryUsage += bytes;
+	return true;
+}
+
+
+void EmbreeTracer::AttachUserGeometry(uint32_t geomId, uint32_t numPrimitives, void* userData, RTCBoundsFunction boundsFunc, RTCIntersectFunctionN intersectFunc)
+{
+	RTCGeometry geom = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_USER);
+	rtcAttachGeometryByID(m_scene, geom, geomId);
+
+	rtcSetGeometryBuildQuality(geom, m_config.buildQuality);
+	rtcSetGeometryUserPrimitiveCount(geom, numPrimitives);
+	rtcSetGeometryUserData(geom, userData);
+	rtcSetGeometryBoundsFunction(geom, boundsFunc, nullptr);
+	rtcSetGeometryIntersectFunction(geom, intersectFunc);
+
+	rtcCommitGeometry(geom);
+	rtcReleaseGeometry(geom);
+}
+
+
+void EmbreeTracer::AttachSpherePoints(uint32_t geomId, const SceneDesc& desc)
+{
+#if EMBREE_HAS_SPHERE_POINTS
+	RTCGeometry geom = rtcNewGeometry(m_device, RTC_GEOMETRY_TYPE_SPHERE_POINT);
+	rtcAttachGeometryByID(m_scene, geom, geomId);
+
+	rtcSetGeometryBuildQuality(geom, m_config.buildQuality);
+
+	// One (x, y, z, radius) vertex per sphere, in Embree's own buffer
+	const size_t numSpheres = desc.spheres.size();
+	float* vertices = (float*)rtcSetNewGeometryBuffer(geom, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT4, 4 * sizeof(float), numSpheres);
+	for (size_t i = 0; i < numSpheres; ++i)
+	{
+		const auto& sphere = desc.spheres[i];
+		vertices[4 * i + 0] = sphere.center.GetX();
+		vertices[4 * i + 1] = sphere.center.GetY();
+		vertices[4 * i + 2] = sphere.center.GetZ();
+		vertices[4 * i + 3] = sphere.radius;
+	}
+
+	rtcCommitGeometry(geom);
+	rtcReleaseGeometry(geom);
+#endif
+}
+
+
+template <int N>
+void EmbreeTracer::IntersectPackets(Ray* rays, Hit* hits, size_t count) const
+{
+	using Packet = RayHitPacket<N>;
+
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	context.flags = RTC_INTERSECT_CONTEXT_FLAG_COHERENT;
+
+	for (size_t first = 0; first < count; first += N)
+	{
+		const int numLanes = static_cast<int>(min<size_t>(N, count - first));
+
+		// The last packet of a batch may be partial.  Its inactive lanes repeat the last ray, so they hold
+		// valid data, and are masked off.
+		alignas(64) int valid[N];
+		typename Packet::Type rayHit;
+		for (int lane = 0; lane < N; ++lane)
+		{
+			const Ray& ray = rays[first + min(lane, numLanes - 1)];
+
+			valid[lane] = (lane < numLanes) ? -1 : 0;
+			rayHit.ray.org_x[lane] = ray.posX;
+			rayHit.ray.org_y[lane] = ray.posY;
+			rayHit.ray.org_z[lane] = ray.posZ;
+			rayHit.ray.tnear[lane] = ray.tmin;
+			rayHit.ray.dir_x[lane] = ray.dirX;
+			rayHit.ray.dir_y[lane] = ray.dirY;
+			rayHit.ray.dir_z[lane] = ray.dirZ;
+			rayHit.ray.time[lane] = 0.0f;
+			rayHit.ray.tfar[lane] = ray.tmax;
+			rayHit.ray.mask[lane] = 0xFFFFFFFF;
+			rayHit.ray.id[lane] = lane;
+			rayHit.ray.flags[lane] = 0;
+			rayHit.hit.instID[0][lane] = RTC_INVALID_GEOMETRY_ID;
+			rayHit.hit.geomID[lane] = RTC_INVALID_GEOMETRY_ID;
+			rayHit.hit.primID[lane] = RTC_INVALID_GEOMETRY_ID;
+		}
+
+		Packet::Intersect(valid, m_scene, &context, &rayHit);
+
+		for (int lane = 0; lane < numLanes; ++lane)
+		{
+			ResolveHit(rayHit.hit.Ng_x[lane], rayHit.hit.Ng_y[lane], rayHit.hit.Ng_z[lane], rayHit.hit.geomID[lane], rayHit.hit.primID[lane], rayHit.ray.tfar[lane], rays[first + lane], hits[first + lane]);
+		}
+	}
+}
+
+
+void EmbreeTracer::IntersectStream(Ray* rays, Hit* hits, size_t count) const
+{
+	// Kept per thread, so streams stop allocating once the thread has seen its largest batch
+	thread_local vector<RTCRayHit> rayHits;
+	rayHits.resize(count);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		InitRayHit(rays[i], rayHits[i]);
+		rayHits[i].ray.id = static_cast<unsigned int>(i);
+	}
+
+	RTCIntersectContext context;
+	rtcInitIntersectContext(&context);
+	context.flags = RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+
+	rtcIntersect1M(m_scene, &context, rayHits.data(), static_cast<unsigned int>(count), sizeof(RTCRayHit));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const RTCRayHit& rayHit = rayHits[i];
+		ResolveHit(rayHit.hit.Ng_x, rayHit.hit.Ng_y, rayHit.hit.Ng_z, rayHit.hit.geomID, rayHit.hit.primID, rayHit.ray.tfar, rays[i], hits[i]);
+	}
+}
+
+
+void EmbreeTracer::ResolveHit(float NgX, float NgY, float NgZ, uint32_t geomID, uint32_t primID, float tfar, Ray& ray, Hit& hit) const
+{
+	if (geomID != RTC_INVALID_GEOMETRY_ID)
+	{
+		Vector3 normal = Normalize(Vector3(NgX, NgY, NgZ));
+		hit.normalX = normal.GetX();
+		hit.normalY = normal.GetY();
+		hit.normalZ = normal.GetZ();
+		hit.geomId = (geomID == m_sphereGeomId) ? m_sphereBaseId + primID : geomID;
+
+		ray.tmax = tfar;
+	}
+}
\ No newline at end of file
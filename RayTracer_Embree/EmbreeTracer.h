@@ -0,0 +1,129 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#pragma once
+
+#include "ITracer.h"
+
+#include <string>
+
+#include "embree3/rtcore.h"
+
+
+// Native sphere points need Embree 3.9 or later
+#if defined(RTC_VERSION) && RTC_VERSION >= 30900
+#define EMBREE_HAS_SPHERE_POINTS 1
+#else
+#define EMBREE_HAS_SPHERE_POINTS 0
+#endif
+
+
+// How the spheres are handed to Embree
+enum class EmbreeGeometry
+{
+	PerSphere,		// One user geometry per sphere, each with a single primitive
+	UserGeometry,	// One user geometry with a primitive per sphere, over SoA sphere arrays
+	SpherePoints	// One RTC_GEOMETRY_TYPE_SPHERE_POINT geometry, intersected by Embree itself
+};
+
+
+struct EmbreeConfig
+{
+	EmbreeGeometry		geometry{ EmbreeGeometry::UserGeometry };
+	RTCBuildQuality		buildQuality{ RTC_BUILD_QUALITY_MEDIUM };
+	RTCSceneFlags		sceneFlags{ RTC_SCENE_FLAG_NONE };
+
+	// Traces ray batches as packets (coherent batches) and streams (incoherent ones), with the N-wide intersect
+	// callbacks for the user geometries.  Otherwise batches are traced one rtcIntersect1 at a time.
+	bool				useStreams{ false };
+	int					packetWidth{ 8 };	// Rays per packet, 4, 8 or 16
+};
+
+
+const char* GetEmbreeGeometryName(EmbreeGeometry geometry);
+const char* GetEmbreeBuildQualityName(RTCBuildQuality quality);
+
+
+// Reference backend.  The ground plane is a user geometry attached with geometry id 0, and the spheres follow the
+// configured EmbreeGeometry.  Hits are mapped back to the scene description ids, so Embree hits index the same
+// materials as native hits.
+class EmbreeTracer : public ITracer
+{
+public:
+	explicit EmbreeTracer(const EmbreeConfig& config = EmbreeConfig());
+	~EmbreeTracer();
+
+	EmbreeTracer(const EmbreeTracer&) = delete;
+	EmbreeTracer& operator=(const EmbreeTracer&) = delete;
+
+	const char* GetName() const final { return m_name.c_str(); }
+
+	// Builds a new Embree scene, replacing the one from any earlier call
+	void Build(const SceneDesc& desc) final;
+	void Intersect1(Ray& ray, Hit& hit) const final;
+	void IntersectBatch(Ray* rays, Hit* hits, size_t count, bool coherent) const final;
+
+	// Everything allocated through the Embree device, as reported by its memory monitor, plus the sphere data
+	// the user geometry callbacks read
+	size_t GetMemoryUsage() const final;
+
+	const EmbreeConfig& GetConfig() const { return m_config; }
+
+	// User geometry data, referenced by the Embree callbacks.  Per-sphere geometries each point at one Sphere,
+	// the single sphere geometry at the SphereArrays, indexed by primitive id.
+	struct Sphere
+	{
+		Math::Vector3	center;
+		float			radius;
+		uint32_t		geomId;
+	};
+
+	struct SphereArrays
+	{
+		std::vector<float>	centerX;
+		std::vector<float>	centerY;
+		std::vector<float>	centerZ;
+		std::vector<float>	radius;
+	};
+
+	struct Plane
+	{
+		Math::Vector3	normal;
+		float			distance;
+		uint32_t		geomId;
+	};
+
+private:
+	static bool MemoryMonitor(void* userPtr, ssize_t bytes, bool post);
+
+	void AttachUserGeometry(uint32_t geomId, uint32_t numPrimitives, void* userData, RTCBoundsFunction boundsFunc, RTCIntersectFunctionN intersectFunc);
+	void AttachSpherePoints(uint32_t geomId, const SceneDesc& desc);
+
+	template <int N>
+	void IntersectPackets(Ray* rays, Hit* hits, size_t count) const;
+	void IntersectStream(Ray* rays, Hit* hits, size_t count) const;
+
+	// Copies an Embree hit, if there is one, back to ray and hit
+	void ResolveHit(float NgX, float NgY, float NgZ, uint32_t geomID, uint32_t primID, float tfar, Ray& ray, Hit& hit) const;
+
+private:
+	RTCDevice				m_device{ nullptr };
+	RTCScene				m_scene{ nullptr };
+	EmbreeConfig			m_config;
+	std::string				m_name;
+
+	std::vector<Sphere>		m_spheres;
+	SphereArrays			m_sphereArrays;
+	Plane					m_ground;
+
+	// With a single sphere geometry, its hits map to scene description ids m_sphereBaseId + primitive id
+	uint32_t				m_sphereGeomId{ RTC_INVALID_GEOMETRY_ID };
+	uint32_t				m_sphereBaseId{ 0 };
+
+	std::atomic<int64_t>	m_memoryUsage{ 0 };
+};
\ No newline at end of file
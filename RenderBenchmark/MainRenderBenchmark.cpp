@@ -0,0 +1,641 @@
+//
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+
+#include "stdafx.h"
+
+#include "Camera.h"
+#include "EmbreeTracer.h"
+#include "Image.h"
+#include "NativeTracer.h"
+#include "Renderer.h"
+#include "ReplicatedTracer.h"
+#include "SceneGenerator.h"
+#include "Timer.h"
+#include "WorkerPool.h"
+
+using namespace std;
+using namespace Math;
+
+
+// Sweep parameters.  Each sweep varies one axis of the base configuration and keeps the others fixed.  Every
+// run generates its scene from SCENE_SEED, so all backends trace identical input, and each data point is the
+// fastest of NUM_REPETITIONS runs, each with a freshly built tracer.
+constexpr uint32_t SCENE_SEED = 1524374227u;
+constexpr int NUM_REPETITIONS = 3;
+
+constexpr int BASE_WIDTH = 640;
+constexpr int BASE_HEIGHT = 360;
+constexpr int BASE_SAMPLES = 4;
+constexpr int BASE_GRID_SIZE = 11;
+
+constexpr int RESOLUTIONS[][2] = { { 320, 180 }, { 640, 360 }, { 1280, 720 } };
+constexpr int SAMPLE_COUNTS[] = { 1, 4, 16 };
+constexpr int GRID_SIZES[] = { 5, 11, 22, 44 };
+
+// The scene memory sweep needs more scene data than the dTLB covers with 4 KB pages: about 250k spheres, or 8 MB
+constexpr int MEMORY_GRID_SIZE = 256;
+constexpr SceneMemory SCENE_MEMORIES[] = { SceneMemory::Heap, SceneMemory::Arena, SceneMemory::LargePageArena };
+
+// The sphere layout sweep runs at the same size, so the leaves are scattered well beyond the caches
+constexpr SphereLayout SPHERE_LAYOUTS[] = { SphereLayout::SoA, SphereLayout::AoSoA };
+
+// The BVH node format sweep compares full precision, quantized and treelet ordered nodes at about 250k and 1M
+// spheres, where the nodes no longer fit in the caches
+constexpr int NODE_FORMAT_GRID_SIZES[] = { MEMORY_GRID_SIZE, 500 };
+constexpr BvhNodeFormat BVH_NODE_FORMATS[] = { BvhNodeFormat::Full, BvhNodeFormat::Quantized, BvhNodeFormat::Treelet };
+
+// The Embree sweep compares scene layouts and build qualities at about 500 and 1M spheres
+constexpr int EMBREE_GRID_SIZES[] = { 11, 500 };
+constexpr EmbreeConfig EMBREE_CONFIGS[] =
+{
+	{ EmbreeGeometry::PerSphere, RTC_BUILD_QUALITY_MEDIUM },
+	{ EmbreeGeometry::UserGeometry, RTC_BUILD_QUALITY_LOW },
+	{ EmbreeGeometry::UserGeometry, RTC_BUILD_QUALITY_MEDIUM },
+	{ EmbreeGeometry::UserGeometry, RTC_BUILD_QUALITY_HIGH },
+	{ EmbreeGeometry::SpherePoints, RTC_BUILD_QUALITY_MEDIUM }
+};
+
+// The grid sweep compares the spheres in a uniform grid against the BVH, at about 100k and 1M spheres, and against
+// a linear scan over every sphere at 100k.  At 1M spheres the linear scan takes hours per render.
+constexpr int GRID_ACCEL_GRID_SIZES[] = { 158, 500 };
+constexpr int LINEAR_MAX_GRID_SIZE = 158;
+
+// The sorted sweep covers the mid-size scenes the Morton-sorted blocks are meant for, about 2k and 25k spheres
+constexpr int SORTED_GRID_SIZES[] = { 22, 80 };
+
+// The tile culling sweep renders a small scene, where most tiles see few enough spheres to cull, and a larger one
+constexpr int CULLING_GRID_SIZES[] = { 11, 44 };
+
+constexpr const char* DEFAULT_OUTPUT_BASENAME = "render_benchmark";
+
+
+struct BenchmarkRun
+{
+	const char*		sweep;
+	RenderConfig	config;
+	int				gridSize;
+
+	// Worker pool runs replicate the scene per NUMA node, the others use the PPL scheduler
+	bool			usePool{ false };
+	NodePlacement	placement{ NodePlacement::Compact };
+
+	// Engine backends only
+	SceneMemory		memory{ SceneMemory::Heap };
+
+	// Native backend only.  Runs of the sphere layout and BVH node format sweeps are skipped for the other backends.
+	SphereLayout	layout{ SphereLayout::SoA };
+	BvhNodeFormat	nodeFormat{ BvhNodeFormat::Full };
+	bool			nativeOnly{ false };
+
+	// Embree backend only.  Runs of the Embree sweep are skipped for the other backends.
+	EmbreeConfig	embree;
+	bool			embreeOnly{ false };
+
+	// The linear scan backend only runs where this is set, as a baseline
+	bool			linearBaseline{ false };
+
+	const char* GetScheduling() const
+	{
+		return !usePool ? "ppl" : (placement == NodePlacement::Compact ? "compact" : "scatter");
+	}
+
+	const char* GetMemoryName() const
+	{
+		return (memory == SceneMemory::Heap) ? "heap" : (memory == SceneMemory::Arena ? "arena" : "large-pages");
+	}
+
+	const char* GetLayoutName() const
+	{
+		return (layout == SphereLayout::SoA) ? "soa" : "aosoa";
+	}
+
+	const char* GetNodeFormatName() const
+	{
+		return (nodeFormat == BvhNodeFormat::Full) ? "full" : (nodeFormat == BvhNodeFormat::Quantized ? "quantized" : "treelet");
+	}
+
+	bool AppliesTo(const string& backend) const
+	{
+		// Embree manages its own memory
+		if ((backend == "engine-embree" || backend == "embree") && memory != SceneMemory::Heap)
+		{
+			return false;
+		}
+		if (backend == "engine-linear" && !linearBaseline)
+		{
+			return false;
+		}
+		if (nativeOnly)
+		{
+			return backend == "native";
+		}
+		return !embreeOnly || backend == "embree";
+	}
+};
+
+
+struct BenchmarkResult
+{
+	string			backend;
+	BenchmarkRun	run;
+	int				numThreads{ 0 };
+	int				numNodes{ 1 };
+	size_t			numPrimitives{ 0 };
+	double			buildSeconds{ 0.0 };
+	size_t			memoryBytes{ 0 };
+	bool			largePages{ false };
+	EmbreeConfig	embree;		// As built, when the backend is Embree
+	RenderStats		stats;
+
+	double GetPrimaryRaysPerSecond() const { return static_cast<double>(stats.primaryRays) / stats.seconds; }
+	double GetTotalRaysPerSecond() const { return static_cast<double>(stats.totalRays) / stats.seconds; }
+	double GetBytesPerPrimitive() const { return static_cast<double>(memoryBytes) / static_cast<double>(numPrimitives); }
+
+	// Only measured in the scene memory sweep, and only where hardware counters are available
+	bool HasDtlbMisses() const { return stats.counters.IsValid(PERF_DTLB_MISSES); }
+	double GetDtlbMissesPerRay() const { return static_cast<double>(stats.counters.values[PERF_DTLB_MISSES]) / static_cast<double>(stats.totalRays); }
+
+	// Measured in the scene memory, sphere layout and BVH node format sweeps
+	bool HasCacheMisses() const { return stats.counters.IsValid(PERF_L1D_MISSES) && stats.counters.IsValid(PERF_LLC_MISSES); }
+	double GetL1dMissesPerRay() const { return static_cast<double>(stats.counters.values[PERF_L1D_MISSES]) / static_cast<double>(stats.totalRays); }
+	double GetLlcMissesPerRay() const { return static_cast<double>(stats.counters.values[PERF_LLC_MISSES]) / static_cast<double>(stats.totalRays); }
+
+	// Only measured in the node fetch runs of the BVH node format sweep, on every platform
+	bool HasNodeFetches() const { return stats.counters.IsValid(PERF_NODE_LINES) && stats.counters.IsValid(PERF_NODE_PAGES); }
+	double GetNodeLinesPerRay() const { return static_cast<double>(stats.counters.values[PERF_NODE_LINES]) / static_cast<double>(stats.totalRays); }
+	double GetNodePagesPerRay() const { return static_cast<double>(stats.counters.values[PERF_NODE_PAGES]) / static_cast<double>(stats.totalRays); }
+};
+
+
+int GetHardwareThreads()
+{
+	return max(static_cast<int>(thread::hardware_concurrency()), 1);
+}
+
+
+unique_ptr<ITracer> CreateTracer(const string& backend, const BenchmarkRun& run)
+{
+	if (backend == "native")
+	{
+		return make_unique<NativeTracer>(NativeTracerConfig{ run.memory, SceneBackend::Native, run.layout, run.nodeFormat });
+	}
+	else if (backend == "engine-grid")
+	{
+		return make_unique<NativeTracer>(NativeTracerConfig{ run.memory, SceneBackend::Grid });
+	}
+	else if (backend == "engine-kdtree")
+	{
+		return make_unique<NativeTracer>(NativeTracerConfig{ run.memory, SceneBackend::KdTree });
+	}
+	else if (backend == "engine-sorted")
+	{
+		return make_unique<NativeTracer>(NativeTracerConfig{ run.memory, SceneBackend::Sorted });
+	}
+	else if (backend == "engine-linear")
+	{
+		return make_unique<NativeTracer>(NativeTracerConfig{ run.memory, SceneBackend::Linear });
+	}
+	else if (backend == "engine-embree")
+	{
+		// The engine's scene and renderer, with the spheres in an EmbreeAccelerator
+		return make_unique<NativeTracer>(NativeTracerConfig{ run.memory, SceneBackend::Embree });
+	}
+	else if (backend == "embree")
+	{
+		return make_unique<EmbreeTracer>(run.embree);
+	}
+	return nullptr;
+}
+
+
+vector<BenchmarkRun> GetSweep()
+{
+	RenderConfig base;
+	base.width = BASE_WIDTH;
+	base.height = BASE_HEIGHT;
+	base.samples = BASE_SAMPLES;
+
+	vector<BenchmarkRun> runs;
+
+	for (const auto& resolution : RESOLUTIONS)
+	{
+		BenchmarkRun run{ "resolution", base, BASE_GRID_SIZE };
+		run.config.width = resolution[0];
+		run.config.height = resolution[1];
+		runs.push_back(run);
+	}
+
+	for (int samples : SAMPLE_COUNTS)
+	{
+		BenchmarkRun run{ "samples", base, BASE_GRID_SIZE };
+		run.config.samples = samples;
+		runs.push_back(run);
+	}
+
+	for (int gridSize : GRID_SIZES)
+	{
+		runs.push_back(BenchmarkRun{ "scene", base, gridSize });
+	}
+
+	// Powers of two, then every hardware thread.  Once with the PPL scheduler, then with workers pinned to cores,
+	// filling one NUMA node at a time (compact) or spreading them over all nodes (scatter).
+	const int hardwareThreads = GetHardwareThreads();
+	for (bool usePool : { false, true })
+	{
+		for (int numThreads = 1; ; numThreads *= 2)
+		{
+			BenchmarkRun run{ usePool ? "numa" : "threads", base, BASE_GRID_SIZE };
+			run.config.numThreads = min(numThreads, hardwareThreads);
+
+			if (usePool)
+			{
+				run.usePool = true;
+				run.placement = NodePlacement::Compact;
+				runs.push_back(run);
+				run.placement = NodePlacement::Scatter;
+			}
+			runs.push_back(run);
+
+			if (numThreads >= hardwareThreads)
+			{
+				break;
+			}
+		}
+	}
+
+	// Heap allocations against one arena, on regular and large pages, with hardware counters for the dTLB misses
+	for (SceneMemory memory : SCENE_MEMORIES)
+	{
+		BenchmarkRun run{ "memory", base, MEMORY_GRID_SIZE };
+		run.config.perfCounters = true;
+		run.memory = memory;
+		runs.push_back(run);
+	}
+
+	// Sphere leaf data in separate arrays against blocks of 8 spheres, with hardware counters for the cache misses
+	for (SphereLayout layout : SPHERE_LAYOUTS)
+	{
+		BenchmarkRun run{ "layout", base, MEMORY_GRID_SIZE };
+		run.config.perfCounters = true;
+		run.layout = layout;
+		run.nativeOnly = true;
+		runs.push_back(run);
+	}
+
+	// Full precision BVH nodes against quantized and treelet ordered ones, for memory and rays per second, with
+	// hardware counters for the cache misses.  The node lines and pages each ray reads are counted in runs of their
+	// own, since counting them slows traversal down.
+	for (int gridSize : NODE_FORMAT_GRID_SIZES)
+	{
+		for (BvhNodeFormat nodeFormat : BVH_NODE_FORMATS)
+		{
+			BenchmarkRun run{ "nodes", base, gridSize };
+			run.config.perfCounters = true;
+			run.nodeFormat = nodeFormat;
+			run.nativeOnly = true;
+			runs.push_back(run);
+
+			run.sweep = "node-fetches";
+			run.config.countNodeFetches = true;
+			runs.push_back(run);
+		}
+	}
+
+	// Tiles traced in ray batches, as packets and streams in Embree, against the base configuration
+	{
+		BenchmarkRun run{ "batches", base, BASE_GRID_SIZE };
+		run.config.rayBatches = true;
+		run.embree.useStreams = true;
+		runs.push_back(run);
+	}
+
+	// Camera rays traced against the spheres culled to each tile's frustum, against the base configuration
+	for (int gridSize : CULLING_GRID_SIZES)
+	{
+		BenchmarkRun run{ "culling", base, gridSize };
+		run.config.tileCulling = true;
+		runs.push_back(run);
+	}
+
+	// Large, evenly spread scenes, where the uniform grid should pull ahead of the BVH, and both far ahead of the
+	// linear scan
+	for (int gridSize : GRID_ACCEL_GRID_SIZES)
+	{
+		BenchmarkRun run{ "grid", base, gridSize };
+		run.linearBaseline = (gridSize <= LINEAR_MAX_GRID_SIZE);
+		runs.push_back(run);
+	}
+
+	// Mid-size scenes, where the sorted blocks should come close to the BVH for a fraction of its build time
+	for (int gridSize : SORTED_GRID_SIZES)
+	{
+		runs.push_back(BenchmarkRun{ "sorted", base, gridSize });
+	}
+
+	// One Embree geometry per sphere against all spheres in one geometry, at each build quality
+	for (int gridSize : EMBREE_GRID_SIZES)
+	{
+		for (const auto& embree : EMBREE_CONFIGS)
+		{
+			BenchmarkRun run{ "embree", base, gridSize };
+			run.embree = embree;
+			run.embreeOnly = true;
+			runs.push_back(run);
+		}
+	}
+
+	return runs;
+}
+
+
+BenchmarkResult RunBenchmark(const string& backend, const BenchmarkRun& run)
+{
+	SceneDesc desc;
+	GenerateRandomScene(SCENE_SEED, run.gridSize, desc);
+
+	Camera camera;
+	camera.LookAt(desc.cameraPos, desc.cameraTarget, Vector3(kYUnitVector), desc.fovY, run.config.GetAspect(), desc.aperture, desc.focusDist);
+
+	BenchmarkResult result;
+	result.backend = backend;
+	result.run = run;
+	result.numThreads = (run.config.numThreads > 0) ? run.config.numThreads : GetHardwareThreads();
+	result.numPrimitives = desc.GetNumPrimitives();
+
+	for (int i = 0; i < NUM_REPETITIONS; ++i)
+	{
+		RenderConfig config = run.config;
+
+		unique_ptr<WorkerPool> pool;
+		unique_ptr<ITracer> tracer;
+		if (run.usePool)
+		{
+			pool = make_unique<WorkerPool>(WorkerPoolConfig{ config.numThreads, ThreadPinning::Core, run.placement });
+			config.pool = pool.get();
+			result.numNodes = pool->GetNumNodes();
+			tracer = make_unique<ReplicatedTracer>(*pool, [&] { return CreateTracer(backend, run); });
+		}
+		else
+		{
+			tracer = CreateTracer(backend, run);
+		}
+
+		Timer timer;
+		timer.Start();
+		tracer->Build(desc);
+		timer.Stop();
+
+		if (auto nativeTracer = dynamic_cast<NativeTracer*>(tracer.get()))
+		{
+			result.largePages = nativeTracer->GetScene().HasLargePages();
+		}
+		else if (auto embreeTracer = dynamic_cast<EmbreeTracer*>(tracer.get()))
+		{
+			result.embree = embreeTracer->GetConfig();
+		}
+
+		Image image(config.width, config.height);
+
+		RenderStats stats = RenderImage(*tracer, desc.materials, camera, config, image);
+
+		if (i == 0 || timer.GetElapsedSeconds() < result.buildSeconds)
+		{
+			result.buildSeconds = timer.GetElapsedSeconds();
+		}
+		if (i == 0 || stats.seconds < result.stats.seconds)
+		{
+			result.stats = stats;
+		}
+		result.memoryBytes = tracer->GetMemoryUsage();
+	}
+
+	return result;
+}
+
+
+void LogResult(const BenchmarkResult& result)
+{
+	const auto& config = result.run.config;
+
+	stringstream sstr;
+	sstr.precision(4);
+	sstr << result.backend << " " << result.run.sweep << ": " << config.width << " x " << config.height << ", " << config.samples << " spp, ";
+	sstr << result.numPrimitives << " primitives, " << result.numThreads << " threads (" << result.run.GetScheduling() << ", " << result.numNodes << " nodes)" << endl;
+	sstr << "  Build " << 1000.0 * result.buildSeconds << " ms, " << result.memoryBytes / 1024 << " KB (" << result.GetBytesPerPrimitive() << " bytes per primitive), render " << result.stats.seconds << " s" << endl;
+	sstr << "  Primary rays per second: " << result.GetPrimaryRaysPerSecond() << ", total rays per second: " << result.GetTotalRaysPerSecond() << endl;
+	if (result.run.memory != SceneMemory::Heap || result.HasDtlbMisses())
+	{
+		sstr << "  Scene memory: " << result.run.GetMemoryName() << (result.largePages ? " (large pages)" : "");
+		if (result.HasDtlbMisses())
+		{
+			sstr << ", dTLB misses per ray: " << result.GetDtlbMissesPerRay();
+		}
+		sstr << endl;
+	}
+	if (result.run.nativeOnly || result.HasCacheMisses())
+	{
+		sstr << "  Sphere layout: " << result.run.GetLayoutName() << ", BVH nodes: " << result.run.GetNodeFormatName();
+		if (result.HasCacheMisses())
+		{
+			sstr << ", L1D misses per ray: " << result.GetL1dMissesPerRay() << ", LLC misses per ray: " << result.GetLlcMissesPerRay();
+		}
+		if (result.HasNodeFetches())
+		{
+			sstr << ", node lines per ray: " << result.GetNodeLinesPerRay() << ", node pages per ray: " << result.GetNodePagesPerRay();
+		}
+		sstr << endl;
+	}
+	if (result.backend == "embree")
+	{
+		sstr << "  Embree geometry: " << GetEmbreeGeometryName(result.embree.geometry) << ", build quality: " << GetEmbreeBuildQualityName(result.embree.buildQuality) << endl;
+	}
+	OutputDebugStringA(sstr.str().c_str());
+	cout << sstr.str();
+}
+
+
+bool WriteCsv(const string& filename, const vector<BenchmarkResult>& results)
+{
+	ofstream outfile;
+	outfile.open(filename, ios::out | ios::trunc);
+	if (!outfile.is_open())
+	{
+		return false;
+	}
+
+	outfile.precision(12);
+	outfile << "backend,sweep,width,height,samples,gridSize,primitives,threads,scheduling,nodes,buildSeconds,memoryBytes,bytesPerPrimitive,renderSeconds,";
+	outfile << "primaryRays,totalRays,primaryRaysPerSecond,totalRaysPerSecond,sceneMemory,largePages,dtlbMissesPerRay,";
+	outfile << "sphereLayout,bvhNodes,l1dMissesPerRay,llcMissesPerRay,nodeLinesPerRay,nodePagesPerRay,";
+	outfile << "embreeGeometry,buildQuality" << endl;
+
+	for (const auto& result : results)
+	{
+		const auto& config = result.run.config;
+		outfile << result.backend << "," << result.run.sweep << "," << config.width << "," << config.height << "," << config.samples << ",";
+		outfile << result.run.gridSize << "," << result.numPrimitives << "," << result.numThreads << "," << result.run.GetScheduling() << ",";
+		outfile << result.numNodes << "," << result.buildSeconds << ",";
+		outfile << result.memoryBytes << "," << result.GetBytesPerPrimitive() << "," << result.stats.seconds << "," << result.stats.primaryRays << "," << result.stats.totalRays << ",";
+		outfile << result.GetPrimaryRaysPerSecond() << "," << result.GetTotalRaysPerSecond() << "," << result.run.GetMemoryName() << ",";
+		outfile << (result.largePages ? 1 : 0) << ",";
+		if (result.HasDtlbMisses())
+		{
+			outfile << result.GetDtlbMissesPerRay();
+		}
+		outfile << "," << result.run.GetLayoutName() << "," << result.run.GetNodeFormatName() << ",";
+		if (result.HasCacheMisses())
+		{
+			outfile << result.GetL1dMissesPerRay() << "," << result.GetLlcMissesPerRay();
+		}
+		else
+		{
+			outfile << ",";
+		}
+		outfile << ",";
+		if (result.HasNodeFetches())
+		{
+			outfile << result.GetNodeLinesPerRay() << "," << result.GetNodePagesPerRay();
+		}
+		else
+		{
+			outfile << ",";
+		}
+		outfile << ",";
+		if (result.backend == "embree")
+		{
+			outfile << GetEmbreeGeometryName(result.embree.geometry) << "," << GetEmbreeBuildQualityName(result.embree.buildQuality);
+		}
+		else
+		{
+			outfile << ",";
+		}
+		outfile << endl;
+	}
+
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+bool WriteJson(const string& filename, const vector<BenchmarkResult>& results)
+{
+	ofstream outfile;
+	outfile.open(filename, ios::out | ios::trunc);
+	if (!outfile.is_open())
+	{
+		return false;
+	}
+
+	outfile.precision(12);
+	outfile << "{" << endl;
+	outfile << "  \"seed\": " << SCENE_SEED << "," << endl;
+	outfile << "  \"repetitions\": " << NUM_REPETITIONS << "," << endl;
+	outfile << "  \"results\": [" << endl;
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& result = results[i];
+		const auto& config = result.run.config;
+		outfile << "    { \"backend\": \"" << result.backend << "\", \"sweep\": \"" << result.run.sweep << "\"";
+		outfile << ", \"width\": " << config.width << ", \"height\": " << config.height << ", \"samples\": " << config.samples;
+		outfile << ", \"gridSize\": " << result.run.gridSize << ", \"primitives\": " << result.numPrimitives << ", \"threads\": " << result.numThreads;
+		outfile << ", \"scheduling\": \"" << result.run.GetScheduling() << "\", \"nodes\": " << result.numNodes;
+		outfile << ", \"buildSeconds\": " << result.buildSeconds << ", \"memoryBytes\": " << result.memoryBytes << ", \"bytesPerPrimitive\": " << result.GetBytesPerPrimitive();
+		outfile << ", \"renderSeconds\": " << result.stats.seconds << ", \"primaryRays\": " << result.stats.primaryRays << ", \"totalRays\": " << result.stats.totalRays;
+		outfile << ", \"primaryRaysPerSecond\": " << result.GetPrimaryRaysPerSecond() << ", \"totalRaysPerSecond\": " << result.GetTotalRaysPerSecond();
+		outfile << ", \"sceneMemory\": \"" << result.run.GetMemoryName() << "\", \"largePages\": " << (result.largePages ? "true" : "false");
+		if (result.HasDtlbMisses())
+		{
+			outfile << ", \"dtlbMissesPerRay\": " << result.GetDtlbMissesPerRay();
+		}
+		outfile << ", \"sphereLayout\": \"" << result.run.GetLayoutName() << "\", \"bvhNodes\": \"" << result.run.GetNodeFormatName() << "\"";
+		if (result.HasCacheMisses())
+		{
+			outfile << ", \"l1dMissesPerRay\": " << result.GetL1dMissesPerRay() << ", \"llcMissesPerRay\": " << result.GetLlcMissesPerRay();
+		}
+		if (result.HasNodeFetches())
+		{
+			outfile << ", \"nodeLinesPerRay\": " << result.GetNodeLinesPerRay() << ", \"nodePagesPerRay\": " << result.GetNodePagesPerRay();
+		}
+		if (result.backend == "embree")
+		{
+			outfile << ", \"embreeGeometry\": \"" << GetEmbreeGeometryName(result.embree.geometry) << "\"";
+			outfile << ", \"buildQuality\": \"" << GetEmbreeBuildQualityName(result.embree.buildQuality) << "\"";
+		}
+		outfile << " }";
+		outfile << (i + 1 < results.size() ? "," : "") << endl;
+	}
+
+	outfile << "  ]" << endl;
+	outfile << "}" << endl;
+
+	outfile.close();
+	return !outfile.fail();
+}
+
+
+// Usage: RenderBenchmark [native|engine-grid|engine-kdtree|engine-sorted|engine-linear|engine-embree|embree|all] [output basename]
+// Writes <basename>.csv and <basename>.json
+int main(int argc, char** argv)
+{
+	const string backendArg = (argc > 1) ? argv[1] : "all";
+	const string outputBasename = (argc > 2) ? argv[2] : DEFAULT_OUTPUT_BASENAME;
+
+	const vector<string> allBackends = { "native", "engine-grid", "engine-kdtree", "engine-sorted", "engine-linear", "engine-embree", "embree" };
+
+	vector<string> backends;
+	if (backendArg == "all")
+	{
+		backends = allBackends;
+	}
+	else if (find(allBackends.begin(), allBackends.end(), backendArg) != allBackends.end())
+	{
+		backends = { backendArg };
+	}
+	else
+	{
+		cerr << "Unknown backend " << backendArg << ", expected native, engine-grid, engine-kdtree, engine-sorted, engine-linear, engine-embree, embree or all" << endl;
+		return 1;
+	}
+
+	// The engine's Embree backend is only there when the engine is built with the UseEmbree property
+	if (!Scene::IsBackendAvailable(SceneBackend::Embree))
+	{
+		if (backendArg == "engine-embree")
+		{
+			cerr << "The engine was built without Embree, rebuild it with /p:UseEmbree=true for engine-embree" << endl;
+			return 1;
+		}
+		backends.erase(remove(backends.begin(), backends.end(), "engine-embree"), backends.end());
+	}
+
+	vector<BenchmarkResult> results;
+	for (const auto& run : GetSweep())
+	{
+		for (const auto& backend : backends)
+		{
+			if (!run.AppliesTo(backend))
+			{
+				continue;
+			}
+
+			results.push_back(RunBenchmark(backend, run));
+			LogResult(results.back());
+		}
+	}
+
+	bool written = WriteCsv(outputBasename + ".csv", results);
+	written = WriteJson(outputBasename + ".json", results) && written;
+	if (!written)
+	{
+		cerr << "Failed to write " << outputBasename << ".csv/.json" << endl;
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file